@@ -1 +1,242 @@
-#include "ast.h"
\ No newline at end of file
+#include "ast.h"
+
+#include "memo/memo_cache.h"
+
+namespace simp {
+
+int64_t CallExpression::evaluate_with_cache(Environment& environment,
+                                            Function& callee) {
+  MemoCache* memo_cache = environment.memo_cache();
+  Environment frame(callee.frame_size(), environment.functions(), memo_cache);
+  int64_t arguments[MemoCache::kMaxArguments];
+  for (size_t i = 0; i < arguments_.size(); ++i) {
+    int64_t argument = arguments_[i]->evaluate(environment);
+    frame.set(i, argument);
+    if (i < MemoCache::kMaxArguments) {
+      arguments[i] = argument;
+    }
+  }
+  if (!memo_cache->memoized(function_)) {
+    return callee.body()->evaluate(frame);
+  }
+  int64_t result;
+  if (!memo_cache->lookup(function_, arguments, arguments_.size(), result)) {
+    result = callee.body()->evaluate(frame);
+    memo_cache->insert(function_, arguments, arguments_.size(), result);
+  }
+  return result;
+}
+
+size_t count_nodes(Expression* expression) {
+  if (!expression) {
+    return 0;
+  }
+  switch (expression->type()) {
+    case ExpressionType::INTEGER:
+    case ExpressionType::IDENTIFIER:
+      return 1;
+    case ExpressionType::PARENTHESIS:
+      return 1 + count_nodes(static_cast<ParenthesizedExpression*>(expression)
+                                 ->expression()
+                                 .get());
+    case ExpressionType::NOT:
+      return 1 + count_nodes(
+                     static_cast<NotExpression*>(expression)->expression().get());
+    case ExpressionType::NEGATIVE:
+      return 1 + count_nodes(static_cast<NegativeExpression*>(expression)
+                                 ->expression()
+                                 .get());
+    case ExpressionType::IF: {
+      auto if_expression = static_cast<IfExpression*>(expression);
+      return 1 + count_nodes(if_expression->condition().get()) +
+             count_nodes(if_expression->consequent().get()) +
+             count_nodes(if_expression->alternative().get());
+    }
+    case ExpressionType::BINARY: {
+      auto binary = static_cast<BinaryExpression*>(expression);
+      return 1 + count_nodes(binary->left().get()) +
+             count_nodes(binary->right().get());
+    }
+    case ExpressionType::LET:
+    case ExpressionType::LOOP: {
+      bool let = expression->type() == ExpressionType::LET;
+      Bindings& bindings =
+          let ? static_cast<LetExpression*>(expression)->bindings()
+              : static_cast<LoopExpression*>(expression)->bindings();
+      size_t count =
+          1 + count_nodes(
+                  let ? static_cast<LetExpression*>(expression)
+                            ->expression()
+                            .get()
+                      : static_cast<LoopExpression*>(expression)
+                            ->expression()
+                            .get());
+      for (const auto& binding : bindings) {
+        count += 1 + count_nodes(binding->expression().get());
+      }
+      return count;
+    }
+    case ExpressionType::RECUR: {
+      size_t count = 1;
+      for (const auto& argument :
+           static_cast<RecurExpression*>(expression)->arguments()) {
+        count += count_nodes(argument.get());
+      }
+      return count;
+    }
+    case ExpressionType::CALL: {
+      size_t count = 1;
+      for (const auto& argument :
+           static_cast<CallExpression*>(expression)->arguments()) {
+        count += count_nodes(argument.get());
+      }
+      return count;
+    }
+    case ExpressionType::INTRINSIC: {
+      size_t count = 1;
+      for (const auto& argument :
+           static_cast<IntrinsicExpression*>(expression)->arguments()) {
+        count += count_nodes(argument.get());
+      }
+      return count;
+    }
+  }
+  return 1;
+}
+
+size_t count_nodes(Ast& ast) {
+  size_t count = count_nodes(ast.root().get());
+  for (const auto& function : ast.functions()) {
+    count += count_nodes(function->body().get());
+  }
+  return count;
+}
+
+namespace {
+// Feeds the nodes of an Ast, in prefix order, to a 64-bit FNV-1a hash. Every
+// node starts with its type and every list with its length, so two different
+// trees never feed the same bytes.
+class Fingerprinter {
+ public:
+  uint64_t hash() { return hash_; }
+
+  void add(uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+      hash_ = (hash_ ^ ((value >> (8 * i)) & 0xff)) * 0x100000001b3;
+    }
+  }
+  void add(const std::string& text) {
+    add(text.size());
+    for (char c : text) {
+      hash_ = (hash_ ^ static_cast<uint8_t>(c)) * 0x100000001b3;
+    }
+  }
+  void add(const std::vector<std::unique_ptr<Expression>>& expressions) {
+    add(expressions.size());
+    for (const auto& expression : expressions) {
+      add(expression.get());
+    }
+  }
+  void add(Bindings& bindings) {
+    add(bindings.size());
+    for (const auto& binding : bindings) {
+      add(binding->name());
+      add(binding->expression().get());
+    }
+  }
+
+  void add(Expression* expression) {
+    if (!expression) {
+      add(uint64_t{0xff});
+      return;
+    }
+    add(static_cast<uint64_t>(expression->type()));
+    switch (expression->type()) {
+      case ExpressionType::INTEGER:
+        add(static_cast<uint64_t>(
+            static_cast<IntExpression*>(expression)->value()));
+        return;
+      case ExpressionType::IDENTIFIER:
+        add(static_cast<IdentifierExpression*>(expression)->name());
+        return;
+      case ExpressionType::PARENTHESIS:
+        add(static_cast<ParenthesizedExpression*>(expression)
+                ->expression()
+                .get());
+        return;
+      case ExpressionType::NOT:
+        add(static_cast<NotExpression*>(expression)->expression().get());
+        return;
+      case ExpressionType::NEGATIVE:
+        add(static_cast<NegativeExpression*>(expression)->expression().get());
+        return;
+      case ExpressionType::IF: {
+        auto if_expression = static_cast<IfExpression*>(expression);
+        add(if_expression->condition().get());
+        add(if_expression->consequent().get());
+        add(if_expression->alternative().get());
+        return;
+      }
+      case ExpressionType::BINARY: {
+        auto binary = static_cast<BinaryExpression*>(expression);
+        add(static_cast<uint64_t>(binary->op()));
+        add(binary->left().get());
+        add(binary->right().get());
+        return;
+      }
+      case ExpressionType::LET: {
+        auto let = static_cast<LetExpression*>(expression);
+        add(let->bindings());
+        add(let->expression().get());
+        return;
+      }
+      case ExpressionType::LOOP: {
+        auto loop = static_cast<LoopExpression*>(expression);
+        add(loop->bindings());
+        add(loop->expression().get());
+        return;
+      }
+      case ExpressionType::RECUR:
+        add(static_cast<RecurExpression*>(expression)->arguments());
+        return;
+      case ExpressionType::CALL: {
+        auto call = static_cast<CallExpression*>(expression);
+        add(call->function());
+        add(call->name());
+        add(call->arguments());
+        return;
+      }
+      case ExpressionType::INTRINSIC: {
+        auto intrinsic = static_cast<IntrinsicExpression*>(expression);
+        add(static_cast<uint64_t>(intrinsic->intrinsic()));
+        add(intrinsic->arguments());
+        return;
+      }
+    }
+  }
+
+ private:
+  uint64_t hash_ = 0xcbf29ce484222325;
+};
+}  // namespace
+
+uint64_t fingerprint(Ast& ast) {
+  Fingerprinter fingerprinter;
+  fingerprinter.add(ast.functions().size());
+  for (const auto& function : ast.functions()) {
+    fingerprinter.add(function->name());
+    fingerprinter.add(function->parameters().size());
+    for (const std::string& parameter : function->parameters()) {
+      fingerprinter.add(parameter);
+    }
+    fingerprinter.add(function->body().get());
+  }
+  fingerprinter.add(ast.inputs().size());
+  for (const std::string& input : ast.inputs()) {
+    fingerprinter.add(input);
+  }
+  fingerprinter.add(ast.root().get());
+  return fingerprinter.hash();
+}
+
+}  // namespace simp
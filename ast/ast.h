@@ -1,15 +1,23 @@
 #pragma once
+#include <cstdint>
 #include <iostream>
 #include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
 
 #undef GOOGLE_STRIP_LOG
-#define GOOGLE_STRIP_LOG 0
+#define GOOGLE_STRIP_LOG 1
 #include <glog/logging.h>
 
+#include "ast/intrinsics.h"
+#include "ast/source_map.h"
 #include "tokens/tokens.h"
+#include "trace/trace.h"
 
 namespace simp {
-enum class ExpressionType {
+enum class ExpressionType : uint8_t {
   INTEGER,
   IF,
   NOT,
@@ -18,8 +26,85 @@ enum class ExpressionType {
   BINARY,
   LET,
   IDENTIFIER,
-  // RECUR,
-  // LOOP,
+  RECUR,
+  LOOP,
+  CALL,
+  INTRINSIC,
+};
+
+// SimpLang integers are signed 64 bit values that wrap around on overflow.
+inline int64_t wrapping_add(int64_t left, int64_t right) {
+  return static_cast<int64_t>(static_cast<uint64_t>(left) +
+                              static_cast<uint64_t>(right));
+}
+
+inline int64_t wrapping_multiply(int64_t left, int64_t right) {
+  return static_cast<int64_t>(static_cast<uint64_t>(left) *
+                              static_cast<uint64_t>(right));
+}
+
+inline int64_t wrapping_negate(int64_t value) {
+  return static_cast<int64_t>(-static_cast<uint64_t>(value));
+}
+
+class Function;
+class MemoCache;
+// Functions in definition order. A call names its callee by index here.
+using Functions = std::vector<std::unique_ptr<Function>>;
+
+// Runtime state of the tree evaluator: one slot per variable, indexed by the
+// frame slot the Resolver assigned, and the argument values of a recur that is
+// on its way to its loop. Every call gets an Environment of its own, which
+// shares the caller's MemoCache, if any.
+class Environment {
+ public:
+  Environment(size_t frame_size = 0, const Functions* functions = nullptr,
+              MemoCache* memo_cache = nullptr)
+      : slots_(frame_size), functions_(functions), memo_cache_(memo_cache) {}
+  const Functions* functions() const { return functions_; }
+  MemoCache* memo_cache() const { return memo_cache_; }
+  int64_t get(int slot) const {
+    if (slot < 0) {
+      unresolved();
+    }
+    return slots_[slot];
+  }
+  void set(int slot, int64_t value) {
+    if (slot < 0) {
+      unresolved();
+    }
+    if (static_cast<size_t>(slot) >= slots_.size()) {
+      slots_.resize(slot + 1);
+    }
+    slots_[slot] = value;
+  }
+
+  // A recur pushes its argument values and raises the flag. The enclosing
+  // if/let expressions return straight to the loop, which then stores them in
+  // its variable slots, so iterating never grows the native stack.
+  bool recurring() const { return recurring_; }
+  void push_recur_argument(int64_t value) { recur_arguments_.push_back(value); }
+  void start_recur() { recurring_ = true; }
+  void finish_recur(int base, size_t count) {
+    size_t first = recur_arguments_.size() - count;
+    for (size_t i = 0; i < count; ++i) {
+      slots_[base + i] = recur_arguments_[first + i];
+    }
+    recur_arguments_.resize(first);
+    recurring_ = false;
+  }
+
+ private:
+  [[noreturn]] static void unresolved() {
+    LOG(ERROR) << "Variable was not resolved to a slot";
+    throw std::runtime_error("Unresolved variable");
+  }
+
+  std::vector<int64_t> slots_;
+  std::vector<int64_t> recur_arguments_;
+  bool recurring_ = false;
+  const Functions* functions_;
+  MemoCache* memo_cache_;
 };
 
 class ParsePrintable {
@@ -34,62 +119,61 @@ class ParsePrintable {
     return result;
   }
 };
+// Nodes hold only their semantic children. Where a node came from lives in
+// the Ast's SourceMap, at index span().
 class Expression : public ParsePrintable {
  public:
-  Expression(ExpressionType type) : type_(type) {}
-  virtual int eval() = 0;
+  Expression(ExpressionType type, uint32_t span = SourceMap::kNoSpan)
+      : type_(type), span_(span) {}
+  virtual int64_t evaluate(Environment& environment) = 0;
+  int64_t eval() {
+    Environment environment;
+    return evaluate(environment);
+  }
 
   ExpressionType type() { return type_; }
+  uint32_t span() { return span_; }
   virtual ~Expression() {}
 
  private:
   ExpressionType type_;
+  uint32_t span_;
 };
 
 class IntExpression : public Expression {
  public:
-  IntExpression(int value)
-      : Expression(ExpressionType::INTEGER), value_(value) {}
-  int eval() override { return value_; }
+  IntExpression(int64_t value, uint32_t span = SourceMap::kNoSpan)
+      : Expression(ExpressionType::INTEGER, span), value_(value) {}
+  int64_t value() { return value_; }
+  int64_t evaluate(Environment&) override { return value_; }
 
   std::string to_string(int indent = 0) override {
     return spacing(indent) + std::to_string(value_);
   }
 
  private:
-  int value_;
+  int64_t value_;
 };
 class IfExpression : public Expression {
  public:
-  IfExpression(std::unique_ptr<KeywordToken> if_token,
-               std::unique_ptr<Expression> condition,
-               std::unique_ptr<KeywordToken> then_token,
+  IfExpression(std::unique_ptr<Expression> condition,
                std::unique_ptr<Expression> consequent,
-               std::unique_ptr<KeywordToken> else_token,
                std::unique_ptr<Expression> alternative,
-               std::unique_ptr<KeywordToken> end_token)
-      : Expression(ExpressionType::IF),
-        if_token_(std::move(if_token)),
+               uint32_t span = SourceMap::kNoSpan)
+      : Expression(ExpressionType::IF, span),
         condition_(std::move(condition)),
-        then_token_(std::move(then_token)),
         consequent_(std::move(consequent)),
-        else_token_(std::move(else_token)),
-        alternative_(std::move(alternative)),
-        end_token_(std::move(end_token)) {}
+        alternative_(std::move(alternative)) {}
 
-  std::unique_ptr<KeywordToken>& if_token() { return if_token_; }
-  std::unique_ptr<KeywordToken>& then_token() { return then_token_; }
-  std::unique_ptr<KeywordToken>& else_token() { return else_token_; }
   std::unique_ptr<Expression>& condition() { return condition_; }
   std::unique_ptr<Expression>& consequent() { return consequent_; }
   std::unique_ptr<Expression>& alternative() { return alternative_; }
-  std::unique_ptr<KeywordToken>& end_token() { return end_token_; }
 
-  int eval() override {
-    if (condition_->eval()) {
-      return consequent_->eval();
+  int64_t evaluate(Environment& environment) override {
+    if (condition_->evaluate(environment)) {
+      return consequent_->evaluate(environment);
     }
-    return alternative_->eval();
+    return alternative_->evaluate(environment);
   }
 
   std::string to_string(int indent = 0) override {
@@ -99,43 +183,45 @@ class IfExpression : public Expression {
   }
 
  private:
-  std::unique_ptr<KeywordToken> if_token_;
   std::unique_ptr<Expression> condition_;
-  std::unique_ptr<KeywordToken> then_token_;
   std::unique_ptr<Expression> consequent_;
-  std::unique_ptr<KeywordToken> else_token_;
   std::unique_ptr<Expression> alternative_;
-  std::unique_ptr<KeywordToken> end_token_;
 };
 
 class BinaryExpression : public Expression {
  public:
   BinaryExpression(std::unique_ptr<Expression> left,
-                   std::unique_ptr<Expression> right,
-                   std::unique_ptr<OperatorToken> operator_token)
-      : Expression(ExpressionType::IF),
+                   std::unique_ptr<Expression> right, Operator op,
+                   uint32_t span = SourceMap::kNoSpan)
+      : Expression(ExpressionType::BINARY, span),
         left_(std::move(left)),
         right_(std::move(right)),
-        operator_token_(std::move(operator_token)) {}
+        op_(op) {}
+
+  std::unique_ptr<Expression>& left() { return left_; }
+  std::unique_ptr<Expression>& right() { return right_; }
+  Operator op() { return op_; }
 
   std::string to_string(int indent = 0) override {
-    return spacing(indent) + op_to_string(operator_token_->op()) + "\n" +
+    return spacing(indent) + op_to_string(op_) + "\n" +
            left_->to_string(indent + 1) + "\n" + right_->to_string(indent + 1);
   }
 
-  int eval() override {
-    if (operator_token_->op() == Operator::PLUS) {
-      return left_->eval() + right_->eval();
-    } else if (operator_token_->op() == Operator::TIMES) {
-      return left_->eval() * right_->eval();
-    } else if (operator_token_->op() == Operator::LESS_THAN) {
-      return left_->eval() < right_->eval();
-    } else if (operator_token_->op() == Operator::LOGICAL_AND) {
-      return left_->eval() && right_->eval();
-    } else if (operator_token_->op() == Operator::LOGICAL_OR) {
-      return left_->eval() || right_->eval();
-    } else if (operator_token_->op() == Operator::EQUALS) {
-      return left_->eval() == right_->eval();
+  int64_t evaluate(Environment& environment) override {
+    if (op_ == Operator::PLUS) {
+      return wrapping_add(left_->evaluate(environment),
+                          right_->evaluate(environment));
+    } else if (op_ == Operator::TIMES) {
+      return wrapping_multiply(left_->evaluate(environment),
+                               right_->evaluate(environment));
+    } else if (op_ == Operator::LESS_THAN) {
+      return left_->evaluate(environment) < right_->evaluate(environment);
+    } else if (op_ == Operator::LOGICAL_AND) {
+      return left_->evaluate(environment) && right_->evaluate(environment);
+    } else if (op_ == Operator::LOGICAL_OR) {
+      return left_->evaluate(environment) || right_->evaluate(environment);
+    } else if (op_ == Operator::EQUALS) {
+      return left_->evaluate(environment) == right_->evaluate(environment);
     }
     return 0;
   }
@@ -143,20 +229,26 @@ class BinaryExpression : public Expression {
  private:
   std::unique_ptr<Expression> left_;
   std::unique_ptr<Expression> right_;
-  std::unique_ptr<OperatorToken> operator_token_;
+  Operator op_;
 };
 
 class NotExpression : public Expression {
  public:
-  NotExpression(std::unique_ptr<Expression> expression)
-      : Expression(ExpressionType::NOT), expression_(std::move(expression)) {}
+  NotExpression(std::unique_ptr<Expression> expression,
+                uint32_t span = SourceMap::kNoSpan)
+      : Expression(ExpressionType::NOT, span),
+        expression_(std::move(expression)) {}
 
   std::string to_string(int indent = 0) override {
     return spacing(indent) + "NotExpression:\n" +
            expression_->to_string(indent + 1);
   }
 
-  int eval() override { return !expression_->eval(); }
+  std::unique_ptr<Expression>& expression() { return expression_; }
+
+  int64_t evaluate(Environment& environment) override {
+    return !expression_->evaluate(environment);
+  }
 
  private:
   std::unique_ptr<Expression> expression_;
@@ -164,8 +256,9 @@ class NotExpression : public Expression {
 
 class NegativeExpression : public Expression {
  public:
-  NegativeExpression(std::unique_ptr<Expression> expression)
-      : Expression(ExpressionType::NEGATIVE),
+  NegativeExpression(std::unique_ptr<Expression> expression,
+                     uint32_t span = SourceMap::kNoSpan)
+      : Expression(ExpressionType::NEGATIVE, span),
         expression_(std::move(expression)) {}
 
   std::string to_string(int indent = 0) override {
@@ -173,7 +266,11 @@ class NegativeExpression : public Expression {
            expression_->to_string(indent + 1);
   }
 
-  int eval() override { return -expression_->eval(); }
+  std::unique_ptr<Expression>& expression() { return expression_; }
+
+  int64_t evaluate(Environment& environment) override {
+    return wrapping_negate(expression_->evaluate(environment));
+  }
 
  private:
   std::unique_ptr<Expression> expression_;
@@ -181,134 +278,375 @@ class NegativeExpression : public Expression {
 
 class ParenthesizedExpression : public Expression {
  public:
-  ParenthesizedExpression(std::unique_ptr<OperatorToken> open_paren,
-                          std::unique_ptr<Expression> expression,
-                          std::unique_ptr<OperatorToken> close_paren)
-      : Expression(ExpressionType::PARENTHESIS),
-        open_paren_(std::move(open_paren)),
-        expression_(std::move(expression)),
-        close_paren_(std::move(close_paren)) {
-    LOG(INFO) << "ParenthesizedExpression created" << std::endl;
+  ParenthesizedExpression(std::unique_ptr<Expression> expression,
+                          uint32_t span = SourceMap::kNoSpan)
+      : Expression(ExpressionType::PARENTHESIS, span),
+        expression_(std::move(expression)) {
+    SIMP_TRACE(PARSER, "parenthesized node", span);
   }
 
   std::string to_string(int indent = 0) override {
     return spacing(indent) + "(" + expression_->to_string() + ")";
   }
-  int eval() override { return expression_->eval(); }
+  std::unique_ptr<Expression>& expression() { return expression_; }
+  int64_t evaluate(Environment& environment) override {
+    return expression_->evaluate(environment);
+  }
 
  private:
-  std::unique_ptr<OperatorToken> open_paren_;
   std::unique_ptr<Expression> expression_;
-  std::unique_ptr<OperatorToken> close_paren_;
 };
 
 class Binding : public ParsePrintable {
  public:
-  Binding(std::unique_ptr<IdentifierToken> identifier,
-          std::unique_ptr<OperatorToken> assign,
-          std::unique_ptr<Expression> expression)
-      : identifier_(std::move(identifier)),
-        assign_(std::move(assign)),
-        expression_(std::move(expression)) {
-    LOG(INFO) << "Binding created" << std::endl;
+  Binding(std::string name, std::unique_ptr<Expression> expression,
+          uint32_t span = SourceMap::kNoSpan)
+      : name_(std::move(name)),
+        expression_(std::move(expression)),
+        span_(span) {
+    SIMP_TRACE(PARSER, "binding node", span);
   }
 
-  std::unique_ptr<IdentifierToken>& identifier() { return identifier_; }
-  std::unique_ptr<OperatorToken>& assign() { return assign_; }
+  const std::string& name() { return name_; }
   std::unique_ptr<Expression>& expression() { return expression_; }
+  uint32_t span() { return span_; }
+  // Frame slot of the bound variable, -1 until resolved.
+  int slot() { return slot_; }
+  void set_slot(int slot) { slot_ = slot; }
 
   std::string to_string(int indent = 0) {
-    return spacing(indent) + identifier_->to_string() + " = " +
-           expression_->to_string();
+    return spacing(indent) + name_ + " = " + expression_->to_string();
   }
 
  private:
-  std::unique_ptr<IdentifierToken> identifier_;
-  std::unique_ptr<OperatorToken> assign_;
+  std::string name_;
   std::unique_ptr<Expression> expression_;
+  uint32_t span_;
+  int slot_ = -1;
 };
 
+// Bindings in source order. Later bindings see (and may hide) earlier ones.
+using Bindings = std::vector<std::unique_ptr<Binding>>;
+
+inline std::string bindings_to_string(Bindings& bindings, int indent) {
+  std::string result = "";
+  for (const auto& binding : bindings) {
+    result += binding->to_string(indent) + "\n";
+  }
+  return result;
+}
+
 class LetExpression : public Expression {
  public:
-  LetExpression(
-      std::unique_ptr<KeywordToken> let_keyword,
-      std::unique_ptr<std::unordered_map<std::string, std::unique_ptr<Binding>>>
-          bindings,
-      std::unique_ptr<KeywordToken> in_keyword,
-      std::unique_ptr<Expression> expression,
-      std::unique_ptr<KeywordToken> end_keyword)
-      : Expression(ExpressionType::LET),
-        let_keyword_(std::move(let_keyword)),
+  LetExpression(Bindings bindings, std::unique_ptr<Expression> expression,
+                uint32_t span = SourceMap::kNoSpan)
+      : Expression(ExpressionType::LET, span),
         bindings_(std::move(bindings)),
-        in_keyword_(std::move(in_keyword)),
-        expression_(std::move(expression)),
-        end_keyword_(std::move(end_keyword)) {
-    LOG(INFO) << "LetExpression created" << std::endl;
+        expression_(std::move(expression)) {
+    SIMP_TRACE(PARSER, "let node", span);
   }
 
+  Bindings& bindings() { return bindings_; }
+  std::unique_ptr<Expression>& expression() { return expression_; }
+
   std::string to_string(int indent = 0) override {
-    std::string result = spacing(indent) + "Let\n";
-    for (const auto& pair : *bindings_) {
-      result += spacing(indent + 1) + pair.first + " = " +
-                pair.second->to_string() + "\n";
-    }
-    result += spacing(indent) + "In\n" + expression_->to_string(indent + 1);
-    return result;
+    return spacing(indent) + "Let\n" +
+           bindings_to_string(bindings_, indent + 1) + spacing(indent) +
+           "In\n" + expression_->to_string(indent + 1);
   }
 
-  int eval() override {
-    return 1;  // TODO: implement eval
+  int64_t evaluate(Environment& environment) override {
+    for (const auto& binding : bindings_) {
+      environment.set(binding->slot(),
+                      binding->expression()->evaluate(environment));
+    }
+    return expression_->evaluate(environment);
   }
 
   void print_bindings() {
-    for (const auto& binding : *bindings_) {
-      std::cout << binding.second->to_string() << std::endl;
+    for (const auto& binding : bindings_) {
+      std::cout << binding->to_string() << std::endl;
     }
   }
 
  private:
-  std::unique_ptr<KeywordToken> let_keyword_;
-  std::unique_ptr<std::unordered_map<std::string, std::unique_ptr<Binding>>>
-      bindings_;
-  std::unique_ptr<KeywordToken> in_keyword_;
+  Bindings bindings_;
   std::unique_ptr<Expression> expression_;
-  std::unique_ptr<KeywordToken> end_keyword_;
 };
 
-class IdentifierExpression : public Expression {
+// Binds its variables like let and is the jump target of every recur in tail
+// position of its body.
+class LoopExpression : public Expression {
  public:
-  IdentifierExpression(std::string name)
-      : Expression(ExpressionType::IDENTIFIER), name_(name) {
-    LOG(INFO) << "IdentifierExpression created" << std::endl;
+  LoopExpression(Bindings bindings, std::unique_ptr<Expression> expression,
+                 uint32_t span = SourceMap::kNoSpan)
+      : Expression(ExpressionType::LOOP, span),
+        bindings_(std::move(bindings)),
+        expression_(std::move(expression)) {
+    SIMP_TRACE(PARSER, "loop node", span);
   }
 
-  IdentifierExpression(IdentifierToken* identifier_token)
-      : Expression(ExpressionType::IDENTIFIER),
-        name_(identifier_token->name()) {
-    LOG(INFO) << "IdentifierExpression created from pointer" << std::endl;
+  Bindings& bindings() { return bindings_; }
+  std::unique_ptr<Expression>& expression() { return expression_; }
+
+  std::string to_string(int indent = 0) override {
+    return spacing(indent) + "Loop\n" +
+           bindings_to_string(bindings_, indent + 1) + spacing(indent) +
+           "In\n" + expression_->to_string(indent + 1);
   }
 
+  int64_t evaluate(Environment& environment) override {
+    // The Resolver gives the variables of a loop consecutive slots.
+    for (const auto& binding : bindings_) {
+      environment.set(binding->slot(),
+                      binding->expression()->evaluate(environment));
+    }
+    for (;;) {
+      int64_t result = expression_->evaluate(environment);
+      if (!environment.recurring()) {
+        return result;
+      }
+      SIMP_TRACE(EVAL, "loop iteration", span());
+      environment.finish_recur(bindings_.front()->slot(), bindings_.size());
+    }
+  }
+
+ private:
+  Bindings bindings_;
+  std::unique_ptr<Expression> expression_;
+};
+
+// Jumps back to the innermost loop with new values for its variables. The
+// parser only accepts recur in tail position, so the value returned here is
+// never used.
+class RecurExpression : public Expression {
+ public:
+  RecurExpression(std::vector<std::unique_ptr<Expression>> arguments,
+                  uint32_t span = SourceMap::kNoSpan)
+      : Expression(ExpressionType::RECUR, span),
+        arguments_(std::move(arguments)) {
+    SIMP_TRACE(PARSER, "recur node", span);
+  }
+
+  std::vector<std::unique_ptr<Expression>>& arguments() { return arguments_; }
+
+  std::string to_string(int indent = 0) override {
+    std::string result = spacing(indent) + "Recur";
+    for (const auto& argument : arguments_) {
+      result += "\n" + argument->to_string(indent + 1);
+    }
+    return result;
+  }
+
+  int64_t evaluate(Environment& environment) override {
+    for (const auto& argument : arguments_) {
+      environment.push_recur_argument(argument->evaluate(environment));
+    }
+    environment.start_recur();
+    return 0;
+  }
+
+ private:
+  std::vector<std::unique_ptr<Expression>> arguments_;
+};
+
+class IdentifierExpression : public Expression {
+ public:
+  IdentifierExpression(std::string name, uint32_t span = SourceMap::kNoSpan)
+      : Expression(ExpressionType::IDENTIFIER, span), name_(std::move(name)) {
+    SIMP_TRACE(PARSER, "identifier node", span);
+  }
+
+  const std::string& name() { return name_; }
+  // Frame slot of the variable this name refers to, -1 until resolved.
+  int slot() { return slot_; }
+  void set_slot(int slot) { slot_ = slot; }
+
   std::string to_string(int indent = 0) override {
     return spacing(indent) + name_;
   }
 
-  int eval() override {
-    return 1;  // TODO: implement eval
+  int64_t evaluate(Environment& environment) override {
+    return environment.get(slot_);
   }
 
  private:
   std::string name_;
+  int slot_ = -1;
 };
 
+// Calls a top level function. The parser has already checked the arity and
+// turned the name into the callee's index in the Ast's Functions, so a call
+// never looks a name up while it runs.
+class CallExpression : public Expression {
+ public:
+  CallExpression(uint32_t function, std::string name,
+                 std::vector<std::unique_ptr<Expression>> arguments,
+                 uint32_t span = SourceMap::kNoSpan)
+      : Expression(ExpressionType::CALL, span),
+        function_(function),
+        name_(std::move(name)),
+        arguments_(std::move(arguments)) {
+    SIMP_TRACE(PARSER, "call node", span);
+  }
+
+  uint32_t function() { return function_; }
+  const std::string& name() { return name_; }
+  std::vector<std::unique_ptr<Expression>>& arguments() { return arguments_; }
+
+  std::string to_string(int indent = 0) override {
+    std::string result = spacing(indent) + "Call " + name_;
+    for (const auto& argument : arguments_) {
+      result += "\n" + argument->to_string(indent + 1);
+    }
+    return result;
+  }
+
+  int64_t evaluate(Environment& environment) override;
+
+ private:
+  // The rest of evaluate when the environment has a MemoCache, which may or
+  // may not memoize the callee.
+  int64_t evaluate_with_cache(Environment& environment, Function& callee);
+
+  uint32_t function_;
+  std::string name_;
+  std::vector<std::unique_ptr<Expression>> arguments_;
+};
+
+// Applies an Intrinsic to as many arguments as it takes, which the parser has
+// checked.
+class IntrinsicExpression : public Expression {
+ public:
+  IntrinsicExpression(Intrinsic intrinsic,
+                      std::vector<std::unique_ptr<Expression>> arguments,
+                      uint32_t span = SourceMap::kNoSpan)
+      : Expression(ExpressionType::INTRINSIC, span),
+        intrinsic_(intrinsic),
+        arguments_(std::move(arguments)) {}
+
+  Intrinsic intrinsic() { return intrinsic_; }
+  std::vector<std::unique_ptr<Expression>>& arguments() { return arguments_; }
+
+  std::string to_string(int indent = 0) override {
+    std::string result =
+        spacing(indent) + "Intrinsic " + intrinsic_name(intrinsic_);
+    for (const auto& argument : arguments_) {
+      result += "\n" + argument->to_string(indent + 1);
+    }
+    return result;
+  }
+
+  int64_t evaluate(Environment& environment) override {
+    int64_t x = arguments_[0]->evaluate(environment);
+    int64_t y =
+        arguments_.size() > 1 ? arguments_[1]->evaluate(environment) : 0;
+    return apply_intrinsic(intrinsic_, x, y);
+  }
+
+ private:
+  Intrinsic intrinsic_;
+  std::vector<std::unique_ptr<Expression>> arguments_;
+};
+
+// A top level `let name parameters = body end`. The parameters take the first
+// slots of the function's own frame, in order.
+class Function : public ParsePrintable {
+ public:
+  Function(std::string name, std::vector<std::string> parameters,
+           std::unique_ptr<Expression> body, uint32_t span = SourceMap::kNoSpan)
+      : name_(std::move(name)),
+        parameters_(std::move(parameters)),
+        body_(std::move(body)),
+        span_(span) {}
+
+  const std::string& name() { return name_; }
+  const std::vector<std::string>& parameters() { return parameters_; }
+  std::unique_ptr<Expression>& body() { return body_; }
+  uint32_t span() { return span_; }
+  // Number of variable slots a call needs, set by the Resolver.
+  size_t frame_size() { return frame_size_; }
+  void set_frame_size(size_t frame_size) { frame_size_ = frame_size; }
+
+  std::string to_string(int indent = 0) override {
+    std::string result = spacing(indent) + "Function " + name_;
+    for (const auto& parameter : parameters_) {
+      result += " " + parameter;
+    }
+    return result + "\n" + body_->to_string(indent + 1);
+  }
+
+ private:
+  std::string name_;
+  std::vector<std::string> parameters_;
+  std::unique_ptr<Expression> body_;
+  uint32_t span_;
+  size_t frame_size_ = 0;
+};
+
+inline int64_t CallExpression::evaluate(Environment& environment) {
+  Function& callee = *(*environment.functions())[function_];
+  if (environment.memo_cache()) {
+    return evaluate_with_cache(environment, callee);
+  }
+  Environment frame(callee.frame_size(), environment.functions());
+  for (size_t i = 0; i < arguments_.size(); ++i) {
+    frame.set(i, arguments_[i]->evaluate(environment));
+  }
+  return callee.body()->evaluate(frame);
+}
+
+// A program: the functions it defines and the expression it evaluates. A
+// program that ends with its definitions evaluates a call to `main`, whose
+// parameters become the inputs of the program and the first slots of the root
+// frame.
 class Ast {
  public:
-  Ast(std::unique_ptr<Expression> root) : root_(std::move(root)) {}
-  int eval() { return root_->eval(); }
+  Ast(std::unique_ptr<Expression> root, SourceMap source_map = {},
+      Functions functions = {}, std::vector<std::string> inputs = {})
+      : root_(std::move(root)),
+        source_map_(std::move(source_map)),
+        functions_(std::move(functions)),
+        inputs_(std::move(inputs)) {}
+  // Calls to the functions memo_cache memoizes go through it.
+  int64_t eval(const std::vector<int64_t>& arguments = {},
+               MemoCache* memo_cache = nullptr) {
+    Environment environment(frame_size_, &functions_, memo_cache);
+    for (size_t i = 0; i < arguments.size(); ++i) {
+      environment.set(i, arguments[i]);
+    }
+    return root_->evaluate(environment);
+  }
   std::unique_ptr<Expression>& root() { return root_; }
-  std::string to_string() { return root_->to_string(); }
+  Functions& functions() { return functions_; }
+  const std::vector<std::string>& inputs() { return inputs_; }
+  std::string to_string() {
+    std::string result = "";
+    for (const auto& function : functions_) {
+      result += function->to_string() + "\n";
+    }
+    return result + root_->to_string();
+  }
+  // Number of variable slots the program needs, set by the Resolver.
+  size_t frame_size() { return frame_size_; }
+  void set_frame_size(size_t frame_size) { frame_size_ = frame_size; }
+  const SourceMap& source_map() { return source_map_; }
 
  private:
   std::unique_ptr<Expression> root_;
+  SourceMap source_map_;
+  Functions functions_;
+  std::vector<std::string> inputs_;
+  size_t frame_size_ = 0;
 };
 
+// The number of nodes under expression, counting each binding as one.
+size_t count_nodes(Expression* expression);
+// The nodes of the root and of every function body.
+size_t count_nodes(Ast& ast);
+// A 64-bit hash of the whole program, in time linear in its size. Programs
+// that differ in any node, name or literal hash differently, barring
+// collisions; source positions are left out.
+uint64_t fingerprint(Ast& ast);
+
 }  // namespace simp
\ No newline at end of file
@@ -0,0 +1,149 @@
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+
+#include "ast/ast.h"
+#include "ast/flat_ast.h"
+#include "parser/parser.h"
+
+DEFINE_string(file, "",
+              "Program to measure; a program is generated when empty");
+DEFINE_int32(depth, 16,
+             "Nesting depth of the generated program, which has 2^depth "
+             "leaf expressions");
+DEFINE_int32(iterations, 10, "Number of evaluations to time per representation");
+
+// Every allocation carries its size in front so that the live heap can be
+// tracked without depending on the allocator.
+namespace {
+std::atomic<int64_t> live_bytes{0};
+constexpr size_t kHeader = alignof(std::max_align_t);
+}  // namespace
+
+void* operator new(size_t size) {
+  char* memory = static_cast<char*>(std::malloc(size + kHeader));
+  if (!memory) {
+    throw std::bad_alloc();
+  }
+  *reinterpret_cast<size_t*>(memory) = size;
+  live_bytes += size;
+  return memory + kHeader;
+}
+
+void operator delete(void* pointer) noexcept {
+  if (!pointer) {
+    return;
+  }
+  char* memory = static_cast<char*>(pointer) - kHeader;
+  live_bytes -= *reinterpret_cast<size_t*>(memory);
+  std::free(memory);
+}
+
+void operator delete(void* pointer, size_t) noexcept { operator delete(pointer); }
+
+namespace simp {
+namespace {
+// A balanced sum, so the parser's recursion stays shallow however large the
+// program is. Every leaf exercises let, if, parentheses and operators.
+void generate(int depth, int& counter, std::string& out) {
+  if (depth == 0) {
+    std::string n = std::to_string(counter++ % 7);
+    out += "let x = " + n + " in if x < 3 then (x * 2) else -x end end";
+    return;
+  }
+  out += "(";
+  generate(depth - 1, counter, out);
+  out += ") + (";
+  generate(depth - 1, counter, out);
+  out += ")";
+}
+
+template <typename Eval>
+double nanoseconds_per_run(Eval eval, int64_t& result) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    result = eval();
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start);
+  return static_cast<double>(elapsed.count()) / FLAGS_iterations;
+}
+}  // namespace
+}  // namespace simp
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  std::string file = FLAGS_file;
+  std::string source;
+  if (file.empty()) {
+    int counter = 0;
+    simp::generate(FLAGS_depth, counter, source);
+    file = "<generated>";
+    std::cerr << "Generated " << source.size() << " bytes" << std::endl;
+  }
+  // Generated programs are scanned in place instead of through a file.
+  auto lex = [&]() {
+    simp::Lexer lexer(file);
+    if (FLAGS_file.empty()) {
+      lexer.scan(source);
+    } else {
+      lexer.scan();
+    }
+    return std::move(lexer.tokens());
+  };
+
+  int64_t before = live_bytes;
+  std::unique_ptr<simp::Ast> ast;
+  {
+    simp::Parser parser(lex());
+    if (!parser.parse()) {
+      LOG(ERROR) << "Failed to parse " << file;
+      return 1;
+    }
+    ast = parser.ast();
+  }
+  int64_t tree_bytes = live_bytes - before;
+
+  before = live_bytes;
+  std::unique_ptr<simp::FlatAst> flat;
+  {
+    simp::Parser parser(lex());
+    if (!parser.parse_flat()) {
+      LOG(ERROR) << "Failed to parse " << file;
+      return 1;
+    }
+    flat = parser.flat_ast();
+  }
+  int64_t flat_bytes = live_bytes - before;
+
+  size_t nodes = simp::count_nodes(ast->root().get());
+  int64_t tree_result = 0;
+  int64_t flat_result = 0;
+  double tree_ns =
+      simp::nanoseconds_per_run([&] { return ast->eval(); }, tree_result);
+  double flat_ns =
+      simp::nanoseconds_per_run([&] { return flat->eval(); }, flat_result);
+  if (tree_result != flat_result) {
+    LOG(ERROR) << "Representations disagree: " << tree_result << " vs "
+               << flat_result;
+    return 1;
+  }
+  std::cout << nodes << " nodes" << std::endl;
+  std::cout << "tree: " << static_cast<double>(tree_bytes) / nodes
+            << " bytes/node, " << tree_ns / nodes << " ns/node to evaluate"
+            << std::endl;
+  std::cout << "flat: " << static_cast<double>(flat_bytes) / nodes
+            << " bytes/node, " << flat_ns / nodes << " ns/node to evaluate"
+            << std::endl;
+  return 0;
+}
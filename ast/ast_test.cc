@@ -18,32 +18,60 @@ TEST_F(AstTest, CreatesIntExpression) {
 }
 
 TEST_F(AstTest, CreatesIfExpression) {
-  std::unique_ptr<KeywordToken> if_token =
-      std::make_unique<KeywordToken>("if", 0, 0, "test");
-  std::unique_ptr<KeywordToken> then_token =
-      std::make_unique<KeywordToken>("then", 0, 0, "test");
-  std::unique_ptr<KeywordToken> else_token =
-      std::make_unique<KeywordToken>("then", 0, 0, "test");
   std::unique_ptr<IntExpression> condition = std::make_unique<IntExpression>(1);
   std::unique_ptr<IntExpression> consequent_expr =
       std::make_unique<IntExpression>(2);
   std::unique_ptr<IntExpression> alternative_expr =
       std::make_unique<IntExpression>(3);
-  IfExpression if_expr(std::move(if_token), std::move(condition),
-                       std::move(then_token), std::move(consequent_expr),
-                       std::move(else_token), std::move(alternative_expr));
-  EXPECT_EQ(if_expr.to_string(), "If\ncondition:1\nthen:2\nelse:3");
+  IfExpression if_expr(std::move(condition), std::move(consequent_expr),
+                       std::move(alternative_expr));
+  EXPECT_EQ(if_expr.to_string(), "If\n\t1\n\t2\n\t3");
   EXPECT_EQ(if_expr.condition()->eval(), 1);
   EXPECT_EQ(if_expr.consequent()->eval(), 2);
   EXPECT_EQ(if_expr.alternative()->eval(), 3);
   EXPECT_EQ(if_expr.eval(), 2);
 }
 
+TEST_F(AstTest, KeepsLocationsInSourceMap) {
+  SourceMap source_map;
+  uint32_t first = source_map.add("test.sl", 1, 0);
+  uint32_t second = source_map.add("test.sl", 2, 4);
+  IntExpression int_expr(42, second);
+  EXPECT_EQ(int_expr.span(), second);
+  EXPECT_EQ(source_map.span(second).line, 2);
+  EXPECT_EQ(source_map.span(second).position, 4);
+  // The file name is stored once for both spans.
+  EXPECT_EQ(source_map.span(first).file, source_map.span(second).file);
+  EXPECT_EQ(source_map.location(second),
+            " in file:\"test.sl\"\ton line:2\tat position:4");
+}
+
+TEST_F(AstTest, NodesHoldNoTokens) {
+  // A vtable pointer, the type and the span index.
+  EXPECT_EQ(sizeof(IntExpression), 16 + sizeof(int64_t));
+  EXPECT_EQ(sizeof(IfExpression), 16 + 3 * sizeof(std::unique_ptr<Expression>));
+}
+
 TEST_F(AstTest, CreatesAst) {
   std::unique_ptr<IntExpression> root = std::make_unique<IntExpression>(1);
   Ast ast(std::move(root));
   EXPECT_EQ(ast.root()->eval(), 1);
 }
 
+TEST_F(AstTest, FingerprintsStructure) {
+  auto sum = [](int64_t left, int64_t right, Operator op) {
+    return Ast(std::make_unique<BinaryExpression>(
+        std::make_unique<IntExpression>(left),
+        std::make_unique<IntExpression>(right), op));
+  };
+  Ast one_plus_two = sum(1, 2, Operator::PLUS);
+  Ast again = sum(1, 2, Operator::PLUS);
+  Ast two_plus_one = sum(2, 1, Operator::PLUS);
+  Ast one_times_two = sum(1, 2, Operator::TIMES);
+  EXPECT_EQ(fingerprint(one_plus_two), fingerprint(again));
+  EXPECT_NE(fingerprint(one_plus_two), fingerprint(two_plus_one));
+  EXPECT_NE(fingerprint(one_plus_two), fingerprint(one_times_two));
+}
+
 }  // namespace
 }  // namespace simp
@@ -0,0 +1,261 @@
+#include "flat_ast.h"
+
+namespace simp {
+
+NodeId FlatAst::add(ExpressionType kind, uint32_t first, uint32_t second,
+                    uint32_t span) {
+  kinds_.push_back(kind);
+  operators_.push_back(0);
+  first_.push_back(first);
+  second_.push_back(second);
+  spans_.push_back(span);
+  return kinds_.size() - 1;
+}
+
+uint32_t FlatAst::intern(const std::string& name) {
+  auto [it, inserted] = name_indices_.try_emplace(name, names_.size());
+  if (inserted) {
+    names_.push_back(name);
+  }
+  return it->second;
+}
+
+NodeId FlatAst::add_integer(int64_t value, uint32_t span) {
+  values_.push_back(value);
+  return add(ExpressionType::INTEGER, values_.size() - 1, 0, span);
+}
+
+NodeId FlatAst::add_identifier(const std::string& name, uint32_t span) {
+  return add(ExpressionType::IDENTIFIER, intern(name),
+             static_cast<uint32_t>(-1), span);
+}
+
+NodeId FlatAst::add_unary(ExpressionType kind, NodeId operand, uint32_t span) {
+  return add(kind, operand, 0, span);
+}
+
+NodeId FlatAst::add_binary(Operator op, NodeId left, NodeId right,
+                           uint32_t span) {
+  NodeId node = add(ExpressionType::BINARY, left, right, span);
+  operators_[node] = op;
+  return node;
+}
+
+NodeId FlatAst::add_if(NodeId condition, NodeId consequent,
+                       NodeId alternative, uint32_t span) {
+  uint32_t extra = extra_.size();
+  extra_.push_back(consequent);
+  extra_.push_back(alternative);
+  return add(ExpressionType::IF, condition, extra, span);
+}
+
+NodeId FlatAst::add_scope(ExpressionType kind,
+                          const std::vector<Binding>& bindings, NodeId body,
+                          uint32_t span) {
+  uint32_t extra = extra_.size();
+  extra_.push_back(bindings.size());
+  for (const auto& binding : bindings) {
+    extra_.push_back(intern(binding.name));
+    extra_.push_back(static_cast<uint32_t>(-1));
+    extra_.push_back(binding.expression);
+    extra_.push_back(binding.span);
+  }
+  return add(kind, body, extra, span);
+}
+
+NodeId FlatAst::add_recur(const std::vector<NodeId>& arguments,
+                          uint32_t span) {
+  uint32_t extra = extra_.size();
+  extra_.push_back(arguments.size());
+  extra_.insert(extra_.end(), arguments.begin(), arguments.end());
+  return add(ExpressionType::RECUR, 0, extra, span);
+}
+
+NodeId FlatAst::add_call(uint32_t function,
+                         const std::vector<NodeId>& arguments, uint32_t span) {
+  uint32_t extra = extra_.size();
+  extra_.push_back(arguments.size());
+  extra_.insert(extra_.end(), arguments.begin(), arguments.end());
+  return add(ExpressionType::CALL, function, extra, span);
+}
+
+NodeId FlatAst::add_intrinsic(Intrinsic intrinsic,
+                              const std::vector<NodeId>& arguments,
+                              uint32_t span) {
+  uint32_t extra = extra_.size();
+  extra_.push_back(arguments.size());
+  extra_.insert(extra_.end(), arguments.begin(), arguments.end());
+  return add(ExpressionType::INTRINSIC, static_cast<uint32_t>(intrinsic),
+             extra, span);
+}
+
+uint32_t FlatAst::add_function(const std::string& name,
+                               std::vector<std::string> parameters,
+                               NodeId body, uint32_t span) {
+  functions_.push_back({name, std::move(parameters), body, span});
+  return functions_.size() - 1;
+}
+
+int64_t FlatAst::eval(const std::vector<int64_t>& arguments) {
+  Environment environment(frame_size_);
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    environment.set(i, arguments[i]);
+  }
+  return evaluate(root_, environment);
+}
+
+int64_t FlatAst::evaluate(NodeId node, Environment& environment) {
+  switch (kinds_[node]) {
+    case ExpressionType::INTEGER:
+      return values_[first_[node]];
+    case ExpressionType::IDENTIFIER:
+      return environment.get(slot(node));
+    case ExpressionType::PARENTHESIS:
+      return evaluate(first_[node], environment);
+    case ExpressionType::NOT:
+      return !evaluate(first_[node], environment);
+    case ExpressionType::NEGATIVE:
+      return wrapping_negate(evaluate(first_[node], environment));
+    case ExpressionType::IF:
+      return evaluate(condition(node), environment)
+                 ? evaluate(consequent(node), environment)
+                 : evaluate(alternative(node), environment);
+    case ExpressionType::BINARY: {
+      NodeId left = first_[node];
+      NodeId right = second_[node];
+      switch (op(node)) {
+        case Operator::PLUS:
+          return wrapping_add(evaluate(left, environment),
+                              evaluate(right, environment));
+        case Operator::TIMES:
+          return wrapping_multiply(evaluate(left, environment),
+                                   evaluate(right, environment));
+        case Operator::LESS_THAN:
+          return evaluate(left, environment) < evaluate(right, environment);
+        case Operator::EQUALS:
+          return evaluate(left, environment) == evaluate(right, environment);
+        case Operator::LOGICAL_AND:
+          return evaluate(left, environment) && evaluate(right, environment);
+        case Operator::LOGICAL_OR:
+          return evaluate(left, environment) || evaluate(right, environment);
+        default:
+          return 0;
+      }
+    }
+    case ExpressionType::LET: {
+      uint32_t count = binding_count(node);
+      for (uint32_t i = 0; i < count; ++i) {
+        environment.set(binding_slot(node, i),
+                        evaluate(binding_expression(node, i), environment));
+      }
+      return evaluate(first_[node], environment);
+    }
+    case ExpressionType::LOOP: {
+      uint32_t count = binding_count(node);
+      for (uint32_t i = 0; i < count; ++i) {
+        environment.set(binding_slot(node, i),
+                        evaluate(binding_expression(node, i), environment));
+      }
+      for (;;) {
+        int64_t result = evaluate(first_[node], environment);
+        if (!environment.recurring()) {
+          return result;
+        }
+        environment.finish_recur(binding_slot(node, 0), count);
+      }
+    }
+    case ExpressionType::RECUR: {
+      uint32_t count = argument_count(node);
+      for (uint32_t i = 0; i < count; ++i) {
+        environment.push_recur_argument(
+            evaluate(argument(node, i), environment));
+      }
+      environment.start_recur();
+      return 0;
+    }
+    case ExpressionType::CALL: {
+      const Function& callee = functions_[first_[node]];
+      Environment frame(callee.frame_size);
+      uint32_t count = argument_count(node);
+      for (uint32_t i = 0; i < count; ++i) {
+        frame.set(i, evaluate(argument(node, i), environment));
+      }
+      return evaluate(callee.body, frame);
+    }
+    case ExpressionType::INTRINSIC: {
+      int64_t x = evaluate(argument(node, 0), environment);
+      int64_t y = argument_count(node) > 1
+                      ? evaluate(argument(node, 1), environment)
+                      : 0;
+      return apply_intrinsic(intrinsic(node), x, y);
+    }
+  }
+  return 0;
+}
+
+// Prints exactly what Ast::to_string prints for the same program.
+std::string FlatAst::to_string() {
+  std::string result = "";
+  for (const auto& function : functions_) {
+    result += "Function " + function.name;
+    for (const auto& parameter : function.parameters) {
+      result += " " + parameter;
+    }
+    result += "\n" + to_string(function.body, 1) + "\n";
+  }
+  return result + to_string(root_, 0);
+}
+
+std::string FlatAst::to_string(NodeId node, int indent) {
+  std::string spacing(indent, '\t');
+  switch (kinds_[node]) {
+    case ExpressionType::INTEGER:
+      return spacing + std::to_string(value(node));
+    case ExpressionType::IDENTIFIER:
+      return spacing + name(node);
+    case ExpressionType::PARENTHESIS:
+      return spacing + "(" + to_string(operand(node), 0) + ")";
+    case ExpressionType::NOT:
+      return spacing + "NotExpression:\n" + to_string(operand(node), indent + 1);
+    case ExpressionType::NEGATIVE:
+      return spacing + "NegativeExpression:\n" +
+             to_string(operand(node), indent + 1);
+    case ExpressionType::IF:
+      return spacing + "If\n" + to_string(condition(node), indent + 1) + "\n" +
+             to_string(consequent(node), indent + 1) + "\n" +
+             to_string(alternative(node), indent + 1);
+    case ExpressionType::BINARY:
+      return spacing + op_to_string(op(node)) + "\n" +
+             to_string(left(node), indent + 1) + "\n" +
+             to_string(right(node), indent + 1);
+    case ExpressionType::LET:
+    case ExpressionType::LOOP: {
+      std::string result =
+          spacing + (kinds_[node] == ExpressionType::LET ? "Let\n" : "Loop\n");
+      for (uint32_t i = 0; i < binding_count(node); ++i) {
+        result += spacing + "\t" + binding_name(node, i) + " = " +
+                  to_string(binding_expression(node, i), 0) + "\n";
+      }
+      return result + spacing + "In\n" + to_string(body(node), indent + 1);
+    }
+    case ExpressionType::RECUR:
+    case ExpressionType::CALL:
+    case ExpressionType::INTRINSIC: {
+      std::string result = spacing;
+      if (kinds_[node] == ExpressionType::RECUR) {
+        result += "Recur";
+      } else if (kinds_[node] == ExpressionType::CALL) {
+        result += "Call " + functions_[function(node)].name;
+      } else {
+        result += std::string("Intrinsic ") + intrinsic_name(intrinsic(node));
+      }
+      for (uint32_t i = 0; i < argument_count(node); ++i) {
+        result += "\n" + to_string(argument(node, i), indent + 1);
+      }
+      return result;
+    }
+  }
+  return spacing;
+}
+
+}  // namespace simp
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ast/ast.h"
+#include "ast/source_map.h"
+
+namespace simp {
+using NodeId = uint32_t;
+constexpr NodeId kNoNode = std::numeric_limits<NodeId>::max();
+
+// The same program as an Ast, held in parallel arrays instead of a tree of
+// heap objects. A node is a 32 bit id; its kind, operator, two operand words
+// and span live at that index in separate vectors. What an operand word
+// means depends on the kind:
+//
+//   INTEGER      first: index into the literal values
+//   IDENTIFIER   first: name index, second: resolved slot
+//   NOT, NEGATIVE, PARENTHESIS
+//                first: operand
+//   BINARY       first: left, second: right, plus the operator
+//   IF           first: condition, second: extra index of consequent and
+//                alternative
+//   LET, LOOP    first: body, second: extra index of the binding count
+//                followed by (name, slot, expression, span) per binding
+//   RECUR        second: extra index of the argument count followed by the
+//                arguments
+//   CALL         first: index of the callee in functions(), second: as RECUR
+//   INTRINSIC    first: the Intrinsic, second: as RECUR
+//
+// Children are added before their parents, so a post-order walk visits
+// memory front to back.
+class FlatAst {
+ public:
+  NodeId root() const { return root_; }
+  void set_root(NodeId root) { root_ = root; }
+  size_t size() const { return kinds_.size(); }
+
+  ExpressionType kind(NodeId node) const { return kinds_[node]; }
+  uint32_t span(NodeId node) const { return spans_[node]; }
+  int64_t value(NodeId node) const { return values_[first_[node]]; }
+  const std::string& name(NodeId node) const { return names_[first_[node]]; }
+  int slot(NodeId node) const { return static_cast<int>(second_[node]); }
+  void set_slot(NodeId node, int slot) { second_[node] = slot; }
+  NodeId operand(NodeId node) const { return first_[node]; }
+  Operator op(NodeId node) const {
+    return static_cast<Operator>(operators_[node]);
+  }
+  NodeId left(NodeId node) const { return first_[node]; }
+  NodeId right(NodeId node) const { return second_[node]; }
+  NodeId condition(NodeId node) const { return first_[node]; }
+  NodeId consequent(NodeId node) const { return extra_[second_[node]]; }
+  NodeId alternative(NodeId node) const { return extra_[second_[node] + 1]; }
+  NodeId body(NodeId node) const { return first_[node]; }
+  uint32_t binding_count(NodeId node) const { return extra_[second_[node]]; }
+  const std::string& binding_name(NodeId node, uint32_t i) const {
+    return names_[extra_[binding(node, i)]];
+  }
+  int binding_slot(NodeId node, uint32_t i) const {
+    return static_cast<int>(extra_[binding(node, i) + 1]);
+  }
+  void set_binding_slot(NodeId node, uint32_t i, int slot) {
+    extra_[binding(node, i) + 1] = slot;
+  }
+  NodeId binding_expression(NodeId node, uint32_t i) const {
+    return extra_[binding(node, i) + 2];
+  }
+  uint32_t binding_span(NodeId node, uint32_t i) const {
+    return extra_[binding(node, i) + 3];
+  }
+  uint32_t argument_count(NodeId node) const { return extra_[second_[node]]; }
+  NodeId argument(NodeId node, uint32_t i) const {
+    return extra_[second_[node] + 1 + i];
+  }
+  uint32_t function(NodeId node) const { return first_[node]; }
+  Intrinsic intrinsic(NodeId node) const {
+    return static_cast<Intrinsic>(first_[node]);
+  }
+
+  NodeId add_integer(int64_t value, uint32_t span);
+  NodeId add_identifier(const std::string& name, uint32_t span);
+  // NOT, NEGATIVE or PARENTHESIS.
+  NodeId add_unary(ExpressionType kind, NodeId operand, uint32_t span);
+  NodeId add_binary(Operator op, NodeId left, NodeId right, uint32_t span);
+  NodeId add_if(NodeId condition, NodeId consequent, NodeId alternative,
+                uint32_t span);
+  struct Binding {
+    std::string name;
+    NodeId expression;
+    uint32_t span;
+  };
+  // LET or LOOP.
+  NodeId add_scope(ExpressionType kind, const std::vector<Binding>& bindings,
+                   NodeId body, uint32_t span);
+  NodeId add_recur(const std::vector<NodeId>& arguments, uint32_t span);
+  NodeId add_call(uint32_t function, const std::vector<NodeId>& arguments,
+                  uint32_t span);
+  NodeId add_intrinsic(Intrinsic intrinsic,
+                       const std::vector<NodeId>& arguments, uint32_t span);
+
+  // A top level function, as in the Ast. Its parameters take the first slots
+  // of its frame.
+  struct Function {
+    std::string name;
+    std::vector<std::string> parameters;
+    NodeId body;
+    uint32_t span;
+    size_t frame_size = 0;
+  };
+  // Returns the index calls use to name the function.
+  uint32_t add_function(const std::string& name,
+                        std::vector<std::string> parameters, NodeId body,
+                        uint32_t span);
+  std::vector<Function>& functions() { return functions_; }
+  // The parameters of main when the program evaluates a call to it.
+  const std::vector<std::string>& inputs() const { return inputs_; }
+  void set_inputs(std::vector<std::string> inputs) {
+    inputs_ = std::move(inputs);
+  }
+
+  int64_t eval(const std::vector<int64_t>& arguments = {});
+  std::string to_string();
+  std::string to_string(NodeId node, int indent);
+
+  size_t frame_size() const { return frame_size_; }
+  void set_frame_size(size_t frame_size) { frame_size_ = frame_size; }
+  SourceMap& source_map() { return source_map_; }
+
+ private:
+  NodeId add(ExpressionType kind, uint32_t first, uint32_t second,
+             uint32_t span);
+  uint32_t intern(const std::string& name);
+  uint32_t binding(NodeId node, uint32_t i) const {
+    return second_[node] + 1 + 4 * i;
+  }
+  int64_t evaluate(NodeId node, Environment& environment);
+
+  std::vector<ExpressionType> kinds_;
+  std::vector<uint8_t> operators_;
+  std::vector<uint32_t> first_;
+  std::vector<uint32_t> second_;
+  std::vector<uint32_t> spans_;
+  std::vector<int64_t> values_;
+  std::vector<uint32_t> extra_;
+  std::vector<std::string> names_;
+  std::unordered_map<std::string, uint32_t> name_indices_;
+  std::vector<Function> functions_;
+  std::vector<std::string> inputs_;
+  NodeId root_ = kNoNode;
+  size_t frame_size_ = 0;
+  SourceMap source_map_;
+};
+}  // namespace simp
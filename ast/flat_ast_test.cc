@@ -0,0 +1,110 @@
+#include "ast/flat_ast.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "parser/parser.h"
+
+namespace simp {
+namespace {
+using ::testing::Eq;
+using ::testing::Lt;
+using ::testing::NotNull;
+class FlatAstTest : public ::testing::Test {
+ protected:
+  FlatAstTest() {}
+  ~FlatAstTest() override {}
+  void SetUp() override {}
+
+  std::unique_ptr<FlatAst> parse_flat(const std::string& file) {
+    Parser parser(file);
+    EXPECT_TRUE(parser.parse_flat()) << file;
+    return parser.flat_ast();
+  }
+  std::unique_ptr<Ast> parse(const std::string& file) {
+    Parser parser(file);
+    EXPECT_TRUE(parser.parse()) << file;
+    return parser.ast();
+  }
+};
+
+TEST_F(FlatAstTest, StoresIntExpression) {
+  auto ast = parse_flat("examples/just_nums.sl");
+  ASSERT_THAT(ast, NotNull());
+  EXPECT_THAT(ast->size(), Eq(1));
+  EXPECT_THAT(ast->kind(ast->root()), Eq(ExpressionType::INTEGER));
+  EXPECT_THAT(ast->value(ast->root()), Eq(1234567890));
+  EXPECT_THAT(ast->eval(), Eq(1234567890));
+}
+
+TEST_F(FlatAstTest, AddsChildrenBeforeParents) {
+  auto ast = parse_flat("examples/if_statement.sl");
+  ASSERT_THAT(ast, NotNull());
+  NodeId root = ast->root();
+  EXPECT_THAT(root, Eq(ast->size() - 1));
+  EXPECT_THAT(ast->condition(root), Lt(root));
+  EXPECT_THAT(ast->consequent(root), Lt(root));
+  EXPECT_THAT(ast->alternative(root), Lt(root));
+}
+
+TEST_F(FlatAstTest, ResolvesBindingsToSlots) {
+  auto ast = parse_flat("examples/shadowing.sl");
+  ASSERT_THAT(ast, NotNull());
+  NodeId outer = ast->root();
+  ASSERT_THAT(ast->kind(outer), Eq(ExpressionType::LET));
+  EXPECT_THAT(ast->binding_slot(outer, 0), Eq(0));
+  NodeId inner = ast->body(outer);
+  EXPECT_THAT(ast->binding_slot(inner, 1), Eq(2));
+  EXPECT_THAT(ast->slot(ast->body(inner)), Eq(2));
+  EXPECT_THAT(ast->frame_size(), Eq(3));
+}
+
+TEST_F(FlatAstTest, KeepsBindingSpans) {
+  auto flat = parse_flat("examples/shadowing.sl");
+  auto tree = parse("examples/shadowing.sl");
+  ASSERT_THAT(flat, NotNull());
+  ASSERT_THAT(tree, NotNull());
+  auto outer = static_cast<LetExpression*>(tree->root().get());
+  auto inner = static_cast<LetExpression*>(outer->expression().get());
+  EXPECT_THAT(flat->binding_span(flat->root(), 0),
+              Eq(outer->bindings()[0]->span()));
+  NodeId flat_inner = flat->body(flat->root());
+  for (uint32_t i = 0; i < 2; ++i) {
+    EXPECT_THAT(flat->binding_span(flat_inner, i),
+                Eq(inner->bindings()[i]->span()));
+  }
+  EXPECT_THAT(flat->binding_span(flat_inner, 0),
+              Lt(flat->binding_span(flat_inner, 1)));
+}
+
+TEST_F(FlatAstTest, RejectsInvalidPrograms) {
+  for (std::string file :
+       {"examples/unbound_variable.sl", "examples/recur_not_tail.sl",
+        "examples/recur_outside_loop.sl", "examples/recur_arity.sl"}) {
+    Parser parser(file);
+    EXPECT_FALSE(parser.parse_flat()) << file;
+  }
+}
+
+TEST_F(FlatAstTest, MatchesTree) {
+  for (std::string file :
+       {"examples/just_nums.sl", "examples/if_statement.sl",
+        "examples/not_expression.sl", "examples/negative_expression.sl",
+        "examples/parenthesized_expression.sl",
+        "examples/logical_expression.sl", "examples/overflow.sl",
+        "examples/let_expression.sl", "examples/shadowing.sl",
+        "examples/sibling_lets.sl", "examples/factorial_loop.sl",
+        "examples/shiftl_loop.sl", "examples/swap_loop.sl",
+        "examples/nested_loop.sl"}) {
+    auto flat = parse_flat(file);
+    auto tree = parse(file);
+    ASSERT_THAT(flat, NotNull()) << file;
+    ASSERT_THAT(tree, NotNull()) << file;
+    EXPECT_THAT(flat->to_string(), Eq(tree->to_string())) << file;
+    EXPECT_THAT(flat->eval(), Eq(tree->eval())) << file;
+    EXPECT_THAT(flat->frame_size(), Eq(tree->frame_size())) << file;
+  }
+}
+
+}  // namespace
+}  // namespace simp
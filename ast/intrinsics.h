@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+namespace simp {
+// Operations built into the language, called like functions, e.g.
+// `div (x) (3)`. A function the program defines under the same name hides
+// the intrinsic.
+//
+// Each one computes exactly what the SimpLang definition of the same name in
+// examples/nextprime.sl computes, including the cases where that differs from
+// C: division by 0 gives 0, as does division with INT64_MIN on either side,
+// and shifts by 64 or more give 0.
+enum class Intrinsic : uint8_t {
+  DIV,
+  REM,
+  SHIFTL,
+  SHIFTR,
+  LEADING_ZEROS,
+};
+inline constexpr size_t kIntrinsicCount =
+    static_cast<size_t>(Intrinsic::LEADING_ZEROS) + 1;
+
+inline const char* intrinsic_name(Intrinsic intrinsic) {
+  switch (intrinsic) {
+    case Intrinsic::DIV:
+      return "div";
+    case Intrinsic::REM:
+      return "rem";
+    case Intrinsic::SHIFTL:
+      return "shiftl";
+    case Intrinsic::SHIFTR:
+      return "shiftr";
+    case Intrinsic::LEADING_ZEROS:
+      return "leadingzeros";
+  }
+  return "invalid-intrinsic";
+}
+
+inline size_t intrinsic_arity(Intrinsic intrinsic) {
+  return intrinsic == Intrinsic::LEADING_ZEROS ? 1 : 2;
+}
+
+// Sets intrinsic to the one called name, if any.
+inline bool find_intrinsic(const std::string& name, Intrinsic& intrinsic) {
+  for (size_t i = 0; i < kIntrinsicCount; ++i) {
+    if (name == intrinsic_name(static_cast<Intrinsic>(i))) {
+      intrinsic = static_cast<Intrinsic>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+inline int64_t intrinsic_div(int64_t x, int64_t y) {
+  constexpr int64_t kMin = std::numeric_limits<int64_t>::min();
+  if (y == 0 || x == kMin || y == kMin) {
+    return 0;
+  }
+  return x / y;
+}
+
+inline int64_t intrinsic_rem(int64_t x, int64_t y) {
+  return static_cast<int64_t>(
+      static_cast<uint64_t>(x) -
+      static_cast<uint64_t>(y) * static_cast<uint64_t>(intrinsic_div(x, y)));
+}
+
+inline int64_t intrinsic_shiftl(int64_t x, int64_t a) {
+  if (a <= 0) {
+    return x;
+  }
+  return a >= 64 ? 0 : static_cast<int64_t>(static_cast<uint64_t>(x) << a);
+}
+
+// A logical shift; a negative a shifts left by -a.
+inline int64_t intrinsic_shiftr(int64_t x, int64_t a) {
+  if (a < 0) {
+    return a <= -64 ? 0 : intrinsic_shiftl(x, -a);
+  }
+  return a >= 64 ? 0 : static_cast<int64_t>(static_cast<uint64_t>(x) >> a);
+}
+
+inline int64_t intrinsic_leadingzeros(int64_t x) {
+  return x == 0 ? 64 : __builtin_clzll(static_cast<uint64_t>(x));
+}
+
+// The second argument is ignored by intrinsics that take one, so that every
+// intrinsic has this signature.
+inline int64_t apply_intrinsic(Intrinsic intrinsic, int64_t x, int64_t y) {
+  switch (intrinsic) {
+    case Intrinsic::DIV:
+      return intrinsic_div(x, y);
+    case Intrinsic::REM:
+      return intrinsic_rem(x, y);
+    case Intrinsic::SHIFTL:
+      return intrinsic_shiftl(x, y);
+    case Intrinsic::SHIFTR:
+      return intrinsic_shiftr(x, y);
+    case Intrinsic::LEADING_ZEROS:
+      return intrinsic_leadingzeros(x);
+  }
+  return 0;
+}
+}  // namespace simp
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace simp {
+// Where in the source an Ast node starts.
+struct Span {
+  uint32_t file;
+  // Line and position exactly as the lexer reported them.
+  int32_t line;
+  int32_t position;
+};
+
+// Locations of Ast nodes, kept out of the nodes themselves. A node only
+// stores a 32 bit index into this table, and every file name is stored once
+// however many nodes come from it.
+class SourceMap {
+ public:
+  static constexpr uint32_t kNoSpan = std::numeric_limits<uint32_t>::max();
+
+  uint32_t add(const std::string& file_name, int line, int position) {
+    return add(add_file(file_name), line, position);
+  }
+  // Adds a span in a file already returned by add_file.
+  uint32_t add(uint32_t file, int line, int position) {
+    spans_.push_back({file, line, position});
+    return spans_.size() - 1;
+  }
+  // The index of file_name, for spans of nodes from the same file.
+  uint32_t add_file(const std::string& file_name) {
+    // Programs come from a handful of files, mostly one.
+    for (size_t i = files_.size(); i-- > 0;) {
+      if (files_[i] == file_name) {
+        return i;
+      }
+    }
+    files_.push_back(file_name);
+    return files_.size() - 1;
+  }
+  const Span& span(uint32_t index) const { return spans_[index]; }
+  const std::string& file_name(const Span& span) const {
+    return files_[span.file];
+  }
+  size_t size() const { return spans_.size(); }
+
+  // Formats a location the same way TokenStream::location does.
+  std::string location(uint32_t index) const {
+    if (index == kNoSpan || index >= spans_.size()) {
+      return " at unknown location";
+    }
+    const Span& where = spans_[index];
+    return " in file:\"" + files_[where.file] +
+           "\"\ton line:" + std::to_string(where.line) +
+           "\tat position:" + std::to_string(where.position);
+  }
+
+ private:
+  std::vector<std::string> files_;
+  std::vector<Span> spans_;
+};
+}  // namespace simp
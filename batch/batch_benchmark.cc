@@ -0,0 +1,110 @@
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ast/ast.h"
+#include "batch/batch_evaluator.h"
+#include "batch/lane_ops.h"
+#include "parser/parser.h"
+#include "vm/compiler.h"
+#include "vm/vm.h"
+
+DEFINE_string(file, "examples/mix_loop.sl",
+              "Program to run; every input of its main gets the same value");
+DEFINE_int64(first, 1000000, "Value given to the first run");
+DEFINE_int32(inputs, 1 << 16,
+             "Number of runs, given first, first + 1 and so on");
+
+namespace simp {
+namespace {
+// Times a single pass over every input, which fills results.
+double inputs_per_second(const std::function<void(std::vector<int64_t>&)>& run,
+                         std::vector<int64_t>& results) {
+  auto start = std::chrono::steady_clock::now();
+  run(results);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return results.size() / elapsed.count();
+}
+}  // namespace
+}  // namespace simp
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  simp::Parser parser(FLAGS_file);
+  if (!parser.parse()) {
+    LOG(ERROR) << "Failed to parse " << FLAGS_file;
+    return 1;
+  }
+  auto ast = parser.ast();
+  size_t inputs = ast->inputs().size();
+  size_t count = FLAGS_inputs;
+  std::vector<int64_t> arguments;
+  for (size_t i = 0; i < count; ++i) {
+    arguments.insert(arguments.end(), inputs, FLAGS_first + i);
+  }
+  auto row = [&](size_t i) {
+    return std::vector<int64_t>(arguments.begin() + i * inputs,
+                                arguments.begin() + (i + 1) * inputs);
+  };
+
+  std::vector<int64_t> expected;
+  double tree = simp::inputs_per_second(
+      [&](std::vector<int64_t>& results) {
+        for (size_t i = 0; i < count; ++i) {
+          results.push_back(ast->eval(row(i)));
+        }
+      },
+      expected);
+  auto program = simp::BytecodeCompiler().compile(*ast);
+  if (!program) {
+    LOG(ERROR) << "Failed to compile " << FLAGS_file;
+    return 1;
+  }
+  simp::Vm vm(*program);
+  std::vector<int64_t> vm_results;
+  double bytecode = simp::inputs_per_second(
+      [&](std::vector<int64_t>& results) {
+        for (size_t i = 0; i < count; ++i) {
+          results.push_back(vm.run(row(i)));
+        }
+      },
+      vm_results);
+  if (vm_results != expected) {
+    LOG(ERROR) << "The bytecode VM disagrees with the tree evaluator";
+    return 1;
+  }
+  std::cout << count << " runs of " << FLAGS_file << std::endl;
+  std::cout << "tree: " << tree << " inputs/s" << std::endl;
+  std::cout << "bytecode: " << bytecode << " inputs/s" << std::endl;
+  for (const simp::LaneOps* ops :
+       {&simp::LaneOps::scalar(), simp::LaneOps::avx2(),
+        simp::LaneOps::avx512()}) {
+    if (!ops) {
+      continue;
+    }
+    simp::BatchEvaluator evaluator(*ast, *ops);
+    std::vector<int64_t> results;
+    double batch = simp::inputs_per_second(
+        [&](std::vector<int64_t>& results) {
+          evaluator.eval(arguments, count, results);
+        },
+        results);
+    if (results != expected) {
+      LOG(ERROR) << "The batch evaluator (" << ops->name
+                 << ") disagrees with the tree evaluator";
+      return 1;
+    }
+    std::cout << "batch (" << ops->name << "): " << batch << " inputs/s"
+              << std::endl;
+  }
+  return 0;
+}
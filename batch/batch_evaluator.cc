@@ -0,0 +1,233 @@
+#include "batch_evaluator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace simp {
+
+BatchEvaluator::BatchEvaluator(Ast& ast, const LaneOps& ops)
+    : ast_(ast), ops_(ops) {}
+
+bool BatchEvaluator::eval(const std::vector<int64_t>& arguments, size_t count,
+                          std::vector<int64_t>& results) {
+  size_t inputs = ast_.inputs().size();
+  if (arguments.size() != count * inputs) {
+    LOG(ERROR) << count << " runs of a program with " << inputs
+               << " inputs need " << count * inputs << " arguments, not "
+               << arguments.size();
+    return false;
+  }
+  results.resize(count);
+  Frame frame;
+  frame.slots.resize(std::max(ast_.frame_size(), inputs));
+  for (size_t first = 0; first < count; first += kLanes) {
+    size_t lanes = std::min(kLanes, count - first);
+    for (size_t i = 0; i < inputs; ++i) {
+      for (size_t lane = 0; lane < lanes; ++lane) {
+        frame.slots[i].lane[lane] = arguments[(first + lane) * inputs + i];
+      }
+    }
+    LaneMask mask = lanes == kLanes ? kAllLanes : (1u << lanes) - 1;
+    Lanes result;
+    evaluate(ast_.root().get(), frame, mask, result);
+    std::copy(result.lane, result.lane + lanes, results.begin() + first);
+  }
+  return true;
+}
+
+Lanes& BatchEvaluator::slot(Frame& frame, int slot) {
+  if (slot < 0) {
+    LOG(ERROR) << "Variable was not resolved to a slot";
+    throw std::runtime_error("Unresolved variable");
+  }
+  if (static_cast<size_t>(slot) >= frame.slots.size()) {
+    frame.slots.resize(slot + 1);
+  }
+  return frame.slots[slot];
+}
+
+void BatchEvaluator::evaluate(Expression* expression, Frame& frame,
+                              LaneMask mask, Lanes& out) {
+  switch (expression->type()) {
+    case ExpressionType::INTEGER:
+      ops_.broadcast(static_cast<IntExpression*>(expression)->value(), out);
+      return;
+    case ExpressionType::IDENTIFIER:
+      out = slot(frame, static_cast<IdentifierExpression*>(expression)->slot());
+      return;
+    case ExpressionType::PARENTHESIS:
+      evaluate(
+          static_cast<ParenthesizedExpression*>(expression)->expression().get(),
+          frame, mask, out);
+      return;
+    case ExpressionType::NOT: {
+      Lanes value;
+      evaluate(static_cast<NotExpression*>(expression)->expression().get(),
+               frame, mask, value);
+      ops_.from_mask(static_cast<LaneMask>(~ops_.nonzero(value)), out);
+      return;
+    }
+    case ExpressionType::NEGATIVE:
+      evaluate(
+          static_cast<NegativeExpression*>(expression)->expression().get(),
+          frame, mask, out);
+      ops_.negate(out, out);
+      return;
+    case ExpressionType::BINARY: {
+      auto binary = static_cast<BinaryExpression*>(expression);
+      evaluate(binary->left().get(), frame, mask, out);
+      Lanes right;
+      switch (binary->op()) {
+        // The right operand only runs in the lanes the left one leaves
+        // undecided.
+        case Operator::LOGICAL_AND: {
+          LaneMask undecided = mask & ops_.nonzero(out);
+          LaneMask result = 0;
+          if (undecided) {
+            evaluate(binary->right().get(), frame, undecided, right);
+            result = undecided & ops_.nonzero(right);
+          }
+          ops_.from_mask(result, out);
+          return;
+        }
+        case Operator::LOGICAL_OR: {
+          LaneMask result = mask & ops_.nonzero(out);
+          LaneMask undecided = mask & ~result;
+          if (undecided) {
+            evaluate(binary->right().get(), frame, undecided, right);
+            result |= undecided & ops_.nonzero(right);
+          }
+          ops_.from_mask(result, out);
+          return;
+        }
+        default:
+          break;
+      }
+      evaluate(binary->right().get(), frame, mask, right);
+      switch (binary->op()) {
+        case Operator::PLUS:
+          ops_.add(out, right, out);
+          return;
+        case Operator::TIMES:
+          ops_.multiply(out, right, out);
+          return;
+        case Operator::LESS_THAN:
+          ops_.less_than(out, right, out);
+          return;
+        case Operator::EQUALS:
+          ops_.equals(out, right, out);
+          return;
+        default:
+          ops_.broadcast(0, out);
+          return;
+      }
+    }
+    case ExpressionType::IF: {
+      auto if_expression = static_cast<IfExpression*>(expression);
+      Lanes condition;
+      evaluate(if_expression->condition().get(), frame, mask, condition);
+      LaneMask consequent = mask & ops_.nonzero(condition);
+      LaneMask alternative = mask & ~consequent;
+      if (consequent) {
+        evaluate(if_expression->consequent().get(), frame, consequent, out);
+      }
+      if (alternative && !consequent) {
+        evaluate(if_expression->alternative().get(), frame, alternative, out);
+      } else if (alternative) {
+        Lanes value;
+        evaluate(if_expression->alternative().get(), frame, alternative,
+                 value);
+        ops_.blend(alternative, value, out);
+      }
+      return;
+    }
+    case ExpressionType::LET: {
+      auto let = static_cast<LetExpression*>(expression);
+      evaluate_bindings(let->bindings(), frame, mask);
+      evaluate(let->expression().get(), frame, mask, out);
+      return;
+    }
+    case ExpressionType::LOOP:
+      evaluate_loop(static_cast<LoopExpression*>(expression), frame, mask,
+                    out);
+      return;
+    case ExpressionType::RECUR: {
+      // The arguments wait in the loop's buffer, in the lanes of this recur.
+      // Other recurs of the same iteration run in other lanes.
+      auto& arguments = static_cast<RecurExpression*>(expression)->arguments();
+      for (size_t i = 0; i < arguments.size(); ++i) {
+        Lanes value;
+        evaluate(arguments[i].get(), frame, mask, value);
+        ops_.blend(mask, value, (*frame.recur_arguments)[i]);
+      }
+      frame.recurring |= mask;
+      return;
+    }
+    case ExpressionType::CALL:
+      call(static_cast<CallExpression*>(expression), frame, mask, out);
+      return;
+    case ExpressionType::INTRINSIC: {
+      auto intrinsic = static_cast<IntrinsicExpression*>(expression);
+      Lanes values[2];
+      for (size_t i = 0; i < intrinsic->arguments().size(); ++i) {
+        evaluate(intrinsic->arguments()[i].get(), frame, mask, values[i]);
+      }
+      bool binary = intrinsic->arguments().size() > 1;
+      for (size_t lane = 0; lane < kLanes; ++lane) {
+        if ((mask >> lane) & 1) {
+          out.lane[lane] =
+              apply_intrinsic(intrinsic->intrinsic(), values[0].lane[lane],
+                              binary ? values[1].lane[lane] : 0);
+        }
+      }
+      return;
+    }
+  }
+}
+
+void BatchEvaluator::evaluate_bindings(Bindings& bindings, Frame& frame,
+                                       LaneMask mask) {
+  for (const auto& binding : bindings) {
+    Lanes value;
+    evaluate(binding->expression().get(), frame, mask, value);
+    slot(frame, binding->slot()) = value;
+  }
+}
+
+void BatchEvaluator::evaluate_loop(LoopExpression* loop, Frame& frame,
+                                   LaneMask mask, Lanes& out) {
+  Bindings& bindings = loop->bindings();
+  evaluate_bindings(bindings, frame, mask);
+  std::vector<Lanes> arguments(bindings.size());
+  std::vector<Lanes>* outer_arguments = frame.recur_arguments;
+  LaneMask outer_recurring = frame.recurring;
+  frame.recur_arguments = &arguments;
+  int base = bindings.front()->slot();
+  Lanes value;
+  for (LaneMask active = mask; active;) {
+    frame.recurring = 0;
+    evaluate(loop->expression().get(), frame, active, value);
+    ops_.blend(active & ~frame.recurring, value, out);
+    active &= frame.recurring;
+    // Lanes that left the loop read its variables no more.
+    for (size_t i = 0; i < arguments.size(); ++i) {
+      slot(frame, base + i) = arguments[i];
+    }
+  }
+  frame.recur_arguments = outer_arguments;
+  frame.recurring = outer_recurring;
+}
+
+void BatchEvaluator::call(CallExpression* call, Frame& frame, LaneMask mask,
+                          Lanes& out) {
+  Function& callee = *ast_.functions()[call->function()];
+  auto& arguments = call->arguments();
+  Frame callee_frame;
+  callee_frame.slots.resize(std::max(callee.frame_size(), arguments.size()));
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    evaluate(arguments[i].get(), frame, mask, callee_frame.slots[i]);
+  }
+  evaluate(callee.body().get(), callee_frame, mask, out);
+}
+
+}  // namespace simp
@@ -0,0 +1,57 @@
+#pragma once
+
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <glog/logging.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ast/ast.h"
+#include "batch/lane_ops.h"
+
+namespace simp {
+// Runs a resolved Ast once for each of many inputs, kLanes runs at a time,
+// one per vector lane: every node of the tree is visited once for all the
+// lanes and computes their values with LaneOps. The lanes that take an if's
+// branch form a LaneMask, and a branch no lane takes is skipped. A loop
+// iterates until every lane has left it, each lane keeping the value of the
+// iteration in which it did. Calls evaluate the callee's body for the lanes
+// that make them.
+//
+// Intrinsics are applied lane by lane. Functions are never memoized.
+class BatchEvaluator {
+ public:
+  explicit BatchEvaluator(Ast& ast, const LaneOps& ops = LaneOps::best());
+
+  const LaneOps& ops() const { return ops_; }
+  // Runs the program count times. arguments holds the arguments of each run
+  // in turn, one per input of the Ast (see Ast::inputs), and results gets the
+  // result of each. Returns false if the number of arguments does not match.
+  bool eval(const std::vector<int64_t>& arguments, size_t count,
+            std::vector<int64_t>& results);
+
+ private:
+  struct Frame {
+    std::vector<Lanes> slots;
+    // The lanes that ran into a recur of the innermost loop, and the
+    // argument values they pass it.
+    LaneMask recurring = 0;
+    std::vector<Lanes>* recur_arguments = nullptr;
+  };
+
+  // Sets out in the lanes of mask, which is never empty, to the value of
+  // expression; the other lanes of out are left undefined.
+  void evaluate(Expression* expression, Frame& frame, LaneMask mask,
+                Lanes& out);
+  void evaluate_bindings(Bindings& bindings, Frame& frame, LaneMask mask);
+  void evaluate_loop(LoopExpression* loop, Frame& frame, LaneMask mask,
+                     Lanes& out);
+  void call(CallExpression* call, Frame& frame, LaneMask mask, Lanes& out);
+  static Lanes& slot(Frame& frame, int slot);
+
+  Ast& ast_;
+  const LaneOps& ops_;
+};
+}  // namespace simp
@@ -0,0 +1,135 @@
+#include "batch/batch_evaluator.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "parser/parser.h"
+
+namespace simp {
+namespace {
+using ::testing::ElementsAreArray;
+using ::testing::Eq;
+class BatchEvaluatorTest : public ::testing::Test {
+ protected:
+  BatchEvaluatorTest() {}
+  ~BatchEvaluatorTest() override {}
+  void SetUp() override {
+    for (const LaneOps* ops :
+         {&LaneOps::scalar(), LaneOps::avx2(), LaneOps::avx512()}) {
+      if (ops) {
+        ops_.push_back(ops);
+      }
+    }
+  }
+
+  std::unique_ptr<Ast> parse(const std::string& file) {
+    Parser parser(file);
+    EXPECT_TRUE(parser.parse());
+    return parser.ast();
+  }
+
+  // Runs main of file for each argument on ast->eval and on every LaneOps.
+  void expect_matches_tree(const std::string& file,
+                           const std::vector<int64_t>& arguments) {
+    auto ast = parse(file);
+    std::vector<int64_t> expected;
+    for (int64_t argument : arguments) {
+      expected.push_back(ast->eval({argument}));
+    }
+    for (const LaneOps* ops : ops_) {
+      std::vector<int64_t> results;
+      ASSERT_TRUE(BatchEvaluator(*ast, *ops).eval(arguments, arguments.size(),
+                                                  results));
+      EXPECT_THAT(results, ElementsAreArray(expected))
+          << file << " " << ops->name;
+    }
+  }
+
+  std::vector<const LaneOps*> ops_;
+};
+
+TEST_F(BatchEvaluatorTest, LaneOpsMatchScalar) {
+  std::mt19937_64 random(42);
+  const LaneOps& scalar = LaneOps::scalar();
+  for (int round = 0; round < 1000; ++round) {
+    Lanes left, right;
+    for (size_t i = 0; i < kLanes; ++i) {
+      left.lane[i] = round % 3 == 0 ? random() % 5 : random();
+      right.lane[i] = i % 2 ? left.lane[i] : random();
+    }
+    left.lane[0] = INT64_MIN;
+    LaneMask mask = random();
+    for (const LaneOps* ops : ops_) {
+      for (LaneOps::Binary LaneOps::*op :
+           {&LaneOps::add, &LaneOps::multiply, &LaneOps::less_than,
+            &LaneOps::equals}) {
+        Lanes expected, actual;
+        (scalar.*op)(left, right, expected);
+        (ops->*op)(left, right, actual);
+        EXPECT_THAT(actual.lane, ElementsAreArray(expected.lane))
+            << ops->name;
+      }
+      Lanes expected, actual;
+      scalar.negate(left, expected);
+      ops->negate(left, actual);
+      EXPECT_THAT(actual.lane, ElementsAreArray(expected.lane)) << ops->name;
+      EXPECT_THAT(ops->nonzero(left), Eq(scalar.nonzero(left))) << ops->name;
+      scalar.from_mask(mask, expected);
+      ops->from_mask(mask, actual);
+      EXPECT_THAT(actual.lane, ElementsAreArray(expected.lane)) << ops->name;
+      expected = right;
+      actual = right;
+      scalar.blend(mask, left, expected);
+      ops->blend(mask, left, actual);
+      EXPECT_THAT(actual.lane, ElementsAreArray(expected.lane)) << ops->name;
+    }
+  }
+}
+
+TEST_F(BatchEvaluatorTest, RunsProgramsWithoutInputs) {
+  for (std::string file :
+       {"examples/just_nums.sl", "examples/if_statement.sl",
+        "examples/not_expression.sl", "examples/negative_expression.sl",
+        "examples/parenthesized_expression.sl",
+        "examples/logical_expression.sl", "examples/overflow.sl",
+        "examples/shadowing.sl", "examples/sibling_lets.sl",
+        "examples/factorial_loop.sl", "examples/shiftl_loop.sl",
+        "examples/swap_loop.sl", "examples/nested_loop.sl",
+        "examples/functions.sl", "examples/intrinsics.sl"}) {
+    auto ast = parse(file);
+    for (const LaneOps* ops : ops_) {
+      std::vector<int64_t> results;
+      ASSERT_TRUE(BatchEvaluator(*ast, *ops).eval({}, 3, results));
+      EXPECT_THAT(results, ElementsAreArray(std::vector<int64_t>(
+                               3, ast->eval())))
+          << file << " " << ops->name;
+    }
+  }
+}
+
+TEST_F(BatchEvaluatorTest, DivergesWithinABatch) {
+  // Lanes leave the loops after different numbers of iterations, and a
+  // batch of 13 runs leaves the last lanes of its second batch empty.
+  std::vector<int64_t> arguments;
+  for (int64_t n = 0; n < 13; ++n) {
+    arguments.push_back(n * n * n * 7919);
+  }
+  expect_matches_tree("examples/mix_loop.sl", arguments);
+  expect_matches_tree("examples/nextprime_intrinsics.sl", arguments);
+  expect_matches_tree("examples/search_loop.sl", arguments);
+  expect_matches_tree("examples/nextprime.sl", {0, 1, 2, 3, 100, 1000, 7});
+  expect_matches_tree("examples/wide_calls.sl", {0, 1, 10, 100, 3});
+}
+
+TEST_F(BatchEvaluatorTest, ChecksTheNumberOfArguments) {
+  auto ast = parse("examples/nextprime_intrinsics.sl");
+  std::vector<int64_t> results;
+  EXPECT_FALSE(BatchEvaluator(*ast).eval({1, 2, 3}, 2, results));
+  ASSERT_TRUE(BatchEvaluator(*ast).eval({}, 0, results));
+  EXPECT_TRUE(results.empty());
+}
+
+}  // namespace
+}  // namespace simp
@@ -0,0 +1,274 @@
+#include "lane_ops.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include "ast/ast.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SIMP_BATCH_SIMD 1
+#include <immintrin.h>
+#else
+#define SIMP_BATCH_SIMD 0
+#endif
+
+namespace simp {
+
+namespace {
+void add_scalar(const Lanes& left, const Lanes& right, Lanes& out) {
+  for (size_t i = 0; i < kLanes; ++i) {
+    out.lane[i] = wrapping_add(left.lane[i], right.lane[i]);
+  }
+}
+void multiply_scalar(const Lanes& left, const Lanes& right, Lanes& out) {
+  for (size_t i = 0; i < kLanes; ++i) {
+    out.lane[i] = wrapping_multiply(left.lane[i], right.lane[i]);
+  }
+}
+void less_than_scalar(const Lanes& left, const Lanes& right, Lanes& out) {
+  for (size_t i = 0; i < kLanes; ++i) {
+    out.lane[i] = left.lane[i] < right.lane[i];
+  }
+}
+void equals_scalar(const Lanes& left, const Lanes& right, Lanes& out) {
+  for (size_t i = 0; i < kLanes; ++i) {
+    out.lane[i] = left.lane[i] == right.lane[i];
+  }
+}
+void negate_scalar(const Lanes& value, Lanes& out) {
+  for (size_t i = 0; i < kLanes; ++i) {
+    out.lane[i] = wrapping_negate(value.lane[i]);
+  }
+}
+void broadcast_scalar(int64_t value, Lanes& out) {
+  for (size_t i = 0; i < kLanes; ++i) {
+    out.lane[i] = value;
+  }
+}
+LaneMask nonzero_scalar(const Lanes& value) {
+  LaneMask mask = 0;
+  for (size_t i = 0; i < kLanes; ++i) {
+    mask |= static_cast<LaneMask>(value.lane[i] != 0) << i;
+  }
+  return mask;
+}
+void from_mask_scalar(LaneMask mask, Lanes& out) {
+  for (size_t i = 0; i < kLanes; ++i) {
+    out.lane[i] = (mask >> i) & 1;
+  }
+}
+void blend_scalar(LaneMask mask, const Lanes& value, Lanes& out) {
+  for (size_t i = 0; i < kLanes; ++i) {
+    if ((mask >> i) & 1) {
+      out.lane[i] = value.lane[i];
+    }
+  }
+}
+
+#if SIMP_BATCH_SIMD
+// Lanes holds two AVX2 registers, of lanes 0 to 3 and 4 to 7.
+#define SIMP_AVX2 __attribute__((target("avx2")))
+
+SIMP_AVX2 inline __m256i load_half(const Lanes& value, size_t half) {
+  return _mm256_load_si256(
+      reinterpret_cast<const __m256i*>(value.lane + 4 * half));
+}
+SIMP_AVX2 inline void store_half(__m256i value, size_t half, Lanes& out) {
+  _mm256_store_si256(reinterpret_cast<__m256i*>(out.lane + 4 * half), value);
+}
+// All ones in the lanes of the half whose bits are set in mask.
+SIMP_AVX2 inline __m256i expand_half(LaneMask mask, size_t half) {
+  __m256i bits = _mm256_setr_epi64x(1, 2, 4, 8);
+  return _mm256_cmpeq_epi64(
+      _mm256_and_si256(_mm256_set1_epi64x((mask >> (4 * half)) & 0xf), bits),
+      bits);
+}
+
+SIMP_AVX2 inline __m256i add_4(__m256i left, __m256i right) {
+  return _mm256_add_epi64(left, right);
+}
+// AVX2 only multiplies 32 bit halves: the high halves of the cross products
+// fall outside the 64 bits kept, as does the product of the high halves.
+SIMP_AVX2 inline __m256i multiply_4(__m256i left, __m256i right) {
+  __m256i low = _mm256_mul_epu32(left, right);
+  __m256i cross = _mm256_add_epi64(
+      _mm256_mul_epu32(_mm256_srli_epi64(left, 32), right),
+      _mm256_mul_epu32(left, _mm256_srli_epi64(right, 32)));
+  return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+}
+SIMP_AVX2 inline __m256i less_than_4(__m256i left, __m256i right) {
+  return _mm256_and_si256(_mm256_cmpgt_epi64(right, left),
+                          _mm256_set1_epi64x(1));
+}
+SIMP_AVX2 inline __m256i equals_4(__m256i left, __m256i right) {
+  return _mm256_and_si256(_mm256_cmpeq_epi64(left, right),
+                          _mm256_set1_epi64x(1));
+}
+
+template <__m256i (*op)(__m256i, __m256i)>
+SIMP_AVX2 void binary_avx2(const Lanes& left, const Lanes& right, Lanes& out) {
+  for (size_t half = 0; half < 2; ++half) {
+    store_half(op(load_half(left, half), load_half(right, half)), half, out);
+  }
+}
+SIMP_AVX2 void negate_avx2(const Lanes& value, Lanes& out) {
+  for (size_t half = 0; half < 2; ++half) {
+    store_half(
+        _mm256_sub_epi64(_mm256_setzero_si256(), load_half(value, half)),
+        half, out);
+  }
+}
+SIMP_AVX2 void broadcast_avx2(int64_t value, Lanes& out) {
+  for (size_t half = 0; half < 2; ++half) {
+    store_half(_mm256_set1_epi64x(value), half, out);
+  }
+}
+SIMP_AVX2 LaneMask nonzero_avx2(const Lanes& value) {
+  LaneMask mask = 0;
+  for (size_t half = 0; half < 2; ++half) {
+    __m256i zero =
+        _mm256_cmpeq_epi64(load_half(value, half), _mm256_setzero_si256());
+    mask |= (~_mm256_movemask_pd(_mm256_castsi256_pd(zero)) & 0xf)
+            << (4 * half);
+  }
+  return mask;
+}
+SIMP_AVX2 void from_mask_avx2(LaneMask mask, Lanes& out) {
+  for (size_t half = 0; half < 2; ++half) {
+    store_half(
+        _mm256_and_si256(expand_half(mask, half), _mm256_set1_epi64x(1)),
+        half, out);
+  }
+}
+SIMP_AVX2 void blend_avx2(LaneMask mask, const Lanes& value, Lanes& out) {
+  for (size_t half = 0; half < 2; ++half) {
+    store_half(_mm256_blendv_epi8(load_half(out, half),
+                                  load_half(value, half),
+                                  expand_half(mask, half)),
+               half, out);
+  }
+}
+
+#define SIMP_AVX512 __attribute__((target("avx512f,avx512dq")))
+
+SIMP_AVX512 inline __m512i load_8(const Lanes& value) {
+  return _mm512_load_si512(value.lane);
+}
+SIMP_AVX512 inline void store_8(__m512i value, Lanes& out) {
+  _mm512_store_si512(out.lane, value);
+}
+
+SIMP_AVX512 void add_avx512(const Lanes& left, const Lanes& right,
+                            Lanes& out) {
+  store_8(_mm512_add_epi64(load_8(left), load_8(right)), out);
+}
+SIMP_AVX512 void multiply_avx512(const Lanes& left, const Lanes& right,
+                                 Lanes& out) {
+  store_8(_mm512_mullo_epi64(load_8(left), load_8(right)), out);
+}
+SIMP_AVX512 void less_than_avx512(const Lanes& left, const Lanes& right,
+                                  Lanes& out) {
+  store_8(_mm512_maskz_mov_epi64(
+              _mm512_cmplt_epi64_mask(load_8(left), load_8(right)),
+              _mm512_set1_epi64(1)),
+          out);
+}
+SIMP_AVX512 void equals_avx512(const Lanes& left, const Lanes& right,
+                               Lanes& out) {
+  store_8(_mm512_maskz_mov_epi64(
+              _mm512_cmpeq_epi64_mask(load_8(left), load_8(right)),
+              _mm512_set1_epi64(1)),
+          out);
+}
+SIMP_AVX512 void negate_avx512(const Lanes& value, Lanes& out) {
+  store_8(_mm512_sub_epi64(_mm512_setzero_si512(), load_8(value)), out);
+}
+SIMP_AVX512 void broadcast_avx512(int64_t value, Lanes& out) {
+  store_8(_mm512_set1_epi64(value), out);
+}
+SIMP_AVX512 LaneMask nonzero_avx512(const Lanes& value) {
+  __m512i lanes = load_8(value);
+  return _mm512_test_epi64_mask(lanes, lanes);
+}
+SIMP_AVX512 void from_mask_avx512(LaneMask mask, Lanes& out) {
+  store_8(_mm512_maskz_mov_epi64(mask, _mm512_set1_epi64(1)), out);
+}
+SIMP_AVX512 void blend_avx512(LaneMask mask, const Lanes& value, Lanes& out) {
+  store_8(_mm512_mask_mov_epi64(load_8(out), mask, load_8(value)), out);
+}
+#endif
+}  // namespace
+
+const LaneOps& LaneOps::scalar() {
+  static const LaneOps ops = {
+      "scalar",
+      add_scalar,
+      multiply_scalar,
+      less_than_scalar,
+      equals_scalar,
+      negate_scalar,
+      broadcast_scalar,
+      nonzero_scalar,
+      from_mask_scalar,
+      blend_scalar};
+  return ops;
+}
+
+const LaneOps* LaneOps::avx2() {
+#if SIMP_BATCH_SIMD
+  static const LaneOps ops = {
+      "avx2",
+      binary_avx2<add_4>,
+      binary_avx2<multiply_4>,
+      binary_avx2<less_than_4>,
+      binary_avx2<equals_4>,
+      negate_avx2,
+      broadcast_avx2,
+      nonzero_avx2,
+      from_mask_avx2,
+      blend_avx2};
+  return __builtin_cpu_supports("avx2") ? &ops : nullptr;
+#else
+  return nullptr;
+#endif
+}
+
+const LaneOps* LaneOps::avx512() {
+#if SIMP_BATCH_SIMD
+  static const LaneOps ops = {
+      "avx512",
+      add_avx512,
+      multiply_avx512,
+      less_than_avx512,
+      equals_avx512,
+      negate_avx512,
+      broadcast_avx512,
+      nonzero_avx512,
+      from_mask_avx512,
+      blend_avx512};
+  return __builtin_cpu_supports("avx512f") &&
+                 __builtin_cpu_supports("avx512dq")
+             ? &ops
+             : nullptr;
+#else
+  return nullptr;
+#endif
+}
+
+const LaneOps& LaneOps::best() {
+  static const LaneOps& ops = []() -> const LaneOps& {
+    const char* isa = std::getenv("SIMP_BATCH_ISA");
+    bool scalar_only = isa && std::strcmp(isa, "scalar") == 0;
+    bool avx2_only = isa && std::strcmp(isa, "avx2") == 0;
+    if (!scalar_only && !avx2_only && avx512()) {
+      return *avx512();
+    }
+    if (!scalar_only && avx2()) {
+      return *avx2();
+    }
+    return scalar();
+  }();
+  return ops;
+}
+
+}  // namespace simp
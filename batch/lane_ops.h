@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace simp {
+// The values of one SimpLang expression for a batch of kLanes runs of a
+// program, one run per lane: a single AVX-512 register or two AVX2 ones.
+inline constexpr size_t kLanes = 8;
+struct alignas(64) Lanes {
+  int64_t lane[kLanes];
+};
+// Bit i stands for lane i.
+using LaneMask = uint8_t;
+inline constexpr LaneMask kAllLanes = 0xff;
+
+// The arithmetic of SimpLang on every lane at once, wrapping on overflow
+// like the scalar evaluators. Comparisons give 0 or 1 per lane, the values
+// SimpLang has for them. Every implementation returns exactly what the
+// scalar one does.
+struct LaneOps {
+  using Binary = void (*)(const Lanes& left, const Lanes& right, Lanes& out);
+
+  const char* name;
+  Binary add;
+  Binary multiply;
+  Binary less_than;
+  Binary equals;
+  void (*negate)(const Lanes& value, Lanes& out);
+  void (*broadcast)(int64_t value, Lanes& out);
+  // The lanes whose value is not 0.
+  LaneMask (*nonzero)(const Lanes& value);
+  // 1 in the lanes of mask and 0 in the others.
+  void (*from_mask)(LaneMask mask, Lanes& out);
+  // Copies the lanes of mask from value into out, leaving the others.
+  void (*blend)(LaneMask mask, const Lanes& value, Lanes& out);
+
+  static const LaneOps& scalar();
+  // nullptr when the host or the compiler lacks the instruction set. AVX-512
+  // needs the F and DQ extensions, the latter for 64 bit multiplication.
+  static const LaneOps* avx2();
+  static const LaneOps* avx512();
+  // The widest implementation the CPU supports. Setting SIMP_BATCH_ISA to
+  // scalar or avx2 caps the choice.
+  static const LaneOps& best();
+};
+}  // namespace simp
@@ -0,0 +1,416 @@
+#include "closure.h"
+
+namespace simp {
+
+namespace {
+// Operands that are cheaper to read than calling a Closure.
+struct Constant {
+  int64_t value;
+  int64_t operator()(Frame&) const { return value; }
+};
+
+struct Variable {
+  size_t slot;
+  int64_t operator()(Frame& frame) const { return frame.slots[slot]; }
+};
+
+// Enters function with the arguments, already in their slots of frame.
+int64_t call_function(const ClosureFunction& function,
+                      const std::vector<std::pair<size_t, Closure>>& arguments,
+                      Frame& frame) {
+  if (!frame.callee) {
+    frame.callee = std::make_unique<Frame>();
+  }
+  Frame& callee = *frame.callee;
+  if (callee.slots.size() < function.slot_count) {
+    callee.slots.resize(function.slot_count);
+  }
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    callee.slots[i] = frame.slots[arguments[i].first];
+  }
+  return function.body(callee);
+}
+}  // namespace
+
+std::unique_ptr<ClosureProgram> ClosureCompiler::compile(
+    Ast& ast, MemoCache* memo_cache) {
+  memo_cache_ = memo_cache;
+  // Sized up front, so calls can refer to functions not compiled yet.
+  functions_ = std::make_shared<ClosureFunctions>(ast.functions().size());
+  for (size_t i = 0; i < ast.functions().size(); ++i) {
+    Function& function = *ast.functions()[i];
+    enter_frame(function.parameters().size());
+    Closure body = compile_expression(function.body().get());
+    if (!body) {
+      LOG(ERROR) << "Failed to compile function " << function.name()
+                 << " to closures";
+      return nullptr;
+    }
+    (*functions_)[i] = {std::move(body), slot_count_};
+  }
+  enter_frame(ast.inputs().size());
+  Closure closure = compile_expression(ast.root().get());
+  if (!closure) {
+    LOG(ERROR) << "Failed to compile program to closures";
+    return nullptr;
+  }
+  return std::make_unique<ClosureProgram>(std::move(closure), slot_count_,
+                                          std::move(functions_));
+}
+
+void ClosureCompiler::enter_frame(size_t parameters) {
+  variable_slots_.clear();
+  loops_.clear();
+  next_slot_ = 0;
+  slot_count_ = 0;
+  for (size_t i = 0; i < parameters; ++i) {
+    variable_slots_.push_back(allocate_slot());
+  }
+}
+
+size_t ClosureCompiler::allocate_slot() {
+  size_t slot = next_slot_++;
+  if (next_slot_ > slot_count_) {
+    slot_count_ = next_slot_;
+  }
+  return slot;
+}
+
+bool ClosureCompiler::lookup(IdentifierExpression* identifier, size_t& slot) {
+  int resolved = identifier->slot();
+  if (resolved < 0 || static_cast<size_t>(resolved) >= variable_slots_.size()) {
+    LOG(ERROR) << "Unresolved variable: " << identifier->name();
+    return false;
+  }
+  slot = variable_slots_[resolved];
+  return true;
+}
+
+template <typename Next>
+Closure ClosureCompiler::with_operand(Expression* expression, Next next) {
+  if (expression->type() == ExpressionType::INTEGER) {
+    return next(Constant{static_cast<IntExpression*>(expression)->value()});
+  }
+  if (expression->type() == ExpressionType::IDENTIFIER) {
+    size_t slot;
+    if (!lookup(static_cast<IdentifierExpression*>(expression), slot)) {
+      return nullptr;
+    }
+    return next(Variable{slot});
+  }
+  Closure closure = compile_expression(expression);
+  if (!closure) {
+    return nullptr;
+  }
+  return next(std::move(closure));
+}
+
+template <typename Op>
+Closure ClosureCompiler::bind_binary(Expression* left, Expression* right,
+                                     Op op) {
+  return with_operand(left, [&](auto left_operand) {
+    return with_operand(right, [&](auto right_operand) -> Closure {
+      return [left_operand, right_operand, op](Frame& frame) {
+        return op(left_operand(frame), right_operand(frame));
+      };
+    });
+  });
+}
+
+Closure ClosureCompiler::compile_expression(Expression* expression) {
+  if (!expression) {
+    LOG(ERROR) << "Missing expression";
+    return nullptr;
+  }
+  switch (expression->type()) {
+    case ExpressionType::INTEGER:
+    case ExpressionType::IDENTIFIER:
+      return with_operand(expression,
+                          [](auto operand) -> Closure { return operand; });
+    case ExpressionType::PARENTHESIS:
+      return compile_expression(
+          static_cast<ParenthesizedExpression*>(expression)
+              ->expression()
+              .get());
+    case ExpressionType::NOT: {
+      Closure operand = compile_expression(
+          static_cast<NotExpression*>(expression)->expression().get());
+      if (!operand) {
+        return nullptr;
+      }
+      return [operand = std::move(operand)](Frame& frame) -> int64_t {
+        return !operand(frame);
+      };
+    }
+    case ExpressionType::NEGATIVE: {
+      Closure operand = compile_expression(
+          static_cast<NegativeExpression*>(expression)->expression().get());
+      if (!operand) {
+        return nullptr;
+      }
+      return [operand = std::move(operand)](Frame& frame) {
+        return wrapping_negate(operand(frame));
+      };
+    }
+    case ExpressionType::IF: {
+      auto if_expression = static_cast<IfExpression*>(expression);
+      Closure condition = compile_expression(if_expression->condition().get());
+      Closure consequent =
+          compile_expression(if_expression->consequent().get());
+      Closure alternative =
+          compile_expression(if_expression->alternative().get());
+      if (!condition || !consequent || !alternative) {
+        return nullptr;
+      }
+      return [condition = std::move(condition),
+              consequent = std::move(consequent),
+              alternative = std::move(alternative)](Frame& frame) {
+        return condition(frame) ? consequent(frame) : alternative(frame);
+      };
+    }
+    case ExpressionType::BINARY:
+      return compile_binary(static_cast<BinaryExpression*>(expression));
+    case ExpressionType::LET:
+      return compile_let(static_cast<LetExpression*>(expression));
+    case ExpressionType::LOOP:
+      return compile_loop(static_cast<LoopExpression*>(expression));
+    case ExpressionType::RECUR:
+      return compile_recur(static_cast<RecurExpression*>(expression));
+    case ExpressionType::CALL:
+      return compile_call(static_cast<CallExpression*>(expression));
+    case ExpressionType::INTRINSIC:
+      return compile_intrinsic(static_cast<IntrinsicExpression*>(expression));
+    default:
+      LOG(ERROR) << "Closure compiler does not support expression:\n"
+                 << expression->to_string();
+      return nullptr;
+  }
+}
+
+bool ClosureCompiler::compile_bindings(
+    Bindings& bindings, std::vector<std::pair<size_t, Closure>>& compiled) {
+  for (const auto& binding : bindings) {
+    Closure closure = compile_expression(binding->expression().get());
+    int resolved = binding->slot();
+    if (!closure || resolved < 0) {
+      return false;
+    }
+    size_t slot = allocate_slot();
+    if (static_cast<size_t>(resolved) >= variable_slots_.size()) {
+      variable_slots_.resize(resolved + 1);
+    }
+    variable_slots_[resolved] = slot;
+    compiled.push_back({slot, std::move(closure)});
+  }
+  return true;
+}
+
+Closure ClosureCompiler::compile_let(LetExpression* expression) {
+  std::vector<std::pair<size_t, Closure>> bindings;
+  Closure body;
+  if (compile_bindings(expression->bindings(), bindings)) {
+    body = compile_expression(expression->expression().get());
+  }
+  release_slots(bindings.size());
+  if (!body) {
+    return nullptr;
+  }
+  return [bindings = std::move(bindings), body = std::move(body)](Frame& frame) {
+    for (const auto& [slot, closure] : bindings) {
+      frame.slots[slot] = closure(frame);
+    }
+    return body(frame);
+  };
+}
+
+Closure ClosureCompiler::compile_loop(LoopExpression* expression) {
+  std::vector<std::pair<size_t, Closure>> bindings;
+  Closure body;
+  if (compile_bindings(expression->bindings(), bindings)) {
+    std::vector<size_t> variables;
+    for (const auto& binding : bindings) {
+      variables.push_back(binding.first);
+    }
+    loops_.push_back(variables);
+    body = compile_expression(expression->expression().get());
+    loops_.pop_back();
+  }
+  release_slots(bindings.size());
+  if (!body) {
+    return nullptr;
+  }
+  return [bindings = std::move(bindings), body = std::move(body)](Frame& frame) {
+    for (const auto& [slot, closure] : bindings) {
+      frame.slots[slot] = closure(frame);
+    }
+    for (;;) {
+      int64_t result = body(frame);
+      if (!frame.recurring) {
+        return result;
+      }
+      frame.recurring = false;
+    }
+  };
+}
+
+Closure ClosureCompiler::compile_recur(RecurExpression* expression) {
+  if (loops_.empty() ||
+      loops_.back().size() != expression->arguments().size()) {
+    LOG(ERROR) << "Recur does not match its loop";
+    return nullptr;
+  }
+  // Arguments land in scratch slots first, since they may refer to each
+  // other's old values, and are copied into the loop variables afterwards.
+  std::vector<std::pair<size_t, Closure>> arguments;
+  std::vector<std::pair<size_t, size_t>> moves;
+  const std::vector<size_t> variables = loops_.back();
+  for (size_t i = 0; i < expression->arguments().size(); ++i) {
+    Closure closure = compile_expression(expression->arguments()[i].get());
+    if (!closure) {
+      release_slots(arguments.size());
+      return nullptr;
+    }
+    size_t scratch = allocate_slot();
+    arguments.push_back({scratch, std::move(closure)});
+    moves.push_back({variables[i], scratch});
+  }
+  release_slots(arguments.size());
+  return [arguments = std::move(arguments),
+          moves = std::move(moves)](Frame& frame) -> int64_t {
+    for (const auto& [slot, closure] : arguments) {
+      frame.slots[slot] = closure(frame);
+    }
+    for (const auto& [variable, scratch] : moves) {
+      frame.slots[variable] = frame.slots[scratch];
+    }
+    frame.recurring = true;
+    return 0;
+  };
+}
+
+Closure ClosureCompiler::compile_call(CallExpression* expression) {
+  // Arguments land in scratch slots of the caller's frame first, since
+  // evaluating one may itself call and reuse the callee frame.
+  std::vector<std::pair<size_t, Closure>> arguments;
+  for (const auto& argument : expression->arguments()) {
+    Closure closure = compile_expression(argument.get());
+    if (!closure) {
+      release_slots(arguments.size());
+      return nullptr;
+    }
+    arguments.push_back({allocate_slot(), std::move(closure)});
+  }
+  release_slots(arguments.size());
+  if (memo_cache_ && memo_cache_->memoized(expression->function())) {
+    return [functions = functions_.get(), index = expression->function(),
+            arguments = std::move(arguments),
+            memo_cache = memo_cache_](Frame& frame) -> int64_t {
+      int64_t values[MemoCache::kMaxArguments];
+      for (size_t i = 0; i < arguments.size(); ++i) {
+        values[i] = arguments[i].second(frame);
+        frame.slots[arguments[i].first] = values[i];
+      }
+      int64_t result;
+      if (!memo_cache->lookup(index, values, arguments.size(), result)) {
+        result = call_function((*functions)[index], arguments, frame);
+        memo_cache->insert(index, values, arguments.size(), result);
+      }
+      return result;
+    };
+  }
+  return [functions = functions_.get(), index = expression->function(),
+          arguments = std::move(arguments)](Frame& frame) -> int64_t {
+    for (const auto& [slot, closure] : arguments) {
+      frame.slots[slot] = closure(frame);
+    }
+    return call_function((*functions)[index], arguments, frame);
+  };
+}
+
+Closure ClosureCompiler::compile_intrinsic(IntrinsicExpression* expression) {
+  auto& arguments = expression->arguments();
+  switch (expression->intrinsic()) {
+    case Intrinsic::DIV:
+      return bind_binary(arguments[0].get(), arguments[1].get(),
+                         [](int64_t x, int64_t y) {
+                           return intrinsic_div(x, y);
+                         });
+    case Intrinsic::REM:
+      return bind_binary(arguments[0].get(), arguments[1].get(),
+                         [](int64_t x, int64_t y) {
+                           return intrinsic_rem(x, y);
+                         });
+    case Intrinsic::SHIFTL:
+      return bind_binary(arguments[0].get(), arguments[1].get(),
+                         [](int64_t x, int64_t a) {
+                           return intrinsic_shiftl(x, a);
+                         });
+    case Intrinsic::SHIFTR:
+      return bind_binary(arguments[0].get(), arguments[1].get(),
+                         [](int64_t x, int64_t a) {
+                           return intrinsic_shiftr(x, a);
+                         });
+    case Intrinsic::LEADING_ZEROS:
+      return with_operand(arguments[0].get(), [](auto operand) -> Closure {
+        return [operand](Frame& frame) {
+          return intrinsic_leadingzeros(operand(frame));
+        };
+      });
+  }
+  LOG(ERROR) << "Unknown intrinsic";
+  return nullptr;
+}
+
+Closure ClosureCompiler::compile_binary(BinaryExpression* expression) {
+  Expression* left = expression->left().get();
+  Expression* right = expression->right().get();
+  if (!left || !right) {
+    LOG(ERROR) << "Missing operand";
+    return nullptr;
+  }
+  switch (expression->op()) {
+    case Operator::PLUS:
+      return bind_binary(left, right, [](int64_t l, int64_t r) {
+        return wrapping_add(l, r);
+      });
+    case Operator::TIMES:
+      return bind_binary(left, right, [](int64_t l, int64_t r) {
+        return wrapping_multiply(l, r);
+      });
+    case Operator::LESS_THAN:
+      return bind_binary(left, right, [](int64_t l, int64_t r) -> int64_t {
+        return l < r;
+      });
+    case Operator::EQUALS:
+      return bind_binary(left, right, [](int64_t l, int64_t r) -> int64_t {
+        return l == r;
+      });
+    case Operator::LOGICAL_AND:
+    case Operator::LOGICAL_OR: {
+      // Shortcut evaluation needs the right operand unevaluated.
+      Closure left_closure = compile_expression(left);
+      Closure right_closure = compile_expression(right);
+      if (!left_closure || !right_closure) {
+        return nullptr;
+      }
+      if (expression->op() == Operator::LOGICAL_AND) {
+        return [left_closure = std::move(left_closure),
+                right_closure = std::move(right_closure)](
+                   Frame& frame) -> int64_t {
+          return left_closure(frame) && right_closure(frame);
+        };
+      }
+      return [left_closure = std::move(left_closure),
+              right_closure = std::move(right_closure)](
+                 Frame& frame) -> int64_t {
+        return left_closure(frame) || right_closure(frame);
+      };
+    }
+    default:
+      LOG(ERROR) << "Not a binary operator: "
+                 << op_to_string(expression->op());
+      return nullptr;
+  }
+}
+
+}  // namespace simp
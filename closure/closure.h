@@ -0,0 +1,104 @@
+#pragma once
+
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ast/ast.h"
+#include "memo/memo_cache.h"
+
+namespace simp {
+// Variables of a running closure program. Every variable, and every value a
+// recur passes to its loop, has a fixed slot chosen when the closures are
+// built.
+struct Frame {
+  std::vector<int64_t> slots;
+  // Set by a recur on its way back to its loop.
+  bool recurring = false;
+  // The frame of the function this one calls. A frame has at most one call
+  // running, so the chain is the call stack and is reused from call to call.
+  std::unique_ptr<Frame> callee;
+};
+
+// A compiled expression. Every decision that only depends on the shape of the
+// Ast (which operator to apply, which operands are constants, which slot holds
+// a variable) is made once when the closure is built, so calling it never
+// looks at the Ast again.
+using Closure = std::function<int64_t(Frame&)>;
+
+// A compiled function, entered with its parameters in its first slots.
+struct ClosureFunction {
+  Closure body;
+  size_t slot_count = 0;
+};
+// Indexed the way calls name their callee.
+using ClosureFunctions = std::vector<ClosureFunction>;
+
+class ClosureProgram {
+ public:
+  ClosureProgram(Closure root, size_t slot_count,
+                 std::shared_ptr<ClosureFunctions> functions = nullptr)
+      : root_(std::move(root)), functions_(std::move(functions)) {
+    frame_.slots.resize(slot_count);
+  }
+
+  // The arguments go to the first slots of the root frame.
+  int64_t run(const std::vector<int64_t>& arguments = {}) {
+    std::copy(arguments.begin(), arguments.end(), frame_.slots.begin());
+    return root_(frame_);
+  }
+
+ private:
+  Closure root_;
+  // Call closures refer to the table, which lives as long as the program.
+  std::shared_ptr<ClosureFunctions> functions_;
+  Frame frame_;
+};
+
+class ClosureCompiler {
+ public:
+  // Returns nullptr if the Ast contains unsupported expressions. Calls to the
+  // functions memo_cache memoizes go through it.
+  std::unique_ptr<ClosureProgram> compile(Ast& ast,
+                                          MemoCache* memo_cache = nullptr);
+
+ private:
+  Closure compile_expression(Expression* expression);
+  Closure compile_binary(BinaryExpression* expression);
+  Closure compile_let(LetExpression* expression);
+  Closure compile_loop(LoopExpression* expression);
+  Closure compile_recur(RecurExpression* expression);
+  Closure compile_call(CallExpression* expression);
+  Closure compile_intrinsic(IntrinsicExpression* expression);
+  // Starts compiling a function whose parameters take the first slots.
+  void enter_frame(size_t parameters);
+  bool compile_bindings(Bindings& bindings,
+                        std::vector<std::pair<size_t, Closure>>& compiled);
+  template <typename Op>
+  Closure bind_binary(Expression* left, Expression* right, Op op);
+  // Calls `next` with the cheapest callable that produces the operand.
+  template <typename Next>
+  Closure with_operand(Expression* expression, Next next);
+  bool lookup(IdentifierExpression* identifier, size_t& slot);
+  size_t allocate_slot();
+  void release_slots(size_t count) { next_slot_ -= count; }
+
+  // The frame slot holding each variable, indexed by its resolved slot. The
+  // frame also holds recur scratch values, so the two numberings differ.
+  std::vector<size_t> variable_slots_;
+  // The variable slots of the loops being compiled, innermost last.
+  std::vector<std::vector<size_t>> loops_;
+  size_t next_slot_ = 0;
+  size_t slot_count_ = 0;
+  std::shared_ptr<ClosureFunctions> functions_;
+  MemoCache* memo_cache_ = nullptr;
+};
+}  // namespace simp
@@ -0,0 +1,80 @@
+#include "closure/closure.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "parser/parser.h"
+
+namespace simp {
+namespace {
+using ::testing::Eq;
+using ::testing::NotNull;
+class ClosureTest : public ::testing::Test {
+ protected:
+  ClosureTest() {}
+  ~ClosureTest() override {}
+  void SetUp() override {}
+
+  std::unique_ptr<Ast> parse(const std::string& file) {
+    Parser parser(file);
+    EXPECT_TRUE(parser.parse());
+    return parser.ast();
+  }
+};
+
+TEST_F(ClosureTest, RunsIntExpression) {
+  auto ast = parse("examples/just_nums.sl");
+  auto program = ClosureCompiler().compile(*ast);
+  ASSERT_THAT(program, NotNull());
+  EXPECT_THAT(program->run(), Eq(1234567890));
+}
+
+TEST_F(ClosureTest, RunsIfExpression) {
+  auto ast = parse("examples/if_statement.sl");
+  auto program = ClosureCompiler().compile(*ast);
+  ASSERT_THAT(program, NotNull());
+  EXPECT_THAT(program->run(), Eq(2));
+}
+
+TEST_F(ClosureTest, WrapsOnOverflow) {
+  auto ast = parse("examples/overflow.sl");
+  auto program = ClosureCompiler().compile(*ast);
+  ASSERT_THAT(program, NotNull());
+  EXPECT_THAT(program->run(), Eq(INT64_MIN));
+}
+
+TEST_F(ClosureTest, RunsLoopInConstantStack) {
+  auto ast = parse("examples/long_loop.sl");
+  auto program = ClosureCompiler().compile(*ast);
+  ASSERT_THAT(program, NotNull());
+  EXPECT_THAT(program->run(), Eq(49999995000000));
+}
+
+TEST_F(ClosureTest, CallsFunctions) {
+  auto ast = parse("examples/nextprime.sl");
+  auto program = ClosureCompiler().compile(*ast);
+  ASSERT_THAT(program, NotNull());
+  for (int64_t n : {1, 100, 1000000, 2147483647}) {
+    EXPECT_THAT(program->run({n}), Eq(ast->eval({n}))) << n;
+  }
+}
+
+TEST_F(ClosureTest, MatchesTreeEvaluation) {
+  for (std::string file :
+       {"examples/just_nums.sl", "examples/if_statement.sl",
+        "examples/not_expression.sl", "examples/negative_expression.sl",
+        "examples/parenthesized_expression.sl",
+        "examples/logical_expression.sl", "examples/overflow.sl",
+        "examples/shadowing.sl", "examples/factorial_loop.sl",
+        "examples/shiftl_loop.sl", "examples/swap_loop.sl",
+        "examples/nested_loop.sl", "examples/functions.sl",
+        "examples/intrinsics.sl"}) {
+    auto ast = parse(file);
+    auto program = ClosureCompiler().compile(*ast);
+    ASSERT_THAT(program, NotNull()) << file;
+    EXPECT_THAT(program->run(), Eq(ast->eval())) << file;
+  }
+}
+
+}  // namespace
+}  // namespace simp
@@ -0,0 +1,438 @@
+#include "c_emitter.h"
+
+#include <algorithm>
+
+namespace simp {
+
+namespace {
+const char* kPrelude =
+    "#include <inttypes.h>\n"
+    "#include <stdint.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "\n"
+    "/* SimpLang integers wrap around on overflow. */\n"
+    "static inline int64_t simp_add(int64_t a, int64_t b) {\n"
+    "  return (int64_t)((uint64_t)a + (uint64_t)b);\n"
+    "}\n"
+    "static inline int64_t simp_multiply(int64_t a, int64_t b) {\n"
+    "  return (int64_t)((uint64_t)a * (uint64_t)b);\n"
+    "}\n"
+    "static inline int64_t simp_negate(int64_t a) {\n"
+    "  return (int64_t)(0 - (uint64_t)a);\n"
+    "}\n"
+    "\n"
+    "/* The intrinsics, with the edge cases of ast/intrinsics.h. */\n"
+    "static inline int64_t simp_div(int64_t x, int64_t y) {\n"
+    "  if (y == 0 || x == INT64_MIN || y == INT64_MIN) return 0;\n"
+    "  return x / y;\n"
+    "}\n"
+    "static inline int64_t simp_rem(int64_t x, int64_t y) {\n"
+    "  return (int64_t)((uint64_t)x - (uint64_t)y * (uint64_t)simp_div(x, y));\n"
+    "}\n"
+    "static inline int64_t simp_shiftl(int64_t x, int64_t a) {\n"
+    "  if (a <= 0) return x;\n"
+    "  return a >= 64 ? 0 : (int64_t)((uint64_t)x << a);\n"
+    "}\n"
+    "static inline int64_t simp_shiftr(int64_t x, int64_t a) {\n"
+    "  if (a < 0) return a <= -64 ? 0 : simp_shiftl(x, -a);\n"
+    "  return a >= 64 ? 0 : (int64_t)((uint64_t)x >> a);\n"
+    "}\n"
+    "static inline int64_t simp_leadingzeros(int64_t x) {\n"
+    "  if (x == 0) return 64;\n"
+    "#if defined(__GNUC__)\n"
+    "  return __builtin_clzll((uint64_t)x);\n"
+    "#else\n"
+    "  int64_t n = 0;\n"
+    "  for (; x > 0; x = (int64_t)((uint64_t)x << 1)) n++;\n"
+    "  return n;\n"
+    "#endif\n"
+    "}\n"
+    "\n";
+
+std::string literal(int64_t value) {
+  return "INT64_C(" + std::to_string(value) + ")";
+}
+
+// Numbered like bound variables, since parameters may share a name.
+std::string parameter_name(const std::string& name, size_t index) {
+  return "p_" + name + "_" + std::to_string(index);
+}
+}  // namespace
+
+bool CEmitter::emit(Ast& ast, std::string& source) {
+  source = kPrelude;
+  function_names_.clear();
+  std::vector<std::string> signatures;
+  for (size_t i = 0; i < ast.functions().size(); ++i) {
+    Function& function = *ast.functions()[i];
+    function_names_.push_back("simp_fn_" + function.name());
+    std::string signature = "int64_t " + function_names_.back() + "(";
+    for (size_t j = 0; j < function.parameters().size(); ++j) {
+      signature += std::string(j == 0 ? "" : ", ") + "int64_t " +
+                   parameter_name(function.parameters()[j], j);
+    }
+    signatures.push_back(signature + ")");
+    // Declared up front, since a function may call itself.
+    source += signatures.back() + ";\n";
+  }
+  if (!signatures.empty()) {
+    source += "\n";
+  }
+  for (size_t i = 0; i < ast.functions().size(); ++i) {
+    Function& function = *ast.functions()[i];
+    if (!emit_function(function.body().get(), function.parameters(),
+                       signatures[i], source)) {
+      LOG(ERROR) << "Failed to translate function " << function.name()
+                 << " to C";
+      return false;
+    }
+    source += "\n";
+  }
+  std::string signature = "int64_t simp_main(";
+  for (size_t i = 0; i < ast.inputs().size(); ++i) {
+    signature += std::string(i == 0 ? "" : ", ") + "int64_t " +
+                 parameter_name(ast.inputs()[i], i);
+  }
+  signature += ast.inputs().empty() ? "void)" : ")";
+  if (!emit_function(ast.root().get(), ast.inputs(), signature, source)) {
+    LOG(ERROR) << "Failed to translate program to C";
+    return false;
+  }
+  return true;
+}
+
+bool CEmitter::emit_function(Expression* body,
+                             const std::vector<std::string>& parameters,
+                             const std::string& signature,
+                             std::string& source) {
+  body_ = "";
+  next_temporary_ = 0;
+  temporaries_ = 0;
+  slot_variables_.clear();
+  variables_.clear();
+  loops_.clear();
+  for (size_t i = 0; i < parameters.size(); ++i) {
+    slot_variables_.push_back(parameter_name(parameters[i], i));
+  }
+  std::string result = new_temporary();
+  if (!emit_expression(body, result, 1)) {
+    return false;
+  }
+  source += signature + " {\n";
+  for (int i = 0; i < temporaries_; ++i) {
+    source += "  int64_t t" + std::to_string(i) + ";\n";
+  }
+  for (const auto& variable : variables_) {
+    source += "  int64_t " + variable + ";\n";
+  }
+  source += body_;
+  source += "  return " + result + ";\n";
+  source += "}\n";
+  return true;
+}
+
+std::string CEmitter::executable_entry_point(size_t inputs) {
+  if (inputs == 0) {
+    return "\n"
+           "int main(void) {\n"
+           "  printf(\"%\" PRId64 \"\\n\", simp_main());\n"
+           "  return 0;\n"
+           "}\n";
+  }
+  std::string arguments = "";
+  for (size_t i = 0; i < inputs; ++i) {
+    arguments += std::string(i == 0 ? "" : ", ") + "strtoll(argv[" +
+                 std::to_string(i + 1) + "], NULL, 10)";
+  }
+  return "\n"
+         "int main(int argc, char** argv) {\n"
+         "  if (argc != " +
+         std::to_string(inputs + 1) +
+         ") {\n"
+         "    fprintf(stderr, \"usage: %s " +
+         std::to_string(inputs) +
+         " integer arguments\\n\", argv[0]);\n"
+         "    return 1;\n"
+         "  }\n"
+         "  printf(\"%\" PRId64 \"\\n\", simp_main(" +
+         arguments +
+         "));\n"
+         "  return 0;\n"
+         "}\n";
+}
+
+std::string CEmitter::new_temporary() {
+  if (next_temporary_ == temporaries_) {
+    temporaries_++;
+  }
+  return "t" + std::to_string(next_temporary_++);
+}
+
+bool CEmitter::lookup(IdentifierExpression* identifier, std::string& variable) {
+  int slot = identifier->slot();
+  if (slot < 0 || static_cast<size_t>(slot) >= slot_variables_.size()) {
+    LOG(ERROR) << "Unresolved variable: " << identifier->name();
+    return false;
+  }
+  variable = slot_variables_[slot];
+  return true;
+}
+
+void CEmitter::line(int indent, const std::string& statement) {
+  body_ += std::string(indent * 2, ' ') + statement + "\n";
+}
+
+bool CEmitter::emit_operand(Expression* expression, int indent,
+                            std::string& operand, const std::string& scratch) {
+  if (expression && expression->type() == ExpressionType::INTEGER) {
+    operand = literal(static_cast<IntExpression*>(expression)->value());
+    return true;
+  }
+  if (expression && expression->type() == ExpressionType::IDENTIFIER) {
+    return lookup(static_cast<IdentifierExpression*>(expression), operand);
+  }
+  operand = scratch.empty() ? new_temporary() : scratch;
+  return emit_expression(expression, operand, indent);
+}
+
+bool CEmitter::emit_expression(Expression* expression,
+                               const std::string& target, int indent) {
+  if (!expression) {
+    LOG(ERROR) << "Missing expression";
+    return false;
+  }
+  switch (expression->type()) {
+    case ExpressionType::INTEGER:
+      line(indent,
+           target + " = " +
+               literal(static_cast<IntExpression*>(expression)->value()) + ";");
+      return true;
+    case ExpressionType::PARENTHESIS:
+      return emit_expression(
+          static_cast<ParenthesizedExpression*>(expression)
+              ->expression()
+              .get(),
+          target, indent);
+    case ExpressionType::NOT: {
+      std::string operand;
+      if (!emit_operand(
+              static_cast<NotExpression*>(expression)->expression().get(),
+              indent, operand, target)) {
+        return false;
+      }
+      line(indent, target + " = !" + operand + ";");
+      return true;
+    }
+    case ExpressionType::NEGATIVE: {
+      std::string operand;
+      if (!emit_operand(
+              static_cast<NegativeExpression*>(expression)->expression().get(),
+              indent, operand, target)) {
+        return false;
+      }
+      line(indent, target + " = simp_negate(" + operand + ");");
+      return true;
+    }
+    case ExpressionType::IF: {
+      auto if_expression = static_cast<IfExpression*>(expression);
+      std::string condition;
+      if (!emit_operand(if_expression->condition().get(), indent, condition,
+                        target)) {
+        return false;
+      }
+      line(indent, "if (" + condition + ") {");
+      if (!emit_expression(if_expression->consequent().get(), target,
+                           indent + 1)) {
+        return false;
+      }
+      line(indent, "} else {");
+      if (!emit_expression(if_expression->alternative().get(), target,
+                           indent + 1)) {
+        return false;
+      }
+      line(indent, "}");
+      return true;
+    }
+    case ExpressionType::BINARY:
+      return emit_binary(static_cast<BinaryExpression*>(expression), target,
+                         indent);
+    case ExpressionType::IDENTIFIER: {
+      std::string variable;
+      if (!lookup(static_cast<IdentifierExpression*>(expression), variable)) {
+        return false;
+      }
+      line(indent, target + " = " + variable + ";");
+      return true;
+    }
+    case ExpressionType::LET: {
+      auto let_expression = static_cast<LetExpression*>(expression);
+      std::vector<std::string> variables;
+      return emit_bindings(let_expression->bindings(), indent, variables) &&
+             emit_expression(let_expression->expression().get(), target,
+                             indent);
+    }
+    case ExpressionType::LOOP:
+      return emit_loop(static_cast<LoopExpression*>(expression), target,
+                       indent);
+    case ExpressionType::RECUR:
+      return emit_recur(static_cast<RecurExpression*>(expression), indent);
+    case ExpressionType::CALL: {
+      auto call = static_cast<CallExpression*>(expression);
+      return emit_call(function_names_[call->function()], call->arguments(),
+                       target, indent);
+    }
+    case ExpressionType::INTRINSIC: {
+      auto intrinsic = static_cast<IntrinsicExpression*>(expression);
+      return emit_call(
+          std::string("simp_") + intrinsic_name(intrinsic->intrinsic()),
+          intrinsic->arguments(), target, indent);
+    }
+    default:
+      LOG(ERROR) << "C emitter does not support expression:\n"
+                 << expression->to_string();
+      return false;
+  }
+}
+
+bool CEmitter::emit_bindings(Bindings& bindings, int indent,
+                             std::vector<std::string>& variables) {
+  for (const auto& binding : bindings) {
+    // Every binding gets its own C variable, so shadowing needs no scopes.
+    // It is reserved before its initializer is emitted, since bindings in the
+    // initializer need names of their own.
+    std::string variable = "v_" + binding->name() + "_" +
+                           std::to_string(variables_.size());
+    variables_.push_back(variable);
+    int slot = binding->slot();
+    if (slot < 0 ||
+        !emit_expression(binding->expression().get(), variable, indent)) {
+      return false;
+    }
+    variables.push_back(variable);
+    if (static_cast<size_t>(slot) >= slot_variables_.size()) {
+      slot_variables_.resize(slot + 1);
+    }
+    slot_variables_[slot] = variable;
+  }
+  return true;
+}
+
+bool CEmitter::emit_loop(LoopExpression* expression, const std::string& target,
+                         int indent) {
+  std::vector<std::string> variables;
+  bool ok = emit_bindings(expression->bindings(), indent, variables);
+  if (ok) {
+    loops_.push_back(variables);
+    line(indent, "for (;;) {");
+    ok = emit_expression(expression->expression().get(), target, indent + 1);
+    line(indent + 1, "break;");
+    line(indent, "}");
+    loops_.pop_back();
+  }
+  return ok;
+}
+
+bool CEmitter::emit_recur(RecurExpression* expression, int indent) {
+  auto& arguments = expression->arguments();
+  if (loops_.empty() || loops_.back().size() != arguments.size()) {
+    LOG(ERROR) << "Recur does not match its loop";
+    return false;
+  }
+  // All arguments are computed before any loop variable changes.
+  const std::vector<std::string> variables = loops_.back();
+  int temporaries_before = next_temporary_;
+  std::vector<std::string> values;
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    std::string value;
+    if (!emit_operand(arguments[i].get(), indent, value)) {
+      return false;
+    }
+    // Another loop variable may be overwritten before it is read.
+    if (value != variables[i] &&
+        std::find(variables.begin(), variables.end(), value) !=
+            variables.end()) {
+      std::string copy = new_temporary();
+      line(indent, copy + " = " + value + ";");
+      value = copy;
+    }
+    values.push_back(value);
+  }
+  for (size_t i = 0; i < variables.size(); ++i) {
+    if (values[i] != variables[i]) {
+      line(indent, variables[i] + " = " + values[i] + ";");
+    }
+  }
+  next_temporary_ = temporaries_before;
+  line(indent, "continue;");
+  return true;
+}
+
+bool CEmitter::emit_call(const std::string& function,
+                         std::vector<std::unique_ptr<Expression>>& arguments,
+                         const std::string& target, int indent) {
+  int temporaries_before = next_temporary_;
+  std::string values = "";
+  for (const auto& argument : arguments) {
+    std::string value;
+    if (!emit_operand(argument.get(), indent, value)) {
+      return false;
+    }
+    values += (values.empty() ? "" : ", ") + value;
+  }
+  next_temporary_ = temporaries_before;
+  line(indent, target + " = " + function + "(" + values + ");");
+  return true;
+}
+
+bool CEmitter::emit_binary(BinaryExpression* expression,
+                           const std::string& target, int indent) {
+  Operator op = expression->op();
+  if (op == Operator::LOGICAL_AND || op == Operator::LOGICAL_OR) {
+    // Shortcut evaluation: only run the right hand side when it decides.
+    if (!emit_expression(expression->left().get(), target, indent)) {
+      return false;
+    }
+    line(indent, target + " = " + target + " != 0;");
+    line(indent, std::string("if (") + (op == Operator::LOGICAL_OR ? "!" : "") +
+                     target + ") {");
+    if (!emit_expression(expression->right().get(), target, indent + 1)) {
+      return false;
+    }
+    line(indent + 1, target + " = " + target + " != 0;");
+    line(indent, "}");
+    return true;
+  }
+
+  std::string left;
+  if (!emit_operand(expression->left().get(), indent, left, target)) {
+    return false;
+  }
+  int temporaries_before = next_temporary_;
+  std::string right;
+  if (!emit_operand(expression->right().get(), indent, right)) {
+    return false;
+  }
+  if (next_temporary_ > temporaries_before) {
+    release_temporary();
+  }
+  switch (op) {
+    case Operator::PLUS:
+      line(indent, target + " = simp_add(" + left + ", " + right + ");");
+      return true;
+    case Operator::TIMES:
+      line(indent, target + " = simp_multiply(" + left + ", " + right + ");");
+      return true;
+    case Operator::LESS_THAN:
+      line(indent, target + " = " + left + " < " + right + ";");
+      return true;
+    case Operator::EQUALS:
+      line(indent, target + " = " + left + " == " + right + ";");
+      return true;
+    default:
+      LOG(ERROR) << "Not a binary operator: " << op_to_string(op);
+      return false;
+  }
+}
+
+}  // namespace simp
@@ -0,0 +1,77 @@
+#pragma once
+
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <glog/logging.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ast/ast.h"
+
+namespace simp {
+// Translates an Ast into a portable C translation unit. Expressions are
+// lowered to statements that assign into int64_t temporaries, so control
+// flow maps onto plain C if statements and the C compiler does the register
+// allocation. Each SimpLang function becomes an exported C function named
+// `simp_fn_<name>`, with one int64_t parameter per SimpLang one, and calls
+// become direct C calls. The program is exported as `int64_t simp_main(void)`,
+// or with one int64_t parameter per input when it evaluates a call to main.
+class CEmitter {
+ public:
+  // Returns false if the Ast contains unsupported expressions.
+  bool emit(Ast& ast, std::string& source);
+  // Appends a C `main` that prints the result of simp_main, for building a
+  // standalone executable. A program with inputs reads them from the command
+  // line.
+  static std::string executable_entry_point(size_t inputs = 0);
+
+ private:
+  // Appends the C definition of a function with the given signature, whose
+  // parameters are named after the SimpLang ones.
+  bool emit_function(Expression* body,
+                     const std::vector<std::string>& parameters,
+                     const std::string& signature, std::string& source);
+  bool emit_expression(Expression* expression, const std::string& target,
+                       int indent);
+  // Literals are used in place; anything else is computed into `scratch`,
+  // or into a fresh temporary when no scratch variable is given.
+  bool emit_operand(Expression* expression, int indent, std::string& operand,
+                    const std::string& scratch = "");
+  bool emit_binary(BinaryExpression* expression, const std::string& target,
+                   int indent);
+  // Assigns each binding to a fresh C variable and brings it into scope.
+  bool emit_bindings(Bindings& bindings, int indent,
+                     std::vector<std::string>& variables);
+  // A loop becomes `for (;;)` around its body; a recur assigns the loop
+  // variables and continues, so neither grows the C stack.
+  bool emit_loop(LoopExpression* expression, const std::string& target,
+                 int indent);
+  bool emit_recur(RecurExpression* expression, int indent);
+  // Calls a C function, a SimpLang function's or an intrinsic's.
+  bool emit_call(const std::string& function,
+                 std::vector<std::unique_ptr<Expression>>& arguments,
+                 const std::string& target, int indent);
+  bool lookup(IdentifierExpression* identifier, std::string& variable);
+  // Temporaries are reused like a stack, the same way the bytecode compiler
+  // hands out registers.
+  std::string new_temporary();
+  void release_temporary() { next_temporary_--; }
+  void line(int indent, const std::string& statement);
+
+  std::string body_;
+  int next_temporary_ = 0;
+  int temporaries_ = 0;
+  // The C variable holding each SimpLang variable, indexed by its resolved
+  // frame slot.
+  std::vector<std::string> slot_variables_;
+  // Every C variable bound in the function being emitted, declared at its
+  // top.
+  std::vector<std::string> variables_;
+  // The variables of the loops being emitted, innermost last.
+  std::vector<std::vector<std::string>> loops_;
+  // The C name of each function, indexed as calls name them.
+  std::vector<std::string> function_names_;
+};
+}  // namespace simp
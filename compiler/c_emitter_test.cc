@@ -0,0 +1,160 @@
+#include "compiler/c_emitter.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <dlfcn.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+#include "parser/parser.h"
+
+namespace simp {
+namespace {
+using ::testing::Eq;
+using ::testing::HasSubstr;
+using ::testing::Not;
+using ::testing::NotNull;
+class CEmitterTest : public ::testing::Test {
+ protected:
+  CEmitterTest() {}
+  ~CEmitterTest() override {}
+  void SetUp() override {}
+
+  std::string emit(const std::string& file) {
+    Parser parser(file);
+    EXPECT_TRUE(parser.parse());
+    ast_ = parser.ast();
+    std::string source;
+    EXPECT_TRUE(CEmitter().emit(*ast_, source));
+    return source;
+  }
+
+  // Builds and runs the emitted program with the system C compiler. Returns
+  // false if no C compiler is available.
+  bool compile_and_run(const std::string& source, std::string& output) {
+    auto dir = std::filesystem::temp_directory_path();
+    std::string c_file = (dir / "c_emitter_test.c").string();
+    std::string binary = (dir / "c_emitter_test").string();
+    std::ofstream(c_file) << source << CEmitter::executable_entry_point();
+    std::string command =
+        "cc -O1 -o '" + binary + "' '" + c_file + "' 2>/dev/null";
+    if (std::system(command.c_str()) != 0) {
+      return false;
+    }
+    FILE* pipe = popen(binary.c_str(), "r");
+    char buffer[64] = {0};
+    if (!pipe || !fgets(buffer, sizeof(buffer), pipe)) {
+      return false;
+    }
+    pclose(pipe);
+    output = buffer;
+    return true;
+  }
+
+  // Builds the emitted program into a shared object and opens it. Returns
+  // nullptr if no C compiler is available.
+  void* compile_shared(const std::string& source) {
+    auto dir = std::filesystem::temp_directory_path();
+    std::string c_file = (dir / "c_emitter_test_shared.c").string();
+    std::string library = (dir / "libc_emitter_test.so").string();
+    std::ofstream(c_file) << source;
+    std::string command = "cc -O1 -shared -fPIC -o '" + library + "' '" +
+                          c_file + "' 2>/dev/null";
+    if (std::system(command.c_str()) != 0) {
+      return nullptr;
+    }
+    return dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+  }
+
+  std::unique_ptr<Ast> ast_;
+};
+
+TEST_F(CEmitterTest, EmitsSimpMain) {
+  std::string source = emit("examples/just_nums.sl");
+  EXPECT_THAT(source, HasSubstr("int64_t simp_main(void) {"));
+  EXPECT_THAT(source, HasSubstr("t0 = INT64_C(1234567890);"));
+}
+
+TEST_F(CEmitterTest, UsesLiteralsAsOperands) {
+  std::string source = emit("examples/overflow.sl");
+  EXPECT_THAT(source,
+              HasSubstr("t0 = simp_add(INT64_C(9223372036854775807), "
+                        "INT64_C(1));"));
+  EXPECT_THAT(source, Not(HasSubstr("int64_t t1;")));
+}
+
+TEST_F(CEmitterTest, EmitsIfStatement) {
+  std::string source = emit("examples/if_statement.sl");
+  EXPECT_THAT(source, HasSubstr("if (INT64_C(123)) {"));
+  EXPECT_THAT(source, HasSubstr("} else {"));
+}
+
+TEST_F(CEmitterTest, EmitsLoopAsForStatement) {
+  std::string source = emit("examples/factorial_loop.sl");
+  EXPECT_THAT(source, HasSubstr("for (;;) {"));
+  EXPECT_THAT(source, HasSubstr("continue;"));
+}
+
+TEST_F(CEmitterTest, EmitsFunctionsAsCFunctions) {
+  std::string source = emit("examples/nextprime.sl");
+  EXPECT_THAT(source,
+              HasSubstr("\nint64_t simp_fn_shiftl(int64_t p_x_0, "
+                        "int64_t p_a_1);"));
+  EXPECT_THAT(source, HasSubstr("int64_t simp_main(int64_t p_x_0) {"));
+  EXPECT_THAT(source, HasSubstr("t0 = simp_fn_main(p_x_0);"));
+  EXPECT_THAT(CEmitter::executable_entry_point(1),
+              HasSubstr("simp_main(strtoll(argv[1], NULL, 10))"));
+}
+
+TEST_F(CEmitterTest, ExportsFunctionsFromSharedObjects) {
+  void* library = compile_shared(emit("examples/nextprime.sl"));
+  if (!library) {
+    GTEST_SKIP() << "No working C compiler";
+  }
+  using Unary = int64_t (*)(int64_t);
+  using Binary = int64_t (*)(int64_t, int64_t);
+  auto isprime = reinterpret_cast<Unary>(dlsym(library, "simp_fn_isprime"));
+  auto div = reinterpret_cast<Binary>(dlsym(library, "simp_fn_div"));
+  auto simp_main = reinterpret_cast<Unary>(dlsym(library, "simp_main"));
+  ASSERT_THAT(isprime, NotNull());
+  ASSERT_THAT(div, NotNull());
+  ASSERT_THAT(simp_main, NotNull());
+  EXPECT_THAT(isprime(97), Eq(1));
+  EXPECT_THAT(isprime(91), Eq(0));
+  EXPECT_THAT(div(-17, 5), Eq(-3));
+  EXPECT_THAT(simp_main(1000), Eq(1009));
+  dlclose(library);
+}
+
+TEST_F(CEmitterTest, NamesNestedBindingsApart) {
+  // The inner a is bound while the outer one's initializer is emitted.
+  std::string source = emit("examples/nested_lets.sl");
+  EXPECT_THAT(source, HasSubstr("v_a_0"));
+  EXPECT_THAT(source, HasSubstr("v_a_1"));
+}
+
+TEST_F(CEmitterTest, CompiledProgramsMatchTreeEvaluation) {
+  for (std::string file :
+       {"examples/just_nums.sl", "examples/if_statement.sl",
+        "examples/not_expression.sl", "examples/negative_expression.sl",
+        "examples/parenthesized_expression.sl",
+        "examples/logical_expression.sl", "examples/overflow.sl",
+        "examples/shadowing.sl", "examples/nested_lets.sl",
+        "examples/factorial_loop.sl", "examples/shiftl_loop.sl",
+        "examples/swap_loop.sl", "examples/nested_loop.sl",
+        "examples/functions.sl", "examples/intrinsics.sl"}) {
+    std::string source = emit(file);
+    std::string output;
+    if (!compile_and_run(source, output)) {
+      GTEST_SKIP() << "No working C compiler";
+    }
+    EXPECT_THAT(output, Eq(std::to_string(ast_->eval()) + "\n")) << file;
+  }
+}
+
+}  // namespace
+}  // namespace simp
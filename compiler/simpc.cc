@@ -0,0 +1,69 @@
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include "compiler/c_emitter.h"
+#include "parser/parser.h"
+
+DEFINE_string(file, "", "SimpLang file to compile");
+DEFINE_string(output, "", "Executable or shared object to produce");
+DEFINE_bool(shared, false,
+            "Build a shared object exporting simp_main and simp_fn_<name> "
+            "for each function instead of an executable");
+DEFINE_bool(emit_c, false, "Print the generated C to stdout and stop");
+DEFINE_string(cc, "cc", "C compiler to invoke");
+DEFINE_string(cflags, "-O2", "Flags passed to the C compiler");
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (FLAGS_file.empty()) {
+    LOG(ERROR) << "No file provided";
+    return 1;
+  }
+  if (FLAGS_output.empty() && !FLAGS_emit_c) {
+    LOG(ERROR) << "No output provided";
+    return 1;
+  }
+  simp::Parser parser(FLAGS_file);
+  if (!parser.parse()) {
+    LOG(ERROR) << "Failed to parse file";
+    return 1;
+  }
+  auto ast = parser.ast();
+  std::string source;
+  if (!simp::CEmitter().emit(*ast, source)) {
+    return 1;
+  }
+  if (!FLAGS_shared) {
+    source += simp::CEmitter::executable_entry_point(ast->inputs().size());
+  }
+  if (FLAGS_emit_c) {
+    std::cout << source;
+    return 0;
+  }
+
+  std::string c_file = FLAGS_output + ".c";
+  {
+    std::ofstream out(c_file);
+    out << source;
+    if (!out) {
+      LOG(ERROR) << "Unable to write " << c_file;
+      return 1;
+    }
+  }
+  std::string command = FLAGS_cc + " " + FLAGS_cflags +
+                        (FLAGS_shared ? " -shared -fPIC" : "") + " -o '" +
+                        FLAGS_output + "' '" + c_file + "'";
+  LOG(INFO) << "Running " << command;
+  if (std::system(command.c_str()) != 0) {
+    LOG(ERROR) << "C compiler failed: " << command;
+    return 1;
+  }
+  return 0;
+}
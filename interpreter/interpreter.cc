@@ -1,7 +1,180 @@
 #include "interpreter.h"
 
+#include "optimizer/inliner.h"
+#include "optimizer/intrinsic_recognizer.h"
+#include "optimizer/simplifier.h"
+#include "trace/trace.h"
+#include "vm/compiler.h"
+
 namespace simp {
-  bool Interpreter::run() {
+Interpreter::Interpreter(const std::string& source, Engine engine,
+                         bool simplify, size_t inline_budget,
+                         bool intrinsics,
+                         const std::vector<std::string>& memoized,
+                         size_t memo_capacity, size_t threads)
+    : source_(source), engine_(engine) {
+  Parser parser{source};
+  if (!parser.parse()) {
+    LOG(ERROR) << "Failed to parse " << source;
+    return;
+  }
+  ast_ = parser.ast();
+  // How ast_ is optimized below depends on the flags, so results are keyed by
+  // the program as parsed.
+  fingerprint_ = fingerprint(*ast_);
+  std::vector<bool> memoized_functions(ast_->functions().size(), false);
+  for (const std::string& name : memoized) {
+    size_t function = 0;
+    while (function < ast_->functions().size() &&
+           ast_->functions()[function]->name() != name) {
+      ++function;
+    }
+    if (function == ast_->functions().size()) {
+      LOG(ERROR) << source << " has no function " << name << " to memoize";
+      ast_ = nullptr;
+      return;
+    }
+    if (ast_->functions()[function]->parameters().size() >
+        MemoCache::kMaxArguments) {
+      LOG(ERROR) << "Cannot memoize " << name << ", which takes more than "
+                 << MemoCache::kMaxArguments << " arguments";
+      ast_ = nullptr;
+      return;
+    }
+    memoized_functions[function] = true;
+  }
+  if (!memoized.empty()) {
+    memo_cache_ = std::make_unique<MemoCache>(std::move(memoized_functions),
+                                              memo_capacity);
+  }
+  // Calls to memoized functions stay calls, so that they reach memo_cache_.
+  if (intrinsics) {
+    IntrinsicRecognizer recognizer;
+    for (size_t i = 0; i < ast_->functions().size(); ++i) {
+      if (memo_cache_ && memo_cache_->memoized(i)) {
+        recognizer.keep_calls(i);
+      }
+    }
+    recognizer.recognize(*ast_);
+  }
+  if (inline_budget > 0) {
+    Inliner inliner(inline_budget);
+    for (size_t i = 0; i < ast_->functions().size(); ++i) {
+      if (memo_cache_ && memo_cache_->memoized(i)) {
+        inliner.keep_calls(i);
+      }
+    }
+    inliner.inline_calls(*ast_);
+  }
+  if (simplify) {
+    Simplifier().simplify(*ast_);
+  }
+  if (engine_ == Engine::JIT && !JitCompiler::supported()) {
+    LOG(WARNING) << "JIT not supported on this host, using the tree evaluator";
+    engine_ = Engine::TREE;
+  }
+  if (engine_ == Engine::JIT && memo_cache_) {
+    LOG(WARNING) << "The JIT does not memoize calls, using the bytecode VM";
+    engine_ = Engine::BYTECODE;
+  }
+  if (engine_ == Engine::BYTECODE || engine_ == Engine::JIT) {
+    program_ = BytecodeCompiler().compile(*ast_);
+    if (program_ && engine_ == Engine::BYTECODE) {
+      vm_ = std::make_unique<Vm>(*program_, memo_cache_.get());
+    } else if (program_) {
+      jit_function_ = JitCompiler().compile(*program_);
+    }
+  } else if (engine_ == Engine::CLOSURE) {
+    closure_program_ = ClosureCompiler().compile(*ast_, memo_cache_.get());
+  } else if (engine_ == Engine::PARALLEL) {
+    thread_pool_ = std::make_unique<ThreadPool>(threads);
+    parallel_evaluator_ =
+        std::make_unique<ParallelEvaluator>(*ast_, *thread_pool_);
+  }
+}
 
+bool Interpreter::run(const std::vector<int64_t>& arguments) {
+  if (!ast_) {
+    return false;
+  }
+  if (arguments.size() != ast_->inputs().size()) {
+    LOG(ERROR) << source_ << " takes " << ast_->inputs().size()
+               << " arguments but was given " << arguments.size();
+    return false;
+  }
+  uint32_t root = ast_->functions().size();
+  if (result_store_ && result_store_->lookup(root, arguments.data(),
+                                             arguments.size(), result_)) {
+    return true;
+  }
+  if (!evaluate(arguments)) {
+    return false;
+  }
+  if (result_store_) {
+    result_store_->insert(root, arguments.data(), arguments.size(), result_);
+  }
+  return true;
+}
+
+bool Interpreter::open_result_store(const std::string& path,
+                                    size_t capacity) {
+  if (!ast_) {
+    return false;
+  }
+  result_store_ = ResultStore::open(path, fingerprint_, capacity);
+  return result_store_ != nullptr;
+}
+
+bool Interpreter::evaluate(const std::vector<int64_t>& arguments) {
+  SIMP_TRACE(EVAL, "run engine", static_cast<int>(engine_));
+  switch (engine_) {
+    case Engine::TREE:
+      try {
+        result_ = ast_->eval(arguments, memo_cache_.get());
+      } catch (const std::runtime_error& error) {
+        return false;
+      }
+      return true;
+    case Engine::BYTECODE:
+      if (!vm_) {
+        return false;
+      }
+      result_ = vm_->run(arguments);
+      return true;
+    case Engine::CLOSURE:
+      if (!closure_program_) {
+        return false;
+      }
+      result_ = closure_program_->run(arguments);
+      return true;
+    case Engine::JIT:
+      if (!jit_function_) {
+        return false;
+      }
+      result_ = jit_function_->run(arguments);
+      return true;
+    case Engine::PARALLEL:
+      try {
+        result_ = parallel_evaluator_->eval(arguments, memo_cache_.get());
+      } catch (const std::runtime_error& error) {
+        return false;
+      }
+      return true;
+  }
+  return false;
+}
+
+std::vector<MemoStats> Interpreter::memo_stats() {
+  std::vector<MemoStats> stats;
+  if (!memo_cache_) {
+    return stats;
+  }
+  for (size_t i = 0; i < ast_->functions().size(); ++i) {
+    if (memo_cache_->memoized(i)) {
+      stats.push_back({ast_->functions()[i]->name(), memo_cache_->hits(i),
+                       memo_cache_->misses(i)});
+    }
   }
-}
\ No newline at end of file
+  return stats;
+}
+}  // namespace simp
@@ -1,30 +1,98 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "ast/ast.h"
+#include "closure/closure.h"
+#include "jit/jit.h"
 #include "lexer/lexer.h"
+#include "memo/memo_cache.h"
+#include "memo/result_store.h"
+#include "parallel/parallel_evaluator.h"
+#include "parallel/thread_pool.h"
 #include "parser/parser.h"
 #include "tokens/tokens.h"
+#include "vm/bytecode.h"
+#include "vm/vm.h"
 
 namespace simp {
+enum class Engine {
+  TREE,      // walks the Ast through Expression::eval
+  BYTECODE,  // compiles the Ast to register bytecode and runs it on the Vm
+  CLOSURE,   // compiles the Ast once into pre-bound closures and calls them
+  JIT,       // compiles the bytecode to x86-64 machine code, falling back to
+             // TREE on hosts the JIT does not support and to BYTECODE for
+             // programs that memoize functions
+  PARALLEL,  // walks the Ast like TREE, running independent expensive
+             // bindings and arguments on a work-stealing ThreadPool
+};
+
+// How often the calls to a memoized function found their result cached.
+struct MemoStats {
+  std::string function;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+};
+
 class Interpreter {
  public:
-  Interpreter(const std::string& source) : source_(source) {
-    lexer_ = Lexer(source);
-    lexer_.scan();
-    parser_ = Parser(lexer_.tokens());
-    parser_.parse();
-    ast_ = std::move(parser_.ast());
-  }
+  // With simplify, the Simplifier rewrites the Ast before any engine sees it.
+  // A nonzero inline_budget first inlines functions of at most that many
+  // nodes (see Inliner), and with intrinsics, before all that, functions
+  // that emulate an Intrinsic are replaced by it (see IntrinsicRecognizer).
+  //
+  // Calls to the functions named in memoized are never inlined and go through
+  // a MemoCache of memo_capacity entries, which keeps results from one run to
+  // the next. Each one must take at most MemoCache::kMaxArguments arguments.
+  // The JIT does not use the cache, so memoizing runs the Vm instead.
+  //
+  // The PARALLEL engine runs on threads threads, 0 meaning one per hardware
+  // thread.
+  Interpreter(const std::string& source, Engine engine = Engine::TREE,
+              bool simplify = false, size_t inline_budget = 0,
+              bool intrinsics = false,
+              const std::vector<std::string>& memoized = {},
+              size_t memo_capacity = MemoCache::kDefaultCapacity,
+              size_t threads = 0);
+
   const std::string& source() const { return source_; }
-  Lexer& lexer() { return lexer_; }
-  Parser& parser() { return parser_; }
-  Ast& ast() { return ast_; }
-  bool run();
+  Engine engine() const { return engine_; }
+  Ast* ast() { return ast_.get(); }
+  Program* program() { return program_.get(); }
+  // Runs the program with one argument per input (see Ast::inputs).
+  bool run(const std::vector<int64_t>& arguments = {});
+  // From now on, run() first looks the arguments up in the ResultStore at
+  // path and stores what it computes there. Results are keyed by a
+  // fingerprint of the program as parsed, before any optimization, and by the
+  // index one past the last function, which names the program's root.
+  bool open_result_store(
+      const std::string& path,
+      size_t capacity = ResultStore::kDefaultCapacity);
+  ResultStore* result_store() { return result_store_.get(); }
+  int64_t result() const { return result_; }
+  // One entry per memoized function, in definition order.
+  std::vector<MemoStats> memo_stats();
 
  private:
-  Lexer lexer_;
-  Parser parser_;
-  Ast ast_;
+  bool evaluate(const std::vector<int64_t>& arguments);
+
   const std::string source_;
-}
-}  // namespace simp
\ No newline at end of file
+  Engine engine_;
+  std::unique_ptr<Ast> ast_;
+  // Of ast_ as parsed, taken before the constructor optimizes it.
+  uint64_t fingerprint_ = 0;
+  std::unique_ptr<MemoCache> memo_cache_;
+  std::unique_ptr<ResultStore> result_store_;
+  std::unique_ptr<Program> program_;
+  std::unique_ptr<Vm> vm_;
+  std::unique_ptr<ClosureProgram> closure_program_;
+  std::unique_ptr<JitFunction> jit_function_;
+  std::unique_ptr<ThreadPool> thread_pool_;
+  std::unique_ptr<ParallelEvaluator> parallel_evaluator_;
+  int64_t result_ = 0;
+};
+}  // namespace simp
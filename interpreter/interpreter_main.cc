@@ -0,0 +1,147 @@
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "interpreter.h"
+#include "optimizer/inliner.h"
+#include "trace/trace.h"
+
+DEFINE_string(file, "", "File to run");
+DEFINE_string(engine, "tree",
+              "Execution engine: tree, bytecode, closure, jit or parallel");
+DEFINE_int32(iterations, 1,
+             "Number of times to run the program, for benchmarking engines");
+DEFINE_bool(simplify, true,
+            "Fold constants and remove identities before running");
+DEFINE_int32(inline_budget, simp::Inliner::kDefaultBudget,
+             "Inline calls to non-recursive functions of at most this many "
+             "nodes before running; 0 turns inlining off");
+DEFINE_bool(intrinsics, true,
+            "Replace functions that emulate div, rem, shiftl, shiftr or "
+            "leadingzeros with the native intrinsic before running");
+DEFINE_string(memoize, "",
+              "Comma-separated functions whose results are cached across "
+              "calls and iterations; hits and misses go to stderr");
+DEFINE_int32(memo_capacity, simp::MemoCache::kDefaultCapacity,
+             "Entries in the cache of --memoize");
+DEFINE_string(result_store, "",
+              "File of results kept across processes; a run whose arguments "
+              "are stored there for the same program is not evaluated again");
+DEFINE_int32(result_store_capacity, simp::ResultStore::kDefaultCapacity,
+             "Entries in a --result_store file when it is created");
+DEFINE_int32(threads, 0,
+             "Threads of the parallel engine; 0 means one per hardware "
+             "thread");
+DEFINE_string(trace, "",
+              "Trace categories to record (lexer, parser, eval or all); the "
+              "trace is printed to stderr on exit");
+
+// The arguments of main follow the flags, e.g.
+//   interpreter_main --file=examples/nextprime.sl 100
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (FLAGS_file.empty()) {
+    LOG(ERROR) << "No file provided";
+    return 1;
+  }
+  uint32_t categories;
+  if (!simp::Tracer::parse_categories(FLAGS_trace, categories)) {
+    LOG(ERROR) << "Unknown trace category in: " << FLAGS_trace;
+    return 1;
+  }
+  simp::Tracer::enable(categories);
+  simp::Engine engine;
+  if (FLAGS_engine == "tree") {
+    engine = simp::Engine::TREE;
+  } else if (FLAGS_engine == "bytecode") {
+    engine = simp::Engine::BYTECODE;
+  } else if (FLAGS_engine == "closure") {
+    engine = simp::Engine::CLOSURE;
+  } else if (FLAGS_engine == "jit") {
+    engine = simp::Engine::JIT;
+  } else if (FLAGS_engine == "parallel") {
+    engine = simp::Engine::PARALLEL;
+  } else {
+    LOG(ERROR) << "Unknown engine: " << FLAGS_engine;
+    return 1;
+  }
+  std::vector<int64_t> arguments;
+  for (int i = 1; i < argc; ++i) {
+    char* end;
+    arguments.push_back(std::strtoll(argv[i], &end, 10));
+    if (*end != '\0') {
+      LOG(ERROR) << "Not an integer argument: " << argv[i];
+      return 1;
+    }
+  }
+  if (FLAGS_inline_budget < 0) {
+    LOG(ERROR) << "Negative inline budget: " << FLAGS_inline_budget;
+    return 1;
+  }
+  if (FLAGS_memo_capacity <= 0) {
+    LOG(ERROR) << "Memo capacity must be positive: " << FLAGS_memo_capacity;
+    return 1;
+  }
+  if (FLAGS_threads < 0) {
+    LOG(ERROR) << "Negative thread count: " << FLAGS_threads;
+    return 1;
+  }
+  std::vector<std::string> memoized;
+  std::stringstream names(FLAGS_memoize);
+  for (std::string name; std::getline(names, name, ',');) {
+    if (!name.empty()) {
+      memoized.push_back(name);
+    }
+  }
+  simp::Interpreter interpreter(FLAGS_file, engine, FLAGS_simplify,
+                                FLAGS_inline_budget, FLAGS_intrinsics,
+                                memoized, FLAGS_memo_capacity,
+                                FLAGS_threads);
+  if (!FLAGS_result_store.empty()) {
+    if (FLAGS_result_store_capacity <= 0) {
+      LOG(ERROR) << "Result store capacity must be positive: "
+                 << FLAGS_result_store_capacity;
+      return 1;
+    }
+    if (!interpreter.open_result_store(FLAGS_result_store,
+                                       FLAGS_result_store_capacity)) {
+      LOG(ERROR) << "Failed to open result store " << FLAGS_result_store;
+      return 1;
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    if (!interpreter.run(arguments)) {
+      LOG(ERROR) << "Failed to run " << FLAGS_file;
+      return 1;
+    }
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  std::cout << interpreter.result() << std::endl;
+  for (const simp::MemoStats& stats : interpreter.memo_stats()) {
+    std::cerr << "memo " << stats.function << ": " << stats.hits
+              << " hits, " << stats.misses << " misses" << std::endl;
+  }
+  if (simp::ResultStore* store = interpreter.result_store()) {
+    std::cerr << "result store: " << store->hits() << " hits, "
+              << store->misses() << " misses" << std::endl;
+  }
+  simp::Tracer::dump(std::cerr);
+  if (FLAGS_iterations > 1) {
+    std::cerr << FLAGS_engine << ": " << FLAGS_iterations << " runs, "
+              << elapsed.count() / FLAGS_iterations << " ns/run" << std::endl;
+  }
+  return 0;
+}
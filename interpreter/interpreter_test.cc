@@ -1,11 +1,20 @@
 #include "interpreter.h"
 
+#include <gmock/gmock.h>
+
+#include <cstdio>
+
 #include "gtest/gtest.h"
 #include "lexer/lexer.h"
+#include "optimizer/inliner.h"
 #include "parser/parser.h"
 
 namespace simp {
 namespace {
+using ::testing::Eq;
+using ::testing::Gt;
+using ::testing::Lt;
+using ::testing::NotNull;
 class InterpreterTest : public ::testing::Test {
  protected:
   InterpreterTest() {}
@@ -13,5 +22,183 @@ class InterpreterTest : public ::testing::Test {
   void SetUp() override {}
 };
 
+TEST_F(InterpreterTest, RunsTreeEngine) {
+  Interpreter interpreter("examples/parenthesized_expression.sl");
+  EXPECT_THAT(interpreter.engine(), Eq(Engine::TREE));
+  ASSERT_TRUE(interpreter.run());
+  EXPECT_THAT(interpreter.result(), Eq(3));
+}
+
+TEST_F(InterpreterTest, RunsBytecodeEngine) {
+  Interpreter interpreter("examples/parenthesized_expression.sl",
+                          Engine::BYTECODE);
+  ASSERT_THAT(interpreter.program(), NotNull());
+  ASSERT_TRUE(interpreter.run());
+  EXPECT_THAT(interpreter.result(), Eq(3));
+}
+
+TEST_F(InterpreterTest, RunsClosureEngine) {
+  Interpreter interpreter("examples/parenthesized_expression.sl",
+                          Engine::CLOSURE);
+  ASSERT_TRUE(interpreter.run());
+  EXPECT_THAT(interpreter.result(), Eq(3));
+}
+
+TEST_F(InterpreterTest, RunsJitEngine) {
+  Interpreter interpreter("examples/parenthesized_expression.sl", Engine::JIT);
+  EXPECT_THAT(interpreter.engine(),
+              Eq(JitCompiler::supported() ? Engine::JIT : Engine::TREE));
+  ASSERT_TRUE(interpreter.run());
+  EXPECT_THAT(interpreter.result(), Eq(3));
+}
+
+TEST_F(InterpreterTest, RunsParallelEngine) {
+  Interpreter interpreter("examples/wide_calls.sl", Engine::PARALLEL, true,
+                          24, true, {}, MemoCache::kDefaultCapacity, 4);
+  EXPECT_THAT(interpreter.engine(), Eq(Engine::PARALLEL));
+  ASSERT_TRUE(interpreter.run({1000}));
+  EXPECT_THAT(interpreter.result(), Eq(550));
+  // The loops of isprime and nextprime run as searches.
+  Interpreter search("examples/nextprime_intrinsics.sl", Engine::PARALLEL,
+                     true, 24, true, {}, MemoCache::kDefaultCapacity, 4);
+  ASSERT_TRUE(search.run({1000000000000}));
+  EXPECT_THAT(search.result(), Eq(1000000000039));
+}
+
+TEST_F(InterpreterTest, PassesArgumentsToMain) {
+  for (Engine engine :
+       {Engine::TREE, Engine::BYTECODE, Engine::CLOSURE, Engine::JIT}) {
+    Interpreter interpreter("examples/nextprime.sl", engine);
+    ASSERT_TRUE(interpreter.run({100}));
+    EXPECT_THAT(interpreter.result(), Eq(101));
+    EXPECT_FALSE(interpreter.run());
+  }
+  Interpreter interpreter("examples/nextprime.sl", Engine::JIT);
+  EXPECT_THAT(interpreter.engine(),
+              Eq(JitCompiler::supported() ? Engine::JIT : Engine::TREE));
+  // The JIT leaves programs that memoize functions to the bytecode VM.
+  Interpreter memoized("examples/nextprime.sl", Engine::JIT, false, 0, false,
+                       {"isprime"});
+  EXPECT_THAT(memoized.engine(),
+              Eq(JitCompiler::supported() ? Engine::BYTECODE : Engine::TREE));
+}
+
+TEST_F(InterpreterTest, SimplifiesBeforeRunning) {
+  Interpreter plain("examples/nextprime.sl", Engine::TREE);
+  Interpreter simplified("examples/nextprime.sl", Engine::TREE, true);
+  EXPECT_THAT(count_nodes(*simplified.ast()), Lt(count_nodes(*plain.ast())));
+  ASSERT_TRUE(simplified.run({100}));
+  EXPECT_THAT(simplified.result(), Eq(101));
+}
+
+TEST_F(InterpreterTest, InlinesBeforeRunning) {
+  for (Engine engine : {Engine::TREE, Engine::BYTECODE, Engine::CLOSURE}) {
+    Interpreter interpreter("examples/nextprime.sl", engine, true, 24);
+    ASSERT_TRUE(interpreter.run({1000}));
+    EXPECT_THAT(interpreter.result(), Eq(1009));
+  }
+}
+
+TEST_F(InterpreterTest, InlinesCallsWithBindingsInArguments) {
+  // The arguments bind variables of their own, which must not overwrite
+  // the inlined parameters bound before them.
+  for (Engine engine : {Engine::TREE, Engine::BYTECODE, Engine::CLOSURE,
+                        Engine::JIT, Engine::PARALLEL}) {
+    for (size_t inline_budget : {size_t{0}, Inliner::kDefaultBudget}) {
+      for (bool simplify : {false, true}) {
+        Interpreter interpreter("examples/let_in_arguments.sl", engine,
+                                simplify, inline_budget);
+        ASSERT_TRUE(interpreter.run({5}));
+        EXPECT_THAT(interpreter.result(), Eq(474))
+            << static_cast<int>(engine) << " " << inline_budget << " "
+            << simplify;
+      }
+    }
+  }
+}
+
+TEST_F(InterpreterTest, RunsIntrinsics) {
+  for (Engine engine :
+       {Engine::TREE, Engine::BYTECODE, Engine::CLOSURE, Engine::JIT}) {
+    Interpreter interpreter("examples/nextprime_intrinsics.sl", engine);
+    ASSERT_TRUE(interpreter.run({1000}));
+    EXPECT_THAT(interpreter.result(), Eq(1009));
+  }
+}
+
+TEST_F(InterpreterTest, RecognizesIntrinsicsBeforeRunning) {
+  for (Engine engine : {Engine::TREE, Engine::BYTECODE, Engine::CLOSURE}) {
+    Interpreter interpreter("examples/nextprime.sl", engine, true, 24, true);
+    ASSERT_TRUE(interpreter.run({1000}));
+    EXPECT_THAT(interpreter.result(), Eq(1009));
+  }
+}
+
+TEST_F(InterpreterTest, MemoizesAcrossRuns) {
+  for (Engine engine : {Engine::TREE, Engine::BYTECODE, Engine::CLOSURE,
+                        Engine::PARALLEL}) {
+    Interpreter interpreter("examples/nextprime.sl", engine, true, 24, false,
+                            {"isprime"});
+    ASSERT_TRUE(interpreter.run({1000}));
+    EXPECT_THAT(interpreter.result(), Eq(1009));
+    ASSERT_TRUE(interpreter.run({1000}));
+    EXPECT_THAT(interpreter.result(), Eq(1009));
+    auto stats = interpreter.memo_stats();
+    ASSERT_THAT(stats.size(), Eq(1));
+    EXPECT_THAT(stats[0].function, Eq("isprime"));
+    // 1001 to 1009 miss the first time and hit the second.
+    EXPECT_THAT(stats[0].misses, Eq(9));
+    EXPECT_THAT(stats[0].hits, Eq(9));
+  }
+  // A memoized function is not replaced by the intrinsic it emulates.
+  Interpreter recognizing("examples/nextprime.sl", Engine::TREE, false, 0,
+                          true, {"div"});
+  ASSERT_TRUE(recognizing.run({1000}));
+  EXPECT_THAT(recognizing.result(), Eq(1009));
+  auto stats = recognizing.memo_stats();
+  ASSERT_THAT(stats.size(), Eq(1));
+  EXPECT_THAT(stats[0].hits + stats[0].misses, Gt(0));
+  EXPECT_FALSE(Interpreter("examples/nextprime.sl", Engine::TREE, false, 0,
+                           false, {"nosuchfunction"})
+                   .run({1000}));
+}
+
+TEST_F(InterpreterTest, ReusesStoredResults) {
+  std::string path = ::testing::TempDir() + "/interpreter_test.results";
+  std::remove(path.c_str());
+  for (Engine engine : {Engine::TREE, Engine::BYTECODE}) {
+    Interpreter interpreter("examples/nextprime.sl", engine);
+    ASSERT_TRUE(interpreter.open_result_store(path));
+    ASSERT_TRUE(interpreter.run({1000}));
+    EXPECT_THAT(interpreter.result(), Eq(1009));
+    ASSERT_TRUE(interpreter.run({2000}));
+    EXPECT_THAT(interpreter.result(), Eq(2003));
+  }
+  // The second interpreter found both results; another program finds none.
+  Interpreter same("examples/nextprime.sl", Engine::CLOSURE);
+  ASSERT_TRUE(same.open_result_store(path));
+  ASSERT_TRUE(same.run({1000}));
+  EXPECT_THAT(same.result(), Eq(1009));
+  EXPECT_THAT(same.result_store()->hits(), Eq(1));
+  // The fingerprint is taken before optimization, which changes nothing the
+  // program computes.
+  Interpreter optimized("examples/nextprime.sl", Engine::TREE, true,
+                        Inliner::kDefaultBudget);
+  ASSERT_TRUE(optimized.open_result_store(path));
+  ASSERT_TRUE(optimized.run({2000}));
+  EXPECT_THAT(optimized.result(), Eq(2003));
+  EXPECT_THAT(optimized.result_store()->hits(), Eq(1));
+  Interpreter other("examples/nextprime_intrinsics.sl");
+  ASSERT_TRUE(other.open_result_store(path));
+  ASSERT_TRUE(other.run({1000}));
+  EXPECT_THAT(other.result_store()->hits(), Eq(0));
+  std::remove(path.c_str());
+}
+
+TEST_F(InterpreterTest, FailsOnUnparsableFile) {
+  Interpreter interpreter("examples/empty.sl", Engine::BYTECODE);
+  EXPECT_FALSE(interpreter.run());
+}
+
 }  // namespace
 }  // namespace simp
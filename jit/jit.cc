@@ -0,0 +1,596 @@
+#include "jit.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include "ast/intrinsics.h"
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define SIMP_JIT_SUPPORTED 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define SIMP_JIT_SUPPORTED 0
+#endif
+
+namespace simp {
+
+#if SIMP_JIT_SUPPORTED
+
+StackMemory::~StackMemory() {
+  if (words_) {
+    munmap(words_, size_ * sizeof(int64_t));
+  }
+}
+
+bool StackMemory::allocate(size_t size) {
+  // Pages are only backed once a call reaches them.
+  void* memory = mmap(nullptr, size * sizeof(int64_t), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (memory == MAP_FAILED) {
+    LOG(ERROR) << "Unable to map memory for a stack: " << strerror(errno);
+    return false;
+  }
+  words_ = static_cast<int64_t*>(memory);
+  size_ = size;
+  return true;
+}
+
+ExecutableBuffer::~ExecutableBuffer() {
+  if (memory_) {
+    munmap(memory_, size_);
+  }
+}
+
+bool ExecutableBuffer::load(const std::vector<uint8_t>& code) {
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  size_ = (code.size() + page_size - 1) / page_size * page_size;
+  void* memory = mmap(nullptr, size_, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    LOG(ERROR) << "Unable to map memory for generated code: "
+               << strerror(errno);
+    return false;
+  }
+  memory_ = memory;
+  std::memcpy(memory_, code.data(), code.size());
+  if (mprotect(memory_, size_, PROT_READ | PROT_EXEC) != 0) {
+    LOG(ERROR) << "Unable to make generated code executable: "
+               << strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+namespace {
+// Condition codes, as used in the low nibble of setcc and jcc.
+enum Condition : uint8_t {
+  BELOW = 0x2,
+  EQUAL = 0x4,
+  NOT_EQUAL = 0x5,
+  ABOVE = 0x7,
+  LESS = 0xc,
+  GREATER_OR_EQUAL = 0xd,
+};
+
+Condition invert(Condition condition) {
+  return static_cast<Condition>(condition ^ 1);
+}
+
+// Just enough of an x86-64 assembler for the bytecode templates. All values
+// are computed in rax, with rcx for the second operand when it is a constant
+// too wide for an immediate; bytecode register n lives at [rdi + 8 * n].
+class Assembler {
+ public:
+  std::vector<uint8_t>& code() { return code_; }
+  size_t offset() const { return code_.size(); }
+
+  // mov rax, [rdi + 8 * reg]
+  void load(uint32_t reg) { memory_operation({0x48, 0x8b}, 0, reg); }
+  // mov [rdi + 8 * reg], rax
+  void store(uint32_t reg) { memory_operation({0x48, 0x89}, 0, reg); }
+  // add rax, [rdi + 8 * reg]
+  void add(uint16_t reg) { memory_operation({0x48, 0x03}, 0, reg); }
+  // imul rax, [rdi + 8 * reg]
+  void multiply(uint16_t reg) {
+    memory_operation({0x48, 0x0f, 0xaf}, 0, reg);
+  }
+  // cmp rax, [rdi + 8 * reg]
+  void compare(uint16_t reg) { memory_operation({0x48, 0x3b}, 0, reg); }
+  // cmp qword [rdi + 8 * reg], 0
+  void compare_with_zero(uint16_t reg) {
+    memory_operation({0x48, 0x83}, 7, reg);
+    code_.push_back(0);
+  }
+
+  void load_immediate(int64_t value) {
+    if (fits_in_32_bits(value)) {
+      // mov rax, imm32 (sign extended)
+      emit({0x48, 0xc7, 0xc0});
+      emit32(static_cast<int32_t>(value));
+    } else {
+      // movabs rax, imm64
+      emit({0x48, 0xb8});
+      emit64(value);
+    }
+  }
+  // add rax, imm32
+  void add_immediate(int32_t value) {
+    emit({0x48, 0x05});
+    emit32(value);
+  }
+  // imul rax, rax, imm32
+  void multiply_immediate(int32_t value) {
+    emit({0x48, 0x69, 0xc0});
+    emit32(value);
+  }
+  // cmp rax, imm32
+  void compare_immediate(int32_t value) {
+    emit({0x48, 0x3d});
+    emit32(value);
+  }
+  // movabs rcx, imm64
+  void load_second(int64_t value) {
+    emit({0x48, 0xb9});
+    emit64(value);
+  }
+  // add rax, rcx
+  void add_second() { emit({0x48, 0x01, 0xc8}); }
+  // imul rax, rcx
+  void multiply_second() { emit({0x48, 0x0f, 0xaf, 0xc1}); }
+  // cmp rax, rcx
+  void compare_second() { emit({0x48, 0x39, 0xc8}); }
+  // neg rax
+  void negate() { emit({0x48, 0xf7, 0xd8}); }
+  // setcc al; movzx eax, al (leaves the flags alone)
+  void set(Condition condition) {
+    emit({0x0f, static_cast<uint8_t>(0x90 | condition), 0xc0});
+    emit({0x0f, 0xb6, 0xc0});
+  }
+  // jmp rel32, returns the offset of the displacement for patching
+  size_t jump() {
+    code_.push_back(0xe9);
+    emit32(0);
+    return offset() - 4;
+  }
+  // jcc rel32, returns the offset of the displacement for patching
+  size_t jump(Condition condition) {
+    emit({0x0f, static_cast<uint8_t>(0x80 | condition)});
+    emit32(0);
+    return offset() - 4;
+  }
+  void patch(size_t displacement, size_t target) {
+    int32_t relative = static_cast<int32_t>(target - (displacement + 4));
+    std::memcpy(code_.data() + displacement, &relative, 4);
+  }
+  void ret() { code_.push_back(0xc3); }
+
+  // push rdi
+  void push_base() { code_.push_back(0x57); }
+  // pop rdi
+  void pop_base() { code_.push_back(0x5f); }
+  // movabs rcx, limit; cmp rdi, rcx
+  void compare_base(const int64_t* limit) {
+    load_second(reinterpret_cast<int64_t>(limit));
+    emit({0x48, 0x39, 0xcf});
+  }
+  // movabs rcx, limit; cmp rsp, rcx
+  void compare_stack(const int64_t* limit) {
+    load_second(reinterpret_cast<int64_t>(limit));
+    emit({0x48, 0x39, 0xcc});
+  }
+  // push rbx; mov rbx, rsp; movabs rsp, top
+  void switch_stack(const int64_t* top) {
+    emit({0x53, 0x48, 0x89, 0xe3, 0x48, 0xbc});
+    emit64(reinterpret_cast<int64_t>(top));
+  }
+  // mov rsp, rbx; pop rbx
+  void restore_stack() { emit({0x48, 0x89, 0xdc, 0x5b}); }
+  // add rdi, imm32
+  void add_to_base(int32_t value) {
+    emit({0x48, 0x81, 0xc7});
+    emit32(value);
+  }
+  // call rel32, returns the offset of the displacement for patching
+  size_t call() {
+    code_.push_back(0xe8);
+    emit32(0);
+    return offset() - 4;
+  }
+  // Calls function, which does not return, with the stack aligned as it is
+  // after a push_base.
+  void call(void (*function)()) {
+    emit({0x48, 0xb8});  // movabs rax, function
+    emit64(reinterpret_cast<int64_t>(function));
+    emit({0xff, 0xd0});  // call rax
+  }
+
+  // Calls function(rax, second argument) and leaves its result in rax. The
+  // register base is saved around the call, which also keeps the stack
+  // aligned as the ABI wants it.
+  void call(int64_t (*function)(int64_t, int64_t), bool second_is_constant,
+            int64_t second) {
+    code_.push_back(0x57);  // push rdi
+    if (second_is_constant) {
+      // movabs rsi, imm64
+      emit({0x48, 0xbe});
+      emit64(second);
+    } else {
+      // mov rsi, [rdi + 8 * second]
+      memory_operation({0x48, 0x8b}, 6, static_cast<uint16_t>(second));
+    }
+    emit({0x48, 0x89, 0xc7});  // mov rdi, rax
+    emit({0x48, 0xb8});        // movabs rax, function
+    emit64(reinterpret_cast<int64_t>(function));
+    emit({0xff, 0xd0});        // call rax
+    code_.push_back(0x5f);     // pop rdi
+  }
+
+  static bool fits_in_32_bits(int64_t value) {
+    return value >= std::numeric_limits<int32_t>::min() &&
+           value <= std::numeric_limits<int32_t>::max();
+  }
+
+ private:
+  void emit(std::initializer_list<uint8_t> bytes) {
+    code_.insert(code_.end(), bytes);
+  }
+  void emit32(int32_t value) {
+    uint8_t bytes[4];
+    std::memcpy(bytes, &value, 4);
+    code_.insert(code_.end(), bytes, bytes + 4);
+  }
+  void emit64(int64_t value) {
+    uint8_t bytes[8];
+    std::memcpy(bytes, &value, 8);
+    code_.insert(code_.end(), bytes, bytes + 8);
+  }
+  // Emits opcode followed by a ModRM byte addressing [rdi + disp32].
+  void memory_operation(std::initializer_list<uint8_t> opcode, uint8_t reg,
+                        uint32_t slot) {
+    emit(opcode);
+    code_.push_back(0x80 | (reg << 3) | 7);
+    emit32(static_cast<int32_t>(slot) * 8);
+  }
+
+  std::vector<uint8_t> code_;
+};
+
+[[noreturn]] void stack_overflow() {
+  LOG(ERROR) << "Calls nest too deeply for the JIT's "
+             << JitFunction::kStackRegisters << " registers and "
+             << JitFunction::kMachineStackWords << " words of machine stack";
+  std::abort();
+}
+
+// Translates the program and then each of its functions into one piece of
+// code that starts with the program. A call passes its arguments in the
+// registers just above the caller's, moves rdi there for the callee and back
+// afterwards, the way the Vm slides its register window. A program with
+// functions is entered through a stub that moves it onto its machine stack.
+class Translator {
+ public:
+  // No register window may extend past stack_end, and no call may be made
+  // with rsp below machine_stack_limit. The machine stack is only used when
+  // the program has functions.
+  Translator(const Program& program, const int64_t* stack_end,
+             const int64_t* machine_stack_top,
+             const int64_t* machine_stack_limit)
+      : program_(program),
+        stack_end_(stack_end),
+        machine_stack_top_(machine_stack_top),
+        machine_stack_limit_(machine_stack_limit) {}
+
+  std::vector<uint8_t> translate() {
+    if (!program_.functions().empty()) {
+      // The top of the stack is page aligned, so the program starts with rsp
+      // aligned as the ABI wants it after a call.
+      assembler_.switch_stack(machine_stack_top_);
+      size_t entry = assembler_.call();
+      assembler_.restore_stack();
+      assembler_.ret();
+      assembler_.patch(entry, assembler_.offset());
+    }
+    translate(program_);
+    std::vector<size_t> entries;
+    for (const Program& function : program_.functions()) {
+      entries.push_back(assembler_.offset());
+      translate(function);
+    }
+    for (const auto& [displacement, function] : calls_) {
+      assembler_.patch(displacement, entries[function]);
+    }
+    if (!overflows_.empty()) {
+      size_t overflow = assembler_.offset();
+      assembler_.call(stack_overflow);
+      for (size_t displacement : overflows_) {
+        assembler_.patch(displacement, overflow);
+      }
+    }
+    return std::move(assembler_.code());
+  }
+
+ private:
+  void translate(const Program& program) {
+    program_being_translated_ = &program;
+    const auto& code = program.code();
+    std::vector<bool> is_jump_target(code.size() + 1, false);
+    for (const auto& instruction : code) {
+      if (is_jump(instruction.op)) {
+        is_jump_target[instruction.bc()] = true;
+      }
+    }
+    std::vector<size_t> offsets(code.size() + 1);
+    std::vector<std::pair<size_t, uint32_t>> jumps;
+    // The register whose value the flags currently describe, if any.
+    bool flags_valid = false;
+    uint16_t flags_register = 0;
+    Condition flags_condition = EQUAL;
+
+    for (size_t pc = 0; pc < code.size(); ++pc) {
+      const Instruction& instruction = code[pc];
+      offsets[pc] = assembler_.offset();
+      if (is_jump_target[pc]) {
+        flags_valid = false;
+      }
+      switch (instruction.op) {
+        case OpCode::MOVE:
+          load_operand(instruction.b);
+          assembler_.store(instruction.a);
+          flags_valid = false;
+          break;
+        case OpCode::ADD:
+        case OpCode::MULTIPLY:
+          arithmetic(instruction);
+          flags_valid = false;
+          break;
+        case OpCode::LESS_THAN:
+        case OpCode::EQUALS:
+          flags_condition = instruction.op == OpCode::LESS_THAN ? LESS : EQUAL;
+          load_operand(instruction.b);
+          if (is_immediate(instruction.c)) {
+            assembler_.compare_immediate(constant(instruction.c));
+          } else if (is_constant(instruction.c)) {
+            assembler_.load_second(constant(instruction.c));
+            assembler_.compare_second();
+          } else {
+            assembler_.compare(instruction.c);
+          }
+          assembler_.set(flags_condition);
+          assembler_.store(instruction.a);
+          flags_valid = true;
+          flags_register = instruction.a;
+          break;
+        case OpCode::NOT:
+        case OpCode::TO_BOOL:
+          flags_condition = instruction.op == OpCode::NOT ? EQUAL : NOT_EQUAL;
+          if (is_constant(instruction.b)) {
+            load_operand(instruction.b);
+            assembler_.compare_immediate(0);
+          } else {
+            assembler_.compare_with_zero(instruction.b);
+          }
+          assembler_.set(flags_condition);
+          assembler_.store(instruction.a);
+          flags_valid = true;
+          flags_register = instruction.a;
+          break;
+        case OpCode::NEGATE:
+          load_operand(instruction.b);
+          assembler_.negate();
+          assembler_.store(instruction.a);
+          flags_valid = false;
+          break;
+        case OpCode::JUMP:
+          jumps.push_back({assembler_.jump(), instruction.bc()});
+          break;
+        case OpCode::JUMP_IF_ZERO:
+        case OpCode::JUMP_IF_NOT_ZERO: {
+          // A conditional jump on the register the previous comparison just
+          // wrote can branch on the flags it left behind.
+          Condition taken;
+          if (flags_valid && flags_register == instruction.a) {
+            taken = instruction.op == OpCode::JUMP_IF_ZERO
+                        ? invert(flags_condition)
+                        : flags_condition;
+          } else {
+            assembler_.compare_with_zero(instruction.a);
+            taken = instruction.op == OpCode::JUMP_IF_ZERO ? EQUAL : NOT_EQUAL;
+          }
+          jumps.push_back({assembler_.jump(taken), instruction.bc()});
+          break;
+        }
+        case OpCode::RETURN:
+          load_operand(instruction.a);
+          assembler_.ret();
+          flags_valid = false;
+          break;
+        case OpCode::CALL:
+          call(instruction);
+          flags_valid = false;
+          break;
+        case OpCode::DIVIDE:
+        case OpCode::REMAINDER:
+        case OpCode::SHIFT_LEFT:
+        case OpCode::SHIFT_RIGHT:
+        case OpCode::LEADING_ZEROS:
+          intrinsic(instruction);
+          flags_valid = false;
+          break;
+      }
+    }
+    offsets[code.size()] = assembler_.offset();
+    for (const auto& [displacement, target] : jumps) {
+      assembler_.patch(displacement, offsets[target]);
+    }
+  }
+
+  static bool is_jump(OpCode op) {
+    return op == OpCode::JUMP || op == OpCode::JUMP_IF_ZERO ||
+           op == OpCode::JUMP_IF_NOT_ZERO;
+  }
+  // Constants are never read from the registers, so a callee's window needs
+  // no filling in.
+  bool is_constant(uint16_t reg) const {
+    return reg >= program_being_translated_->constant_base() &&
+           reg < program_being_translated_->register_count();
+  }
+  int64_t constant(uint16_t reg) const {
+    return program_being_translated_
+        ->constants()[reg - program_being_translated_->constant_base()];
+  }
+  bool is_immediate(uint16_t reg) const {
+    return is_constant(reg) && Assembler::fits_in_32_bits(constant(reg));
+  }
+  void load_operand(uint16_t reg) {
+    if (is_constant(reg)) {
+      assembler_.load_immediate(constant(reg));
+    } else {
+      assembler_.load(reg);
+    }
+  }
+  void arithmetic(const Instruction& instruction) {
+    bool add = instruction.op == OpCode::ADD;
+    uint16_t left = instruction.b;
+    uint16_t right = instruction.c;
+    // Both operations commute, so a constant goes wherever an immediate fits.
+    if (is_immediate(left) && !is_immediate(right)) {
+      std::swap(left, right);
+    }
+    load_operand(left);
+    if (is_immediate(right)) {
+      if (add) {
+        assembler_.add_immediate(constant(right));
+      } else {
+        assembler_.multiply_immediate(constant(right));
+      }
+    } else if (is_constant(right)) {
+      assembler_.load_second(constant(right));
+      if (add) {
+        assembler_.add_second();
+      } else {
+        assembler_.multiply_second();
+      }
+    } else if (add) {
+      assembler_.add(right);
+    } else {
+      assembler_.multiply(right);
+    }
+    assembler_.store(instruction.a);
+  }
+
+  // The intrinsics are out of line calls with the signature of
+  // Assembler::call.
+  void intrinsic(const Instruction& instruction) {
+    int64_t (*function)(int64_t, int64_t);
+    switch (instruction.op) {
+      case OpCode::DIVIDE:
+        function = intrinsic_div;
+        break;
+      case OpCode::REMAINDER:
+        function = intrinsic_rem;
+        break;
+      case OpCode::SHIFT_LEFT:
+        function = intrinsic_shiftl;
+        break;
+      case OpCode::SHIFT_RIGHT:
+        function = intrinsic_shiftr;
+        break;
+      default:
+        function = [](int64_t x, int64_t) { return intrinsic_leadingzeros(x); };
+        break;
+    }
+    bool one_operand = instruction.op == OpCode::LEADING_ZEROS;
+    load_operand(instruction.b);
+    if (one_operand || is_constant(instruction.c)) {
+      assembler_.call(function, true,
+                      one_operand ? 0 : constant(instruction.c));
+    } else {
+      assembler_.call(function, false, instruction.c);
+    }
+    assembler_.store(instruction.a);
+  }
+
+  void call(const Instruction& instruction) {
+    const Program& callee = program_.functions()[instruction.b];
+    uint32_t window = program_being_translated_->register_count();
+    assembler_.push_base();
+    assembler_.compare_base(stack_end_ - window - callee.register_count());
+    overflows_.push_back(assembler_.jump(ABOVE));
+    assembler_.compare_stack(machine_stack_limit_);
+    overflows_.push_back(assembler_.jump(BELOW));
+    for (uint32_t i = 0; i < callee.parameter_count(); ++i) {
+      assembler_.load(instruction.c + i);
+      assembler_.store(window + i);
+    }
+    assembler_.add_to_base(static_cast<int32_t>(window * sizeof(int64_t)));
+    calls_.push_back({assembler_.call(), instruction.b});
+    assembler_.pop_base();
+    assembler_.store(instruction.a);
+  }
+
+  const Program& program_;
+  const int64_t* stack_end_;
+  const int64_t* machine_stack_top_;
+  const int64_t* machine_stack_limit_;
+  const Program* program_being_translated_ = nullptr;
+  Assembler assembler_;
+  // The displacement of every call and the function it calls.
+  std::vector<std::pair<size_t, uint16_t>> calls_;
+  // The displacements of the jumps taken when either stack is full.
+  std::vector<size_t> overflows_;
+};
+}  // namespace
+
+bool JitCompiler::supported() { return true; }
+
+std::unique_ptr<JitFunction> JitCompiler::compile(const Program& program) {
+  auto function = std::make_unique<JitFunction>();
+  StackMemory& registers = function->registers();
+  StackMemory& machine_stack = function->machine_stack();
+  if (program.functions().empty()) {
+    if (!registers.allocate(program.register_count())) {
+      return nullptr;
+    }
+  } else if (!registers.allocate(JitFunction::kStackRegisters) ||
+             !machine_stack.allocate(JitFunction::kMachineStackWords)) {
+    return nullptr;
+  }
+  int64_t* machine_stack_top = nullptr;
+  int64_t* machine_stack_limit = nullptr;
+  if (machine_stack.data()) {
+    machine_stack_top = machine_stack.data() + machine_stack.size();
+    machine_stack_limit =
+        machine_stack.data() + JitFunction::kMachineStackReserve;
+  }
+  Translator translator(program, registers.data() + registers.size(),
+                        machine_stack_top, machine_stack_limit);
+  if (!function->buffer().load(translator.translate())) {
+    return nullptr;
+  }
+  return function;
+}
+
+#else
+
+StackMemory::~StackMemory() {}
+
+bool StackMemory::allocate(size_t size) { return false; }
+
+ExecutableBuffer::~ExecutableBuffer() {}
+
+bool ExecutableBuffer::load(const std::vector<uint8_t>& code) {
+  return false;
+}
+
+bool JitCompiler::supported() { return false; }
+
+std::unique_ptr<JitFunction> JitCompiler::compile(const Program& program) {
+  LOG(ERROR) << "The JIT does not support this host";
+  return nullptr;
+}
+
+#endif
+
+}  // namespace simp
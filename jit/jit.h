@@ -0,0 +1,100 @@
+#pragma once
+
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <glog/logging.h>
+
+#include <cstddef>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "vm/bytecode.h"
+
+namespace simp {
+// Page aligned memory that is writable while code is copied in and then
+// becomes executable (never both at once).
+class ExecutableBuffer {
+ public:
+  ExecutableBuffer() {}
+  ExecutableBuffer(const ExecutableBuffer&) = delete;
+  ExecutableBuffer& operator=(const ExecutableBuffer&) = delete;
+  ~ExecutableBuffer();
+
+  bool load(const std::vector<uint8_t>& code);
+  const void* entry() const { return memory_; }
+
+ private:
+  void* memory_ = nullptr;
+  size_t size_ = 0;
+};
+
+// Stack memory for the generated code, reserved up front and only backed by
+// pages as calls reach them.
+class StackMemory {
+ public:
+  StackMemory() {}
+  StackMemory(const StackMemory&) = delete;
+  StackMemory& operator=(const StackMemory&) = delete;
+  ~StackMemory();
+
+  // Reserves size 64-bit words.
+  bool allocate(size_t size);
+  int64_t* data() { return words_; }
+  size_t size() const { return size_; }
+
+ private:
+  int64_t* words_ = nullptr;
+  size_t size_ = 0;
+};
+
+// Native code for one Program. Bytecode registers live in a StackMemory that
+// the generated code addresses through rdi; each call runs in a window above
+// its caller's. A program with functions also runs on a machine stack of its
+// own, so that how deeply it may recurse does not depend on the stack of the
+// thread that runs it.
+class JitFunction {
+ public:
+  using Entry = int64_t (*)(int64_t* registers);
+  // Registers reserved for programs with functions.
+  static constexpr size_t kStackRegisters = size_t{1} << 23;
+  // Words of machine stack reserved for programs with functions. Every level
+  // of calls takes two of them (the saved rdi and the return address), and
+  // the last kMachineStackReserve are kept for intrinsics and for reporting
+  // an overflow.
+  static constexpr size_t kMachineStackWords = size_t{1} << 23;
+  static constexpr size_t kMachineStackReserve = size_t{1} << 15;
+  // Calls therefore nest at most (kMachineStackWords - kMachineStackReserve)
+  // / 2 deep, or less when their frames exhaust kStackRegisters first; a
+  // call past either limit stops the process with an error.
+
+  ExecutableBuffer& buffer() { return buffer_; }
+  StackMemory& registers() { return registers_; }
+  StackMemory& machine_stack() { return machine_stack_; }
+  // Runs the program with one argument per input.
+  int64_t run(const std::vector<int64_t>& arguments = {}) {
+    std::copy(arguments.begin(), arguments.end(), registers_.data());
+    return reinterpret_cast<Entry>(const_cast<void*>(buffer_.entry()))(
+        registers_.data());
+  }
+
+ private:
+  ExecutableBuffer buffer_;
+  StackMemory registers_;
+  StackMemory machine_stack_;
+};
+
+// Translates register bytecode into x86-64 machine code, one instruction
+// template per opcode. Constant operands become immediates and a comparison
+// that feeds a conditional jump is fused into a single compare-and-branch.
+// Calls become native calls, checked against both stacks of the JitFunction
+// before they pass their arguments.
+class JitCompiler {
+ public:
+  // Whether this host can run code generated by the JIT.
+  static bool supported();
+
+  std::unique_ptr<JitFunction> compile(const Program& program);
+};
+}  // namespace simp
@@ -0,0 +1,106 @@
+#include "jit/jit.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "parser/parser.h"
+#include "vm/compiler.h"
+
+namespace simp {
+namespace {
+using ::testing::Eq;
+using ::testing::NotNull;
+class JitTest : public ::testing::Test {
+ protected:
+  JitTest() {}
+  ~JitTest() override {}
+  void SetUp() override {
+    if (!JitCompiler::supported()) {
+      GTEST_SKIP() << "JIT not supported on this host";
+    }
+  }
+
+  std::unique_ptr<JitFunction> compile(const std::string& file) {
+    Parser parser(file);
+    EXPECT_TRUE(parser.parse());
+    ast_ = parser.ast();
+    program_ = BytecodeCompiler().compile(*ast_);
+    EXPECT_THAT(program_, NotNull());
+    return JitCompiler().compile(*program_);
+  }
+
+  std::unique_ptr<Ast> ast_;
+  std::unique_ptr<Program> program_;
+};
+
+TEST_F(JitTest, RunsIntExpression) {
+  auto function = compile("examples/just_nums.sl");
+  ASSERT_THAT(function, NotNull());
+  EXPECT_THAT(function->run(), Eq(1234567890));
+}
+
+TEST_F(JitTest, RunsIfExpression) {
+  auto function = compile("examples/if_statement.sl");
+  ASSERT_THAT(function, NotNull());
+  EXPECT_THAT(function->run(), Eq(2));
+}
+
+TEST_F(JitTest, WrapsOnOverflow) {
+  auto function = compile("examples/overflow.sl");
+  ASSERT_THAT(function, NotNull());
+  EXPECT_THAT(function->run(), Eq(INT64_MIN));
+}
+
+TEST_F(JitTest, RunsLoopInConstantStack) {
+  auto function = compile("examples/long_loop.sl");
+  ASSERT_THAT(function, NotNull());
+  EXPECT_THAT(function->run(), Eq(49999995000000));
+}
+
+TEST_F(JitTest, RunsFunctions) {
+  auto function = compile("examples/functions.sl");
+  ASSERT_THAT(function, NotNull());
+  EXPECT_THAT(function->run(), Eq(385));
+  // nextprime's functions call each other, leadingzeros calls itself and sqrt
+  // compares with a constant too wide for an immediate.
+  for (std::string file :
+       {"examples/nextprime.sl", "examples/wide_calls.sl",
+        "examples/let_in_arguments.sl"}) {
+    function = compile(file);
+    ASSERT_THAT(function, NotNull()) << file;
+    for (int64_t input : {5, 100, 1000}) {
+      EXPECT_THAT(function->run({input}), Eq(ast_->eval({input}))) << file;
+    }
+  }
+}
+
+TEST_F(JitTest, NestsCallsInRegisterWindows) {
+  auto function = compile("examples/recursive_count.sl");
+  ASSERT_THAT(function, NotNull());
+  EXPECT_THAT(function->run({100000}), Eq(100000));
+}
+
+TEST_F(JitTest, RecursesOnItsOwnMachineStack) {
+  // Deeper than the default thread stack allows for native frames.
+  auto function = compile("examples/recursive_count.sl");
+  ASSERT_THAT(function, NotNull());
+  EXPECT_THAT(function->run({1000000}), Eq(1000000));
+}
+
+TEST_F(JitTest, MatchesTreeEvaluation) {
+  for (std::string file :
+       {"examples/just_nums.sl", "examples/if_statement.sl",
+        "examples/not_expression.sl", "examples/negative_expression.sl",
+        "examples/parenthesized_expression.sl",
+        "examples/logical_expression.sl", "examples/overflow.sl",
+        "examples/shadowing.sl", "examples/factorial_loop.sl",
+        "examples/shiftl_loop.sl", "examples/swap_loop.sl",
+        "examples/nested_loop.sl", "examples/intrinsics.sl"}) {
+    auto function = compile(file);
+    ASSERT_THAT(function, NotNull()) << file;
+    EXPECT_THAT(function->run(), Eq(ast_->eval())) << file;
+  }
+}
+
+}  // namespace
+}  // namespace simp
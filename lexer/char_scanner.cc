@@ -0,0 +1,167 @@
+#include "char_scanner.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SIMP_LEXER_SIMD 1
+#include <immintrin.h>
+#else
+#define SIMP_LEXER_SIMD 0
+#endif
+
+namespace simp {
+
+namespace {
+// ASCII only, as std::isspace and friends are in the "C" locale.
+inline bool is_blank(unsigned char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+inline bool is_digit(unsigned char c) {
+  return static_cast<unsigned>(c - '0') < 10;
+}
+inline bool is_word(unsigned char c) {
+  return is_digit(c) || static_cast<unsigned>((c | 0x20) - 'a') < 26 ||
+         c == '_';
+}
+
+template <bool (*in_class)(unsigned char)>
+const char* skip_scalar(const char* p, const char* end) {
+  while (p < end && in_class(*p)) {
+    p++;
+  }
+  return p;
+}
+
+#if SIMP_LEXER_SIMD
+// Byte masks for a block of 16. Bytes from 0x80 up compare as negative, so
+// they fall outside every class, as they do for the scalar tests.
+inline __m128i blanks_16(__m128i bytes) {
+  __m128i mask = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '));
+  for (char blank : {'\t', '\r', '\v', '\f'}) {
+    mask = _mm_or_si128(mask, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(blank)));
+  }
+  return mask;
+}
+inline __m128i in_range_16(__m128i bytes, char low, char high) {
+  return _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(low - 1)),
+                       _mm_cmplt_epi8(bytes, _mm_set1_epi8(high + 1)));
+}
+inline __m128i digits_16(__m128i bytes) {
+  return in_range_16(bytes, '0', '9');
+}
+inline __m128i words_16(__m128i bytes) {
+  // Setting bit 5 folds upper case onto lower case without making anything
+  // else a letter.
+  __m128i letters =
+      in_range_16(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), 'a', 'z');
+  return _mm_or_si128(
+      _mm_or_si128(letters, digits_16(bytes)),
+      _mm_cmpeq_epi8(bytes, _mm_set1_epi8('_')));
+}
+
+template <__m128i (*in_class)(__m128i), bool (*scalar)(unsigned char)>
+const char* skip_sse2(const char* p, const char* end) {
+  while (end - p >= 16) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    unsigned outside = ~_mm_movemask_epi8(in_class(bytes)) & 0xffff;
+    if (outside) {
+      return p + __builtin_ctz(outside);
+    }
+    p += 16;
+  }
+  return skip_scalar<scalar>(p, end);
+}
+
+#define SIMP_AVX2 __attribute__((target("avx2")))
+
+SIMP_AVX2 inline __m256i blanks_32(__m256i bytes) {
+  __m256i mask = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '));
+  for (char blank : {'\t', '\r', '\v', '\f'}) {
+    mask = _mm256_or_si256(mask,
+                           _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(blank)));
+  }
+  return mask;
+}
+SIMP_AVX2 inline __m256i in_range_32(__m256i bytes, char low, char high) {
+  return _mm256_and_si256(
+      _mm256_cmpgt_epi8(bytes, _mm256_set1_epi8(low - 1)),
+      _mm256_cmpgt_epi8(_mm256_set1_epi8(high + 1), bytes));
+}
+SIMP_AVX2 inline __m256i digits_32(__m256i bytes) {
+  return in_range_32(bytes, '0', '9');
+}
+SIMP_AVX2 inline __m256i words_32(__m256i bytes) {
+  __m256i letters =
+      in_range_32(_mm256_or_si256(bytes, _mm256_set1_epi8(0x20)), 'a', 'z');
+  return _mm256_or_si256(
+      _mm256_or_si256(letters, digits_32(bytes)),
+      _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('_')));
+}
+
+// Finishes with the 16 byte loop, so short tails are still vectorized.
+template <__m256i (*in_class)(__m256i), __m128i (*in_class_16)(__m128i),
+          bool (*scalar)(unsigned char)>
+SIMP_AVX2 const char* skip_avx2(const char* p, const char* end) {
+  while (end - p >= 32) {
+    __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    unsigned outside = ~static_cast<unsigned>(
+        _mm256_movemask_epi8(in_class(bytes)));
+    if (outside) {
+      return p + __builtin_ctz(outside);
+    }
+    p += 32;
+  }
+  return skip_sse2<in_class_16, scalar>(p, end);
+}
+#endif
+}  // namespace
+
+const CharScanner& CharScanner::scalar() {
+  static const CharScanner scanner = {
+      "scalar", skip_scalar<is_blank>, skip_scalar<is_digit>,
+      skip_scalar<is_word>};
+  return scanner;
+}
+
+const CharScanner* CharScanner::sse2() {
+#if SIMP_LEXER_SIMD
+  // SSE2 is part of x86-64.
+  static const CharScanner scanner = {
+      "sse2", skip_sse2<blanks_16, is_blank>, skip_sse2<digits_16, is_digit>,
+      skip_sse2<words_16, is_word>};
+  return &scanner;
+#else
+  return nullptr;
+#endif
+}
+
+const CharScanner* CharScanner::avx2() {
+#if SIMP_LEXER_SIMD
+  static const CharScanner scanner = {
+      "avx2", skip_avx2<blanks_32, blanks_16, is_blank>,
+      skip_avx2<digits_32, digits_16, is_digit>,
+      skip_avx2<words_32, words_16, is_word>};
+  return __builtin_cpu_supports("avx2") ? &scanner : nullptr;
+#else
+  return nullptr;
+#endif
+}
+
+const CharScanner& CharScanner::best() {
+  static const CharScanner& scanner = []() -> const CharScanner& {
+    const char* isa = std::getenv("SIMP_LEXER_ISA");
+    bool scalar_only = isa && std::strcmp(isa, "scalar") == 0;
+    bool sse2_only = isa && std::strcmp(isa, "sse2") == 0;
+    if (!scalar_only && !sse2_only && avx2()) {
+      return *avx2();
+    }
+    if (!scalar_only && sse2()) {
+      return *sse2();
+    }
+    return scalar();
+  }();
+  return scanner;
+}
+
+}  // namespace simp
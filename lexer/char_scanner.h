@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string_view>
+
+namespace simp {
+// Finds where a run of one character class ends. The lexer hands every run
+// of blanks, digits or word characters to one of these instead of testing it
+// a byte at a time; operators are single bytes and stay in the lexer's
+// switch. Every implementation returns exactly what the scalar one does.
+struct CharScanner {
+  // Each returns the first byte in [p, end) outside its class, or end.
+  // Blanks are whitespace other than '\n', which the lexer counts lines by.
+  using Skip = const char* (*)(const char* p, const char* end);
+
+  const char* name;
+  Skip skip_blanks;
+  Skip skip_digits;
+  // Letters, digits and '_'.
+  Skip skip_word;
+
+  static const CharScanner& scalar();
+  // nullptr when the host or the compiler lacks the instruction set.
+  static const CharScanner* sse2();
+  static const CharScanner* avx2();
+  // The widest scanner the CPU supports. Setting SIMP_LEXER_ISA to scalar,
+  // sse2 or avx2 caps the choice, which is how tests cover every path.
+  static const CharScanner& best();
+};
+}  // namespace simp
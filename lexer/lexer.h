@@ -1,38 +1,48 @@
 #pragma once
 
-#include <deque>
 #include <memory>
 #include <string>
+#include <string_view>
 #undef GOOGLE_STRIP_LOG
 #define GOOGLE_STRIP_LOG 1
 #include <glog/logging.h>
 
+#include "lexer/char_scanner.h"
+#include "lexer/source_buffer.h"
+#include "tokens/symbol_table.h"
 #include "tokens/tokens.h"
 
 namespace simp {
-enum State {
-  START,
-  IN_INTEGER,
-  IN_IDENTIFIER,
-  IN_KEYWORD,
-};
 class Lexer {
  public:
-  Lexer(const std::string& file_name) : file_name_(file_name) {}
+  // Names are interned into symbols, or into a table of the lexer's own.
+  Lexer(const std::string& file_name,
+        std::shared_ptr<SymbolTable> symbols = nullptr)
+      : file_name_(file_name), tokens_(std::move(symbols)) {
+    tokens_.set_file_name(file_name_);
+  }
 
+  // Scans the file, mapped into memory rather than read through a stream.
   bool scan();
-  std::deque<std::unique_ptr<Token>>& tokens() { return tokens_; }
+  // Scans source in place; file_name() is only used to report locations.
+  // Nothing in the token stream points into source once this returns.
+  bool scan(std::string_view source);
+  TokenStream& tokens() { return tokens_; }
+  // Picks the implementation that skips runs of blanks, digits and words;
+  // CharScanner::best() unless set.
+  void set_scanner(const CharScanner& scanner) { scanner_ = &scanner; }
+  const CharScanner& scanner() const { return *scanner_; }
   const std::string& file_name() const { return file_name_; }
   void print_tokens() {
-    while (!tokens_.empty()) {
-      std::cout << tokens_.front()->to_string();
-      tokens_.pop_front();
+    for (const Token& token : tokens_) {
+      std::cout << tokens_.to_string(token);
     }
   }
 
  private:
   const std::string file_name_;
-  std::deque<std::unique_ptr<Token>> tokens_;
+  TokenStream tokens_;
+  const CharScanner* scanner_ = &CharScanner::best();
 };
 
-}  // namespace simp
\ No newline at end of file
+}  // namespace simp
@@ -0,0 +1,212 @@
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lexer/char_scanner.h"
+#include "lexer/lexer.h"
+#include "tokens/tokens.h"
+
+DEFINE_string(file, "",
+              "Program to scan; a program is generated when empty");
+DEFINE_int32(megabytes, 16, "Size of the generated program");
+DEFINE_int32(iterations, 5, "Number of scans to time per lexer");
+
+namespace simp {
+namespace {
+// Roughly what generated programs look like: nested lets, loops and
+// arithmetic over many distinct names.
+void generate(size_t size, std::string& source) {
+  for (int i = 0; source.size() < size; ++i) {
+    std::string n = std::to_string(i);
+    source += "let value_" + n + " = " + n + " * (a + b) and\n";
+    source += "    flag_" + n + " = !(value_" + n + " < 1000) || c == " + n +
+              " in\n";
+    source += "  loop acc = 1 and i = 2 in\n";
+    source += "    if flag_" + n + " && i < value_" + n +
+              " then recur (acc * i) (i + 1) else -acc end\n";
+    source += "  end\nend\n";
+  }
+}
+
+// The scanner Lexer::scan used before it ran over a contiguous buffer: one
+// ifstream get/peek per character and a std::string per word. Kept as the
+// baseline being measured against.
+bool scan_stream(const std::string& file_name, TokenStream& tokens) {
+  std::ifstream f(file_name);
+  if (!f.is_open()) {
+    return false;
+  }
+  char c;
+  std::string token;
+  uint32_t offset = 0;
+  while (f.get(c)) {
+    uint32_t start = offset++;
+    if (c == '(') {
+      tokens.add_operator(Operator::OPEN_PAREN, start);
+    } else if (c == ')') {
+      tokens.add_operator(Operator::CLOSE_PAREN, start);
+    } else if (c == '+') {
+      tokens.add_operator(Operator::PLUS, start);
+    } else if (c == '*') {
+      tokens.add_operator(Operator::TIMES, start);
+    } else if (c == '!') {
+      tokens.add_operator(Operator::NOT, start);
+    } else if (c == '<') {
+      tokens.add_operator(Operator::LESS_THAN, start);
+    } else if (c == '-') {
+      tokens.add_operator(Operator::UNARY_MINUS, start);
+    } else if (c == '|' || c == '&') {
+      if (f.peek() != c) {
+        return false;
+      }
+      f.get(c);
+      offset++;
+      tokens.add_operator(
+          c == '|' ? Operator::LOGICAL_OR : Operator::LOGICAL_AND, start);
+    } else if (c == '=') {
+      if (f.peek() == '=') {
+        f.get(c);
+        offset++;
+        tokens.add_operator(Operator::EQUALS, start);
+      } else {
+        tokens.add_operator(Operator::ASSIGN, start);
+      }
+    } else if (std::isdigit(c)) {
+      token = c;
+      while (std::isdigit(f.peek())) {
+        f.get(c);
+        offset++;
+        token += c;
+      }
+      int64_t value = 0;
+      std::from_chars(token.data(), token.data() + token.size(), value);
+      tokens.add_integer(value, start);
+    } else if (c == '\n') {
+      tokens.add_line(offset);
+    } else if (c == '_' || std::isalpha(c)) {
+      token = c;
+      while (std::isalnum(f.peek()) || f.peek() == '_') {
+        f.get(c);
+        offset++;
+        token += c;
+      }
+      Keyword keyword;
+      if (find_keyword(token, keyword)) {
+        tokens.add_keyword(keyword, start);
+      } else {
+        tokens.add_identifier(token, start);
+      }
+    }
+  }
+  return true;
+}
+
+// Runs scan FLAGS_iterations times and returns the best throughput in MB/s.
+template <typename Scan>
+double megabytes_per_second(size_t bytes, Scan scan, size_t& token_count) {
+  double best = 0;
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    TokenStream tokens;
+    auto start = std::chrono::steady_clock::now();
+    if (!scan(tokens)) {
+      LOG(ERROR) << "Scan failed";
+      return 0;
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::max(best, bytes / 1e6 / elapsed.count());
+    token_count = tokens.size();
+  }
+  return best;
+}
+}  // namespace
+}  // namespace simp
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  std::string file = FLAGS_file;
+  std::string source;
+  if (file.empty()) {
+    simp::generate(static_cast<size_t>(FLAGS_megabytes) << 20, source);
+    file = (std::filesystem::temp_directory_path() / "lexer_benchmark.sl")
+               .string();
+    std::ofstream(file) << source;
+    std::cerr << "Generated " << source.size() << " bytes into " << file
+              << std::endl;
+  } else {
+    std::ifstream in(file);
+    source.assign(std::istreambuf_iterator<char>(in),
+                  std::istreambuf_iterator<char>());
+  }
+
+  size_t stream_tokens = 0;
+  size_t mapped_tokens = 0;
+  double stream = simp::megabytes_per_second(
+      source.size(),
+      [&](simp::TokenStream& tokens) {
+        return simp::scan_stream(file, tokens);
+      },
+      stream_tokens);
+  double mapped = simp::megabytes_per_second(
+      source.size(),
+      [&](simp::TokenStream& tokens) {
+        simp::Lexer lexer(file);
+        bool success = lexer.scan();
+        tokens = std::move(lexer.tokens());
+        return success;
+      },
+      mapped_tokens);
+  std::vector<std::pair<const simp::CharScanner*, double>> memory;
+  for (const simp::CharScanner* scanner :
+       {&simp::CharScanner::scalar(), simp::CharScanner::sse2(),
+        simp::CharScanner::avx2()}) {
+    if (!scanner) {
+      continue;
+    }
+    size_t memory_tokens = 0;
+    double throughput = simp::megabytes_per_second(
+        source.size(),
+        [&](simp::TokenStream& tokens) {
+          simp::Lexer lexer(file);
+          lexer.set_scanner(*scanner);
+          bool success = lexer.scan(source);
+          tokens = std::move(lexer.tokens());
+          return success;
+        },
+        memory_tokens);
+    if (memory_tokens != stream_tokens) {
+      LOG(ERROR) << "Lexers disagree: " << stream_tokens << " and "
+                 << memory_tokens << " tokens with " << scanner->name;
+      return 1;
+    }
+    memory.push_back({scanner, throughput});
+  }
+  if (stream_tokens != mapped_tokens) {
+    LOG(ERROR) << "Lexers disagree: " << stream_tokens << " and "
+               << mapped_tokens << " tokens";
+    return 1;
+  }
+  std::cout << stream_tokens << " tokens in " << source.size() << " bytes"
+            << std::endl;
+  std::cout << "stream: " << stream << " MB/s" << std::endl;
+  std::cout << "mmap (" << simp::CharScanner::best().name << "): " << mapped
+            << " MB/s" << std::endl;
+  for (const auto& [scanner, throughput] : memory) {
+    std::cout << "memory (" << scanner->name << "): " << throughput << " MB/s"
+              << std::endl;
+  }
+  return 0;
+}
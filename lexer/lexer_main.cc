@@ -3,19 +3,30 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include <iostream>
+
 #include "lexer.h"
+#include "trace/trace.h"
 
 DEFINE_bool(verbose, true, "Enable verbose output");
 DEFINE_string(file, "", "File to scan");
+DEFINE_string(trace, "",
+              "Trace categories to record (lexer, parser, eval or all); the "
+              "trace is printed to stderr on exit");
 
 int main(int argc, char** argv) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
 
   if (FLAGS_verbose) {
     LOG(INFO) << "Verbose output enabled.";
-#undef GOOGLE_STRIP_LOG
-#define GOOGLE_STRIP_LOG 0
   }
+  uint32_t categories;
+  if (!simp::Tracer::parse_categories(FLAGS_trace, categories)) {
+    LOG(ERROR) << "Unknown trace category in: " << FLAGS_trace;
+    return 1;
+  }
+  simp::Tracer::enable(categories);
+
   if (FLAGS_file.empty()) {
     LOG(ERROR) << "No file provided";
     return 1;
@@ -27,6 +38,7 @@ int main(int argc, char** argv) {
     return 1;
   }
   lexer.print_tokens();
+  simp::Tracer::dump(std::cerr);
 
   return 0;
 }
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "tokens/tokens.h"
+
+namespace simp {
+// The lexer as a DFA, with every table built by the compiler. A byte is first
+// mapped to its CharClass; the current LexState and that class then select a
+// Transition saying what to do. Runs of blanks, digits and word characters
+// are left to the CharScanner once the DFA has seen their first byte.
+enum class CharClass : uint8_t {
+  OTHER,
+  BLANK,
+  NEWLINE,
+  DIGIT,
+  LETTER,
+  UNDERSCORE,
+  OPEN_PAREN,
+  CLOSE_PAREN,
+  PLUS,
+  TIMES,
+  BANG,
+  LESS,
+  MINUS,
+  BAR,
+  AMPERSAND,
+  EQUALS,
+  // Not a byte: what the scanner sees past the last one.
+  END_OF_INPUT,
+};
+inline constexpr size_t kCharClassCount =
+    static_cast<size_t>(CharClass::END_OF_INPUT) + 1;
+
+enum class LexState : uint8_t {
+  START,
+  AFTER_BAR,
+  AFTER_AMPERSAND,
+  AFTER_EQUALS,
+  AFTER_UNDERSCORE,
+};
+inline constexpr size_t kLexStateCount =
+    static_cast<size_t>(LexState::AFTER_UNDERSCORE) + 1;
+
+enum class LexAction : uint8_t {
+  // Consume the byte and move to Transition::next.
+  SHIFT,
+  // Consume the byte, which separates tokens.
+  SKIP,
+  SKIP_BLANKS,
+  NEWLINE,
+  // Consume the byte and emit Transition::op, which started at the token.
+  OPERATOR,
+  // Emit Transition::op without consuming the byte, which starts the next
+  // token.
+  OPERATOR_BEFORE,
+  INTEGER,
+  WORD,
+  ERROR,
+  DONE,
+};
+
+struct Transition {
+  LexAction action = LexAction::ERROR;
+  LexState next = LexState::START;
+  Operator op = Operator::OPEN_PAREN;
+  // What went wrong, for an ERROR.
+  const char* error = nullptr;
+};
+
+inline constexpr std::array<CharClass, 256> kCharClasses = [] {
+  std::array<CharClass, 256> classes{};
+  // A loop rather than fill, which is not constexpr before C++20.
+  for (CharClass& c : classes) {
+    c = CharClass::OTHER;
+  }
+  for (unsigned char c : {' ', '\t', '\r', '\v', '\f'}) {
+    classes[c] = CharClass::BLANK;
+  }
+  classes['\n'] = CharClass::NEWLINE;
+  for (int c = '0'; c <= '9'; ++c) {
+    classes[c] = CharClass::DIGIT;
+  }
+  for (int c = 'a'; c <= 'z'; ++c) {
+    classes[c] = CharClass::LETTER;
+    classes[c - 'a' + 'A'] = CharClass::LETTER;
+  }
+  classes['_'] = CharClass::UNDERSCORE;
+  classes['('] = CharClass::OPEN_PAREN;
+  classes[')'] = CharClass::CLOSE_PAREN;
+  classes['+'] = CharClass::PLUS;
+  classes['*'] = CharClass::TIMES;
+  classes['!'] = CharClass::BANG;
+  classes['<'] = CharClass::LESS;
+  classes['-'] = CharClass::MINUS;
+  classes['|'] = CharClass::BAR;
+  classes['&'] = CharClass::AMPERSAND;
+  classes['='] = CharClass::EQUALS;
+  return classes;
+}();
+
+using TransitionTable =
+    std::array<std::array<Transition, kCharClassCount>, kLexStateCount>;
+
+inline constexpr TransitionTable kTransitions = [] {
+  TransitionTable table{};
+  auto at = [&](LexState state) -> auto& {
+    return table[static_cast<size_t>(state)];
+  };
+  auto on = [&](LexState state, CharClass c) -> Transition& {
+    return at(state)[static_cast<size_t>(c)];
+  };
+  auto emit = [](Operator op) {
+    return Transition{LexAction::OPERATOR, LexState::START, op};
+  };
+  auto shift = [](LexState next) {
+    return Transition{LexAction::SHIFT, next};
+  };
+
+  on(LexState::START, CharClass::OTHER) = {LexAction::SKIP};
+  on(LexState::START, CharClass::BLANK) = {LexAction::SKIP_BLANKS};
+  on(LexState::START, CharClass::NEWLINE) = {LexAction::NEWLINE};
+  on(LexState::START, CharClass::DIGIT) = {LexAction::INTEGER};
+  on(LexState::START, CharClass::LETTER) = {LexAction::WORD};
+  on(LexState::START, CharClass::UNDERSCORE) =
+      shift(LexState::AFTER_UNDERSCORE);
+  on(LexState::START, CharClass::OPEN_PAREN) = emit(Operator::OPEN_PAREN);
+  on(LexState::START, CharClass::CLOSE_PAREN) = emit(Operator::CLOSE_PAREN);
+  on(LexState::START, CharClass::PLUS) = emit(Operator::PLUS);
+  on(LexState::START, CharClass::TIMES) = emit(Operator::TIMES);
+  on(LexState::START, CharClass::BANG) = emit(Operator::NOT);
+  on(LexState::START, CharClass::LESS) = emit(Operator::LESS_THAN);
+  on(LexState::START, CharClass::MINUS) = emit(Operator::UNARY_MINUS);
+  on(LexState::START, CharClass::BAR) = shift(LexState::AFTER_BAR);
+  on(LexState::START, CharClass::AMPERSAND) =
+      shift(LexState::AFTER_AMPERSAND);
+  on(LexState::START, CharClass::EQUALS) = shift(LexState::AFTER_EQUALS);
+  on(LexState::START, CharClass::END_OF_INPUT) = {LexAction::DONE};
+
+  for (Transition& transition : at(LexState::AFTER_BAR)) {
+    transition.error = "Expected || but only found one |";
+  }
+  on(LexState::AFTER_BAR, CharClass::BAR) = emit(Operator::LOGICAL_OR);
+
+  for (Transition& transition : at(LexState::AFTER_AMPERSAND)) {
+    transition.error = "Expected && but only found one &";
+  }
+  on(LexState::AFTER_AMPERSAND, CharClass::AMPERSAND) =
+      emit(Operator::LOGICAL_AND);
+
+  for (Transition& transition : at(LexState::AFTER_EQUALS)) {
+    transition = {LexAction::OPERATOR_BEFORE, LexState::START,
+                  Operator::ASSIGN};
+  }
+  on(LexState::AFTER_EQUALS, CharClass::EQUALS) = emit(Operator::EQUALS);
+
+  for (Transition& transition : at(LexState::AFTER_UNDERSCORE)) {
+    transition.error =
+        "Expected identifier but found non alpha char after _ in the front";
+  }
+  on(LexState::AFTER_UNDERSCORE, CharClass::LETTER) = {LexAction::WORD};
+  return table;
+}();
+
+constexpr const Transition& transition(LexState state, CharClass c) {
+  return kTransitions[static_cast<size_t>(state)][static_cast<size_t>(c)];
+}
+
+static_assert(transition(LexState::START, kCharClasses['=']).next ==
+              LexState::AFTER_EQUALS);
+static_assert(transition(LexState::AFTER_EQUALS, CharClass::END_OF_INPUT)
+                  .action == LexAction::OPERATOR_BEFORE);
+static_assert(transition(LexState::AFTER_BAR, CharClass::END_OF_INPUT)
+                  .action == LexAction::ERROR);
+}  // namespace simp
@@ -6,6 +6,7 @@
 #include <filesystem>
 #include <fstream>
 
+#include "lexer/streaming_lexer.h"
 #include "tokens/tokens.h"
 
 namespace simp {
@@ -37,9 +38,9 @@ TEST_F(LexerTest, OpenParen) {
   ASSERT_TRUE(success);
   auto& tokens = lexer.tokens();
   ASSERT_THAT(tokens.size(), Eq(1));
-  auto token = std::move(std::move(tokens.front()));
-  EXPECT_THAT(token->type(), Eq(TokenType::OPERATOR));
-  EXPECT_THAT(token->to_string(), StrEq("open-paren-operator"));
+  const Token& token = tokens[0];
+  EXPECT_THAT(token.type, Eq(TokenType::OPERATOR));
+  EXPECT_THAT(tokens.to_string(token), StrEq("open-paren-operator"));
 }
 
 TEST_F(LexerTest, CloseParen) {
@@ -49,9 +50,9 @@ TEST_F(LexerTest, CloseParen) {
   ASSERT_TRUE(success);
   auto& tokens = lexer.tokens();
   ASSERT_THAT(tokens.size(), Eq(1));
-  auto token = std::move(tokens.front());
-  EXPECT_THAT(token->type(), Eq(TokenType::OPERATOR));
-  EXPECT_THAT(token->to_string(), StrEq("close-paren-operator"));
+  const Token& token = tokens[0];
+  EXPECT_THAT(token.type, Eq(TokenType::OPERATOR));
+  EXPECT_THAT(tokens.to_string(token), StrEq("close-paren-operator"));
 }
 
 TEST_F(LexerTest, Plus) {
@@ -61,9 +62,9 @@ TEST_F(LexerTest, Plus) {
   ASSERT_TRUE(success);
   auto& tokens = lexer.tokens();
   ASSERT_THAT(tokens.size(), Eq(1));
-  auto token = std::move(tokens.front());
-  EXPECT_THAT(token->type(), Eq(TokenType::OPERATOR));
-  EXPECT_THAT(token->to_string(), StrEq("plus-operator"));
+  const Token& token = tokens[0];
+  EXPECT_THAT(token.type, Eq(TokenType::OPERATOR));
+  EXPECT_THAT(tokens.to_string(token), StrEq("plus-operator"));
 }
 
 TEST_F(LexerTest, Times) {
@@ -73,9 +74,9 @@ TEST_F(LexerTest, Times) {
   ASSERT_TRUE(success);
   auto& tokens = lexer.tokens();
   ASSERT_THAT(tokens.size(), Eq(1));
-  auto token = std::move(tokens.front());
-  EXPECT_THAT(token->type(), Eq(TokenType::OPERATOR));
-  EXPECT_THAT(token->to_string(), StrEq("times-operator"));
+  const Token& token = tokens[0];
+  EXPECT_THAT(token.type, Eq(TokenType::OPERATOR));
+  EXPECT_THAT(tokens.to_string(token), StrEq("times-operator"));
 }
 
 TEST_F(LexerTest, UnaryMinus) {
@@ -85,9 +86,9 @@ TEST_F(LexerTest, UnaryMinus) {
   ASSERT_TRUE(success);
   auto& tokens = lexer.tokens();
   ASSERT_THAT(tokens.size(), Eq(1));
-  auto token = std::move(tokens.front());
-  EXPECT_THAT(token->type(), Eq(TokenType::OPERATOR));
-  EXPECT_THAT(token->to_string(), StrEq("unary-minus-operator"));
+  const Token& token = tokens[0];
+  EXPECT_THAT(token.type, Eq(TokenType::OPERATOR));
+  EXPECT_THAT(tokens.to_string(token), StrEq("unary-minus-operator"));
 }
 
 TEST_F(LexerTest, Not) {
@@ -97,9 +98,9 @@ TEST_F(LexerTest, Not) {
   ASSERT_TRUE(success);
   auto& tokens = lexer.tokens();
   ASSERT_THAT(tokens.size(), Eq(1));
-  auto token = std::move(tokens.front());
-  EXPECT_THAT(token->type(), Eq(TokenType::OPERATOR));
-  EXPECT_THAT(token->to_string(), StrEq("not-operator"));
+  const Token& token = tokens[0];
+  EXPECT_THAT(token.type, Eq(TokenType::OPERATOR));
+  EXPECT_THAT(tokens.to_string(token), StrEq("not-operator"));
 }
 
 TEST_F(LexerTest, LessThan) {
@@ -109,9 +110,9 @@ TEST_F(LexerTest, LessThan) {
   ASSERT_TRUE(success);
   auto& tokens = lexer.tokens();
   ASSERT_THAT(tokens.size(), Eq(1));
-  auto token = std::move(tokens.front());
-  EXPECT_THAT(token->type(), Eq(TokenType::OPERATOR));
-  EXPECT_THAT(token->to_string(), StrEq("less-than-operator"));
+  const Token& token = tokens[0];
+  EXPECT_THAT(token.type, Eq(TokenType::OPERATOR));
+  EXPECT_THAT(tokens.to_string(token), StrEq("less-than-operator"));
 }
 
 // /************** Binary operators ********/
@@ -123,9 +124,9 @@ TEST_F(LexerTest, LogicalAnd) {
   ASSERT_TRUE(success);
   auto& tokens = lexer.tokens();
   ASSERT_THAT(tokens.size(), Eq(1));
-  auto token = std::move(tokens.front());
-  EXPECT_THAT(token->type(), Eq(TokenType::OPERATOR));
-  EXPECT_THAT(token->to_string(), StrEq("logical-and-operator"));
+  const Token& token = tokens[0];
+  EXPECT_THAT(token.type, Eq(TokenType::OPERATOR));
+  EXPECT_THAT(tokens.to_string(token), StrEq("logical-and-operator"));
 }
 
 TEST_F(LexerTest, LogicalOr) {
@@ -135,9 +136,9 @@ TEST_F(LexerTest, LogicalOr) {
   ASSERT_TRUE(success);
   auto& tokens = lexer.tokens();
   ASSERT_THAT(tokens.size(), Eq(1));
-  auto token = std::move(tokens.front());
-  EXPECT_THAT(token->type(), Eq(TokenType::OPERATOR));
-  EXPECT_THAT(token->to_string(), StrEq("logical-or-operator"));
+  const Token& token = tokens[0];
+  EXPECT_THAT(token.type, Eq(TokenType::OPERATOR));
+  EXPECT_THAT(tokens.to_string(token), StrEq("logical-or-operator"));
 }
 
 TEST_F(LexerTest, Equals) {
@@ -147,9 +148,9 @@ TEST_F(LexerTest, Equals) {
   ASSERT_TRUE(success);
   auto& tokens = lexer.tokens();
   ASSERT_THAT(tokens.size(), Eq(1));
-  auto token = std::move(tokens.front());
-  EXPECT_THAT(token->type(), Eq(TokenType::OPERATOR));
-  EXPECT_THAT(token->to_string(), StrEq("equals-operator"));
+  const Token& token = tokens[0];
+  EXPECT_THAT(token.type, Eq(TokenType::OPERATOR));
+  EXPECT_THAT(tokens.to_string(token), StrEq("equals-operator"));
 }
 
 TEST_F(LexerTest, Assign) {
@@ -159,9 +160,9 @@ TEST_F(LexerTest, Assign) {
   ASSERT_TRUE(success);
   auto& tokens = lexer.tokens();
   ASSERT_THAT(tokens.size(), Eq(1));
-  auto token = std::move(tokens.front());
-  EXPECT_THAT(token->type(), Eq(TokenType::OPERATOR));
-  EXPECT_THAT(token->to_string(), StrEq("assign-operator"));
+  const Token& token = tokens[0];
+  EXPECT_THAT(token.type, Eq(TokenType::OPERATOR));
+  EXPECT_THAT(tokens.to_string(token), StrEq("assign-operator"));
 }
 
 TEST_F(LexerTest, Integer) {
@@ -171,14 +172,14 @@ TEST_F(LexerTest, Integer) {
   ASSERT_TRUE(success);
   auto& tokens = lexer.tokens();
   ASSERT_THAT(tokens.size(), Eq(1));
-  auto token = std::move(tokens.front());
-  EXPECT_THAT(token->type(), Eq(TokenType::INTEGER));
-  EXPECT_THAT(token->to_string(), StrEq("1234567890"));
+  const Token& token = tokens[0];
+  EXPECT_THAT(token.type, Eq(TokenType::INTEGER));
+  EXPECT_THAT(tokens.to_string(token), StrEq("1234567890"));
 }
 
 TEST_F(LexerTest, Keyword) {
-  for (const auto& pair : Keywords) {
-    std::string keyword = pair.first;
+  for (std::string_view name : kKeywordNames) {
+    std::string keyword(name);
     std::string file = "examples/" + keyword + "_keyword.sl";
     Lexer lexer(file);
     ASSERT_THAT(lexer.file_name(), StrEq(file));
@@ -186,9 +187,9 @@ TEST_F(LexerTest, Keyword) {
     ASSERT_TRUE(success);
     auto& tokens = lexer.tokens();
     ASSERT_THAT(tokens.size(), Eq(1));
-    auto token = std::move(tokens.front());
-    EXPECT_THAT(token->type(), Eq(TokenType::KEYWORD));
-    EXPECT_THAT(token->to_string(), StrEq(keyword + "-keyword"));
+    const Token& token = tokens[0];
+    EXPECT_THAT(token.type, Eq(TokenType::KEYWORD));
+    EXPECT_THAT(tokens.to_string(token), StrEq(keyword + "-keyword"));
   };
 }
 
@@ -199,9 +200,9 @@ TEST_F(LexerTest, Identifier) {
   ASSERT_TRUE(success);
   auto& tokens = lexer.tokens();
   ASSERT_THAT(tokens.size(), Eq(1));
-  auto token = std::move(tokens.front());
-  EXPECT_THAT(token->type(), Eq(TokenType::IDENTIFIER));
-  EXPECT_THAT(token->to_string(), StrEq("qwertyuiop_1234567890"));
+  const Token& token = tokens[0];
+  EXPECT_THAT(token.type, Eq(TokenType::IDENTIFIER));
+  EXPECT_THAT(tokens.to_string(token), StrEq("qwertyuiop_1234567890"));
 }
 
 TEST_F(LexerTest, Add) {
@@ -211,41 +212,264 @@ TEST_F(LexerTest, Add) {
   ASSERT_TRUE(success);
   auto& tokens = lexer.tokens();
   ASSERT_THAT(tokens.size(), Eq(9));
-  auto let_token = std::move(tokens.front());
-  EXPECT_THAT(let_token->type(), Eq(TokenType::KEYWORD));
-  EXPECT_THAT(let_token->to_string(), StrEq("let-keyword"));
-  tokens.pop_front();
-  auto main_token = std::move(tokens.front());
-  EXPECT_THAT(main_token->type(), Eq(TokenType::IDENTIFIER));
-  EXPECT_THAT(main_token->to_string(), StrEq("main"));
-  tokens.pop_front();
-  auto a_token = std::move(tokens.front());
-  EXPECT_THAT(a_token->type(), Eq(TokenType::IDENTIFIER));
-  EXPECT_THAT(a_token->to_string(), StrEq("a"));
-  tokens.pop_front();
-  auto b_token = std::move(tokens.front());
-  EXPECT_THAT(b_token->type(), Eq(TokenType::IDENTIFIER));
-  EXPECT_THAT(b_token->to_string(), StrEq("b"));
-  tokens.pop_front();
-  auto assign_token = std::move(tokens.front());
-  EXPECT_THAT(assign_token->type(), Eq(TokenType::OPERATOR));
-  EXPECT_THAT(assign_token->to_string(), StrEq("assign-operator"));
-  tokens.pop_front();
-  auto second_a_token = std::move(tokens.front());
-  EXPECT_THAT(second_a_token->type(), Eq(TokenType::IDENTIFIER));
-  EXPECT_THAT(second_a_token->to_string(), StrEq("a"));
-  tokens.pop_front();
-  auto plus_token = std::move(tokens.front());
-  EXPECT_THAT(plus_token->type(), Eq(TokenType::OPERATOR));
-  EXPECT_THAT(plus_token->to_string(), StrEq("plus-operator"));
-  tokens.pop_front();
-  auto second_b_token = std::move(tokens.front());
-  EXPECT_THAT(second_b_token->type(), Eq(TokenType::IDENTIFIER));
-  EXPECT_THAT(second_b_token->to_string(), StrEq("b"));
-  tokens.pop_front();
-  auto end_token = std::move(tokens.front());
-  EXPECT_THAT(end_token->type(), Eq(TokenType::KEYWORD));
-  EXPECT_THAT(end_token->to_string(), StrEq("end-keyword"));
+  const Token& let_token = tokens[0];
+  EXPECT_THAT(let_token.type, Eq(TokenType::KEYWORD));
+  EXPECT_THAT(tokens.to_string(let_token), StrEq("let-keyword"));
+  const Token& main_token = tokens[1];
+  EXPECT_THAT(main_token.type, Eq(TokenType::IDENTIFIER));
+  EXPECT_THAT(tokens.to_string(main_token), StrEq("main"));
+  const Token& a_token = tokens[2];
+  EXPECT_THAT(a_token.type, Eq(TokenType::IDENTIFIER));
+  EXPECT_THAT(tokens.to_string(a_token), StrEq("a"));
+  const Token& b_token = tokens[3];
+  EXPECT_THAT(b_token.type, Eq(TokenType::IDENTIFIER));
+  EXPECT_THAT(tokens.to_string(b_token), StrEq("b"));
+  const Token& assign_token = tokens[4];
+  EXPECT_THAT(assign_token.type, Eq(TokenType::OPERATOR));
+  EXPECT_THAT(tokens.to_string(assign_token), StrEq("assign-operator"));
+  const Token& second_a_token = tokens[5];
+  EXPECT_THAT(second_a_token.type, Eq(TokenType::IDENTIFIER));
+  EXPECT_THAT(tokens.to_string(second_a_token), StrEq("a"));
+  const Token& plus_token = tokens[6];
+  EXPECT_THAT(plus_token.type, Eq(TokenType::OPERATOR));
+  EXPECT_THAT(tokens.to_string(plus_token), StrEq("plus-operator"));
+  const Token& second_b_token = tokens[7];
+  EXPECT_THAT(second_b_token.type, Eq(TokenType::IDENTIFIER));
+  EXPECT_THAT(tokens.to_string(second_b_token), StrEq("b"));
+  EXPECT_THAT(second_a_token.value, Eq(a_token.value));
+  EXPECT_THAT(second_b_token.value, Eq(b_token.value));
+  const Token& end_token = tokens[8];
+  EXPECT_THAT(end_token.type, Eq(TokenType::KEYWORD));
+  EXPECT_THAT(tokens.to_string(end_token), StrEq("end-keyword"));
+}
+
+TEST_F(LexerTest, LocatesTokensFromOffsets) {
+  Lexer lexer("examples/factorial_loop.sl");
+  ASSERT_TRUE(lexer.scan());
+  auto& tokens = lexer.tokens();
+  ASSERT_THAT(tokens.size(), Eq(35));
+  const Token& loop_token = tokens[5];
+  ASSERT_TRUE(loop_token.is(Keyword::LOOP));
+  EXPECT_THAT(loop_token.offset, Eq(16));
+  EXPECT_THAT(tokens.location(loop_token),
+              StrEq(" in file:\"examples/factorial_loop.sl\"\ton line:2\tat "
+                    "position:3"));
+  const Token& i_token = tokens[10];
+  EXPECT_THAT(tokens.name(i_token), StrEq("i"));
+  EXPECT_THAT(tokens.line(i_token), Eq(3));
+  EXPECT_THAT(tokens.position(i_token), Eq(8));
+}
+
+TEST_F(LexerTest, SharesSymbolTable) {
+  auto symbols = std::make_shared<SymbolTable>();
+  Lexer first("examples/add.sl", symbols);
+  Lexer second("examples/factorial_loop.sl", symbols);
+  ASSERT_TRUE(first.scan());
+  ASSERT_TRUE(second.scan());
+  EXPECT_THAT(first.tokens().name(first.tokens()[2]), StrEq("a"));
+  EXPECT_THAT(symbols->intern("main"), Eq(first.tokens()[1].value));
+  EXPECT_THAT(symbols->intern("acc"), Eq(second.tokens()[6].value));
+}
+
+TEST_F(LexerTest, ScansSourceInMemory) {
+  Lexer lexer("<memory>");
+  ASSERT_TRUE(lexer.scan("let x_1 = 12345678901 in\n  x_1 == 3 end"));
+  auto& tokens = lexer.tokens();
+  ASSERT_THAT(tokens.size(), Eq(9));
+  EXPECT_TRUE(tokens[0].is(Keyword::LET));
+  EXPECT_THAT(tokens.name(tokens[1]), StrEq("x_1"));
+  EXPECT_THAT(tokens.integer(tokens[3]), Eq(12345678901));
+  EXPECT_THAT(tokens[5].value, Eq(tokens[1].value));
+  EXPECT_TRUE(tokens[6].is(Operator::EQUALS));
+  EXPECT_THAT(tokens.location(tokens[5]),
+              StrEq(" in file:\"<memory>\"\ton line:2\tat position:3"));
+}
+
+TEST_F(LexerTest, MatchesFileScan) {
+  std::ifstream file("examples/factorial_loop.sl");
+  std::string source((std::istreambuf_iterator<char>(file)),
+                     std::istreambuf_iterator<char>());
+  Lexer from_file("examples/factorial_loop.sl");
+  Lexer from_memory("examples/factorial_loop.sl");
+  ASSERT_TRUE(from_file.scan());
+  ASSERT_TRUE(from_memory.scan(source));
+  auto& expected = from_file.tokens();
+  auto& actual = from_memory.tokens();
+  ASSERT_THAT(actual.size(), Eq(expected.size()));
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_THAT(actual.to_string(actual[i]),
+                StrEq(expected.to_string(expected[i])));
+    EXPECT_THAT(actual.location(actual[i]),
+                StrEq(expected.location(expected[i])));
+  }
+}
+
+TEST_F(LexerTest, RejectsIncompleteOperatorAtEnd) {
+  Lexer lexer("<memory>");
+  EXPECT_FALSE(lexer.scan("a &"));
+  Lexer empty("<memory>");
+  EXPECT_TRUE(empty.scan(""));
+  EXPECT_THAT(empty.tokens().size(), Eq(0));
+}
+
+TEST_F(LexerTest, EndsOperatorsWhereTheNextTokenStarts) {
+  Lexer lexer("<memory>");
+  ASSERT_TRUE(lexer.scan("a=b==_c="));
+  auto& tokens = lexer.tokens();
+  ASSERT_THAT(tokens.size(), Eq(6));
+  EXPECT_TRUE(tokens[1].is(Operator::ASSIGN));
+  EXPECT_TRUE(tokens[3].is(Operator::EQUALS));
+  EXPECT_THAT(tokens.to_string(tokens[4]), StrEq("_c"));
+  EXPECT_TRUE(tokens[5].is(Operator::ASSIGN));
+  Lexer digit("<memory>");
+  EXPECT_FALSE(digit.scan("_1"));
+}
+
+// Every scanner the host supports, widest first.
+std::vector<const CharScanner*> available_scanners() {
+  std::vector<const CharScanner*> scanners;
+  for (const CharScanner* scanner :
+       {CharScanner::avx2(), CharScanner::sse2(), &CharScanner::scalar()}) {
+    if (scanner) {
+      scanners.push_back(scanner);
+    }
+  }
+  return scanners;
+}
+
+TEST_F(LexerTest, ScannersFindTheSameRuns) {
+  // Runs of every class and length around the 16 and 32 byte blocks, with
+  // bytes that are easy to misclassify: '@' and '[' next to the letters, '/'
+  // and ':' next to the digits, '\n' among the blanks and bytes above 0x7f.
+  std::string text;
+  const std::string pieces[] = {"a", "Z_9", " \t\r\v\f", "0123456789",
+                                "@", "[", "`", "{", "/", ":", "\n", "\xc3\xa9"};
+  for (int i = 0; i < 400; ++i) {
+    const std::string& piece = pieces[(i * 7 + i / 5) % std::size(pieces)];
+    for (int repeat = 0; repeat <= i % 37; ++repeat) {
+      text += piece;
+    }
+  }
+  const char* end = text.data() + text.size();
+  const CharScanner& reference = CharScanner::scalar();
+  for (const CharScanner* scanner : available_scanners()) {
+    for (const char* p = text.data(); p < end; ++p) {
+      ASSERT_EQ(scanner->skip_blanks(p, end), reference.skip_blanks(p, end))
+          << scanner->name << " at " << p - text.data();
+      ASSERT_EQ(scanner->skip_digits(p, end), reference.skip_digits(p, end))
+          << scanner->name << " at " << p - text.data();
+      ASSERT_EQ(scanner->skip_word(p, end), reference.skip_word(p, end))
+          << scanner->name << " at " << p - text.data();
+    }
+  }
+}
+
+TEST_F(LexerTest, ScannersProduceTheSameTokens) {
+  std::string source =
+      "let long_identifier_with_more_than_thirty_two_characters = "
+      "12345678901234567890123 in\n"
+      "    \t  loop acc = 1 and i = 2 in if acc < 100000 && !(i == 7) then "
+      "recur (acc * i) (i + 1) else -acc end end end";
+  Lexer reference("<memory>");
+  reference.set_scanner(CharScanner::scalar());
+  ASSERT_FALSE(reference.scan(source));  // the literal overflows
+  source.erase(source.find("4567890123 in"), 10);
+  Lexer expected("<memory>");
+  expected.set_scanner(CharScanner::scalar());
+  ASSERT_TRUE(expected.scan(source));
+  for (const CharScanner* scanner : available_scanners()) {
+    Lexer lexer("<memory>");
+    lexer.set_scanner(*scanner);
+    ASSERT_TRUE(lexer.scan(source));
+    auto& tokens = lexer.tokens();
+    ASSERT_THAT(tokens.size(), Eq(expected.tokens().size())) << scanner->name;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+      EXPECT_THAT(tokens.to_string(tokens[i]),
+                  StrEq(expected.tokens().to_string(expected.tokens()[i])));
+      EXPECT_THAT(tokens[i].offset, Eq(expected.tokens()[i].offset));
+    }
+  }
+}
+
+TEST_F(LexerTest, StreamsTheSameTokens) {
+  Lexer lexer("examples/factorial_loop.sl");
+  ASSERT_TRUE(lexer.scan());
+  auto& expected = lexer.tokens();
+  StreamingLexer stream("examples/factorial_loop.sl");
+  ASSERT_TRUE(stream.open());
+  for (const Token& token : expected) {
+    const Token* streamed = stream.peek();
+    ASSERT_NE(streamed, nullptr);
+    EXPECT_THAT(stream.to_string(), StrEq(expected.to_string(token)));
+    EXPECT_THAT(streamed->offset, Eq(token.offset));
+    EXPECT_THAT(stream.line(), Eq(expected.line(token)));
+    EXPECT_THAT(stream.position(), Eq(expected.position(token)));
+    stream.advance();
+  }
+  EXPECT_EQ(stream.peek(), nullptr);
+  EXPECT_TRUE(stream.ok());
+  EXPECT_THAT(stream.consumed(), Eq(expected.size()));
+}
+
+TEST_F(LexerTest, StreamLooksAheadWithoutConsuming) {
+  StreamingLexer stream("<memory>");
+  std::string source = "let a = 12345678901 and b = a in a + b end";
+  stream.open(source);
+  ASSERT_NE(stream.peek(3), nullptr);
+  EXPECT_THAT(stream.to_string(3), StrEq("12345678901"));
+  EXPECT_THAT(stream.integer(3), Eq(12345678901));
+  EXPECT_TRUE(stream.peek(0)->is(Keyword::LET));
+  EXPECT_EQ(stream.peek(StreamingLexer::kLookahead), nullptr);
+  // Consume past the lookahead; lookahead keeps working.
+  for (int i = 0; i < 9; ++i) {
+    stream.advance();
+  }
+  EXPECT_THAT(stream.to_string(0), StrEq("a"));
+  EXPECT_THAT(stream.to_string(2), StrEq("b"));
+  EXPECT_TRUE(stream.peek(3)->is(Keyword::END));
+  EXPECT_EQ(stream.peek(4), nullptr);
+  EXPECT_THAT(stream.position(3), Eq(40));
+}
+
+TEST_F(LexerTest, StreamLooksAsFarAheadAsAllowedOnEveryToken) {
+  std::string source;
+  for (int i = 0; i < 100; ++i) {
+    source += "a" + std::to_string(i) + " + " + std::to_string(i) + "\n";
+  }
+  Lexer lexer("<memory>");
+  ASSERT_TRUE(lexer.scan(source));
+  auto& expected = lexer.tokens();
+  StreamingLexer stream("<memory>");
+  stream.open(source);
+  constexpr size_t kFarthest = StreamingLexer::kLookahead - 1;
+  for (size_t i = 0; i < expected.size(); ++i) {
+    const Token* far = stream.peek(kFarthest);
+    if (i + kFarthest < expected.size()) {
+      ASSERT_NE(far, nullptr);
+      EXPECT_THAT(far->offset, Eq(expected[i + kFarthest].offset));
+      EXPECT_THAT(stream.line(kFarthest),
+                  Eq(expected.line(expected[i + kFarthest])));
+    } else {
+      EXPECT_EQ(far, nullptr);
+    }
+    EXPECT_THAT(stream.to_string(), StrEq(expected.to_string(expected[i])));
+    stream.advance();
+  }
+  EXPECT_EQ(stream.peek(), nullptr);
+  EXPECT_THAT(stream.consumed(), Eq(expected.size()));
+}
+
+TEST_F(LexerTest, StreamStopsAtMalformedInput) {
+  StreamingLexer stream("<memory>");
+  stream.open("a + b | c");
+  ASSERT_NE(stream.peek(2), nullptr);
+  EXPECT_TRUE(stream.ok());
+  EXPECT_EQ(stream.peek(3), nullptr);
+  EXPECT_FALSE(stream.ok());
+  StreamingLexer missing("non_existent_file.sl");
+  EXPECT_FALSE(missing.open());
+  EXPECT_EQ(missing.peek(), nullptr);
+  EXPECT_FALSE(missing.ok());
 }
 
 TEST_F(LexerTest, ShiftL) {
@@ -264,13 +488,12 @@ TEST_F(LexerTest, NotExpression) {
   ASSERT_TRUE(success);
   auto& tokens = lexer.tokens();
   ASSERT_THAT(tokens.size(), Eq(2));
-  auto not_token = std::move(tokens.front());
-  EXPECT_THAT(not_token->type(), Eq(TokenType::OPERATOR));
-  EXPECT_THAT(not_token->to_string(), StrEq("not-operator"));
-  tokens.pop_front();
-  auto integer_token = std::move(tokens.front());
-  EXPECT_THAT(integer_token->type(), Eq(TokenType::INTEGER));
-  EXPECT_THAT(integer_token->to_string(), StrEq("1"));
+  const Token& not_token = tokens[0];
+  EXPECT_THAT(not_token.type, Eq(TokenType::OPERATOR));
+  EXPECT_THAT(tokens.to_string(not_token), StrEq("not-operator"));
+  const Token& integer_token = tokens[1];
+  EXPECT_THAT(integer_token.type, Eq(TokenType::INTEGER));
+  EXPECT_THAT(tokens.to_string(integer_token), StrEq("1"));
 }
 
 }  // namespace
@@ -0,0 +1,77 @@
+#include "source_buffer.h"
+
+#include <cerrno>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SIMP_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define SIMP_HAS_MMAP 0
+#include <fstream>
+#include <sstream>
+#endif
+
+namespace simp {
+
+#if SIMP_HAS_MMAP
+
+SourceBuffer::~SourceBuffer() {
+  if (mapping_) {
+    munmap(mapping_, mapped_size_);
+  }
+}
+
+bool SourceBuffer::map(const std::string& file_name) {
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG(ERROR) << "Unable to open " << file_name << ": " << strerror(errno);
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    LOG(ERROR) << "Unable to stat " << file_name << ": " << strerror(errno);
+    close(fd);
+    return false;
+  }
+  size_t size = status.st_size;
+  // An empty file cannot be mapped, and has nothing to map anyway.
+  if (size > 0) {
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      LOG(ERROR) << "Unable to map " << file_name << ": " << strerror(errno);
+      close(fd);
+      return false;
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    mapping_ = mapping;
+    mapped_size_ = size;
+    text_ = std::string_view(static_cast<const char*>(mapping), size);
+  }
+  close(fd);
+  return true;
+}
+
+#else
+
+SourceBuffer::~SourceBuffer() {}
+
+bool SourceBuffer::map(const std::string& file_name) {
+  std::ifstream file(file_name, std::ios::binary);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Unable to open " << file_name << ": " << strerror(errno);
+    return false;
+  }
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  contents_ = contents.str();
+  text_ = contents_;
+  return true;
+}
+
+#endif
+
+}  // namespace simp
@@ -0,0 +1,33 @@
+#pragma once
+
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <glog/logging.h>
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace simp {
+// The contiguous text a Lexer scans: a read-only mapping of a file, or a view
+// of memory that the caller owns and keeps alive.
+class SourceBuffer {
+ public:
+  SourceBuffer() {}
+  explicit SourceBuffer(std::string_view text) : text_(text) {}
+  SourceBuffer(const SourceBuffer&) = delete;
+  SourceBuffer& operator=(const SourceBuffer&) = delete;
+  ~SourceBuffer();
+
+  // Maps the whole file. Returns false, after logging why, if it cannot.
+  bool map(const std::string& file_name);
+  std::string_view text() const { return text_; }
+
+ private:
+  void* mapping_ = nullptr;
+  size_t mapped_size_ = 0;
+  // Holds the file on hosts without mmap.
+  std::string contents_;
+  std::string_view text_;
+};
+}  // namespace simp
@@ -0,0 +1,145 @@
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+
+#include "lexer/lexer.h"
+#include "lexer/streaming_lexer.h"
+
+DEFINE_string(file, "",
+              "Program to scan; a program is generated when empty");
+DEFINE_int32(megabytes, 256, "Size of the generated program");
+
+// Every allocation carries its size in front so that the live and the peak
+// heap can be tracked without depending on the allocator.
+namespace {
+std::atomic<int64_t> live_bytes{0};
+std::atomic<int64_t> peak_bytes{0};
+constexpr size_t kHeader = alignof(std::max_align_t);
+}  // namespace
+
+void* operator new(size_t size) {
+  char* memory = static_cast<char*>(std::malloc(size + kHeader));
+  if (!memory) {
+    throw std::bad_alloc();
+  }
+  *reinterpret_cast<size_t*>(memory) = size;
+  int64_t live = live_bytes += size;
+  int64_t peak = peak_bytes;
+  while (live > peak && !peak_bytes.compare_exchange_weak(peak, live)) {
+  }
+  return memory + kHeader;
+}
+
+void operator delete(void* pointer) noexcept {
+  if (!pointer) {
+    return;
+  }
+  char* memory = static_cast<char*>(pointer) - kHeader;
+  live_bytes -= *reinterpret_cast<size_t*>(memory);
+  std::free(memory);
+}
+
+void operator delete(void* pointer, size_t) noexcept { operator delete(pointer); }
+
+namespace simp {
+namespace {
+// Lets and loops over a fixed set of names, so the symbol table stays small
+// and the token buffer is what grows with the file.
+void generate(size_t size, std::ofstream& out) {
+  size_t written = 0;
+  for (int i = 0; written < size; ++i) {
+    std::string n = std::to_string(i % 1000);
+    std::string chunk =
+        "let value_" + n + " = " + n + " * (a + b) and\n" +
+        "    flag_" + n + " = !(value_" + n + " < 1000) || c == " + n +
+        " in\n  loop acc = 1 and i = 2 in\n    if flag_" + n +
+        " && i < value_" + n +
+        " then recur (acc * i) (i + 1) else -acc end\n  end\nend\n";
+    out << chunk;
+    written += chunk.size();
+  }
+}
+
+struct Measurement {
+  uint64_t tokens = 0;
+  int64_t peak_bytes = 0;
+  double seconds = 0;
+};
+
+// Runs scan, which returns the number of tokens it saw, and records the
+// highest heap use above what was live before it started.
+template <typename Scan>
+Measurement measure(Scan scan) {
+  int64_t before = live_bytes;
+  peak_bytes = before;
+  auto start = std::chrono::steady_clock::now();
+  Measurement measurement;
+  measurement.tokens = scan();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  measurement.seconds = elapsed.count();
+  measurement.peak_bytes = peak_bytes - before;
+  return measurement;
+}
+
+void report(const std::string& name, const Measurement& measurement) {
+  std::cout << std::fixed << std::setprecision(1) << name << ": "
+            << measurement.tokens << " tokens, peak heap "
+            << measurement.peak_bytes / 1024.0 << " KiB, "
+            << measurement.seconds << " s" << std::endl;
+}
+}  // namespace
+}  // namespace simp
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  std::string file = FLAGS_file;
+  if (file.empty()) {
+    file = (std::filesystem::temp_directory_path() / "streaming_benchmark.sl")
+               .string();
+    std::ofstream out(file);
+    simp::generate(static_cast<size_t>(FLAGS_megabytes) << 20, out);
+  }
+  std::cerr << "Scanning " << std::filesystem::file_size(file) << " bytes of "
+            << file << std::endl;
+
+  // Both sides map the file; the mapping is page cache, not heap.
+  simp::Measurement scanned = simp::measure([&]() -> uint64_t {
+    simp::Lexer lexer(file);
+    if (!lexer.scan()) {
+      return 0;
+    }
+    return lexer.tokens().size();
+  });
+  simp::Measurement streamed = simp::measure([&]() -> uint64_t {
+    simp::StreamingLexer lexer(file);
+    if (!lexer.open()) {
+      return 0;
+    }
+    while (lexer.peek()) {
+      lexer.advance();
+    }
+    return lexer.ok() ? lexer.consumed() : 0;
+  });
+  if (scanned.tokens == 0 || scanned.tokens != streamed.tokens) {
+    LOG(ERROR) << "Lexers disagree: " << scanned.tokens << " and "
+               << streamed.tokens << " tokens";
+    return 1;
+  }
+  simp::report("scan whole file", scanned);
+  simp::report("stream", streamed);
+  return 0;
+}
@@ -0,0 +1,52 @@
+#include "streaming_lexer.h"
+
+#include <algorithm>
+
+namespace simp {
+
+bool StreamingLexer::open() {
+  if (!buffer_.map(file_name_)) {
+    failed_ = true;
+    return false;
+  }
+  open(buffer_.text());
+  return true;
+}
+
+void StreamingLexer::open(std::string_view source) {
+  scanner_.emplace(source, *chars_);
+  next_ = end_ = tokens_;
+  dropped_ = 0;
+  line_ = 1;
+  line_start_ = 0;
+  failed_ = scanner_->failed();
+}
+
+void StreamingLexer::compact() {
+  size_t consumed = next_ - tokens_;
+  size_t pending = end_ - next_;
+  std::copy(tokens_ + consumed, tokens_ + consumed + pending, tokens_);
+  std::copy(extras_ + consumed, extras_ + consumed + pending, extras_);
+  dropped_ += consumed;
+  next_ = tokens_;
+  end_ = tokens_ + pending;
+}
+
+bool StreamingLexer::fill(size_t k) {
+  if (k >= kLookahead) {
+    LOG(ERROR) << "Cannot look " << k << " tokens ahead";
+    return false;
+  }
+  if (next_ + kLookahead > tokens_ + kCapacity) {
+    compact();
+  }
+  while (static_cast<size_t>(end_ - next_) <= k) {
+    if (!scanner_ || !scanner_->next(*this)) {
+      failed_ = failed_ || (scanner_ && scanner_->failed());
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace simp
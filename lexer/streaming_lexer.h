@@ -0,0 +1,121 @@
+#pragma once
+
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <glog/logging.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "lexer/char_scanner.h"
+#include "lexer/source_buffer.h"
+#include "lexer/token_scanner.h"
+#include "tokens/symbol_table.h"
+#include "tokens/token_source.h"
+#include "tokens/tokens.h"
+
+namespace simp {
+// A lexer the parser pulls tokens from. Tokens are scanned only as far as
+// the parser looks ahead and are kept in a fixed buffer, so memory does not
+// grow with the size of the input; only the symbol table does, with the
+// number of distinct names.
+class StreamingLexer : public TokenSource {
+ public:
+  // How far ahead peek can look.
+  static constexpr size_t kLookahead = 16;
+
+  // Names are interned into symbols, or into a table of the lexer's own.
+  StreamingLexer(const std::string& file_name,
+                 std::shared_ptr<SymbolTable> symbols = nullptr)
+      : file_name_(file_name),
+        symbols_(symbols ? std::move(symbols)
+                         : std::make_shared<SymbolTable>()) {
+    next_ = end_ = tokens_;
+  }
+  StreamingLexer(const StreamingLexer&) = delete;
+  StreamingLexer& operator=(const StreamingLexer&) = delete;
+
+  // Maps the file. Returns false, and produces no tokens, if it cannot.
+  bool open();
+  // Streams source, which must outlive the lexer.
+  void open(std::string_view source);
+  void set_scanner(const CharScanner& scanner) { chars_ = &scanner; }
+
+  const std::string& file_name() const override { return file_name_; }
+  SymbolTable& symbols() override { return *symbols_; }
+  bool ok() const override { return !failed_; }
+  // Tokens consumed so far.
+  uint64_t consumed() const { return dropped_ + (next_ - tokens_); }
+
+ protected:
+  // Scans until k + 1 tokens are buffered or the input ends.
+  bool fill(size_t k) override;
+  int64_t integer_of(const Token& token) override {
+    return extras_[&token - tokens_].integer;
+  }
+  int line_of(const Token& token) override {
+    return extras_[&token - tokens_].line;
+  }
+  int position_of(const Token& token) override {
+    return extras_[&token - tokens_].position;
+  }
+
+ private:
+  friend class TokenScanner;
+
+  // The buffer holds twice the lookahead, so the unconsumed tokens are moved
+  // back to its front at most once every kLookahead tokens.
+  static constexpr size_t kCapacity = 2 * kLookahead;
+
+  // What TokenStream would otherwise look up for a token, kept beside it.
+  struct Extra {
+    int64_t integer;
+    int32_t line;
+    int32_t position;
+  };
+
+  // Called by TokenScanner for each token, in the manner of TokenStream.
+  void add_operator(Operator op, uint32_t offset) {
+    push({TokenType::OPERATOR, op, 0, offset}, 0);
+  }
+  void add_keyword(Keyword keyword, uint32_t offset) {
+    push({TokenType::KEYWORD, static_cast<uint8_t>(keyword), 0, offset}, 0);
+  }
+  void add_identifier(std::string_view name, uint32_t offset) {
+    push({TokenType::IDENTIFIER, 0, symbols_->intern(name), offset}, 0);
+  }
+  void add_integer(int64_t value, uint32_t offset) {
+    push({TokenType::INTEGER, 0, 0, offset}, value);
+  }
+  void add_line(uint32_t offset) {
+    line_++;
+    line_start_ = offset;
+  }
+  void push(Token token, int64_t integer) {
+    size_t index = end_ - tokens_;
+    tokens_[index] = token;
+    extras_[index] = {integer, line_,
+                      static_cast<int32_t>(token.offset - line_start_ + 1)};
+    end_++;
+  }
+  // Moves the unconsumed tokens to the front of the buffer.
+  void compact();
+
+  const std::string file_name_;
+  std::shared_ptr<SymbolTable> symbols_;
+  const CharScanner* chars_ = &CharScanner::best();
+  SourceBuffer buffer_;
+  std::optional<TokenScanner> scanner_;
+  Token tokens_[kCapacity];
+  Extra extras_[kCapacity];
+  // Tokens consumed before the last compaction.
+  uint64_t dropped_ = 0;
+  int32_t line_ = 1;
+  uint32_t line_start_ = 0;
+  bool failed_ = false;
+};
+}  // namespace simp
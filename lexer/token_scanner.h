@@ -0,0 +1,139 @@
+#pragma once
+
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <glog/logging.h>
+
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+
+#include "lexer/char_scanner.h"
+#include "lexer/lexer_table.h"
+#include "tokens/tokens.h"
+#include "trace/trace.h"
+
+namespace simp {
+// A scan over one contiguous source that advances a token at a time, driven
+// by the DFA tables in lexer_table.h. Lexer
+// drains it into a TokenStream; StreamingLexer pulls from it only as far as
+// the parser looks ahead.
+//
+// A Sink receives what is found through the same calls that build a
+// TokenStream: add_operator, add_keyword, add_identifier, add_integer and
+// add_line.
+class TokenScanner {
+ public:
+  TokenScanner(std::string_view source, const CharScanner& chars)
+      : begin_(source.data()),
+        end_(source.data() + source.size()),
+        p_(begin_),
+        line_start_(begin_),
+        chars_(chars) {
+    if (source.size() > std::numeric_limits<uint32_t>::max()) {
+      LOG(ERROR) << "Source is too large to scan";
+      failed_ = true;
+    }
+  }
+
+  // Scans up to and including the next token and passes it, and any lines
+  // that start before it, to sink. Returns false once the source is
+  // exhausted or malformed; failed() tells which.
+  template <typename Sink>
+  bool next(Sink& sink);
+  bool failed() const { return failed_; }
+
+ private:
+  uint32_t offset(const char* at) const { return at - begin_; }
+  bool fail() {
+    failed_ = true;
+    return false;
+  }
+
+  const char* begin_;
+  const char* end_;
+  const char* p_;
+  int line_ = 1;
+  const char* line_start_;
+  const CharScanner& chars_;
+  bool failed_ = false;
+};
+
+template <typename Sink>
+bool TokenScanner::next(Sink& sink) {
+  if (failed_) {
+    return false;
+  }
+  const char* p = p_;
+  const char* start = p;
+  LexState state = LexState::START;
+  // Every action that finds a token breaks out of the switch; the others
+  // continue with the next byte.
+  for (;;) {
+    CharClass c = p < end_ ? kCharClasses[static_cast<unsigned char>(*p)]
+                           : CharClass::END_OF_INPUT;
+    const Transition& step = transition(state, c);
+    switch (step.action) {
+      case LexAction::SHIFT:
+        p++;
+        state = step.next;
+        continue;
+      case LexAction::SKIP:
+        start = ++p;
+        continue;
+      case LexAction::SKIP_BLANKS:
+        start = p = chars_.skip_blanks(p + 1, end_);
+        continue;
+      case LexAction::NEWLINE:
+        start = ++p;
+        line_++;
+        line_start_ = p;
+        sink.add_line(offset(p));
+        continue;
+      case LexAction::OPERATOR:
+        p++;
+        sink.add_operator(step.op, offset(start));
+        break;
+      case LexAction::OPERATOR_BEFORE:
+        sink.add_operator(step.op, offset(start));
+        break;
+      case LexAction::INTEGER: {
+        p = chars_.skip_digits(p + 1, end_);
+        int64_t value;
+        auto [last, error] = std::from_chars(start, p, value);
+        if (error != std::errc()) {
+          LOG(ERROR) << "Integer literal out of range at line:" << line_
+                     << " at position:" << start - line_start_ + 1;
+          return fail();
+        }
+        sink.add_integer(value, offset(start));
+        break;
+      }
+      case LexAction::WORD: {
+        p = chars_.skip_word(p + 1, end_);
+        // The word is a slice of the source; only a name the symbol table
+        // has not seen before is copied.
+        std::string_view word(start, p - start);
+        Keyword keyword;
+        if (find_keyword(word, keyword)) {
+          sink.add_keyword(keyword, offset(start));
+        } else {
+          sink.add_identifier(word, offset(start));
+        }
+        break;
+      }
+      case LexAction::ERROR:
+        LOG(ERROR) << step.error << " at line:" << line_
+                   << " at position:" << start - line_start_ + 1;
+        return fail();
+      case LexAction::DONE:
+        p_ = p;
+        return false;
+    }
+    SIMP_TRACE(LEXER, "token", offset(start));
+    p_ = p;
+    return true;
+  }
+}
+}  // namespace simp
@@ -0,0 +1,109 @@
+#include "memo_cache.h"
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+namespace simp {
+
+MemoCache::MemoCache(std::vector<bool> memoized, size_t capacity)
+    : memoized_(std::move(memoized)),
+      mask_(std::bit_ceil(std::max(capacity, kProbes)) - 1),
+      entries_(std::make_unique<Entry[]>(mask_ + 1)),
+      counters_(memoized_.size()) {}
+
+uint64_t MemoCache::hash(uint32_t function, const int64_t* arguments,
+                         size_t count) {
+  // The splitmix64 finalizer, folded over the key.
+  uint64_t hash = function;
+  for (size_t i = 0; i < count; ++i) {
+    hash = (hash ^ static_cast<uint64_t>(arguments[i])) * 0x9e3779b97f4a7c15;
+    hash ^= hash >> 31;
+  }
+  hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9;
+  hash = (hash ^ (hash >> 27)) * 0x94d049bb133111eb;
+  return hash ^ (hash >> 31);
+}
+
+bool MemoCache::read(const Entry& entry, uint64_t tag,
+                     const int64_t* arguments, size_t count,
+                     int64_t& result) {
+  uint64_t sequence = entry.sequence.load(std::memory_order_acquire);
+  if (sequence & 1 || entry.tag.load(std::memory_order_relaxed) != tag) {
+    return false;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    if (entry.arguments[i].load(std::memory_order_relaxed) != arguments[i]) {
+      return false;
+    }
+  }
+  int64_t value = entry.result.load(std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (entry.sequence.load(std::memory_order_relaxed) != sequence) {
+    return false;
+  }
+  result = value;
+  return true;
+}
+
+bool MemoCache::lookup(uint32_t function, const int64_t* arguments,
+                       size_t count, int64_t& result) {
+  uint64_t key = tag(function, count);
+  size_t home = hash(function, arguments, count);
+  for (size_t i = 0; i < kProbes; ++i) {
+    Entry& entry = entries_[(home + i) & mask_];
+    if (read(entry, key, arguments, count, result)) {
+      // Only written when it changes, so hot entries stay shared in the
+      // readers' caches.
+      if (!entry.referenced.load(std::memory_order_relaxed)) {
+        entry.referenced.store(1, std::memory_order_relaxed);
+      }
+      counters_[function].hits.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  counters_[function].misses.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+void MemoCache::insert(uint32_t function, const int64_t* arguments,
+                       size_t count, int64_t result) {
+  uint64_t key = tag(function, count);
+  size_t home = hash(function, arguments, count);
+  Entry* victim = nullptr;
+  for (size_t i = 0; i < kProbes && !victim; ++i) {
+    Entry& entry = entries_[(home + i) & mask_];
+    int64_t existing;
+    if (entry.tag.load(std::memory_order_relaxed) == 0 ||
+        read(entry, key, arguments, count, existing)) {
+      victim = &entry;
+    }
+  }
+  for (size_t i = 0; i < kProbes && !victim; ++i) {
+    Entry& entry = entries_[(home + i) & mask_];
+    if (entry.referenced.exchange(0, std::memory_order_relaxed) == 0) {
+      victim = &entry;
+    }
+  }
+  if (!victim) {
+    victim = &entries_[home & mask_];
+  }
+  uint64_t sequence = victim->sequence.load(std::memory_order_relaxed);
+  if (sequence & 1 ||
+      !victim->sequence.compare_exchange_strong(
+          sequence, sequence + 1, std::memory_order_acquire,
+          std::memory_order_relaxed)) {
+    return;
+  }
+  // Keeps the stores below from being seen before the odd sequence number.
+  std::atomic_thread_fence(std::memory_order_release);
+  victim->tag.store(key, std::memory_order_relaxed);
+  for (size_t i = 0; i < count; ++i) {
+    victim->arguments[i].store(arguments[i], std::memory_order_relaxed);
+  }
+  victim->result.store(result, std::memory_order_relaxed);
+  victim->referenced.store(0, std::memory_order_relaxed);
+  victim->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+}  // namespace simp
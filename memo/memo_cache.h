@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace simp {
+// Results of calls to pure functions, keyed by the callee's index and the
+// argument values. Only the functions marked memoized are ever looked up.
+//
+// The table is bounded and shared: any number of threads may look up and
+// insert at once without taking a lock. Each entry is guarded by a sequence
+// number that is odd while a writer fills it in. A reader that sees it odd, or
+// changed across its read, treats the entry as a miss, and a writer that finds
+// another writer on its entry drops its result. Either way the call is just
+// evaluated again, so a lost race costs time, never a wrong result.
+//
+// A key may sit in any of kProbes entries from where it hashes to. When all of
+// them are taken, an insert evicts by CLOCK: a hit marks its entry referenced,
+// and the insert replaces the first unreferenced entry, clearing the marks it
+// passes over, or the first entry when every one was marked.
+class MemoCache {
+ public:
+  // Functions with more parameters are not memoized.
+  static constexpr size_t kMaxArguments = 4;
+  static constexpr size_t kDefaultCapacity = 1 << 16;
+  static constexpr size_t kProbes = 4;
+
+  // memoized has one flag per function of the program, and may only flag
+  // functions of at most kMaxArguments parameters. The capacity is rounded up
+  // to a power of two.
+  explicit MemoCache(std::vector<bool> memoized,
+                     size_t capacity = kDefaultCapacity);
+
+  bool memoized(size_t function) const {
+    return function < memoized_.size() && memoized_[function];
+  }
+  size_t capacity() const { return mask_ + 1; }
+
+  // Sets result and returns true if the call is in the table. Counts a hit or
+  // a miss for function either way.
+  bool lookup(uint32_t function, const int64_t* arguments, size_t count,
+              int64_t& result);
+  void insert(uint32_t function, const int64_t* arguments, size_t count,
+              int64_t result);
+
+  uint64_t hits(size_t function) const {
+    return counters_[function].hits.load(std::memory_order_relaxed);
+  }
+  uint64_t misses(size_t function) const {
+    return counters_[function].misses.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // One cache line, so that writers to neighbouring entries do not contend.
+  struct alignas(64) Entry {
+    std::atomic<uint64_t> sequence{0};
+    // The callee's index plus one in the high half and the argument count in
+    // the low half; 0 while the entry is empty.
+    std::atomic<uint64_t> tag{0};
+    std::atomic<int64_t> arguments[kMaxArguments];
+    std::atomic<int64_t> result{0};
+    std::atomic<uint64_t> referenced{0};
+  };
+  struct alignas(64) Counters {
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+  };
+
+  static uint64_t tag(uint32_t function, size_t count) {
+    return (static_cast<uint64_t>(function) + 1) << 32 | count;
+  }
+  static uint64_t hash(uint32_t function, const int64_t* arguments,
+                       size_t count);
+  // Whether entry holds the key, read consistently; sets result if so.
+  static bool read(const Entry& entry, uint64_t tag, const int64_t* arguments,
+                   size_t count, int64_t& result);
+
+  std::vector<bool> memoized_;
+  size_t mask_;
+  std::unique_ptr<Entry[]> entries_;
+  std::vector<Counters> counters_;
+};
+}  // namespace simp
@@ -0,0 +1,96 @@
+#include "memo/memo_cache.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <thread>
+
+namespace simp {
+namespace {
+using ::testing::Eq;
+using ::testing::Gt;
+using ::testing::Le;
+class MemoCacheTest : public ::testing::Test {
+ protected:
+  MemoCacheTest() {}
+  ~MemoCacheTest() override {}
+  void SetUp() override {}
+};
+
+TEST_F(MemoCacheTest, FindsWhatWasInserted) {
+  MemoCache cache({true, true});
+  int64_t arguments[] = {3, -4};
+  int64_t result = 0;
+  EXPECT_FALSE(cache.lookup(0, arguments, 2, result));
+  cache.insert(0, arguments, 2, 42);
+  ASSERT_TRUE(cache.lookup(0, arguments, 2, result));
+  EXPECT_THAT(result, Eq(42));
+  // Neither another function nor a prefix of the arguments matches.
+  EXPECT_FALSE(cache.lookup(1, arguments, 2, result));
+  EXPECT_FALSE(cache.lookup(0, arguments, 1, result));
+  EXPECT_THAT(cache.hits(0), Eq(1));
+  EXPECT_THAT(cache.misses(0), Eq(2));
+  EXPECT_THAT(cache.misses(1), Eq(1));
+}
+
+TEST_F(MemoCacheTest, StaysWithinItsCapacity) {
+  MemoCache cache({true}, 100);
+  EXPECT_THAT(cache.capacity(), Eq(128));
+  for (int64_t i = 0; i < 10000; ++i) {
+    cache.insert(0, &i, 1, i * i);
+  }
+  size_t found = 0;
+  for (int64_t i = 0; i < 10000; ++i) {
+    int64_t result;
+    if (cache.lookup(0, &i, 1, result)) {
+      EXPECT_THAT(result, Eq(i * i));
+      ++found;
+    }
+  }
+  EXPECT_THAT(found, Gt(0));
+  EXPECT_THAT(found, Le(cache.capacity()));
+}
+
+TEST_F(MemoCacheTest, KeepsReferencedEntries) {
+  MemoCache cache({true}, MemoCache::kProbes);
+  int64_t hot = 0;
+  int64_t result;
+  cache.insert(0, &hot, 1, 7);
+  // Every key competes for the same kProbes entries; the one looked up
+  // between inserts survives them.
+  for (int64_t i = 1; i < 100; ++i) {
+    ASSERT_TRUE(cache.lookup(0, &hot, 1, result)) << i;
+    cache.insert(0, &i, 1, i);
+  }
+  EXPECT_THAT(result, Eq(7));
+}
+
+TEST_F(MemoCacheTest, IsSharedAcrossThreads) {
+  MemoCache cache({true}, 1 << 10);
+  std::vector<std::thread> threads;
+  std::atomic<bool> wrong{false};
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&cache, &wrong]() {
+      for (int64_t i = 0; i < 100000; ++i) {
+        int64_t arguments[] = {i % 3000, -(i % 3000)};
+        int64_t result;
+        if (cache.lookup(0, arguments, 2, result)) {
+          if (result != 3 * arguments[0]) {
+            wrong = true;
+          }
+        } else {
+          cache.insert(0, arguments, 2, 3 * arguments[0]);
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_FALSE(wrong);
+  EXPECT_THAT(cache.hits(0) + cache.misses(0), Eq(8 * 100000));
+  EXPECT_THAT(cache.hits(0), Gt(0));
+}
+
+}  // namespace
+}  // namespace simp
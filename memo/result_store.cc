@@ -0,0 +1,213 @@
+#include "result_store.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+
+namespace simp {
+
+namespace {
+// "SIMPRES1"; bump the digit when the layout changes.
+constexpr uint64_t kMagic = 0x31534552504d4953;
+
+// The file is shared with other processes, so every field another process
+// may write concurrently is accessed atomically.
+template <typename T>
+T load(T& field, std::memory_order order = std::memory_order_relaxed) {
+  return std::atomic_ref<T>(field).load(order);
+}
+
+template <typename T>
+void store(T& field, T value,
+           std::memory_order order = std::memory_order_relaxed) {
+  std::atomic_ref<T>(field).store(value, order);
+}
+
+uint64_t tag(uint32_t function, size_t count) {
+  return (static_cast<uint64_t>(function) + 1) << 32 | count;
+}
+}  // namespace
+
+std::unique_ptr<ResultStore> ResultStore::open(const std::string& path,
+                                               uint64_t program,
+                                               size_t capacity) {
+  bool writable = true;
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    writable = false;
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  }
+  if (fd < 0) {
+    LOG(ERROR) << "Cannot open result store " << path << ": "
+               << std::strerror(errno);
+    return nullptr;
+  }
+  // Held until the file is closed.
+  if (writable && flock(fd, LOCK_EX | LOCK_NB) != 0) {
+    writable = false;
+  }
+  Header header = {};
+  struct stat status;
+  bool valid = fstat(fd, &status) == 0 &&
+               pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+               header.magic == kMagic && std::has_single_bit(header.capacity) &&
+               static_cast<size_t>(status.st_size) ==
+                   sizeof(Header) + header.capacity * sizeof(Entry);
+  if (!valid && !writable) {
+    LOG(ERROR) << "Result store " << path
+               << " is not initialized and another process is writing it";
+    close(fd);
+    return nullptr;
+  }
+  if (!valid) {
+    // Truncating first zeroes every entry.
+    header = {};
+    header.capacity = std::bit_ceil(std::max(capacity, kProbes));
+    header.program = program;
+    size_t size = sizeof(Header) + header.capacity * sizeof(Entry);
+    bool created = ftruncate(fd, 0) == 0 && ftruncate(fd, size) == 0 &&
+                   pwrite(fd, &header, sizeof(header), 0) == sizeof(header);
+    // The magic goes last, so a reader never takes a half-made file.
+    header.magic = kMagic;
+    if (!created ||
+        pwrite(fd, &header.magic, sizeof(header.magic), 0) !=
+            sizeof(header.magic)) {
+      LOG(ERROR) << "Cannot create result store " << path << ": "
+                 << std::strerror(errno);
+      close(fd);
+      return nullptr;
+    }
+  }
+  size_t size = sizeof(Header) + header.capacity * sizeof(Entry);
+  void* mapping = mmap(nullptr, size, PROT_READ | (writable ? PROT_WRITE : 0),
+                       MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    LOG(ERROR) << "Cannot map result store " << path << ": "
+               << std::strerror(errno);
+    close(fd);
+    return nullptr;
+  }
+  return std::unique_ptr<ResultStore>(
+      new ResultStore(fd, mapping, size, writable, program));
+}
+
+ResultStore::ResultStore(int fd, void* mapping, size_t size, bool writable,
+                         uint64_t program)
+    : fd_(fd),
+      mapping_(mapping),
+      size_(size),
+      writable_(writable),
+      program_(program),
+      header_(static_cast<Header*>(mapping)),
+      entries_(reinterpret_cast<Entry*>(header_ + 1)),
+      mask_(header_->capacity - 1) {
+  if (writable_ && load(header_->program) != program_) {
+    // Entries of another program never match anyway; clearing them only
+    // frees their places sooner.
+    for (size_t i = 0; i <= mask_; ++i) {
+      write(entries_[i], 0, 0, nullptr, 0, 0);
+    }
+    store(header_->program, program_);
+  }
+}
+
+ResultStore::~ResultStore() {
+  munmap(mapping_, size_);
+  close(fd_);
+}
+
+size_t ResultStore::home(uint32_t function, const int64_t* arguments,
+                         size_t count) const {
+  uint64_t hash = program_ ^ function;
+  for (size_t i = 0; i < count; ++i) {
+    hash = (hash ^ static_cast<uint64_t>(arguments[i])) * 0x9e3779b97f4a7c15;
+    hash ^= hash >> 31;
+  }
+  hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9;
+  hash = (hash ^ (hash >> 27)) * 0x94d049bb133111eb;
+  return (hash ^ (hash >> 31)) & mask_;
+}
+
+bool ResultStore::read(Entry& entry, uint64_t tag, const int64_t* arguments,
+                       size_t count, int64_t& result) {
+  uint64_t sequence = load(entry.sequence, std::memory_order_acquire);
+  if (sequence & 1 || load(entry.program) != program_ ||
+      load(entry.tag) != tag) {
+    return false;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    if (load(entry.arguments[i]) != arguments[i]) {
+      return false;
+    }
+  }
+  int64_t value = load(entry.result);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (load(entry.sequence) != sequence) {
+    return false;
+  }
+  result = value;
+  return true;
+}
+
+void ResultStore::write(Entry& entry, uint64_t program, uint64_t tag,
+                        const int64_t* arguments, size_t count,
+                        int64_t result) {
+  // The only writer, so nothing else moves the sequence number.
+  uint64_t sequence = load(entry.sequence);
+  store(entry.sequence, sequence + 1);
+  std::atomic_thread_fence(std::memory_order_release);
+  store(entry.program, program);
+  store(entry.tag, tag);
+  for (size_t i = 0; i < count; ++i) {
+    store(entry.arguments[i], arguments[i]);
+  }
+  store(entry.result, result);
+  store(entry.sequence, sequence + 2, std::memory_order_release);
+}
+
+bool ResultStore::lookup(uint32_t function, const int64_t* arguments,
+                         size_t count, int64_t& result) {
+  if (count <= kMaxArguments) {
+    uint64_t key = tag(function, count);
+    size_t first = home(function, arguments, count);
+    for (size_t i = 0; i < kProbes; ++i) {
+      if (read(entries_[(first + i) & mask_], key, arguments, count, result)) {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+  }
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+void ResultStore::insert(uint32_t function, const int64_t* arguments,
+                         size_t count, int64_t result) {
+  if (!writable_ || count > kMaxArguments) {
+    return;
+  }
+  uint64_t key = tag(function, count);
+  size_t first = home(function, arguments, count);
+  // The first entry that is free, left by another program or already holds
+  // the key; failing that, the home entry is overwritten.
+  Entry* victim = &entries_[first];
+  for (size_t i = 0; i < kProbes; ++i) {
+    Entry& entry = entries_[(first + i) & mask_];
+    int64_t existing;
+    if (load(entry.tag) == 0 || load(entry.program) != program_ ||
+        read(entry, key, arguments, count, existing)) {
+      victim = &entry;
+      break;
+    }
+  }
+  write(*victim, program_, key, arguments, count, result);
+}
+
+}  // namespace simp
@@ -0,0 +1,93 @@
+#pragma once
+
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <glog/logging.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace simp {
+// Results of whole programs kept in a file, so they outlive the process that
+// computed them. The file is a fixed-size hash table mapped into memory, and a
+// lookup reads one entry of it: after the first run, a repeated input costs
+// about one page-cache access.
+//
+// A key is a fingerprint of the program, the function run and its arguments.
+// The fingerprint is taken from the parsed program, so editing the program
+// changes it and the old results simply never match again; the writer clears
+// them when it opens the file for a different program.
+//
+// Any number of processes may read the file while one writes it. The first to
+// open it takes an exclusive flock and becomes the writer; the others open it
+// read-only. Entries carry sequence numbers as in MemoCache, and a reader that
+// catches an entry being written treats it as a miss.
+class ResultStore {
+ public:
+  // Calls with more arguments are not stored.
+  static constexpr size_t kMaxArguments = 4;
+  static constexpr size_t kDefaultCapacity = 1 << 16;
+  static constexpr size_t kProbes = 8;
+
+  // Opens or creates the store at path for the program with fingerprint
+  // program. The capacity, rounded up to a power of two, only applies when
+  // the file is created. Returns nullptr if the file cannot be used.
+  static std::unique_ptr<ResultStore> open(const std::string& path,
+                                           uint64_t program,
+                                           size_t capacity = kDefaultCapacity);
+  ~ResultStore();
+
+  bool writable() const { return writable_; }
+  size_t capacity() const { return mask_ + 1; }
+
+  // Sets result and returns true if the call is stored.
+  bool lookup(uint32_t function, const int64_t* arguments, size_t count,
+              int64_t& result);
+  // Does nothing unless writable().
+  void insert(uint32_t function, const int64_t* arguments, size_t count,
+              int64_t result);
+
+  uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+  uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+ private:
+  // The file starts with a Header and continues with capacity Entries.
+  struct Header {
+    uint64_t magic;
+    uint64_t capacity;
+    uint64_t program;
+    uint64_t padding[5];
+  };
+  struct Entry {
+    uint64_t sequence;
+    uint64_t program;
+    // As in MemoCache: the function plus one and the argument count.
+    uint64_t tag;
+    int64_t arguments[kMaxArguments];
+    int64_t result;
+  };
+  static_assert(sizeof(Entry) == 64);
+
+  ResultStore(int fd, void* mapping, size_t size, bool writable,
+              uint64_t program);
+  size_t home(uint32_t function, const int64_t* arguments, size_t count) const;
+  bool read(Entry& entry, uint64_t tag, const int64_t* arguments, size_t count,
+            int64_t& result);
+  void write(Entry& entry, uint64_t program, uint64_t tag,
+             const int64_t* arguments, size_t count, int64_t result);
+
+  int fd_;
+  void* mapping_;
+  size_t size_;
+  bool writable_;
+  uint64_t program_;
+  Header* header_;
+  Entry* entries_;
+  size_t mask_;
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+};
+}  // namespace simp
@@ -0,0 +1,96 @@
+#include "memo/result_store.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+namespace simp {
+namespace {
+using ::testing::AllOf;
+using ::testing::Eq;
+using ::testing::Gt;
+using ::testing::Le;
+using ::testing::NotNull;
+class ResultStoreTest : public ::testing::Test {
+ protected:
+  ResultStoreTest() {}
+  ~ResultStoreTest() override {}
+  void SetUp() override {
+    path_ = ::testing::TempDir() + "/" +
+            ::testing::UnitTest::GetInstance()->current_test_info()->name() +
+            ".results";
+    std::remove(path_.c_str());
+  }
+  void TearDown() override { std::remove(path_.c_str()); }
+
+  std::string path_;
+};
+
+TEST_F(ResultStoreTest, KeepsResultsAcrossOpens) {
+  int64_t arguments[] = {1000, -3};
+  {
+    auto store = ResultStore::open(path_, 1);
+    ASSERT_THAT(store, NotNull());
+    EXPECT_TRUE(store->writable());
+    int64_t result;
+    EXPECT_FALSE(store->lookup(0, arguments, 2, result));
+    store->insert(0, arguments, 2, 1009);
+  }
+  auto store = ResultStore::open(path_, 1);
+  ASSERT_THAT(store, NotNull());
+  int64_t result = 0;
+  ASSERT_TRUE(store->lookup(0, arguments, 2, result));
+  EXPECT_THAT(result, Eq(1009));
+  EXPECT_FALSE(store->lookup(1, arguments, 2, result));
+  EXPECT_FALSE(store->lookup(0, arguments, 1, result));
+  EXPECT_THAT(store->hits(), Eq(1));
+  EXPECT_THAT(store->misses(), Eq(2));
+}
+
+TEST_F(ResultStoreTest, ForgetsResultsOfAnotherProgram) {
+  int64_t argument = 7;
+  int64_t result;
+  ResultStore::open(path_, 1)->insert(0, &argument, 1, 11);
+  EXPECT_FALSE(ResultStore::open(path_, 2)->lookup(0, &argument, 1, result));
+  // The second writer cleared the first program's results.
+  EXPECT_FALSE(ResultStore::open(path_, 1)->lookup(0, &argument, 1, result));
+}
+
+TEST_F(ResultStoreTest, HasOneWriter) {
+  auto writer = ResultStore::open(path_, 1, 64);
+  ASSERT_THAT(writer, NotNull());
+  auto reader = ResultStore::open(path_, 1);
+  ASSERT_THAT(reader, NotNull());
+  EXPECT_TRUE(writer->writable());
+  EXPECT_FALSE(reader->writable());
+  // The file keeps the capacity it was created with.
+  EXPECT_THAT(reader->capacity(), Eq(64));
+  int64_t argument = 5;
+  int64_t result;
+  reader->insert(0, &argument, 1, 25);
+  EXPECT_FALSE(reader->lookup(0, &argument, 1, result));
+  writer->insert(0, &argument, 1, 25);
+  ASSERT_TRUE(reader->lookup(0, &argument, 1, result));
+  EXPECT_THAT(result, Eq(25));
+}
+
+TEST_F(ResultStoreTest, StaysWithinItsCapacity) {
+  auto store = ResultStore::open(path_, 1, 16);
+  ASSERT_THAT(store, NotNull());
+  for (int64_t i = 0; i < 1000; ++i) {
+    store->insert(0, &i, 1, -i);
+  }
+  size_t found = 0;
+  for (int64_t i = 0; i < 1000; ++i) {
+    int64_t result;
+    if (store->lookup(0, &i, 1, result)) {
+      EXPECT_THAT(result, Eq(-i));
+      ++found;
+    }
+  }
+  EXPECT_THAT(found, AllOf(Gt(0), Le(16)));
+}
+
+}  // namespace
+}  // namespace simp
@@ -0,0 +1,417 @@
+#include "inliner.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace simp {
+
+namespace {
+void collect_callees(Expression* expression, std::vector<size_t>& callees) {
+  switch (expression->type()) {
+    case ExpressionType::INTEGER:
+    case ExpressionType::IDENTIFIER:
+      return;
+    case ExpressionType::PARENTHESIS:
+      collect_callees(
+          static_cast<ParenthesizedExpression*>(expression)->expression().get(),
+          callees);
+      return;
+    case ExpressionType::NOT:
+      collect_callees(
+          static_cast<NotExpression*>(expression)->expression().get(),
+          callees);
+      return;
+    case ExpressionType::NEGATIVE:
+      collect_callees(
+          static_cast<NegativeExpression*>(expression)->expression().get(),
+          callees);
+      return;
+    case ExpressionType::BINARY: {
+      auto binary = static_cast<BinaryExpression*>(expression);
+      collect_callees(binary->left().get(), callees);
+      collect_callees(binary->right().get(), callees);
+      return;
+    }
+    case ExpressionType::IF: {
+      auto if_expression = static_cast<IfExpression*>(expression);
+      collect_callees(if_expression->condition().get(), callees);
+      collect_callees(if_expression->consequent().get(), callees);
+      collect_callees(if_expression->alternative().get(), callees);
+      return;
+    }
+    case ExpressionType::LET:
+    case ExpressionType::LOOP: {
+      bool is_let = expression->type() == ExpressionType::LET;
+      Bindings& bindings =
+          is_let ? static_cast<LetExpression*>(expression)->bindings()
+                 : static_cast<LoopExpression*>(expression)->bindings();
+      for (const auto& binding : bindings) {
+        collect_callees(binding->expression().get(), callees);
+      }
+      collect_callees(
+          is_let
+              ? static_cast<LetExpression*>(expression)->expression().get()
+              : static_cast<LoopExpression*>(expression)->expression().get(),
+          callees);
+      return;
+    }
+    case ExpressionType::RECUR:
+      for (const auto& argument :
+           static_cast<RecurExpression*>(expression)->arguments()) {
+        collect_callees(argument.get(), callees);
+      }
+      return;
+    case ExpressionType::CALL: {
+      auto call = static_cast<CallExpression*>(expression);
+      callees.push_back(call->function());
+      for (const auto& argument : call->arguments()) {
+        collect_callees(argument.get(), callees);
+      }
+      return;
+    }
+    case ExpressionType::INTRINSIC:
+      for (const auto& argument :
+           static_cast<IntrinsicExpression*>(expression)->arguments()) {
+        collect_callees(argument.get(), callees);
+      }
+      return;
+  }
+}
+
+// The highest slot a let or loop in expression binds, or -1. Calls are
+// included, since their arguments are evaluated in the same frame.
+int highest_slot(Expression* expression) {
+  switch (expression->type()) {
+    case ExpressionType::INTEGER:
+    case ExpressionType::IDENTIFIER:
+      return -1;
+    case ExpressionType::PARENTHESIS:
+      return highest_slot(
+          static_cast<ParenthesizedExpression*>(expression)->expression().get());
+    case ExpressionType::NOT:
+      return highest_slot(
+          static_cast<NotExpression*>(expression)->expression().get());
+    case ExpressionType::NEGATIVE:
+      return highest_slot(
+          static_cast<NegativeExpression*>(expression)->expression().get());
+    case ExpressionType::BINARY: {
+      auto binary = static_cast<BinaryExpression*>(expression);
+      return std::max(highest_slot(binary->left().get()),
+                      highest_slot(binary->right().get()));
+    }
+    case ExpressionType::IF: {
+      auto if_expression = static_cast<IfExpression*>(expression);
+      return std::max({highest_slot(if_expression->condition().get()),
+                       highest_slot(if_expression->consequent().get()),
+                       highest_slot(if_expression->alternative().get())});
+    }
+    case ExpressionType::LET:
+    case ExpressionType::LOOP: {
+      bool is_let = expression->type() == ExpressionType::LET;
+      Bindings& bindings =
+          is_let ? static_cast<LetExpression*>(expression)->bindings()
+                 : static_cast<LoopExpression*>(expression)->bindings();
+      int slot = highest_slot(
+          is_let
+              ? static_cast<LetExpression*>(expression)->expression().get()
+              : static_cast<LoopExpression*>(expression)->expression().get());
+      for (const auto& binding : bindings) {
+        slot = std::max({slot, binding->slot(),
+                         highest_slot(binding->expression().get())});
+      }
+      return slot;
+    }
+    case ExpressionType::RECUR:
+    case ExpressionType::CALL:
+    case ExpressionType::INTRINSIC: {
+      auto& arguments =
+          expression->type() == ExpressionType::RECUR
+              ? static_cast<RecurExpression*>(expression)->arguments()
+          : expression->type() == ExpressionType::CALL
+              ? static_cast<CallExpression*>(expression)->arguments()
+              : static_cast<IntrinsicExpression*>(expression)->arguments();
+      int slot = -1;
+      for (const auto& argument : arguments) {
+        slot = std::max(slot, highest_slot(argument.get()));
+      }
+      return slot;
+    }
+  }
+  return -1;
+}
+
+std::unique_ptr<Expression> copy(Expression* expression, int offset,
+                                 const std::string& prefix);
+
+std::vector<std::unique_ptr<Expression>> copy_all(
+    std::vector<std::unique_ptr<Expression>>& expressions, int offset,
+    const std::string& prefix) {
+  std::vector<std::unique_ptr<Expression>> copies;
+  for (const auto& expression : expressions) {
+    copies.push_back(copy(expression.get(), offset, prefix));
+  }
+  return copies;
+}
+
+Bindings copy_bindings(Bindings& bindings, int offset,
+                       const std::string& prefix) {
+  Bindings copies;
+  for (const auto& binding : bindings) {
+    copies.push_back(std::make_unique<Binding>(
+        prefix + binding->name(),
+        copy(binding->expression().get(), offset, prefix), binding->span()));
+    copies.back()->set_slot(binding->slot() + offset);
+  }
+  return copies;
+}
+
+// A copy of expression whose variables are renamed with prefix and moved
+// offset slots up.
+std::unique_ptr<Expression> copy(Expression* expression, int offset,
+                                 const std::string& prefix) {
+  switch (expression->type()) {
+    case ExpressionType::INTEGER:
+      return std::make_unique<IntExpression>(
+          static_cast<IntExpression*>(expression)->value(),
+          expression->span());
+    case ExpressionType::IDENTIFIER: {
+      auto identifier = static_cast<IdentifierExpression*>(expression);
+      auto renamed = std::make_unique<IdentifierExpression>(
+          prefix + identifier->name(), expression->span());
+      renamed->set_slot(identifier->slot() + offset);
+      return renamed;
+    }
+    case ExpressionType::PARENTHESIS:
+      return std::make_unique<ParenthesizedExpression>(
+          copy(static_cast<ParenthesizedExpression*>(expression)
+                   ->expression()
+                   .get(),
+               offset, prefix),
+          expression->span());
+    case ExpressionType::NOT:
+      return std::make_unique<NotExpression>(
+          copy(static_cast<NotExpression*>(expression)->expression().get(),
+               offset, prefix),
+          expression->span());
+    case ExpressionType::NEGATIVE:
+      return std::make_unique<NegativeExpression>(
+          copy(static_cast<NegativeExpression*>(expression)->expression().get(),
+               offset, prefix),
+          expression->span());
+    case ExpressionType::BINARY: {
+      auto binary = static_cast<BinaryExpression*>(expression);
+      return std::make_unique<BinaryExpression>(
+          copy(binary->left().get(), offset, prefix),
+          copy(binary->right().get(), offset, prefix), binary->op(),
+          expression->span());
+    }
+    case ExpressionType::IF: {
+      auto if_expression = static_cast<IfExpression*>(expression);
+      return std::make_unique<IfExpression>(
+          copy(if_expression->condition().get(), offset, prefix),
+          copy(if_expression->consequent().get(), offset, prefix),
+          copy(if_expression->alternative().get(), offset, prefix),
+          expression->span());
+    }
+    case ExpressionType::LET: {
+      auto let = static_cast<LetExpression*>(expression);
+      return std::make_unique<LetExpression>(
+          copy_bindings(let->bindings(), offset, prefix),
+          copy(let->expression().get(), offset, prefix), expression->span());
+    }
+    case ExpressionType::LOOP: {
+      auto loop = static_cast<LoopExpression*>(expression);
+      return std::make_unique<LoopExpression>(
+          copy_bindings(loop->bindings(), offset, prefix),
+          copy(loop->expression().get(), offset, prefix), expression->span());
+    }
+    case ExpressionType::RECUR:
+      return std::make_unique<RecurExpression>(
+          copy_all(static_cast<RecurExpression*>(expression)->arguments(),
+                   offset, prefix),
+          expression->span());
+    case ExpressionType::CALL: {
+      auto call = static_cast<CallExpression*>(expression);
+      return std::make_unique<CallExpression>(
+          call->function(), call->name(),
+          copy_all(call->arguments(), offset, prefix), expression->span());
+    }
+    case ExpressionType::INTRINSIC: {
+      auto intrinsic = static_cast<IntrinsicExpression*>(expression);
+      return std::make_unique<IntrinsicExpression>(
+          intrinsic->intrinsic(),
+          copy_all(intrinsic->arguments(), offset, prefix),
+          expression->span());
+    }
+  }
+  return nullptr;
+}
+}  // namespace
+
+size_t Inliner::inline_calls(Ast& ast) {
+  Functions& functions = ast.functions();
+  functions_ = &functions;
+  inlined_ = 0;
+  std::vector<std::vector<size_t>> callees(functions.size());
+  for (size_t i = 0; i < functions.size(); ++i) {
+    collect_callees(functions[i]->body().get(), callees[i]);
+  }
+  // A function is recursive when a search along its calls comes back to it.
+  recursive_.assign(functions.size(), false);
+  for (size_t i = 0; i < functions.size(); ++i) {
+    std::vector<bool> reached(functions.size(), false);
+    std::vector<size_t> pending = callees[i];
+    while (!pending.empty() && !recursive_[i]) {
+      size_t function = pending.back();
+      pending.pop_back();
+      if (reached[function]) {
+        continue;
+      }
+      reached[function] = true;
+      recursive_[i] = function == i;
+      pending.insert(pending.end(), callees[function].begin(),
+                     callees[function].end());
+    }
+  }
+  visited_.assign(functions.size(), false);
+  for (size_t i = 0; i < functions.size(); ++i) {
+    if (!visited_[i]) {
+      inline_callees_first(ast, i, callees);
+    }
+  }
+  frame_size_ = ast.frame_size();
+  inline_calls(ast.root(), ast.inputs().size());
+  ast.set_frame_size(frame_size_);
+  SIMP_TRACE(PARSER, "inlined calls", inlined_);
+  return inlined_;
+}
+
+void Inliner::inline_callees_first(
+    Ast& ast, size_t function,
+    const std::vector<std::vector<size_t>>& callees) {
+  visited_[function] = true;
+  for (size_t callee : callees[function]) {
+    if (!visited_[callee]) {
+      inline_callees_first(ast, callee, callees);
+    }
+  }
+  Function& caller = *ast.functions()[function];
+  frame_size_ = caller.frame_size();
+  inline_calls(caller.body(), caller.parameters().size());
+  caller.set_frame_size(frame_size_);
+}
+
+bool Inliner::inlinable(size_t function) {
+  return !recursive_[function] && !kept_.count(function) &&
+         count_nodes((*functions_)[function]->body().get()) <= budget_;
+}
+
+void Inliner::inline_bindings(Bindings& bindings, size_t& depth) {
+  for (const auto& binding : bindings) {
+    inline_calls(binding->expression(), depth);
+    depth = binding->slot() + 1;
+    frame_size_ = std::max(frame_size_, depth);
+  }
+}
+
+void Inliner::inline_calls(std::unique_ptr<Expression>& expression,
+                           size_t depth) {
+  switch (expression->type()) {
+    case ExpressionType::INTEGER:
+    case ExpressionType::IDENTIFIER:
+      return;
+    case ExpressionType::PARENTHESIS:
+      inline_calls(
+          static_cast<ParenthesizedExpression*>(expression.get())
+              ->expression(),
+          depth);
+      return;
+    case ExpressionType::NOT:
+      inline_calls(
+          static_cast<NotExpression*>(expression.get())->expression(), depth);
+      return;
+    case ExpressionType::NEGATIVE:
+      inline_calls(
+          static_cast<NegativeExpression*>(expression.get())->expression(),
+          depth);
+      return;
+    case ExpressionType::BINARY: {
+      auto binary = static_cast<BinaryExpression*>(expression.get());
+      inline_calls(binary->left(), depth);
+      inline_calls(binary->right(), depth);
+      return;
+    }
+    case ExpressionType::IF: {
+      auto if_expression = static_cast<IfExpression*>(expression.get());
+      inline_calls(if_expression->condition(), depth);
+      inline_calls(if_expression->consequent(), depth);
+      inline_calls(if_expression->alternative(), depth);
+      return;
+    }
+    case ExpressionType::LET: {
+      auto let = static_cast<LetExpression*>(expression.get());
+      inline_bindings(let->bindings(), depth);
+      inline_calls(let->expression(), depth);
+      return;
+    }
+    case ExpressionType::LOOP: {
+      auto loop = static_cast<LoopExpression*>(expression.get());
+      inline_bindings(loop->bindings(), depth);
+      inline_calls(loop->expression(), depth);
+      return;
+    }
+    case ExpressionType::RECUR:
+      for (auto& argument :
+           static_cast<RecurExpression*>(expression.get())->arguments()) {
+        inline_calls(argument, depth);
+      }
+      return;
+    case ExpressionType::INTRINSIC:
+      for (auto& argument :
+           static_cast<IntrinsicExpression*>(expression.get())->arguments()) {
+        inline_calls(argument, depth);
+      }
+      return;
+    case ExpressionType::CALL: {
+      auto call = static_cast<CallExpression*>(expression.get());
+      if (!inlinable(call->function())) {
+        for (auto& argument : call->arguments()) {
+          inline_calls(argument, depth);
+        }
+        return;
+      }
+      // The parameters take the slots from base up, in the order the
+      // callee's frame has them, and the callee's own variables follow. The
+      // variables of the arguments were resolved from depth up, so base is
+      // above all of them: evaluating an argument must not overwrite the
+      // parameters bound before it.
+      Function& callee = *(*functions_)[call->function()];
+      std::string prefix = callee.name() + "_";
+      size_t base = depth;
+      for (const auto& argument : call->arguments()) {
+        base = std::max<size_t>(base, highest_slot(argument.get()) + 1);
+      }
+      Bindings parameters;
+      for (size_t i = 0; i < call->arguments().size(); ++i) {
+        parameters.push_back(std::make_unique<Binding>(
+            prefix + callee.parameters()[i], std::move(call->arguments()[i]),
+            callee.span()));
+        parameters.back()->set_slot(base + i);
+      }
+      std::unique_ptr<Expression> body =
+          copy(callee.body().get(), base, prefix);
+      if (parameters.empty()) {
+        expression = std::move(body);
+      } else {
+        expression = std::make_unique<LetExpression>(
+            std::move(parameters), std::move(body), expression->span());
+      }
+      ++inlined_;
+      // Inlines into the arguments; the body has no inlinable calls left.
+      inline_calls(expression, depth);
+      return;
+    }
+  }
+}
+
+}  // namespace simp
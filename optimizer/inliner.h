@@ -0,0 +1,68 @@
+#pragma once
+
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <glog/logging.h>
+
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "ast/ast.h"
+
+namespace simp {
+// Replaces calls to small functions in a resolved Ast with the callee's body.
+// SimpLang functions are pure and see nothing but their parameters, so
+//
+//   min (x) (3)
+//
+// becomes
+//
+//   let min_a = x and min_b = 3 in if min_a < min_b then min_a else min_b end
+//   end
+//
+// Variables of the copied body are renamed with the callee's name in front
+// and moved to slots above those in scope at the call and those the
+// arguments bind themselves, so an argument never sees or overwrites a
+// parameter and the Ast needs no resolving again. The Simplifier can then
+// fold the literal arguments into the body.
+//
+// A callee is inlined when its body, after its own calls were inlined, has at
+// most budget nodes (see count_nodes) and it cannot reach itself through
+// calls. Functions stay in the Ast even when no call is left to them.
+class Inliner {
+ public:
+  static constexpr size_t kDefaultBudget = 24;
+
+  explicit Inliner(size_t budget = kDefaultBudget) : budget_(budget) {}
+
+  // Leaves every call to function in place, e.g. because it is memoized.
+  void keep_calls(size_t function) { kept_.insert(function); }
+
+  // Inlines into every function, callees first, and then into the root.
+  // Returns the number of calls replaced.
+  size_t inline_calls(Ast& ast);
+
+ private:
+  // Inlines into expression, whose frame has depth slots in scope.
+  void inline_calls(std::unique_ptr<Expression>& expression, size_t depth);
+  void inline_bindings(Bindings& bindings, size_t& depth);
+  // Inlines into the functions function calls, unless already visited, and
+  // then into function itself.
+  void inline_callees_first(Ast& ast, size_t function,
+                            const std::vector<std::vector<size_t>>& callees);
+  bool inlinable(size_t function);
+
+  size_t budget_;
+  std::set<size_t> kept_;
+  const Functions* functions_ = nullptr;
+  // For every function, whether it can reach itself through calls.
+  std::vector<bool> recursive_;
+  std::vector<bool> visited_;
+  // The largest frame the expression being rewritten needs.
+  size_t frame_size_ = 0;
+  size_t inlined_ = 0;
+};
+}  // namespace simp
@@ -0,0 +1,123 @@
+#include "optimizer/inliner.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "lexer/lexer.h"
+#include "optimizer/simplifier.h"
+#include "parser/parser.h"
+
+namespace simp {
+namespace {
+using ::testing::Eq;
+using ::testing::Gt;
+using ::testing::HasSubstr;
+using ::testing::Not;
+class InlinerTest : public ::testing::Test {
+ protected:
+  InlinerTest() {}
+  ~InlinerTest() override {}
+  void SetUp() override {}
+
+  static std::unique_ptr<Ast> parse_source(const std::string& source) {
+    Lexer lexer("<memory>");
+    EXPECT_TRUE(lexer.scan(source));
+    Parser parser(std::move(lexer.tokens()));
+    EXPECT_TRUE(parser.parse());
+    return parser.ast();
+  }
+};
+
+TEST_F(InlinerTest, ReplacesCallsWithTheCalleeBody) {
+  auto ast = parse_source(
+      "let min a b = if a < b then a else b end end\n"
+      "let main x = min (x) (3) end");
+  EXPECT_THAT(Inliner().inline_calls(*ast), Eq(2));
+  // main is inlined into the root and min into both.
+  EXPECT_THAT(ast->root()->to_string(), Not(HasSubstr("Call")));
+  EXPECT_THAT(ast->functions()[1]->body()->to_string(),
+              Not(HasSubstr("Call")));
+  EXPECT_THAT(ast->eval({2}), Eq(2));
+  EXPECT_THAT(ast->eval({5}), Eq(3));
+}
+
+TEST_F(InlinerTest, KeepsArgumentsAwayFromParameters) {
+  // Bound in order as a let, the second argument a would see the parameter
+  // a = 10 unless the parameters were renamed.
+  auto ast = parse_source(
+      "let sub a b = a + -b end\n"
+      "let a = 1 in sub (10) (a) end");
+  EXPECT_THAT(Inliner().inline_calls(*ast), Eq(1));
+  EXPECT_THAT(ast->root()->to_string(), HasSubstr("sub_a"));
+  EXPECT_THAT(ast->eval(), Eq(9));
+}
+
+TEST_F(InlinerTest, GrowsTheFrameOfTheCaller) {
+  auto ast = parse_source(
+      "let sum_to n = loop s = 0 and i = 0 in if n < i then s else recur "
+      "(s + i) (i + 1) end end end\n"
+      "let main x = let y = x + 1 in y * sum_to (y) end end");
+  size_t frame_size = ast->functions()[1]->frame_size();
+  EXPECT_THAT(Inliner(64).inline_calls(*ast), Eq(2));
+  EXPECT_THAT(ast->functions()[1]->frame_size(), Gt(frame_size));
+  EXPECT_THAT(ast->eval({3}), Eq(4 * 10));
+}
+
+TEST_F(InlinerTest, RefusesRecursiveCycles) {
+  // A function is only visible after its definition starts, so the only
+  // cycles are through the function itself.
+  auto ast = parse_source(
+      "let count n = if n == 0 then 0 else 1 + count (n + -1) end end\n"
+      "let twice n = count (n) + count (n) end\n"
+      "twice (7)");
+  EXPECT_THAT(Inliner().inline_calls(*ast), Eq(1));
+  EXPECT_THAT(ast->root()->to_string(), HasSubstr("Call count"));
+  EXPECT_THAT(ast->eval(), Eq(14));
+}
+
+TEST_F(InlinerTest, KeepsCallsItIsToldTo) {
+  auto ast = parse_source(
+      "let twice x = x + x end\n"
+      "twice (4) + twice (5)");
+  Inliner inliner;
+  inliner.keep_calls(0);
+  EXPECT_THAT(inliner.inline_calls(*ast), Eq(0));
+  EXPECT_THAT(ast->eval(), Eq(18));
+}
+
+TEST_F(InlinerTest, RespectsTheBudget) {
+  auto ast = parse_source(
+      "let twice x = x + x end\n"
+      "twice (4)");
+  EXPECT_THAT(Inliner(2).inline_calls(*ast), Eq(0));
+  EXPECT_THAT(Inliner(3).inline_calls(*ast), Eq(1));
+  EXPECT_THAT(ast->eval(), Eq(8));
+}
+
+TEST_F(InlinerTest, LeavesConstantsForTheSimplifier) {
+  auto ast = parse_source(
+      "let sign x = if x == 0 then 0 else if x < 0 then -1 else 1 end end "
+      "end\n"
+      "sign (-5) * 7");
+  EXPECT_THAT(Inliner().inline_calls(*ast), Eq(1));
+  Simplifier().simplify(*ast);
+  EXPECT_THAT(ast->root()->to_string(), Eq("-7"));
+}
+
+TEST_F(InlinerTest, PreservesResults) {
+  for (std::string file :
+       {"examples/functions.sl", "examples/nextprime.sl"}) {
+    Parser parser(file);
+    ASSERT_TRUE(parser.parse()) << file;
+    auto ast = parser.ast();
+    std::vector<int64_t> arguments(ast->inputs().size(), 1000);
+    int64_t expected = ast->eval(arguments);
+    EXPECT_THAT(Inliner().inline_calls(*ast), Gt(0)) << file;
+    EXPECT_THAT(ast->eval(arguments), Eq(expected)) << file;
+    Simplifier().simplify(*ast);
+    EXPECT_THAT(ast->eval(arguments), Eq(expected)) << file;
+  }
+}
+
+}  // namespace
+}  // namespace simp
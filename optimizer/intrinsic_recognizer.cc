@@ -0,0 +1,364 @@
+#include "intrinsic_recognizer.h"
+
+#include <utility>
+
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+
+namespace simp {
+
+namespace {
+// The emulations from examples/nextprime.sl, which the intrinsics reproduce
+// exactly. bitset and sign are only ever matched as helpers.
+const char* kReferences = R"(
+let bitset x i =
+  loop x = x and
+       i = i in
+    if i < 63 then
+      recur (x*2) (i+1)
+    else
+      x < 0
+    end
+  end
+end
+
+let shiftl x a =
+  loop x = x and
+       i = 0 in
+    if i < a then
+      recur (x*2) (i+1)
+    else
+      x
+    end
+  end
+end
+
+let shiftr x a =
+  loop r = 0 and
+       i = 0 in
+    if a+i < 64 then
+      recur (r + shiftl (bitset (x) (a+i)) (i)) (i+1)
+    else
+      r
+    end
+  end
+end
+
+let leadingzeros x =
+  if x == 0 then
+    64
+  else
+    if x < 0 then
+      0
+    else
+      1 + (leadingzeros (x*2))
+    end
+  end
+end
+
+let sign x =
+  if x == 0 then
+    0
+  else
+    if x < 0 then
+      -1
+    else
+      1
+    end
+  end
+end
+
+let div x y =
+  let multiplier = sign (x) * sign (y) and
+      x = x * sign (x) and
+      y = y * sign (y) and
+      lz = leadingzeros (y) in
+    loop x = x and
+         r = 0 and
+         i = lz+-1 in
+      if i < 0 then
+        r * multiplier
+      else
+        let sy = shiftl (y) (i) in
+          if !(x < sy) then
+            recur (x+-sy) (r + (shiftl (1) (i))) (i+-1)
+          else
+            recur (x) (r) (i+-1)
+          end
+        end
+      end
+    end
+  end
+end
+
+let rem x y =
+  let quot = div (x) (y) in
+    x + -(y * quot)
+  end
+end
+
+0
+)";
+
+Expression* skip_parentheses(Expression* expression) {
+  while (expression->type() == ExpressionType::PARENTHESIS) {
+    expression =
+        static_cast<ParenthesizedExpression*>(expression)->expression().get();
+  }
+  return expression;
+}
+}  // namespace
+
+IntrinsicRecognizer::IntrinsicRecognizer() {
+  Lexer lexer("<intrinsics>");
+  if (!lexer.scan(kReferences)) {
+    LOG(ERROR) << "Failed to scan the reference intrinsics";
+    return;
+  }
+  Parser parser(std::move(lexer.tokens()));
+  if (!parser.parse()) {
+    LOG(ERROR) << "Failed to parse the reference intrinsics";
+    return;
+  }
+  references_ = parser.ast();
+}
+
+size_t IntrinsicRecognizer::recognize(Ast& ast) {
+  if (!references_) {
+    return 0;
+  }
+  ast_ = &ast;
+  Functions& functions = ast.functions();
+  recognized_.assign(functions.size(), false);
+  intrinsics_.assign(functions.size(), Intrinsic::DIV);
+  // Everything is compared before anything is replaced, since a replaced
+  // callee no longer looks like its reference.
+  size_t count = 0;
+  for (size_t i = 0; i < functions.size(); ++i) {
+    for (size_t j = 0; j < references_->functions().size(); ++j) {
+      Intrinsic intrinsic;
+      if (!find_intrinsic(references_->functions()[j]->name(), intrinsic)) {
+        continue;
+      }
+      assumed_.clear();
+      if (matches(i, j)) {
+        recognized_[i] = true;
+        intrinsics_[i] = intrinsic;
+        ++count;
+        break;
+      }
+    }
+  }
+  for (size_t i = 0; i < functions.size(); ++i) {
+    if (recognized_[i]) {
+      Function& function = *functions[i];
+      std::vector<std::unique_ptr<Expression>> parameters;
+      for (size_t j = 0; j < function.parameters().size(); ++j) {
+        parameters.push_back(std::make_unique<IdentifierExpression>(
+            function.parameters()[j], function.span()));
+        static_cast<IdentifierExpression*>(parameters.back().get())
+            ->set_slot(j);
+      }
+      function.body() = std::make_unique<IntrinsicExpression>(
+          intrinsics_[i], std::move(parameters), function.span());
+      function.set_frame_size(function.parameters().size());
+    } else {
+      replace_calls(functions[i]->body());
+    }
+  }
+  replace_calls(ast.root());
+  SIMP_TRACE(PARSER, "recognized intrinsics", count);
+  return count;
+}
+
+bool IntrinsicRecognizer::matches(size_t function, size_t reference) {
+  if (kept_.count(function)) {
+    return false;
+  }
+  if (!assumed_.insert({function, reference}).second) {
+    return true;
+  }
+  Function& candidate = *ast_->functions()[function];
+  Function& model = *references_->functions()[reference];
+  return candidate.parameters().size() == model.parameters().size() &&
+         same(candidate.body().get(), model.body().get());
+}
+
+bool IntrinsicRecognizer::same(Expression* expression, Expression* reference) {
+  expression = skip_parentheses(expression);
+  reference = skip_parentheses(reference);
+  if (expression->type() != reference->type()) {
+    return false;
+  }
+  switch (expression->type()) {
+    case ExpressionType::INTEGER:
+      return static_cast<IntExpression*>(expression)->value() ==
+             static_cast<IntExpression*>(reference)->value();
+    case ExpressionType::IDENTIFIER:
+      // The Resolver numbers slots by position alone, so equal slots mean
+      // the same variable under any names.
+      return static_cast<IdentifierExpression*>(expression)->slot() ==
+             static_cast<IdentifierExpression*>(reference)->slot();
+    case ExpressionType::PARENTHESIS:
+      return false;
+    case ExpressionType::NOT:
+      return same(
+          static_cast<NotExpression*>(expression)->expression().get(),
+          static_cast<NotExpression*>(reference)->expression().get());
+    case ExpressionType::NEGATIVE:
+      return same(
+          static_cast<NegativeExpression*>(expression)->expression().get(),
+          static_cast<NegativeExpression*>(reference)->expression().get());
+    case ExpressionType::BINARY: {
+      auto binary = static_cast<BinaryExpression*>(expression);
+      auto model = static_cast<BinaryExpression*>(reference);
+      return binary->op() == model->op() &&
+             same(binary->left().get(), model->left().get()) &&
+             same(binary->right().get(), model->right().get());
+    }
+    case ExpressionType::IF: {
+      auto if_expression = static_cast<IfExpression*>(expression);
+      auto model = static_cast<IfExpression*>(reference);
+      return same(if_expression->condition().get(),
+                  model->condition().get()) &&
+             same(if_expression->consequent().get(),
+                  model->consequent().get()) &&
+             same(if_expression->alternative().get(),
+                  model->alternative().get());
+    }
+    case ExpressionType::LET: {
+      auto let = static_cast<LetExpression*>(expression);
+      auto model = static_cast<LetExpression*>(reference);
+      return same_bindings(let->bindings(), model->bindings()) &&
+             same(let->expression().get(), model->expression().get());
+    }
+    case ExpressionType::LOOP: {
+      auto loop = static_cast<LoopExpression*>(expression);
+      auto model = static_cast<LoopExpression*>(reference);
+      return same_bindings(loop->bindings(), model->bindings()) &&
+             same(loop->expression().get(), model->expression().get());
+    }
+    case ExpressionType::RECUR:
+      return same_arguments(
+          static_cast<RecurExpression*>(expression)->arguments(),
+          static_cast<RecurExpression*>(reference)->arguments());
+    case ExpressionType::CALL: {
+      auto call = static_cast<CallExpression*>(expression);
+      auto model = static_cast<CallExpression*>(reference);
+      return same_arguments(call->arguments(), model->arguments()) &&
+             matches(call->function(), model->function());
+    }
+    case ExpressionType::INTRINSIC: {
+      auto intrinsic = static_cast<IntrinsicExpression*>(expression);
+      auto model = static_cast<IntrinsicExpression*>(reference);
+      return intrinsic->intrinsic() == model->intrinsic() &&
+             same_arguments(intrinsic->arguments(), model->arguments());
+    }
+  }
+  return false;
+}
+
+bool IntrinsicRecognizer::same_bindings(Bindings& bindings,
+                                        Bindings& reference) {
+  if (bindings.size() != reference.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < bindings.size(); ++i) {
+    if (bindings[i]->slot() != reference[i]->slot() ||
+        !same(bindings[i]->expression().get(),
+              reference[i]->expression().get())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool IntrinsicRecognizer::same_arguments(
+    std::vector<std::unique_ptr<Expression>>& arguments,
+    std::vector<std::unique_ptr<Expression>>& reference) {
+  if (arguments.size() != reference.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    if (!same(arguments[i].get(), reference[i].get())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void IntrinsicRecognizer::replace_calls(
+    std::unique_ptr<Expression>& expression) {
+  switch (expression->type()) {
+    case ExpressionType::INTEGER:
+    case ExpressionType::IDENTIFIER:
+      return;
+    case ExpressionType::PARENTHESIS:
+      replace_calls(
+          static_cast<ParenthesizedExpression*>(expression.get())
+              ->expression());
+      return;
+    case ExpressionType::NOT:
+      replace_calls(
+          static_cast<NotExpression*>(expression.get())->expression());
+      return;
+    case ExpressionType::NEGATIVE:
+      replace_calls(
+          static_cast<NegativeExpression*>(expression.get())->expression());
+      return;
+    case ExpressionType::BINARY: {
+      auto binary = static_cast<BinaryExpression*>(expression.get());
+      replace_calls(binary->left());
+      replace_calls(binary->right());
+      return;
+    }
+    case ExpressionType::IF: {
+      auto if_expression = static_cast<IfExpression*>(expression.get());
+      replace_calls(if_expression->condition());
+      replace_calls(if_expression->consequent());
+      replace_calls(if_expression->alternative());
+      return;
+    }
+    case ExpressionType::LET:
+    case ExpressionType::LOOP: {
+      bool is_let = expression->type() == ExpressionType::LET;
+      Bindings& bindings =
+          is_let ? static_cast<LetExpression*>(expression.get())->bindings()
+                 : static_cast<LoopExpression*>(expression.get())->bindings();
+      for (const auto& binding : bindings) {
+        replace_calls(binding->expression());
+      }
+      replace_calls(
+          is_let
+              ? static_cast<LetExpression*>(expression.get())->expression()
+              : static_cast<LoopExpression*>(expression.get())->expression());
+      return;
+    }
+    case ExpressionType::RECUR:
+      for (auto& argument :
+           static_cast<RecurExpression*>(expression.get())->arguments()) {
+        replace_calls(argument);
+      }
+      return;
+    case ExpressionType::CALL: {
+      auto call = static_cast<CallExpression*>(expression.get());
+      for (auto& argument : call->arguments()) {
+        replace_calls(argument);
+      }
+      if (recognized_[call->function()]) {
+        expression = std::make_unique<IntrinsicExpression>(
+            intrinsics_[call->function()], std::move(call->arguments()),
+            call->span());
+      }
+      return;
+    }
+    case ExpressionType::INTRINSIC:
+      for (auto& argument :
+           static_cast<IntrinsicExpression*>(expression.get())->arguments()) {
+        replace_calls(argument);
+      }
+      return;
+  }
+}
+
+}  // namespace simp
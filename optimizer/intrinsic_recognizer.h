@@ -0,0 +1,59 @@
+#pragma once
+
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <glog/logging.h>
+
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "ast/ast.h"
+
+namespace simp {
+// Finds the functions of a resolved Ast that emulate an Intrinsic and calls
+// the intrinsic instead: every call to such a function becomes an
+// IntrinsicExpression, and so does its body, in case the Ast is printed or
+// compiled function by function.
+//
+// A function is recognized when it is the reference definition of an
+// intrinsic (the one in examples/nextprime.sl) up to the names of variables
+// and functions and parentheses, and every function it calls is in turn the
+// matching reference helper. That is a structural test, so it never replaces
+// a function that computes something else, but it also misses emulations
+// written differently.
+class IntrinsicRecognizer {
+ public:
+  IntrinsicRecognizer();
+
+  // Leaves function, and every function that calls it, as it is, e.g.
+  // because it is memoized.
+  void keep_calls(size_t function) { kept_.insert(function); }
+
+  // Returns the number of functions replaced.
+  size_t recognize(Ast& ast);
+
+ private:
+  // Whether function of the program matches function reference of the
+  // reference definitions, assuming the pairs in assumed already do.
+  bool matches(size_t function, size_t reference);
+  bool same(Expression* expression, Expression* reference);
+  bool same_bindings(Bindings& bindings, Bindings& reference);
+  bool same_arguments(std::vector<std::unique_ptr<Expression>>& arguments,
+                      std::vector<std::unique_ptr<Expression>>& reference);
+  // Replaces calls to recognized functions under expression.
+  void replace_calls(std::unique_ptr<Expression>& expression);
+
+  std::unique_ptr<Ast> references_;
+  Ast* ast_ = nullptr;
+  // Pairs being compared further up, taken to match so that recursive
+  // definitions can be compared at all.
+  std::set<std::pair<size_t, size_t>> assumed_;
+  std::set<size_t> kept_;
+  // For every function of ast_, whether it was recognized and as what.
+  std::vector<bool> recognized_;
+  std::vector<Intrinsic> intrinsics_;
+};
+}  // namespace simp
@@ -0,0 +1,84 @@
+#include "optimizer/intrinsic_recognizer.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+
+namespace simp {
+namespace {
+using ::testing::Eq;
+using ::testing::HasSubstr;
+using ::testing::Not;
+class IntrinsicRecognizerTest : public ::testing::Test {
+ protected:
+  IntrinsicRecognizerTest() {}
+  ~IntrinsicRecognizerTest() override {}
+  void SetUp() override {}
+
+  static std::unique_ptr<Ast> parse_source(const std::string& source) {
+    Lexer lexer("<memory>");
+    EXPECT_TRUE(lexer.scan(source));
+    Parser parser(std::move(lexer.tokens()));
+    EXPECT_TRUE(parser.parse());
+    return parser.ast();
+  }
+};
+
+TEST_F(IntrinsicRecognizerTest, RecognizesTheNextprimeHelpers) {
+  Parser parser("examples/nextprime.sl");
+  ASSERT_TRUE(parser.parse());
+  auto ast = parser.ast();
+  std::vector<int64_t> arguments = {1000};
+  int64_t expected = ast->eval(arguments);
+  // shiftl, shiftr, leadingzeros, div and rem; bitset and sign are not
+  // intrinsics.
+  EXPECT_THAT(IntrinsicRecognizer().recognize(*ast), Eq(5));
+  std::string printed = ast->to_string();
+  EXPECT_THAT(printed, HasSubstr("Intrinsic rem"));
+  EXPECT_THAT(printed, HasSubstr("Intrinsic shiftr"));
+  EXPECT_THAT(ast->eval(arguments), Eq(expected));
+}
+
+TEST_F(IntrinsicRecognizerTest, IgnoresNames) {
+  auto ast = parse_source(
+      "let double v n = loop v = v and j = 0 in if j < n then recur (v*2) "
+      "(j+1) else v end end end\n"
+      "double (3) (4)");
+  EXPECT_THAT(IntrinsicRecognizer().recognize(*ast), Eq(1));
+  EXPECT_THAT(ast->root()->to_string(), HasSubstr("Intrinsic shiftl"));
+  EXPECT_THAT(ast->eval(), Eq(48));
+}
+
+TEST_F(IntrinsicRecognizerTest, KeepsFunctionsThatDiffer) {
+  // Stops at i <= a, so it shifts one place too far.
+  auto ast = parse_source(
+      "let shiftl x a = loop x = x and i = 0 in if i < a + 1 then recur "
+      "(x*2) (i+1) else x end end end\n"
+      "shiftl (3) (4)");
+  EXPECT_THAT(IntrinsicRecognizer().recognize(*ast), Eq(0));
+  EXPECT_THAT(ast->root()->to_string(), Not(HasSubstr("Intrinsic")));
+  EXPECT_THAT(ast->eval(), Eq(96));
+}
+
+TEST_F(IntrinsicRecognizerTest, LeavesKeptFunctionsAndTheirCallers) {
+  Parser parser("examples/nextprime.sl");
+  ASSERT_TRUE(parser.parse());
+  auto ast = parser.ast();
+  IntrinsicRecognizer recognizer;
+  for (size_t i = 0; i < ast->functions().size(); ++i) {
+    if (ast->functions()[i]->name() == "div") {
+      recognizer.keep_calls(i);
+    }
+  }
+  // rem calls div, so only shiftl, shiftr and leadingzeros are left.
+  EXPECT_THAT(recognizer.recognize(*ast), Eq(3));
+  std::string printed = ast->to_string();
+  EXPECT_THAT(printed, Not(HasSubstr("Intrinsic div")));
+  EXPECT_THAT(printed, Not(HasSubstr("Intrinsic rem")));
+  EXPECT_THAT(ast->eval({1000}), Eq(1009));
+}
+
+}  // namespace
+}  // namespace simp
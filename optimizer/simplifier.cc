@@ -0,0 +1,289 @@
+#include "simplifier.h"
+
+#include <utility>
+
+namespace simp {
+
+namespace {
+bool integer_value(Expression* expression, int64_t& value) {
+  if (expression->type() != ExpressionType::INTEGER) {
+    return false;
+  }
+  value = static_cast<IntExpression*>(expression)->value();
+  return true;
+}
+
+// Whether expression always evaluates to 0 or 1.
+bool is_boolean(Expression* expression) {
+  switch (expression->type()) {
+    case ExpressionType::INTEGER: {
+      int64_t value = static_cast<IntExpression*>(expression)->value();
+      return value == 0 || value == 1;
+    }
+    case ExpressionType::NOT:
+      return true;
+    case ExpressionType::BINARY:
+      return static_cast<BinaryExpression*>(expression)->op() !=
+                 Operator::PLUS &&
+             static_cast<BinaryExpression*>(expression)->op() !=
+                 Operator::TIMES;
+    default:
+      return false;
+  }
+}
+
+int64_t fold(Operator op, int64_t left, int64_t right) {
+  switch (op) {
+    case Operator::PLUS:
+      return wrapping_add(left, right);
+    case Operator::TIMES:
+      return wrapping_multiply(left, right);
+    case Operator::LESS_THAN:
+      return left < right;
+    case Operator::EQUALS:
+      return left == right;
+    case Operator::LOGICAL_AND:
+      return left && right;
+    case Operator::LOGICAL_OR:
+      return left || right;
+    default:
+      return 0;
+  }
+}
+}  // namespace
+
+size_t Simplifier::simplify(Ast& ast) {
+  size_t before = count_nodes(ast);
+  for (const auto& function : ast.functions()) {
+    known_.assign(function->frame_size(), nullptr);
+    simplify(function->body(), false);
+  }
+  known_.assign(ast.frame_size(), nullptr);
+  simplify(ast.root(), false);
+  size_t removed = before - count_nodes(ast);
+  SIMP_TRACE(PARSER, "simplified nodes", removed);
+  return removed;
+}
+
+void Simplifier::replace_with_integer(std::unique_ptr<Expression>& expression,
+                                      int64_t value) {
+  expression = std::make_unique<IntExpression>(value, expression->span());
+}
+
+void Simplifier::simplify(std::unique_ptr<Expression>& expression,
+                          bool truth_only) {
+  switch (expression->type()) {
+    case ExpressionType::INTEGER:
+      return;
+    case ExpressionType::IDENTIFIER: {
+      int slot = static_cast<IdentifierExpression*>(expression.get())->slot();
+      if (slot < 0 || static_cast<size_t>(slot) >= known_.size() ||
+          !known_[slot]) {
+        return;
+      }
+      int64_t value;
+      if (integer_value(known_[slot], value)) {
+        replace_with_integer(expression, value);
+        return;
+      }
+      // Only the loop a variable belongs to assigns its slot again, and a
+      // recur leaves the let first, so the other variable still holds the
+      // same value here.
+      auto variable = static_cast<IdentifierExpression*>(known_[slot]);
+      auto replacement = std::make_unique<IdentifierExpression>(
+          variable->name(), expression->span());
+      replacement->set_slot(variable->slot());
+      expression = std::move(replacement);
+      return;
+    }
+    case ExpressionType::PARENTHESIS: {
+      auto inner = std::move(
+          static_cast<ParenthesizedExpression*>(expression.get())
+              ->expression());
+      expression = std::move(inner);
+      simplify(expression, truth_only);
+      return;
+    }
+    case ExpressionType::NOT: {
+      auto& operand =
+          static_cast<NotExpression*>(expression.get())->expression();
+      simplify(operand, true);
+      int64_t value;
+      if (integer_value(operand.get(), value)) {
+        replace_with_integer(expression, !value);
+      } else if (operand->type() == ExpressionType::NOT) {
+        auto& inner =
+            static_cast<NotExpression*>(operand.get())->expression();
+        if (truth_only || is_boolean(inner.get())) {
+          auto kept = std::move(inner);
+          expression = std::move(kept);
+        }
+      }
+      return;
+    }
+    case ExpressionType::NEGATIVE: {
+      auto& operand =
+          static_cast<NegativeExpression*>(expression.get())->expression();
+      simplify(operand, false);
+      int64_t value;
+      if (integer_value(operand.get(), value)) {
+        replace_with_integer(expression, wrapping_negate(value));
+      } else if (operand->type() == ExpressionType::NEGATIVE) {
+        auto kept = std::move(
+            static_cast<NegativeExpression*>(operand.get())->expression());
+        expression = std::move(kept);
+      }
+      return;
+    }
+    case ExpressionType::BINARY:
+      simplify_binary(expression, truth_only);
+      return;
+    case ExpressionType::IF: {
+      auto if_expression = static_cast<IfExpression*>(expression.get());
+      simplify(if_expression->condition(), true);
+      int64_t value;
+      if (integer_value(if_expression->condition().get(), value)) {
+        auto kept = std::move(value ? if_expression->consequent()
+                                    : if_expression->alternative());
+        expression = std::move(kept);
+        simplify(expression, truth_only);
+        return;
+      }
+      simplify(if_expression->consequent(), truth_only);
+      simplify(if_expression->alternative(), truth_only);
+      return;
+    }
+    case ExpressionType::LET:
+      simplify_let(expression, truth_only);
+      return;
+    case ExpressionType::LOOP: {
+      // Loop variables change from one iteration to the next, so they are
+      // never replaced by their initial values.
+      auto loop = static_cast<LoopExpression*>(expression.get());
+      for (const auto& binding : loop->bindings()) {
+        simplify(binding->expression(), false);
+      }
+      simplify(loop->expression(), truth_only);
+      return;
+    }
+    case ExpressionType::RECUR:
+      for (auto& argument :
+           static_cast<RecurExpression*>(expression.get())->arguments()) {
+        simplify(argument, false);
+      }
+      return;
+    case ExpressionType::CALL:
+      for (auto& argument :
+           static_cast<CallExpression*>(expression.get())->arguments()) {
+        simplify(argument, false);
+      }
+      return;
+    case ExpressionType::INTRINSIC: {
+      auto intrinsic = static_cast<IntrinsicExpression*>(expression.get());
+      int64_t values[2] = {0, 0};
+      bool known = true;
+      for (size_t i = 0; i < intrinsic->arguments().size(); ++i) {
+        simplify(intrinsic->arguments()[i], false);
+        known = integer_value(intrinsic->arguments()[i].get(), values[i]) &&
+                known;
+      }
+      if (known) {
+        replace_with_integer(expression,
+                             apply_intrinsic(intrinsic->intrinsic(), values[0],
+                                             values[1]));
+      }
+      return;
+    }
+  }
+}
+
+void Simplifier::simplify_binary(std::unique_ptr<Expression>& expression,
+                                 bool truth_only) {
+  auto binary = static_cast<BinaryExpression*>(expression.get());
+  Operator op = binary->op();
+  bool logical = op == Operator::LOGICAL_AND || op == Operator::LOGICAL_OR;
+  simplify(binary->left(), logical);
+  simplify(binary->right(), logical);
+  int64_t left = 0;
+  int64_t right = 0;
+  bool left_known = integer_value(binary->left().get(), left);
+  bool right_known = integer_value(binary->right().get(), right);
+  if (left_known && right_known) {
+    replace_with_integer(expression, fold(op, left, right));
+    return;
+  }
+  // The operand that is left when the other one is an identity, if any.
+  std::unique_ptr<Expression>* kept = nullptr;
+  switch (op) {
+    case Operator::PLUS:
+      kept = left_known && left == 0    ? &binary->right()
+             : right_known && right == 0 ? &binary->left()
+                                         : nullptr;
+      break;
+    case Operator::TIMES:
+      kept = left_known && left == 1    ? &binary->right()
+             : right_known && right == 1 ? &binary->left()
+                                         : nullptr;
+      break;
+    case Operator::LOGICAL_AND:
+    case Operator::LOGICAL_OR: {
+      bool is_and = op == Operator::LOGICAL_AND;
+      // 0 && x and 1 || x never look at x.
+      if (left_known && (left != 0) != is_and) {
+        replace_with_integer(expression, !is_and);
+        return;
+      }
+      // Otherwise a literal operand that does not decide the result leaves
+      // the truth of the other one, which is the other one itself where only
+      // truth matters.
+      std::unique_ptr<Expression>* other =
+          left_known                                 ? &binary->right()
+          : right_known && (right != 0) == is_and ? &binary->left()
+                                                  : nullptr;
+      if (other && (truth_only || is_boolean(other->get()))) {
+        kept = other;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  if (kept) {
+    auto operand = std::move(*kept);
+    expression = std::move(operand);
+  }
+}
+
+void Simplifier::simplify_let(std::unique_ptr<Expression>& expression,
+                              bool truth_only) {
+  auto let = static_cast<LetExpression*>(expression.get());
+  Bindings& bindings = let->bindings();
+  // Dropped bindings live until the body is done, since known_ points into
+  // them.
+  Bindings propagated;
+  size_t kept = 0;
+  for (size_t i = 0; i < bindings.size(); ++i) {
+    simplify(bindings[i]->expression(), false);
+    Expression* bound = bindings[i]->expression().get();
+    int slot = bindings[i]->slot();
+    if ((bound->type() == ExpressionType::INTEGER ||
+         bound->type() == ExpressionType::IDENTIFIER) &&
+        slot >= 0 && static_cast<size_t>(slot) < known_.size()) {
+      known_[slot] = bound;
+      propagated.push_back(std::move(bindings[i]));
+      continue;
+    }
+    bindings[kept++] = std::move(bindings[i]);
+  }
+  bindings.resize(kept);
+  simplify(let->expression(), truth_only);
+  for (const auto& binding : propagated) {
+    known_[binding->slot()] = nullptr;
+  }
+  if (bindings.empty()) {
+    auto body = std::move(let->expression());
+    expression = std::move(body);
+  }
+}
+
+}  // namespace simp
@@ -0,0 +1,51 @@
+#pragma once
+
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <glog/logging.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ast/ast.h"
+
+namespace simp {
+// Rewrites a resolved Ast into a smaller one that evaluates to the same value:
+//
+//   * operators, ! and - and intrinsics applied to literals are folded,
+//     wrapping around on overflow as evaluation does;
+//   * x + 0, 0 + x, x * 1, 1 * x and - -x become x;
+//   * !!x becomes x where only the truth of x matters (conditions and the
+//     operands of !, && and ||) or x is already 0 or 1;
+//   * an if whose condition is a literal becomes the branch it selects, and
+//     a literal on the left of && or || decides it where it can;
+//   * a let variable bound to a literal or to another variable is replaced
+//     by it and its binding dropped;
+//   * parentheses disappear.
+//
+// Subexpressions are never dropped when their value is not known, since a
+// SimpLang expression may loop forever. Slots keep the numbers the Resolver
+// gave them, so the result needs no resolving again.
+class Simplifier {
+ public:
+  // Simplifies the root and every function. Returns the number of nodes
+  // removed.
+  size_t simplify(Ast& ast);
+
+ private:
+  // truth_only says that the value of expression is only tested against 0.
+  void simplify(std::unique_ptr<Expression>& expression, bool truth_only);
+  void simplify_binary(std::unique_ptr<Expression>& expression,
+                       bool truth_only);
+  void simplify_let(std::unique_ptr<Expression>& expression, bool truth_only);
+  // Replaces expression with a literal at the same span.
+  static void replace_with_integer(std::unique_ptr<Expression>& expression,
+                                   int64_t value);
+
+  // The literal or identifier each let variable in scope is bound to, by
+  // slot, or null.
+  std::vector<Expression*> known_;
+};
+}  // namespace simp
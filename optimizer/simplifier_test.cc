@@ -0,0 +1,110 @@
+#include "optimizer/simplifier.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+
+namespace simp {
+namespace {
+using ::testing::Eq;
+using ::testing::Gt;
+class SimplifierTest : public ::testing::Test {
+ protected:
+  SimplifierTest() {}
+  ~SimplifierTest() override {}
+  void SetUp() override {}
+
+  static std::unique_ptr<Ast> parse_source(const std::string& source) {
+    Lexer lexer("<memory>");
+    EXPECT_TRUE(lexer.scan(source));
+    Parser parser(std::move(lexer.tokens()));
+    EXPECT_TRUE(parser.parse());
+    return parser.ast();
+  }
+
+  // The simplified form of source, printed.
+  static std::string simplified(const std::string& source) {
+    auto ast = parse_source(source);
+    Simplifier().simplify(*ast);
+    return ast->to_string();
+  }
+
+  static std::string printed(const std::string& source) {
+    return parse_source(source)->to_string();
+  }
+};
+
+TEST_F(SimplifierTest, FoldsConstantsWithWrapping) {
+  EXPECT_THAT(simplified("1 + 2 * 3"), Eq("7"));
+  EXPECT_THAT(simplified("9223372036854775807 + 1"),
+              Eq("-9223372036854775808"));
+  EXPECT_THAT(simplified("-(2 * 3) < 1 == 1"), Eq("1"));
+  EXPECT_THAT(simplified("!(0 || 0) && 5"), Eq("1"));
+}
+
+TEST_F(SimplifierTest, RemovesIdentities) {
+  EXPECT_THAT(simplified("let x = 2 < 3 + 0 in 1 + x * 1 end"), Eq("2"));
+  EXPECT_THAT(
+      simplified("let x = 5 + (2 + -2) in loop y = x in y * 1 + 0 end end"),
+      Eq(printed("loop y = 5 in y end")));
+  EXPECT_THAT(simplified("loop y = 3 in - -y end"),
+              Eq(printed("loop y = 3 in y end")));
+}
+
+TEST_F(SimplifierTest, RemovesDoubleNegationOnlyWhereTruthMatters) {
+  // !!y is 1 for y = 3, so it stays where its value is used.
+  EXPECT_THAT(simplified("loop y = 3 in !!y end"),
+              Eq(printed("loop y = 3 in !!y end")));
+  EXPECT_THAT(simplified("loop y = 3 in if !!y then 1 else 2 end end"),
+              Eq(printed("loop y = 3 in if y then 1 else 2 end end")));
+  EXPECT_THAT(simplified("loop y = 3 in !!(y < 2) end"),
+              Eq(printed("loop y = 3 in y < 2 end")));
+}
+
+TEST_F(SimplifierTest, EliminatesConstantConditions) {
+  EXPECT_THAT(simplified("loop y = 3 in if 1 < 2 then y else y * 2 end end"),
+              Eq(printed("loop y = 3 in y end")));
+  EXPECT_THAT(simplified("loop y = 3 in 0 && y < 2 end"),
+              Eq(printed("loop y = 3 in 0 end")));
+  EXPECT_THAT(simplified("loop y = 3 in 1 && y < 2 end"),
+              Eq(printed("loop y = 3 in y < 2 end")));
+  // The value of y decides 1 && y, so it is kept.
+  EXPECT_THAT(simplified("loop y = 3 in 1 && y end"),
+              Eq(printed("loop y = 3 in 1 && y end")));
+}
+
+TEST_F(SimplifierTest, ReportsRemovedNodes) {
+  auto ast = parse_source("(1 + 2) * 3");
+  EXPECT_THAT(count_nodes(*ast), Eq(6));
+  EXPECT_THAT(Simplifier().simplify(*ast), Eq(5));
+  EXPECT_THAT(count_nodes(*ast), Eq(1));
+}
+
+TEST_F(SimplifierTest, PreservesResults) {
+  for (std::string file :
+       {"examples/if_statement.sl", "examples/not_expression.sl",
+        "examples/negative_expression.sl", "examples/logical_expression.sl",
+        "examples/overflow.sl", "examples/shadowing.sl",
+        "examples/sibling_lets.sl", "examples/factorial_loop.sl",
+        "examples/shiftl_loop.sl", "examples/swap_loop.sl",
+        "examples/nested_loop.sl", "examples/functions.sl",
+        "examples/nextprime.sl"}) {
+    Parser parser(file);
+    ASSERT_TRUE(parser.parse()) << file;
+    auto ast = parser.ast();
+    std::vector<int64_t> arguments(ast->inputs().size(), 1000);
+    int64_t expected = ast->eval(arguments);
+    size_t nodes = count_nodes(*ast);
+    size_t removed = Simplifier().simplify(*ast);
+    EXPECT_THAT(count_nodes(*ast), Eq(nodes - removed)) << file;
+    EXPECT_THAT(ast->eval(arguments), Eq(expected)) << file;
+  }
+  Parser parser("examples/nextprime.sl");
+  ASSERT_TRUE(parser.parse());
+  EXPECT_THAT(Simplifier().simplify(*parser.ast()), Gt(0));
+}
+
+}  // namespace
+}  // namespace simp
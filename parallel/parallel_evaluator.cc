@@ -0,0 +1,763 @@
+#include "parallel_evaluator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <utility>
+
+namespace simp {
+
+namespace {
+// Costs saturate here rather than overflow on deeply nested loops.
+constexpr uint64_t kMaxCost = uint64_t{1} << 48;
+
+uint64_t add(uint64_t left, uint64_t right) {
+  return std::min(left + right, kMaxCost);
+}
+
+uint64_t times(uint64_t cost, uint64_t factor) {
+  return cost > kMaxCost / factor ? kMaxCost : cost * factor;
+}
+
+// Whether expression reads a variable in a slot from low up to high. Calls
+// are not followed, since a callee has a frame of its own.
+bool refers_to(Expression* expression, int low, int high) {
+  switch (expression->type()) {
+    case ExpressionType::INTEGER:
+      return false;
+    case ExpressionType::IDENTIFIER: {
+      int slot = static_cast<IdentifierExpression*>(expression)->slot();
+      return low <= slot && slot < high;
+    }
+    case ExpressionType::PARENTHESIS:
+      return refers_to(
+          static_cast<ParenthesizedExpression*>(expression)->expression().get(),
+          low, high);
+    case ExpressionType::NOT:
+      return refers_to(
+          static_cast<NotExpression*>(expression)->expression().get(), low,
+          high);
+    case ExpressionType::NEGATIVE:
+      return refers_to(
+          static_cast<NegativeExpression*>(expression)->expression().get(),
+          low, high);
+    case ExpressionType::BINARY: {
+      auto binary = static_cast<BinaryExpression*>(expression);
+      return refers_to(binary->left().get(), low, high) ||
+             refers_to(binary->right().get(), low, high);
+    }
+    case ExpressionType::IF: {
+      auto if_expression = static_cast<IfExpression*>(expression);
+      return refers_to(if_expression->condition().get(), low, high) ||
+             refers_to(if_expression->consequent().get(), low, high) ||
+             refers_to(if_expression->alternative().get(), low, high);
+    }
+    case ExpressionType::LET:
+    case ExpressionType::LOOP: {
+      bool is_let = expression->type() == ExpressionType::LET;
+      Bindings& bindings =
+          is_let ? static_cast<LetExpression*>(expression)->bindings()
+                 : static_cast<LoopExpression*>(expression)->bindings();
+      for (const auto& binding : bindings) {
+        if (refers_to(binding->expression().get(), low, high)) {
+          return true;
+        }
+      }
+      return refers_to(
+          is_let ? static_cast<LetExpression*>(expression)->expression().get()
+                 : static_cast<LoopExpression*>(expression)->expression().get(),
+          low, high);
+    }
+    case ExpressionType::RECUR:
+      for (const auto& argument :
+           static_cast<RecurExpression*>(expression)->arguments()) {
+        if (refers_to(argument.get(), low, high)) {
+          return true;
+        }
+      }
+      return false;
+    case ExpressionType::CALL:
+      for (const auto& argument :
+           static_cast<CallExpression*>(expression)->arguments()) {
+        if (refers_to(argument.get(), low, high)) {
+          return true;
+        }
+      }
+      return false;
+    case ExpressionType::INTRINSIC:
+      for (const auto& argument :
+           static_cast<IntrinsicExpression*>(expression)->arguments()) {
+        if (refers_to(argument.get(), low, high)) {
+          return true;
+        }
+      }
+      return false;
+  }
+  return false;
+}
+
+Expression* unparenthesize(Expression* expression) {
+  while (expression->type() == ExpressionType::PARENTHESIS) {
+    expression =
+        static_cast<ParenthesizedExpression*>(expression)->expression().get();
+  }
+  return expression;
+}
+
+// Whether every recur in tail position of expression, the body of a loop, is
+// recur (i + c) for the variable i in slot and the same nonzero constant c,
+// which goes to step. Recurs of loops nested in the body jump to those.
+bool steps_by_constant(Expression* expression, int slot, bool& found,
+                       int64_t& step) {
+  switch (expression->type()) {
+    case ExpressionType::PARENTHESIS:
+      return steps_by_constant(
+          static_cast<ParenthesizedExpression*>(expression)->expression().get(),
+          slot, found, step);
+    case ExpressionType::IF: {
+      auto if_expression = static_cast<IfExpression*>(expression);
+      return steps_by_constant(if_expression->consequent().get(), slot, found,
+                               step) &&
+             steps_by_constant(if_expression->alternative().get(), slot, found,
+                               step);
+    }
+    case ExpressionType::LET:
+      return steps_by_constant(
+          static_cast<LetExpression*>(expression)->expression().get(), slot,
+          found, step);
+    case ExpressionType::RECUR: {
+      auto& arguments = static_cast<RecurExpression*>(expression)->arguments();
+      if (arguments.size() != 1) {
+        return false;
+      }
+      Expression* argument = unparenthesize(arguments[0].get());
+      if (argument->type() != ExpressionType::BINARY) {
+        return false;
+      }
+      auto binary = static_cast<BinaryExpression*>(argument);
+      Expression* variable = unparenthesize(binary->left().get());
+      Expression* constant = unparenthesize(binary->right().get());
+      if (variable->type() == ExpressionType::INTEGER) {
+        std::swap(variable, constant);
+      }
+      if (binary->op() != Operator::PLUS ||
+          variable->type() != ExpressionType::IDENTIFIER ||
+          static_cast<IdentifierExpression*>(variable)->slot() != slot ||
+          constant->type() != ExpressionType::INTEGER) {
+        return false;
+      }
+      int64_t value = static_cast<IntExpression*>(constant)->value();
+      if (value == 0 || (found && value != step)) {
+        return false;
+      }
+      found = true;
+      step = value;
+      return true;
+    }
+    default:
+      return true;
+  }
+}
+
+// A search loop being run on the pool. Its iterations are numbered from 0,
+// and bound is the earliest one known to have exited, or to have thrown.
+struct Search {
+  // The search and iteration that started this one, if any.
+  const Search* parent;
+  uint64_t parent_iteration;
+  std::atomic<uint64_t> next_chunk{1};
+  std::atomic<uint64_t> bound{std::numeric_limits<uint64_t>::max()};
+  std::mutex mutex;
+  int64_t result = 0;
+  std::exception_ptr error;
+};
+
+// Thrown out of a search that is no longer needed.
+struct Cancelled {};
+
+// The search iteration the current thread is running, if any.
+thread_local const Search* current_search = nullptr;
+thread_local uint64_t current_iteration = 0;
+
+class IterationScope {
+ public:
+  IterationScope(const Search* search, uint64_t iteration)
+      : search_(current_search), iteration_(current_iteration) {
+    current_search = search;
+    current_iteration = iteration;
+  }
+  ~IterationScope() {
+    current_search = search_;
+    current_iteration = iteration_;
+  }
+
+ private:
+  const Search* search_;
+  uint64_t iteration_;
+};
+
+// Whether an iteration of search, or one of the iterations that started it,
+// comes after an iteration already known to exit.
+bool obsolete(const Search* search, uint64_t iteration) {
+  for (; search; iteration = search->parent_iteration,
+                 search = search->parent) {
+    if (search->bound.load(std::memory_order_relaxed) < iteration) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Stops the current thread's iteration, and what it runs, once it is known to
+// come too late.
+void cancel_if_obsolete() {
+  if (current_search && obsolete(current_search, current_iteration)) {
+    throw Cancelled();
+  }
+}
+}  // namespace
+
+ParallelEvaluator::ParallelEvaluator(Ast& ast, ThreadPool& pool,
+                                     uint64_t grain)
+    : ast_(ast),
+      pool_(pool),
+      grain_(std::max<uint64_t>(grain, 1)),
+      function_costs_(ast.functions().size(), 0),
+      function_forks_(ast.functions().size(), false) {
+  // A function only calls those defined before it and itself.
+  for (size_t i = 0; i < ast.functions().size(); ++i) {
+    analyze_function(i);
+  }
+  current_function_ = ast.functions().size();
+  analyze(ast.root().get());
+  for (const auto& function : ast.functions()) {
+    find_repetition(function->body().get());
+  }
+  find_repetition(ast.root().get());
+}
+
+bool ParallelEvaluator::find_repetition(Expression* expression) {
+  bool repeats = false;
+  auto children = [this, &repeats](
+                      std::vector<std::unique_ptr<Expression>>& children) {
+    for (const auto& child : children) {
+      repeats = find_repetition(child.get()) || repeats;
+    }
+  };
+  switch (expression->type()) {
+    case ExpressionType::INTEGER:
+    case ExpressionType::IDENTIFIER:
+      break;
+    case ExpressionType::PARENTHESIS:
+      repeats = find_repetition(
+          static_cast<ParenthesizedExpression*>(expression)->expression().get());
+      break;
+    case ExpressionType::NOT:
+      repeats = find_repetition(
+          static_cast<NotExpression*>(expression)->expression().get());
+      break;
+    case ExpressionType::NEGATIVE:
+      repeats = find_repetition(
+          static_cast<NegativeExpression*>(expression)->expression().get());
+      break;
+    case ExpressionType::BINARY: {
+      auto binary = static_cast<BinaryExpression*>(expression);
+      repeats = find_repetition(binary->left().get());
+      repeats = find_repetition(binary->right().get()) || repeats;
+      break;
+    }
+    case ExpressionType::IF: {
+      auto if_expression = static_cast<IfExpression*>(expression);
+      repeats = find_repetition(if_expression->condition().get());
+      repeats = find_repetition(if_expression->consequent().get()) || repeats;
+      repeats = find_repetition(if_expression->alternative().get()) || repeats;
+      break;
+    }
+    case ExpressionType::LET:
+    case ExpressionType::LOOP: {
+      bool is_let = expression->type() == ExpressionType::LET;
+      Bindings& bindings =
+          is_let ? static_cast<LetExpression*>(expression)->bindings()
+                 : static_cast<LoopExpression*>(expression)->bindings();
+      for (const auto& binding : bindings) {
+        repeats = find_repetition(binding->expression().get()) || repeats;
+      }
+      repeats =
+          find_repetition(
+              is_let
+                  ? static_cast<LetExpression*>(expression)->expression().get()
+                  : static_cast<LoopExpression*>(expression)
+                        ->expression()
+                        .get()) ||
+          repeats || !is_let;
+      break;
+    }
+    case ExpressionType::RECUR:
+      children(static_cast<RecurExpression*>(expression)->arguments());
+      break;
+    case ExpressionType::CALL:
+      children(static_cast<CallExpression*>(expression)->arguments());
+      repeats = true;
+      break;
+    case ExpressionType::INTRINSIC:
+      children(static_cast<IntrinsicExpression*>(expression)->arguments());
+      break;
+  }
+  if (repeats) {
+    repeating_.insert(expression);
+  }
+  return repeats;
+}
+
+void ParallelEvaluator::analyze_function(size_t function) {
+  current_function_ = function;
+  recursive_ = false;
+  Expression* body = ast_.functions()[function]->body().get();
+  uint64_t cost = analyze(body);
+  if (!recursive_) {
+    function_costs_[function] = cost;
+    function_forks_[function] = forking_.count(body);
+    return;
+  }
+  // Calls to itself counted as free so far. Once the function's cost and
+  // forking are known, the calls are analyzed again with them.
+  function_costs_[function] = times(cost, kAssumedIterations);
+  function_forks_[function] = forking_.count(body);
+  analyze(body);
+  function_forks_[function] = forking_.count(body);
+}
+
+uint64_t ParallelEvaluator::cost(Expression* expression) const {
+  auto it = costs_.find(expression);
+  return it == costs_.end() ? 0 : it->second;
+}
+
+uint64_t ParallelEvaluator::analyze(Expression* expression) {
+  uint64_t cost = 1;
+  bool forks = false;
+  auto child = [this, &forks](Expression* child) {
+    uint64_t child_cost = analyze(child);
+    forks = forks || forking_.count(child);
+    return child_cost;
+  };
+  switch (expression->type()) {
+    case ExpressionType::INTEGER:
+    case ExpressionType::IDENTIFIER:
+      break;
+    case ExpressionType::PARENTHESIS:
+      cost = add(cost, child(static_cast<ParenthesizedExpression*>(expression)
+                                 ->expression()
+                                 .get()));
+      break;
+    case ExpressionType::NOT:
+      cost = add(
+          cost,
+          child(static_cast<NotExpression*>(expression)->expression().get()));
+      break;
+    case ExpressionType::NEGATIVE:
+      cost = add(cost, child(static_cast<NegativeExpression*>(expression)
+                                 ->expression()
+                                 .get()));
+      break;
+    case ExpressionType::BINARY: {
+      auto binary = static_cast<BinaryExpression*>(expression);
+      cost = add(cost, child(binary->left().get()));
+      cost = add(cost, child(binary->right().get()));
+      break;
+    }
+    case ExpressionType::IF: {
+      auto if_expression = static_cast<IfExpression*>(expression);
+      cost = add(cost, child(if_expression->condition().get()));
+      cost = add(cost, std::max(child(if_expression->consequent().get()),
+                                child(if_expression->alternative().get())));
+      break;
+    }
+    case ExpressionType::LET: {
+      auto let = static_cast<LetExpression*>(expression);
+      cost = add(cost, analyze_bindings(expression, let->bindings()));
+      cost = add(cost, child(let->expression().get()));
+      forks = forks || fork_points_.count(expression);
+      for (const auto& binding : let->bindings()) {
+        forks = forks || forking_.count(binding->expression().get());
+      }
+      break;
+    }
+    case ExpressionType::LOOP: {
+      auto loop = static_cast<LoopExpression*>(expression);
+      cost = add(cost, analyze_bindings(expression, loop->bindings()));
+      uint64_t body = child(loop->expression().get());
+      cost = add(cost, times(body, kAssumedIterations));
+      forks = forks || fork_points_.count(expression);
+      bool found = false;
+      int64_t step = 0;
+      // With a single thread, a search would only add the cost of chunks.
+      if (pool_.threads() > 1 && loop->bindings().size() == 1 &&
+          steps_by_constant(loop->expression().get(),
+                            loop->bindings().front()->slot(), found, step) &&
+          found) {
+        searches_[expression] = {step, std::max<uint64_t>(grain_ / body, 1)};
+        forks = true;
+      } else {
+        searches_.erase(expression);
+      }
+      for (const auto& binding : loop->bindings()) {
+        forks = forks || forking_.count(binding->expression().get());
+      }
+      break;
+    }
+    case ExpressionType::RECUR:
+    case ExpressionType::CALL:
+    case ExpressionType::INTRINSIC: {
+      auto& arguments =
+          expression->type() == ExpressionType::RECUR
+              ? static_cast<RecurExpression*>(expression)->arguments()
+          : expression->type() == ExpressionType::CALL
+              ? static_cast<CallExpression*>(expression)->arguments()
+              : static_cast<IntrinsicExpression*>(expression)->arguments();
+      cost = add(cost, analyze_arguments(expression, arguments));
+      forks = fork_points_.count(expression);
+      for (const auto& argument : arguments) {
+        forks = forks || forking_.count(argument.get());
+      }
+      if (expression->type() == ExpressionType::CALL) {
+        size_t callee = static_cast<CallExpression*>(expression)->function();
+        recursive_ = recursive_ || callee == current_function_;
+        cost = add(cost, function_costs_[callee]);
+        forks = forks || function_forks_[callee];
+      }
+      break;
+    }
+  }
+  costs_[expression] = cost;
+  if (forks) {
+    forking_.insert(expression);
+  } else {
+    forking_.erase(expression);
+  }
+  return cost;
+}
+
+uint64_t ParallelEvaluator::analyze_bindings(Expression* node,
+                                             Bindings& bindings) {
+  uint64_t cost = 0;
+  std::vector<size_t> forked;
+  for (size_t i = 0; i < bindings.size(); ++i) {
+    uint64_t binding_cost = analyze(bindings[i]->expression().get());
+    cost = add(cost, binding_cost);
+    // The bindings take consecutive slots, and each one sees those before.
+    if (binding_cost >= grain_ &&
+        !refers_to(bindings[i]->expression().get(), bindings.front()->slot(),
+                   bindings[i]->slot())) {
+      forked.push_back(i);
+    }
+  }
+  if (forked.size() >= 2) {
+    fork_points_[node] = std::move(forked);
+  } else {
+    fork_points_.erase(node);
+  }
+  return cost;
+}
+
+uint64_t ParallelEvaluator::analyze_arguments(
+    Expression* node, std::vector<std::unique_ptr<Expression>>& arguments) {
+  uint64_t cost = 0;
+  std::vector<size_t> forked;
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    uint64_t argument_cost = analyze(arguments[i].get());
+    cost = add(cost, argument_cost);
+    if (argument_cost >= grain_) {
+      forked.push_back(i);
+    }
+  }
+  if (forked.size() >= 2) {
+    fork_points_[node] = std::move(forked);
+  } else {
+    fork_points_.erase(node);
+  }
+  return cost;
+}
+
+int64_t ParallelEvaluator::eval(const std::vector<int64_t>& arguments,
+                                MemoCache* memo_cache) {
+  Environment environment(ast_.frame_size(), &ast_.functions(), memo_cache);
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    environment.set(i, arguments[i]);
+  }
+  return evaluate(ast_.root().get(), environment);
+}
+
+int64_t ParallelEvaluator::evaluate(Expression* expression,
+                                    Environment& environment) {
+  if (!forking_.count(expression) &&
+      !(current_search && repeating_.count(expression))) {
+    return expression->evaluate(environment);
+  }
+  // The cases below evaluate as Expression::evaluate does, only through
+  // this function, so that forks further down are found.
+  switch (expression->type()) {
+    case ExpressionType::INTEGER:
+    case ExpressionType::IDENTIFIER:
+      return expression->evaluate(environment);
+    case ExpressionType::PARENTHESIS:
+      return evaluate(
+          static_cast<ParenthesizedExpression*>(expression)->expression().get(),
+          environment);
+    case ExpressionType::NOT:
+      return !evaluate(
+          static_cast<NotExpression*>(expression)->expression().get(),
+          environment);
+    case ExpressionType::NEGATIVE:
+      return wrapping_negate(evaluate(
+          static_cast<NegativeExpression*>(expression)->expression().get(),
+          environment));
+    case ExpressionType::BINARY: {
+      auto binary = static_cast<BinaryExpression*>(expression);
+      Expression* left = binary->left().get();
+      Expression* right = binary->right().get();
+      switch (binary->op()) {
+        case Operator::PLUS:
+          return wrapping_add(evaluate(left, environment),
+                              evaluate(right, environment));
+        case Operator::TIMES:
+          return wrapping_multiply(evaluate(left, environment),
+                                   evaluate(right, environment));
+        case Operator::LESS_THAN:
+          return evaluate(left, environment) < evaluate(right, environment);
+        case Operator::LOGICAL_AND:
+          return evaluate(left, environment) && evaluate(right, environment);
+        case Operator::LOGICAL_OR:
+          return evaluate(left, environment) || evaluate(right, environment);
+        case Operator::EQUALS:
+          return evaluate(left, environment) == evaluate(right, environment);
+        default:
+          return 0;
+      }
+    }
+    case ExpressionType::IF: {
+      auto if_expression = static_cast<IfExpression*>(expression);
+      if (evaluate(if_expression->condition().get(), environment)) {
+        return evaluate(if_expression->consequent().get(), environment);
+      }
+      return evaluate(if_expression->alternative().get(), environment);
+    }
+    case ExpressionType::LET: {
+      auto let = static_cast<LetExpression*>(expression);
+      evaluate_bindings(expression, let->bindings(), environment);
+      return evaluate(let->expression().get(), environment);
+    }
+    case ExpressionType::LOOP: {
+      auto loop = static_cast<LoopExpression*>(expression);
+      if (searches_.count(expression)) {
+        return search(loop, environment);
+      }
+      evaluate_bindings(expression, loop->bindings(), environment);
+      for (;;) {
+        int64_t result = evaluate(loop->expression().get(), environment);
+        if (!environment.recurring()) {
+          return result;
+        }
+        cancel_if_obsolete();
+        environment.finish_recur(loop->bindings().front()->slot(),
+                                 loop->bindings().size());
+      }
+    }
+    case ExpressionType::RECUR: {
+      std::vector<int64_t> values;
+      evaluate_arguments(expression,
+                         static_cast<RecurExpression*>(expression)->arguments(),
+                         environment, values);
+      for (int64_t value : values) {
+        environment.push_recur_argument(value);
+      }
+      environment.start_recur();
+      return 0;
+    }
+    case ExpressionType::CALL:
+      return call(static_cast<CallExpression*>(expression), environment);
+    case ExpressionType::INTRINSIC: {
+      auto intrinsic = static_cast<IntrinsicExpression*>(expression);
+      std::vector<int64_t> values;
+      evaluate_arguments(expression, intrinsic->arguments(), environment,
+                         values);
+      return apply_intrinsic(intrinsic->intrinsic(), values[0],
+                             values.size() > 1 ? values[1] : 0);
+    }
+  }
+  return 0;
+}
+
+void ParallelEvaluator::fork(const std::vector<size_t>& indices,
+                             const std::vector<Expression*>& children,
+                             const Environment& environment,
+                             std::vector<int64_t>& values) {
+  std::vector<std::function<void()>> tasks;
+  for (size_t index : indices) {
+    // The task belongs to the same iteration as the fork, if any.
+    tasks.push_back([this, child = children[index], &environment, &values,
+                     index, search = current_search,
+                     iteration = current_iteration]() {
+      IterationScope scope(search, iteration);
+      Environment copy = environment;
+      values[index] = evaluate(child, copy);
+    });
+  }
+  pool_.run(tasks);
+}
+
+void ParallelEvaluator::evaluate_bindings(Expression* node, Bindings& bindings,
+                                          Environment& environment) {
+  auto forked = fork_points_.find(node);
+  if (forked == fork_points_.end()) {
+    for (const auto& binding : bindings) {
+      environment.set(binding->slot(),
+                      evaluate(binding->expression().get(), environment));
+    }
+    return;
+  }
+  // The forked bindings see none of the others, so they can be evaluated
+  // first, from the environment as it is before the let.
+  std::vector<Expression*> children;
+  for (const auto& binding : bindings) {
+    children.push_back(binding->expression().get());
+  }
+  std::vector<int64_t> values(bindings.size());
+  fork(forked->second, children, environment, values);
+  size_t next = 0;
+  for (size_t i = 0; i < bindings.size(); ++i) {
+    if (next < forked->second.size() && forked->second[next] == i) {
+      ++next;
+    } else {
+      values[i] = evaluate(children[i], environment);
+    }
+    environment.set(bindings[i]->slot(), values[i]);
+  }
+}
+
+void ParallelEvaluator::evaluate_arguments(
+    Expression* node, std::vector<std::unique_ptr<Expression>>& arguments,
+    Environment& environment, std::vector<int64_t>& values) {
+  values.resize(arguments.size());
+  auto forked = fork_points_.find(node);
+  size_t next = 0;
+  if (forked != fork_points_.end()) {
+    std::vector<Expression*> children;
+    for (const auto& argument : arguments) {
+      children.push_back(argument.get());
+    }
+    fork(forked->second, children, environment, values);
+  }
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    if (forked != fork_points_.end() && next < forked->second.size() &&
+        forked->second[next] == i) {
+      ++next;
+    } else {
+      values[i] = evaluate(arguments[i].get(), environment);
+    }
+  }
+}
+
+int64_t ParallelEvaluator::call(CallExpression* call,
+                                Environment& environment) {
+  cancel_if_obsolete();
+  uint32_t index = call->function();
+  Function& callee = *ast_.functions()[index];
+  std::vector<int64_t> values;
+  evaluate_arguments(call, call->arguments(), environment, values);
+  MemoCache* memo_cache = environment.memo_cache();
+  bool memoized = memo_cache && memo_cache->memoized(index);
+  int64_t result;
+  if (memoized &&
+      memo_cache->lookup(index, values.data(), values.size(), result)) {
+    return result;
+  }
+  Environment frame(callee.frame_size(), environment.functions(), memo_cache);
+  for (size_t i = 0; i < values.size(); ++i) {
+    frame.set(i, values[i]);
+  }
+  result = evaluate(callee.body().get(), frame);
+  if (memoized) {
+    memo_cache->insert(index, values.data(), values.size(), result);
+  }
+  return result;
+}
+
+bool ParallelEvaluator::iterate(Expression* body, int slot, int64_t i,
+                                Environment& environment, int64_t& result) {
+  environment.set(slot, i);
+  result = evaluate(body, environment);
+  if (!environment.recurring()) {
+    return true;
+  }
+  // The argument is i + step, which the next iteration sets anyway.
+  environment.finish_recur(slot, 1);
+  return false;
+}
+
+int64_t ParallelEvaluator::search(LoopExpression* loop,
+                                  Environment& environment) {
+  const SearchLoop& search_loop = searches_.at(loop);
+  int slot = loop->bindings().front()->slot();
+  Expression* body = loop->expression().get();
+  int64_t first =
+      evaluate(loop->bindings().front()->expression().get(), environment);
+  auto variable = [&](uint64_t iteration) {
+    return wrapping_add(
+        first, wrapping_multiply(static_cast<int64_t>(iteration),
+                                 search_loop.step));
+  };
+  // Most searches end early, so the first chunk runs here without a task.
+  int64_t result;
+  for (uint64_t k = 0; k < search_loop.chunk; ++k) {
+    cancel_if_obsolete();
+    if (iterate(body, slot, variable(k), environment, result)) {
+      return result;
+    }
+  }
+  Search search;
+  search.parent = current_search;
+  search.parent_iteration = current_iteration;
+  auto record = [&search](uint64_t k, int64_t result, std::exception_ptr error) {
+    std::lock_guard<std::mutex> lock(search.mutex);
+    if (k < search.bound.load(std::memory_order_relaxed)) {
+      search.result = result;
+      search.error = error;
+      search.bound.store(k, std::memory_order_relaxed);
+    }
+  };
+  auto scan = [&]() {
+    Environment copy = environment;
+    for (;;) {
+      uint64_t start =
+          search.next_chunk.fetch_add(1, std::memory_order_relaxed) *
+          search_loop.chunk;
+      for (uint64_t k = start; k < start + search_loop.chunk; ++k) {
+        if (obsolete(&search, k)) {
+          return;
+        }
+        IterationScope scope(&search, k);
+        try {
+          int64_t result;
+          if (iterate(body, slot, variable(k), copy, result)) {
+            record(k, result, nullptr);
+            return;
+          }
+        } catch (...) {
+          record(k, 0, std::current_exception());
+          return;
+        }
+      }
+    }
+  };
+  pool_.run(std::vector<std::function<void()>>(pool_.threads(), scan));
+  cancel_if_obsolete();
+  if (search.error) {
+    std::rethrow_exception(search.error);
+  }
+  return search.result;
+}
+
+}  // namespace simp
@@ -0,0 +1,124 @@
+#pragma once
+
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <glog/logging.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ast/ast.h"
+#include "memo/memo_cache.h"
+#include "parallel/thread_pool.h"
+
+namespace simp {
+// Evaluates a resolved Ast like Ast::eval, but runs independent
+// subexpressions on a ThreadPool. Evaluation has no side effects, so the
+// arguments of a call, recur or intrinsic can always run concurrently, and so
+// can the bindings of a let or loop that do not refer to the bindings before
+// them. Each forked subexpression gets a copy of the Environment, since
+// variables it binds itself reuse the slots of its siblings.
+//
+// Forking costs a task and a copy of the frame, so it is only worth it for
+// expensive subexpressions. A static estimate (see cost()) picks them when
+// the evaluator is built: a node forks when at least two of its independent
+// children cost grain or more, and only those children go to the pool. Nodes
+// with no fork anywhere below them, counting the functions they call, run on
+// the plain tree evaluator.
+//
+// A loop with a single binding i whose every recur is recur (i + c), for the
+// same constant c, is a search: its iterations depend on nothing but i, and it
+// returns the value of the first one that does not recur. Such a loop runs
+// its first grain nodes' worth of iterations on the calling thread. If none
+// exits, the threads of the pool take the following iterations in chunks of
+// that size, in order, and stop once an iteration before theirs has exited.
+// Later iterations may have been started by then, but only the earliest exit
+// counts, so the result is the one sequential evaluation gives. Searches
+// nested in iterations that turn out to be too late are cancelled as well,
+// and so is any loop or call such an iteration runs: while an iteration is
+// speculative, every loop back edge and every call first checks that it is
+// still needed. A pool of one thread runs no searches.
+class ParallelEvaluator {
+ public:
+  // Estimated node evaluations a subexpression needs before it is forked.
+  static constexpr uint64_t kDefaultGrain = 4096;
+  // How often a loop is assumed to iterate, and a self-recursive function to
+  // call itself, since neither is known before running.
+  static constexpr uint64_t kAssumedIterations = 32;
+
+  ParallelEvaluator(Ast& ast, ThreadPool& pool,
+                    uint64_t grain = kDefaultGrain);
+
+  // As Ast::eval.
+  int64_t eval(const std::vector<int64_t>& arguments = {},
+               MemoCache* memo_cache = nullptr);
+
+  // The estimated cost of an expression of the Ast: one per node, where an
+  // if costs its more expensive branch, a loop kAssumedIterations times its
+  // body and a call the cost of the callee's body on top of its arguments.
+  uint64_t cost(Expression* expression) const;
+  // The number of nodes that fork.
+  size_t fork_points() const { return fork_points_.size(); }
+  // The number of loops run as searches.
+  size_t searches() const { return searches_.size(); }
+
+ private:
+  // Estimates expression, recording its cost and whether anything under it
+  // forks.
+  uint64_t analyze(Expression* expression);
+  uint64_t analyze_bindings(Expression* node, Bindings& bindings);
+  uint64_t analyze_arguments(
+      Expression* node, std::vector<std::unique_ptr<Expression>>& arguments);
+  void analyze_function(size_t function);
+  // Records whether expression contains a loop or a call in repeating_.
+  bool find_repetition(Expression* expression);
+
+  int64_t evaluate(Expression* expression, Environment& environment);
+  void evaluate_bindings(Expression* node, Bindings& bindings,
+                         Environment& environment);
+  void evaluate_arguments(Expression* node,
+                          std::vector<std::unique_ptr<Expression>>& arguments,
+                          Environment& environment,
+                          std::vector<int64_t>& values);
+  // Evaluates the children of node at indices, each in a copy of
+  // environment, into values.
+  void fork(const std::vector<size_t>& indices,
+            const std::vector<Expression*>& children,
+            const Environment& environment, std::vector<int64_t>& values);
+  int64_t call(CallExpression* call, Environment& environment);
+  int64_t search(LoopExpression* loop, Environment& environment);
+  // Runs the body of a search loop for the value i of its variable in slot,
+  // returning whether it exited, with result.
+  bool iterate(Expression* body, int slot, int64_t i, Environment& environment,
+               int64_t& result);
+
+  Ast& ast_;
+  ThreadPool& pool_;
+  uint64_t grain_;
+  std::unordered_map<Expression*, uint64_t> costs_;
+  // Nodes with a fork point under them or in a function they call.
+  std::unordered_set<Expression*> forking_;
+  // For each node that forks, the children that go to the pool: bindings or
+  // arguments by index.
+  std::unordered_map<Expression*, std::vector<size_t>> fork_points_;
+  // For each search loop, the constant its variable steps by and the
+  // iterations in a chunk.
+  struct SearchLoop {
+    int64_t step;
+    uint64_t chunk;
+  };
+  std::unordered_map<Expression*, SearchLoop> searches_;
+  // Nodes with a loop or a call under them, which a speculative iteration
+  // evaluates through evaluate() so that it can be cancelled.
+  std::unordered_set<Expression*> repeating_;
+  std::vector<uint64_t> function_costs_;
+  std::vector<bool> function_forks_;
+  // The function being analyzed, whose calls to itself are recursion.
+  size_t current_function_ = 0;
+  bool recursive_ = false;
+};
+}  // namespace simp
@@ -0,0 +1,139 @@
+#include "parallel/parallel_evaluator.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "parser/parser.h"
+
+namespace simp {
+namespace {
+using ::testing::Eq;
+using ::testing::Gt;
+class ParallelEvaluatorTest : public ::testing::Test {
+ protected:
+  ParallelEvaluatorTest() : pool_(4) {}
+  ~ParallelEvaluatorTest() override {}
+  void SetUp() override {}
+
+  std::unique_ptr<Ast> parse(const std::string& file) {
+    Parser parser(file);
+    EXPECT_TRUE(parser.parse());
+    return parser.ast();
+  }
+
+  ThreadPool pool_;
+};
+
+TEST_F(ParallelEvaluatorTest, MatchesTreeEvaluation) {
+  for (std::string file :
+       {"examples/just_nums.sl", "examples/if_statement.sl",
+        "examples/not_expression.sl", "examples/negative_expression.sl",
+        "examples/parenthesized_expression.sl",
+        "examples/logical_expression.sl", "examples/overflow.sl",
+        "examples/shadowing.sl", "examples/sibling_lets.sl",
+        "examples/factorial_loop.sl", "examples/shiftl_loop.sl",
+        "examples/swap_loop.sl", "examples/nested_loop.sl",
+        "examples/functions.sl", "examples/intrinsics.sl"}) {
+    auto ast = parse(file);
+    // A grain of 1 forks wherever the evaluator can.
+    for (uint64_t grain : {uint64_t{1}, ParallelEvaluator::kDefaultGrain}) {
+      ParallelEvaluator evaluator(*ast, pool_, grain);
+      EXPECT_THAT(evaluator.eval(), Eq(ast->eval())) << file << " " << grain;
+    }
+  }
+}
+
+TEST_F(ParallelEvaluatorTest, CallsFunctions) {
+  auto ast = parse("examples/nextprime.sl");
+  ParallelEvaluator evaluator(*ast, pool_, 1);
+  for (int64_t n : {1, 100, 10000}) {
+    EXPECT_THAT(evaluator.eval({n}), Eq(ast->eval({n}))) << n;
+  }
+}
+
+TEST_F(ParallelEvaluatorTest, LeavesCheapExpressionsAlone) {
+  for (std::string file : {"examples/nested_loop.sl", "examples/functions.sl",
+                           "examples/nextprime.sl"}) {
+    auto ast = parse(file);
+    ParallelEvaluator evaluator(*ast, pool_);
+    EXPECT_THAT(evaluator.fork_points(), Eq(0)) << file;
+  }
+}
+
+TEST_F(ParallelEvaluatorTest, ForksExpensiveArguments) {
+  auto ast = parse("examples/wide_calls.sl");
+  ParallelEvaluator evaluator(*ast, pool_);
+  // Only the four countprimes calls of main are worth a task.
+  EXPECT_THAT(evaluator.fork_points(), Eq(1));
+  EXPECT_THAT(evaluator.cost(ast->root().get()),
+              Gt(4 * ParallelEvaluator::kDefaultGrain));
+  EXPECT_THAT(evaluator.eval({1000}), Eq(550));
+  EXPECT_THAT(evaluator.eval({1000}), Eq(ast->eval({1000})));
+}
+
+TEST_F(ParallelEvaluatorTest, FindsSearchLoops) {
+  auto ast = parse("examples/nextprime.sl");
+  ParallelEvaluator evaluator(*ast, pool_);
+  // The loops of isprime and nextprime; the one of sqrt has two variables.
+  EXPECT_THAT(evaluator.searches(), Eq(2));
+  ThreadPool one_thread(1);
+  EXPECT_THAT(ParallelEvaluator(*ast, one_thread).searches(), Eq(0));
+  for (std::string file : {"examples/factorial_loop.sl",
+                           "examples/swap_loop.sl", "examples/long_loop.sl"}) {
+    auto ast = parse(file);
+    EXPECT_THAT(ParallelEvaluator(*ast, pool_).searches(), Eq(0)) << file;
+  }
+}
+
+TEST_F(ParallelEvaluatorTest, FindsTheFirstExitOfASearch) {
+  auto ast = parse("examples/search_loop.sl");
+  // A grain of 1 gives chunks of one iteration, the most speculation there
+  // can be. Iterations after the first exit often exit too, with other
+  // values.
+  ParallelEvaluator evaluator(*ast, pool_, 1);
+  EXPECT_THAT(evaluator.searches(), Eq(1));
+  for (int i = 0; i < 10; ++i) {
+    for (int64_t n : {1, 2, 15, 49, 1000003, 1009003027}) {
+      EXPECT_THAT(evaluator.eval({n}), Eq(ast->eval({n}))) << n;
+    }
+  }
+}
+
+TEST_F(ParallelEvaluatorTest, CancelsLoopsOfIterationsPastTheExit) {
+  // Every iteration after the exit spins forever, which only a cancelled
+  // iteration can stop.
+  auto ast = parse("examples/spin_after_exit.sl");
+  for (uint64_t grain : {uint64_t{1}, ParallelEvaluator::kDefaultGrain}) {
+    ParallelEvaluator evaluator(*ast, pool_, grain);
+    EXPECT_THAT(evaluator.searches(), Eq(1));
+    for (int64_t n : {0, 1, 5, 100}) {
+      EXPECT_THAT(evaluator.eval({n}), Eq(1000)) << n << " " << grain;
+    }
+  }
+}
+
+TEST_F(ParallelEvaluatorTest, SearchesInNestedLoops) {
+  auto ast = parse("examples/nextprime.sl");
+  for (uint64_t grain : {uint64_t{1}, uint64_t{64},
+                         ParallelEvaluator::kDefaultGrain}) {
+    ParallelEvaluator evaluator(*ast, pool_, grain);
+    for (int64_t n : {0, 13, 1000, 100000}) {
+      EXPECT_THAT(evaluator.eval({n}), Eq(ast->eval({n})))
+          << n << " " << grain;
+    }
+  }
+}
+
+TEST_F(ParallelEvaluatorTest, MemoizesCalls) {
+  auto ast = parse("examples/wide_calls.sl");
+  std::vector<bool> memoized(ast->functions().size(), false);
+  memoized[0] = true;
+  MemoCache memo_cache(memoized, 1024);
+  ParallelEvaluator evaluator(*ast, pool_);
+  EXPECT_THAT(evaluator.eval({100}, &memo_cache), Eq(ast->eval({100})));
+  EXPECT_THAT(evaluator.eval({100}, &memo_cache), Eq(ast->eval({100})));
+  EXPECT_THAT(memo_cache.hits(0), Gt(0));
+}
+
+}  // namespace
+}  // namespace simp
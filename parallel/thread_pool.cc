@@ -0,0 +1,131 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace simp {
+
+namespace {
+// Which deque of which pool the current thread owns, set for workers only.
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_deque = 0;
+}  // namespace
+
+ThreadPool::ThreadPool(size_t threads) {
+  if (threads == 0) {
+    threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    deques_.push_back(std::make_unique<Deque>());
+  }
+  for (size_t i = 0; i + 1 < threads; ++i) {
+    workers_.emplace_back([this, i]() { work(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+size_t ThreadPool::own_deque() const {
+  return current_pool == this ? current_deque : workers_.size();
+}
+
+void ThreadPool::run(const std::vector<std::function<void()>>& tasks) {
+  if (tasks.empty()) {
+    return;
+  }
+  Group group;
+  group.pending.store(tasks.size(), std::memory_order_relaxed);
+  size_t self = own_deque();
+  if (tasks.size() > 1) {
+    {
+      std::lock_guard<std::mutex> lock(deques_[self]->mutex);
+      for (size_t i = 1; i < tasks.size(); ++i) {
+        deques_[self]->tasks.push_back({&tasks[i], &group});
+      }
+    }
+    queued_.fetch_add(tasks.size() - 1, std::memory_order_release);
+    // Taking the lock orders the count before any worker's check of it.
+    { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+    wake_.notify_all();
+  }
+  execute({&tasks[0], &group});
+  while (group.pending.load(std::memory_order_acquire) > 0) {
+    Task task;
+    if (pop(self, task) || steal(self, task)) {
+      execute(task);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  if (group.error) {
+    std::rethrow_exception(group.error);
+  }
+}
+
+bool ThreadPool::pop(size_t deque, Task& task) {
+  Deque& own = *deques_[deque];
+  std::lock_guard<std::mutex> lock(own.mutex);
+  if (own.tasks.empty()) {
+    return false;
+  }
+  task = own.tasks.back();
+  own.tasks.pop_back();
+  queued_.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool ThreadPool::steal(size_t thief, Task& task) {
+  for (size_t i = 1; i < deques_.size(); ++i) {
+    Deque& victim = *deques_[(thief + i) % deques_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = victim.tasks.front();
+      victim.tasks.pop_front();
+      queued_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::execute(const Task& task) {
+  try {
+    (*task.function)();
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(task.group->mutex);
+    if (!task.group->error) {
+      task.group->error = std::current_exception();
+    }
+  }
+  // The group may be gone as soon as the count reaches 0.
+  task.group->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void ThreadPool::work(size_t deque) {
+  current_pool = this;
+  current_deque = deque;
+  for (;;) {
+    Task task;
+    if (pop(deque, task) || steal(deque, task)) {
+      execute(task);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    wake_.wait(lock, [this]() {
+      return stopping_ || queued_.load(std::memory_order_acquire) > 0;
+    });
+    if (stopping_) {
+      return;
+    }
+  }
+}
+
+}  // namespace simp
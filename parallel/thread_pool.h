@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace simp {
+// A fork-join pool with work stealing. Every worker has a deque of tasks: it
+// takes tasks from the back of its own, the ones it forked last, and idle
+// workers steal from the front of the others', where the oldest and usually
+// largest tasks wait. Threads that are not workers share one more deque.
+//
+// A thread that forks waits for its tasks by running tasks itself, its own
+// first, so tasks may fork in turn and no thread ever blocks on another.
+class ThreadPool {
+ public:
+  // threads counts the thread calling run(), so threads - 1 workers are
+  // started; 0 means one per hardware thread.
+  explicit ThreadPool(size_t threads = 0);
+  ~ThreadPool();
+
+  size_t threads() const { return workers_.size() + 1; }
+
+  // Runs every task and returns once all have finished, rethrowing the first
+  // exception a task threw.
+  void run(const std::vector<std::function<void()>>& tasks);
+
+ private:
+  // The tasks of one run() call still unfinished.
+  struct Group {
+    std::atomic<size_t> pending;
+    std::mutex mutex;
+    std::exception_ptr error;
+  };
+  struct Task {
+    const std::function<void()>* function;
+    Group* group;
+  };
+  struct alignas(64) Deque {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  // The deque of the calling thread.
+  size_t own_deque() const;
+  bool pop(size_t deque, Task& task);
+  bool steal(size_t thief, Task& task);
+  void execute(const Task& task);
+  void work(size_t deque);
+
+  std::vector<std::thread> workers_;
+  // One per worker, then the one shared by other threads.
+  std::vector<std::unique_ptr<Deque>> deques_;
+  std::atomic<size_t> queued_{0};
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  bool stopping_ = false;
+};
+}  // namespace simp
@@ -0,0 +1,71 @@
+#include "parallel/thread_pool.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+
+namespace simp {
+namespace {
+using ::testing::Eq;
+class ThreadPoolTest : public ::testing::Test {
+ protected:
+  ThreadPoolTest() {}
+  ~ThreadPoolTest() override {}
+  void SetUp() override {}
+
+  // Forks both recursive calls, so the pool runs tasks that fork in turn.
+  int64_t fibonacci(ThreadPool& pool, int64_t n) {
+    if (n < 2) {
+      return n;
+    }
+    int64_t left, right;
+    pool.run({[&]() { left = fibonacci(pool, n - 1); },
+              [&]() { right = fibonacci(pool, n - 2); }});
+    return left + right;
+  }
+};
+
+TEST_F(ThreadPoolTest, RunsEveryTask) {
+  ThreadPool pool(4);
+  EXPECT_THAT(pool.threads(), Eq(4));
+  std::atomic<int> sum{0};
+  std::vector<std::function<void()>> tasks;
+  for (int i = 1; i <= 100; ++i) {
+    tasks.push_back([&sum, i]() { sum += i; });
+  }
+  pool.run(tasks);
+  EXPECT_THAT(sum.load(), Eq(5050));
+}
+
+TEST_F(ThreadPoolTest, RunsNestedTasks) {
+  ThreadPool pool(4);
+  EXPECT_THAT(fibonacci(pool, 20), Eq(6765));
+}
+
+TEST_F(ThreadPoolTest, RunsOnTheCallerAlone) {
+  ThreadPool pool(1);
+  EXPECT_THAT(pool.threads(), Eq(1));
+  EXPECT_THAT(fibonacci(pool, 15), Eq(610));
+}
+
+TEST_F(ThreadPoolTest, RethrowsErrors) {
+  ThreadPool pool(4);
+  std::atomic<int> finished{0};
+  std::vector<std::function<void()>> tasks;
+  for (int i = 0; i < 8; ++i) {
+    tasks.push_back([&finished, i]() {
+      ++finished;
+      if (i == 5) {
+        throw std::runtime_error("task failed");
+      }
+    });
+  }
+  EXPECT_THROW(pool.run(tasks), std::runtime_error);
+  // The other tasks still ran before run() returned.
+  EXPECT_THAT(finished.load(), Eq(8));
+}
+
+}  // namespace
+}  // namespace simp
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ast/ast.h"
+#include "ast/flat_ast.h"
+
+namespace simp {
+// The Parser's grammar is written once against these builders and creates
+// nodes only through them, so it can produce either representation directly.
+// A Node must test false when parsing failed, like a null unique_ptr.
+
+// Builds the pointer tree of Expression objects.
+class TreeBuilder {
+ public:
+  using Node = std::unique_ptr<Expression>;
+  using BindingList = Bindings;
+  using NodeList = std::vector<std::unique_ptr<Expression>>;
+
+  Node integer(int64_t value, uint32_t span) {
+    return std::make_unique<IntExpression>(value, span);
+  }
+  Node identifier(const std::string& name, uint32_t span) {
+    return std::make_unique<IdentifierExpression>(name, span);
+  }
+  Node negative(Node operand, uint32_t span) {
+    return std::make_unique<NegativeExpression>(std::move(operand), span);
+  }
+  Node logical_not(Node operand, uint32_t span) {
+    return std::make_unique<NotExpression>(std::move(operand), span);
+  }
+  Node parenthesized(Node expression, uint32_t span) {
+    return std::make_unique<ParenthesizedExpression>(std::move(expression),
+                                                     span);
+  }
+  Node binary(Node left, Node right, Operator op, uint32_t span) {
+    return std::make_unique<BinaryExpression>(std::move(left),
+                                              std::move(right), op, span);
+  }
+  Node if_expression(Node condition, Node consequent, Node alternative,
+                     uint32_t span) {
+    return std::make_unique<IfExpression>(std::move(condition),
+                                          std::move(consequent),
+                                          std::move(alternative), span);
+  }
+  void add_binding(BindingList& bindings, const std::string& name,
+                   Node expression, uint32_t span) {
+    bindings.push_back(
+        std::make_unique<Binding>(name, std::move(expression), span));
+  }
+  Node let(BindingList bindings, Node body, uint32_t span) {
+    return std::make_unique<LetExpression>(std::move(bindings),
+                                           std::move(body), span);
+  }
+  Node loop(BindingList bindings, Node body, uint32_t span) {
+    return std::make_unique<LoopExpression>(std::move(bindings),
+                                            std::move(body), span);
+  }
+  Node recur(NodeList arguments, uint32_t span) {
+    return std::make_unique<RecurExpression>(std::move(arguments), span);
+  }
+  Node call(uint32_t function, const std::string& name, NodeList arguments,
+            uint32_t span) {
+    return std::make_unique<CallExpression>(function, name,
+                                            std::move(arguments), span);
+  }
+  Node intrinsic(Intrinsic intrinsic, NodeList arguments, uint32_t span) {
+    return std::make_unique<IntrinsicExpression>(intrinsic,
+                                                 std::move(arguments), span);
+  }
+  // Functions are numbered in the order they are added.
+  void add_function(const std::string& name,
+                    std::vector<std::string> parameters, Node body,
+                    uint32_t span) {
+    functions_.push_back(std::make_unique<Function>(
+        name, std::move(parameters), std::move(body), span));
+  }
+  Functions take_functions() { return std::move(functions_); }
+
+ private:
+  Functions functions_;
+};
+
+// A node of a FlatAst under construction.
+class FlatNode {
+ public:
+  FlatNode(std::nullptr_t = nullptr) {}
+  explicit FlatNode(NodeId id) : id_(id) {}
+  NodeId id() const { return id_; }
+  explicit operator bool() const { return id_ != kNoNode; }
+
+ private:
+  NodeId id_ = kNoNode;
+};
+
+// Appends nodes to a FlatAst. Bindings have no spans of their own there.
+class FlatBuilder {
+ public:
+  using Node = FlatNode;
+  using BindingList = std::vector<FlatAst::Binding>;
+  using NodeList = std::vector<FlatNode>;
+
+  explicit FlatBuilder(FlatAst& ast) : ast_(ast) {}
+
+  Node integer(int64_t value, uint32_t span) {
+    return Node(ast_.add_integer(value, span));
+  }
+  Node identifier(const std::string& name, uint32_t span) {
+    return Node(ast_.add_identifier(name, span));
+  }
+  Node negative(Node operand, uint32_t span) {
+    return Node(ast_.add_unary(ExpressionType::NEGATIVE, operand.id(), span));
+  }
+  Node logical_not(Node operand, uint32_t span) {
+    return Node(ast_.add_unary(ExpressionType::NOT, operand.id(), span));
+  }
+  Node parenthesized(Node expression, uint32_t span) {
+    return Node(
+        ast_.add_unary(ExpressionType::PARENTHESIS, expression.id(), span));
+  }
+  Node binary(Node left, Node right, Operator op, uint32_t span) {
+    return Node(ast_.add_binary(op, left.id(), right.id(), span));
+  }
+  Node if_expression(Node condition, Node consequent, Node alternative,
+                     uint32_t span) {
+    return Node(ast_.add_if(condition.id(), consequent.id(), alternative.id(),
+                            span));
+  }
+  void add_binding(BindingList& bindings, const std::string& name,
+                   Node expression, uint32_t span) {
+    bindings.push_back({name, expression.id(), span});
+  }
+  Node let(BindingList bindings, Node body, uint32_t span) {
+    return Node(ast_.add_scope(ExpressionType::LET, bindings, body.id(), span));
+  }
+  Node loop(BindingList bindings, Node body, uint32_t span) {
+    return Node(
+        ast_.add_scope(ExpressionType::LOOP, bindings, body.id(), span));
+  }
+  Node recur(NodeList arguments, uint32_t span) {
+    std::vector<NodeId> ids;
+    for (const auto& argument : arguments) {
+      ids.push_back(argument.id());
+    }
+    return Node(ast_.add_recur(ids, span));
+  }
+  // The callee's name is already in FlatAst::functions(), at its index.
+  Node call(uint32_t function, const std::string&, NodeList arguments,
+            uint32_t span) {
+    std::vector<NodeId> ids;
+    for (const auto& argument : arguments) {
+      ids.push_back(argument.id());
+    }
+    return Node(ast_.add_call(function, ids, span));
+  }
+  Node intrinsic(Intrinsic intrinsic, NodeList arguments, uint32_t span) {
+    std::vector<NodeId> ids;
+    for (const auto& argument : arguments) {
+      ids.push_back(argument.id());
+    }
+    return Node(ast_.add_intrinsic(intrinsic, ids, span));
+  }
+  void add_function(const std::string& name,
+                    std::vector<std::string> parameters, Node body,
+                    uint32_t span) {
+    ast_.add_function(name, std::move(parameters), body.id(), span);
+  }
+
+ private:
+  FlatAst& ast_;
+};
+}  // namespace simp
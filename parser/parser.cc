@@ -1,225 +1,363 @@
 #include "parser.h"
 
 #include <memory>
+#include <vector>
 
 #include "tokens/tokens.h"
-namespace simp {
+#include "trace/trace.h"
 
-std::unique_ptr<KeywordToken> Parser::expect_keyword(
-    const std::string& keyword) {
-  std::unique_ptr<Token> token = std::move(tokens_.front());
-  tokens_.pop_front(); // Always pop the front token first
+namespace simp {
 
-  if (!token) {
-    LOG(INFO) << "----------expect_keyword \"" << keyword << "\" not found";
-    tokens_.push_front(std::move(token));
+const Token* Parser::expect_keyword(Keyword keyword) {
+  const Token* token = tokens_->peek();
+  if (!token || !token->is(keyword)) {
+    SIMP_TRACE(PARSER, "expected keyword not found",
+               static_cast<int>(keyword));
     return nullptr;
   }
-
-  if (token->type() == TokenType::KEYWORD) {
-    LOG(INFO) << "----------expect_keyword keyword found";
-    const auto& keyword_token = static_cast<KeywordToken*>(token.get());
-
-    if (keyword_token->keyword() == keyword) {
-      LOG(INFO) << "----------expect_keyword \"" << keyword << "\" match found";
-      return std::make_unique<KeywordToken>(keyword_token);
-    } else {
-      LOG(INFO) << "----------expect_keyword actual keyword: "
-                << keyword_token->keyword();
-      tokens_.push_front(std::move(token));
-      return nullptr;
-    }
-  }
-  tokens_.push_front(std::move(token));
-  return nullptr;
+  tokens_->advance();
+  return token;
 }
 
-std::unique_ptr<OperatorToken> Parser::expect_binary_operator() {
-  std::unique_ptr<Token> token = std::move(tokens_.front());
-  tokens_.pop_front();
-  if (token->type() != TokenType::OPERATOR) {
-    tokens_.push_front(std::move(
-        token));  // needs to be pushed to the front for the algorithm to work.
-    return nullptr;
-  }
-  LOG(INFO) << "----------expect_binary_operator: operator found";
-  const auto& operator_token = static_cast<OperatorToken*>(token.get());
-  if (!operator_token->is_binary()) {
-    tokens_.push_front(std::move(token));
+const Token* Parser::expect_binary_operator() {
+  const Token* token = tokens_->peek();
+  if (!token || !token->is_binary()) {
     return nullptr;
   }
-  return std::make_unique<OperatorToken>(operator_token);
+  SIMP_TRACE(PARSER, "binary operator", token->op());
+  tokens_->advance();
+  return token;
 }
-std::unique_ptr<OperatorToken> Parser::expect_close_paren() {
-  std::unique_ptr<Token> token = std::move(tokens_.front());
-  tokens_.pop_front();
-  if (token->type() != TokenType::OPERATOR) {
-    tokens_.push_front(std::move(
-        token));  // needs to be pushed to the front for the algorithm to work.
+
+const Token* Parser::expect_close_paren() {
+  const Token* token = tokens_->peek();
+  if (!token || !token->is(Operator::CLOSE_PAREN)) {
     return nullptr;
   }
-  const auto& operator_token = static_cast<OperatorToken*>(token.get());
-  if (operator_token->op() != Operator::CLOSE_PAREN) {
-    tokens_.push_front(std::move(token));
+  tokens_->advance();
+  return token;
+}
+
+const Token* Parser::expect_identifier() {
+  const Token* token = tokens_->peek();
+  if (!token || token->type != TokenType::IDENTIFIER) {
     return nullptr;
   }
-  return std::make_unique<OperatorToken>(operator_token);
+  tokens_->advance();
+  return token;
 }
 
-std::unique_ptr<IdentifierToken> Parser::expect_identifier() {
-  std::unique_ptr<Token> token = std::move(tokens_.front());
-  tokens_.pop_front();
-  if (token->type() != TokenType::IDENTIFIER) {
-    tokens_.push_front(std::move(
-        token));  // needs to be pushed to the front for the algorithm to work.
+const Token* Parser::expect_assign_operator() {
+  const Token* token = tokens_->peek();
+  if (!token || !token->is(Operator::ASSIGN)) {
     return nullptr;
   }
-  const auto& identifier_token = static_cast<IdentifierToken*>(token.get());
-  return std::make_unique<IdentifierToken>(identifier_token);
+  tokens_->advance();
+  return token;
 }
 
-std::unique_ptr<OperatorToken> Parser::expect_assign_operator() {
-  std::unique_ptr<Token> token = std::move(tokens_.front());
-  tokens_.pop_front();
-  if (token->type() != TokenType::OPERATOR) {
-    tokens_.push_front(std::move(
-        token));  // needs to be pushed to the front for the algorithm to work.
-    return nullptr;
+uint32_t Parser::span() {
+  if (!tokens_->peek()) {
+    return SourceMap::kNoSpan;
   }
-  const auto& operator_token = static_cast<OperatorToken*>(token.get());
-  if (operator_token->op() != Operator::ASSIGN) {
-    tokens_.push_front(std::move(token));
-    return nullptr;
+  if (source_file_ == SourceMap::kNoSpan) {
+    source_file_ = source_map_.add_file(tokens_->file_name());
   }
-  return std::make_unique<OperatorToken>(operator_token);
+  return source_map_.add(source_file_, tokens_->line(), tokens_->position());
 }
 
 bool Parser::parse() {
-  auto binary_expression = parse_binary_expression();
+  TreeBuilder builder;
+  TreeBuilder::Node root;
+  std::vector<std::string> inputs;
+  bool parsed = parse_program(builder, root, inputs);
+  if (!tokens_->ok()) {
+    LOG(ERROR) << "-------parse Failed to scan " << tokens_->file_name();
+    return false;
+  }
+  if (!parsed) {
+    LOG(ERROR) << "-------parse Failed to parse binary expression";
+    return false;
+  }
+  Functions functions = builder.take_functions();
+  for (const auto& function : functions) {
+    if (!check_recur(function->body().get(), nullptr, false)) {
+      return false;
+    }
+  }
+  if (!check_recur(root.get(), nullptr, false)) {
+    return false;
+  }
+  SIMP_TRACE(PARSER, "parsed", 0);
+  auto ast = std::make_unique<Ast>(std::move(root), std::move(source_map_),
+                                   std::move(functions), std::move(inputs));
+  if (!Resolver().resolve(*ast)) {
+    LOG(ERROR) << "-------parse Failed to resolve variables";
+    return false;
+  }
+  ast_ = std::move(ast);
+  return true;
+}
 
-  if (!binary_expression) {
+bool Parser::parse_flat() {
+  auto ast = std::make_unique<FlatAst>();
+  FlatBuilder builder(*ast);
+  FlatBuilder::Node root;
+  std::vector<std::string> inputs;
+  bool parsed = parse_program(builder, root, inputs);
+  if (!tokens_->ok()) {
+    LOG(ERROR) << "-------parse Failed to scan " << tokens_->file_name();
+    return false;
+  }
+  if (!parsed) {
     LOG(ERROR) << "-------parse Failed to parse binary expression";
     return false;
   }
-  LOG(INFO) << "-------parse Parsed binary expression, making ast";
-  ast_ = std::make_unique<Ast>(std::move(binary_expression));
+  ast->set_root(root.id());
+  ast->set_inputs(std::move(inputs));
+  for (const auto& function : ast->functions()) {
+    if (!check_recur(*ast, function.body, kNoNode, false)) {
+      return false;
+    }
+  }
+  if (!check_recur(*ast, root.id(), kNoNode, false)) {
+    return false;
+  }
+  ast->source_map() = std::move(source_map_);
+  if (!Resolver().resolve(*ast)) {
+    LOG(ERROR) << "-------parse Failed to resolve variables";
+    return false;
+  }
+  flat_ast_ = std::move(ast);
   return true;
 }
 
-std::unique_ptr<Expression> Parser::parse_primary_expression() {
-  LOG(INFO) << "*********Parsing primary expression*******" << std::endl;
-  LOG(INFO) << "-------primary has " << tokens_.size()
-            << " tokens left in begining";
-  if (tokens_.size() == 0) {
-    LOG(INFO) << "-------parse no tokens left";
+template <typename Builder>
+bool Parser::parse_program(Builder& builder, typename Builder::Node& root,
+                           std::vector<std::string>& inputs) {
+  functions_.clear();
+  while (at_function_definition()) {
+    if (!parse_function(builder)) {
+      return false;
+    }
+  }
+  if (tokens_->peek() || functions_.empty()) {
+    root = parse_expression(builder);
+    return static_cast<bool>(root);
+  }
+  auto main = functions_.find("main");
+  if (main == functions_.end()) {
+    LOG(ERROR) << "Program has neither an expression nor a main function";
+    return false;
+  }
+  typename Builder::NodeList arguments;
+  for (const auto& parameter : main->second.parameters) {
+    arguments.push_back(builder.identifier(parameter, SourceMap::kNoSpan));
+  }
+  inputs = main->second.parameters;
+  root = builder.call(main->second.index, main->first, std::move(arguments),
+                      SourceMap::kNoSpan);
+  return true;
+}
+
+bool Parser::at_function_definition() {
+  const Token* token = tokens_->peek();
+  if (!token || !token->is(Keyword::LET)) {
+    return false;
+  }
+  token = tokens_->peek(1);
+  if (!token || token->type != TokenType::IDENTIFIER) {
+    return false;
+  }
+  token = tokens_->peek(2);
+  return token && token->type == TokenType::IDENTIFIER;
+}
+
+template <typename Builder>
+bool Parser::parse_function(Builder& builder) {
+  uint32_t function_span = span();
+  expect_keyword(Keyword::LET);
+  const Token* name_token = expect_identifier();
+  std::string name = symbols().name(name_token->value);
+  std::vector<std::string> parameters;
+  while (const Token* parameter = expect_identifier()) {
+    parameters.push_back(symbols().name(parameter->value));
+  }
+  if (!expect_assign_operator()) {
+    LOG(ERROR) << "Assign operator not found in definition of " << name
+               << source_map_.location(function_span);
+    return false;
+  }
+  uint32_t index = functions_.size();
+  // Registered before the body is parsed, so the function can call itself.
+  if (!functions_.try_emplace(name, FunctionSignature{index, parameters})
+           .second) {
+    LOG(ERROR) << "Function " << name << " is defined twice"
+               << source_map_.location(function_span);
+    return false;
+  }
+  SIMP_TRACE(PARSER, "function", index);
+  auto body = parse_expression(builder);
+  if (!body) {
+    LOG(ERROR) << "Body not found in definition of " << name
+               << source_map_.location(function_span);
+    return false;
+  }
+  if (!expect_keyword(Keyword::END)) {
+    LOG(ERROR) << "End not found in definition of " << name
+               << source_map_.location(function_span);
+    return false;
+  }
+  builder.add_function(name, std::move(parameters), std::move(body),
+                       function_span);
+  return true;
+}
+
+template <typename Builder>
+typename Builder::Node Parser::parse_call(Builder& builder,
+                                          const std::string& name,
+                                          uint32_t call_span) {
+  const FunctionSignature& function = functions_.find(name)->second;
+  typename Builder::NodeList arguments;
+  if (!parse_arguments(builder, name, function.parameters.size(), call_span,
+                       arguments)) {
     return nullptr;
   }
+  return builder.call(function.index, name, std::move(arguments), call_span);
+}
 
-  auto token = std::move(tokens_.front());
+template <typename Builder>
+typename Builder::Node Parser::parse_intrinsic(Builder& builder,
+                                               Intrinsic intrinsic,
+                                               uint32_t call_span) {
+  typename Builder::NodeList arguments;
+  if (!parse_arguments(builder, intrinsic_name(intrinsic),
+                       intrinsic_arity(intrinsic), call_span, arguments)) {
+    return nullptr;
+  }
+  SIMP_TRACE(PARSER, "intrinsic", static_cast<int>(intrinsic));
+  return builder.intrinsic(intrinsic, std::move(arguments), call_span);
+}
 
-  tokens_.pop_front();
-  LOG(INFO) << "-------primary token == nullptr: " << (token == nullptr);
-  LOG(INFO) << "-------primary popped token and have " << tokens_.size()
-            << " tokens left before if statements type";
+template <typename Builder>
+bool Parser::parse_arguments(Builder& builder, const std::string& name,
+                             size_t arity, uint32_t call_span,
+                             typename Builder::NodeList& arguments) {
+  // Arguments are parenthesized, as they are for recur.
+  while (tokens_->peek() && tokens_->peek()->is(Operator::OPEN_PAREN)) {
+    auto argument = parse_primary_expression(builder);
+    if (!argument) {
+      LOG(ERROR) << "Malformed argument in call to " << name
+                 << source_map_.location(call_span);
+      return false;
+    }
+    arguments.push_back(std::move(argument));
+  }
+  if (arguments.size() != arity) {
+    LOG(ERROR) << "Call passes " << arguments.size() << " arguments to " << name
+               << ", which takes " << arity << source_map_.location(call_span);
+    return false;
+  }
+  return true;
+}
 
-  if (token->type() == TokenType::INTEGER) {
-    LOG(INFO) << "-------primary Parsing integer expression";
-    const auto& integer_token_ptr = static_cast<IntegerToken*>(token.get());
-    return std::make_unique<IntExpression>(integer_token_ptr->value());
-  } else if (token->type() == TokenType::KEYWORD) {
-    LOG(INFO) << "-------primary Parsing keyword expression";
-    const auto& keyword_token_ptr = static_cast<KeywordToken*>(token.get());
-    auto keyword_token = std::make_unique<KeywordToken>(keyword_token_ptr);
+template <typename Builder>
+typename Builder::Node Parser::parse_primary_expression(Builder& builder) {
+  SIMP_TRACE(PARSER, "primary", 0);
+  const Token* next = tokens_->peek();
+  if (!next) {
+    SIMP_TRACE(PARSER, "no tokens left", 0);
+    return nullptr;
+  }
+  if (next->is(Operator::CLOSE_PAREN)) {
+    return nullptr;
+  }
+  // The source may reuse the token's storage once it has been consumed.
+  const Token token = *next;
+  uint32_t token_span = span();
+  if (token.type == TokenType::INTEGER) {
+    SIMP_TRACE(PARSER, "integer", token.offset);
+    int64_t value = tokens_->integer();
+    tokens_->advance();
+    return builder.integer(value, token_span);
+  }
+  tokens_->advance();
 
-    if (keyword_token->keyword() == "if") {
-      LOG(INFO) << "-------primary Parsing if expression";
-      auto condtion = parse_binary_expression();
-      auto then_token = expect_keyword("then");
+  if (token.type == TokenType::KEYWORD) {
+    SIMP_TRACE(PARSER, "keyword", token.offset);
+    if (token.keyword() == Keyword::IF) {
+      SIMP_TRACE(PARSER, "if", token.offset);
+      auto condtion = parse_expression(builder);
+      auto then_token = expect_keyword(Keyword::THEN);
       if (!then_token) {
         LOG(ERROR) << "Then not found in if statenent";
         return nullptr;
       }
-      auto consequent = parse_binary_expression();
+      auto consequent = parse_expression(builder);
       if (!consequent) {
         LOG(ERROR) << "Consequent expression not found in if statenent";
         return nullptr;
       }
-      auto else_token = expect_keyword("else");
+      auto else_token = expect_keyword(Keyword::ELSE);
       if (!else_token) {
         LOG(ERROR) << "Else token not found in if statenent";
         return nullptr;
       }
-      auto alternative = parse_binary_expression();
+      auto alternative = parse_expression(builder);
       if (!alternative) {
         LOG(ERROR) << "Alternative expression not found in if statenent";
         return nullptr;
       }
-      auto end_token = expect_keyword("end");
+      auto end_token = expect_keyword(Keyword::END);
       if (!end_token) {
         LOG(ERROR) << "End token not found in if statenent";
         return nullptr;
       }
-      return std::make_unique<IfExpression>(
-          std::move(keyword_token), std::move(condtion), std::move(then_token),
-          std::move(consequent), std::move(else_token), std::move(alternative),
-          std::move(end_token));
-    } else if (keyword_token->keyword() == "let") {
-      LOG(INFO) << "-------primary Parsing let expression";
-      auto bindings_map = std::make_unique<
-          std::unordered_map<std::string, std::unique_ptr<Binding>>>();
-      auto bindings_success = parse_bindings(std::move(bindings_map));
+      return builder.if_expression(std::move(condtion), std::move(consequent),
+                                   std::move(alternative), token_span);
+    } else if (token.keyword() == Keyword::LET) {
+      SIMP_TRACE(PARSER, "let", token.offset);
+      typename Builder::BindingList bindings;
+      auto bindings_success = parse_bindings(builder, bindings);
       if (!bindings_success) {
         LOG(ERROR) << "Bindings not found in let statement";
         return nullptr;
       }
-      LOG(INFO) << "-------primary Bindings found in let statement";
-      auto in_keyword = expect_keyword("in");
+      SIMP_TRACE(PARSER, "let bindings", bindings.size());
+      auto in_keyword = expect_keyword(Keyword::IN);
       if (!in_keyword) {
         LOG(ERROR) << "-------primary In keyword not found in let statement";
         return nullptr;
       } else {
-        LOG(INFO) << "-------primary In keyword found in let statement";
+        SIMP_TRACE(PARSER, "let in", 0);
       }
-      auto expression = parse_binary_expression();
+      auto expression = parse_expression(builder);
       if (!expression) {
         LOG(ERROR) << "Expression not found in let statement";
         return nullptr;
       }
-      LOG(INFO) << "-------primary Expression found in let statement";
-      auto end = expect_keyword("end");
+      SIMP_TRACE(PARSER, "let body", 0);
+      auto end = expect_keyword(Keyword::END);
       if (!end) {
         LOG(ERROR) << "End not found in let statement";
         return nullptr;
       }
-      LOG(INFO) << "-------primary End found in let statement";
-      return std::make_unique<LetExpression>(
-          std::move(keyword_token), std::move(bindings_map),
-          std::move(in_keyword), std::move(expression), std::move(end));
+      SIMP_TRACE(PARSER, "let end", 0);
+      return builder.let(std::move(bindings), std::move(expression),
+                         token_span);
+    } else if (token.keyword() == Keyword::LOOP) {
+      SIMP_TRACE(PARSER, "loop", token.offset);
+      return parse_loop_expression(builder, token_span);
+    } else if (token.keyword() == Keyword::RECUR) {
+      SIMP_TRACE(PARSER, "recur", token.offset);
+      return parse_recur_expression(builder, token_span);
     }
-  } else if (token->type() == TokenType::OPERATOR) {
-    LOG(INFO) << "-------primary Parsing operator expression";
-    const auto& operator_token_ptr = static_cast<OperatorToken*>(token.get());
-    auto operator_token = std::make_unique<OperatorToken>(operator_token_ptr);
-    if (operator_token->op() == Operator::CLOSE_PAREN) {
-      tokens_.push_front(std::move(operator_token));
-      return nullptr;
-    } else if (operator_token->op() == Operator::UNARY_MINUS) {
-      auto expression = parse_primary_expression();
-      if (!expression) {
-        LOG(ERROR) << "Expression not recognized for not expression";
-        return nullptr;
-      }
-      return std::make_unique<NegativeExpression>(std::move(expression));
-    } else if (operator_token->op() == Operator::NOT) {
-      auto expression = parse_primary_expression();
-      if (!expression) {
-        LOG(ERROR) << "Expression not recognized";
-        return nullptr;
-      }
-      return std::make_unique<NotExpression>(std::move(expression));
-    } else if (operator_token->op() == Operator::OPEN_PAREN) {
-      auto expression =
-          parse_binary_expression();  // this is eating up the last close paren
+  } else if (token.type == TokenType::OPERATOR) {
+    SIMP_TRACE(PARSER, "operator", token.offset);
+    if (token.op() == Operator::UNARY_MINUS || token.op() == Operator::NOT) {
+      return parse_prefix_expression(builder, token.op(), token_span);
+    } else if (token.op() == Operator::OPEN_PAREN) {
+      auto expression = parse_expression(builder);
 
       auto close_paren = expect_close_paren();
 
@@ -227,91 +365,497 @@ std::unique_ptr<Expression> Parser::parse_primary_expression() {
         LOG(ERROR) << "Close paren not found";
         return nullptr;
       }
-      LOG(INFO) << "-------primary found close paren";
-      return std::make_unique<ParenthesizedExpression>(
-          std::move(operator_token), std::move(expression),
-          std::move(close_paren));
+      SIMP_TRACE(PARSER, "close paren", 0);
+      return builder.parenthesized(std::move(expression), token_span);
     }
-  } else if (token->type() == TokenType::IDENTIFIER) {
-    LOG(INFO) << "-------primary Parsing identifier expression";
-    const auto& identifier_token_ptr =
-        static_cast<IdentifierToken*>(token.get());
-    return std::make_unique<IdentifierExpression>(identifier_token_ptr);
+  } else if (token.type == TokenType::IDENTIFIER) {
+    SIMP_TRACE(PARSER, "identifier", token.offset);
+    const std::string& name = symbols().name(token.value);
+    // A function name followed by its arguments is a call. Functions of the
+    // program hide intrinsics of the same name.
+    const Token* after = tokens_->peek();
+    if (after && after->is(Operator::OPEN_PAREN)) {
+      Intrinsic intrinsic;
+      if (functions_.count(name)) {
+        return parse_call(builder, name, token_span);
+      } else if (find_intrinsic(name, intrinsic)) {
+        return parse_intrinsic(builder, intrinsic, token_span);
+      }
+    }
+    return builder.identifier(name, token_span);
   } else {
-    LOG(INFO) << "-------primary what is this token";
+    SIMP_TRACE(PARSER, "unexpected token", token.offset);
   }
   LOG(ERROR) << "-------primary expression not regonized";
   return nullptr;
 }
 
-bool Parser::parse_bindings(
-    std::unique_ptr<std::unordered_map<std::string, std::unique_ptr<Binding>>>
-        bindings_map) {
-  LOG(INFO) << "*******************Parsing bindings*************";
-  LOG(INFO) << "-------bindings has " << tokens_.size()
-            << " tokens left in begining";
-  if (tokens_.size() == 0) {
+template <typename Builder>
+bool Parser::parse_bindings(Builder& builder,
+                            typename Builder::BindingList& bindings) {
+  SIMP_TRACE(PARSER, "bindings", 0);
+  if (!tokens_->peek()) {
     LOG(ERROR) << "No tokens found in parsing bindings";
     return false;
   }
-  auto identifier = expect_identifier();
+  uint32_t binding_span = span();
+  const Token* identifier = expect_identifier();
   if (!identifier) {
     LOG(ERROR) << "-------bindings Identifier not found";
     return false;
   }
-  LOG(INFO) << "-------bindings identifier found";
+  const std::string& name = symbols().name(identifier->value);
+  SIMP_TRACE(PARSER, "binding name", identifier->value);
   auto assign_operator = expect_assign_operator();
   if (!assign_operator) {
     LOG(ERROR) << "Assign operator not found in bindings";
     return false;
   }
-  LOG(INFO) << "-------bindings Assign found";
-  auto expression = parse_binary_expression();
+  SIMP_TRACE(PARSER, "binding assign", 0);
+  auto expression = parse_expression(builder);
   if (!expression) {
     LOG(ERROR) << "-------bindings Expression not found";
     return false;
   }
-  LOG(INFO) << "-------bindings Expression found";
-  bindings_map->insert(
-      {identifier->name(), std::make_unique<Binding>(std::move(identifier),
-                                                     std::move(assign_operator),
-                                                     std::move(expression))});
+  SIMP_TRACE(PARSER, "binding value", 0);
+  builder.add_binding(bindings, name, std::move(expression), binding_span);
 
-  auto and_keyword = expect_keyword("and");
+  auto and_keyword = expect_keyword(Keyword::AND);
   if (and_keyword) {
-    LOG(INFO) << "-------bindings and keyword found";
-    return parse_bindings(std::move(bindings_map));
+    SIMP_TRACE(PARSER, "binding and", 0);
+    return parse_bindings(builder, bindings);
   } else {
-    LOG(INFO) << "-------bindings and keyword not found returning true";
+    SIMP_TRACE(PARSER, "bindings end", 0);
 
     return true;
   }
 }
 
-std::unique_ptr<Expression> Parser::parse_binary_expression() {
-  LOG(INFO) << "*******************Parsing binary expression*************";
-  auto left = parse_primary_expression();
-  if (!left) {
+template <typename Builder>
+typename Builder::Node Parser::parse_loop_expression(
+    Builder& builder, uint32_t loop_span) {
+  typename Builder::BindingList bindings;
+  if (!parse_bindings(builder, bindings)) {
+    LOG(ERROR) << "Bindings not found in loop"
+               << source_map_.location(loop_span);
+    return nullptr;
+  }
+  auto in_keyword = expect_keyword(Keyword::IN);
+  if (!in_keyword) {
+    LOG(ERROR) << "In keyword not found in loop"
+               << source_map_.location(loop_span);
+    return nullptr;
+  }
+  auto expression = parse_expression(builder);
+  if (!expression) {
+    LOG(ERROR) << "Expression not found in loop"
+               << source_map_.location(loop_span);
     return nullptr;
   }
+  auto end = expect_keyword(Keyword::END);
+  if (!end) {
+    LOG(ERROR) << "End not found in loop" << source_map_.location(loop_span);
+    return nullptr;
+  }
+  return builder.loop(std::move(bindings), std::move(expression),
+                      loop_span);
+}
 
-  if (tokens_.size() == 0) {
-    return left;
+template <typename Builder>
+typename Builder::Node Parser::parse_recur_expression(
+    Builder& builder, uint32_t recur_span) {
+  typename Builder::NodeList arguments;
+  // Every argument is parenthesized, so arguments continue for as long as
+  // the next token opens a parenthesis.
+  while (tokens_->peek() && tokens_->peek()->is(Operator::OPEN_PAREN)) {
+    auto argument = parse_primary_expression(builder);
+    if (!argument) {
+      LOG(ERROR) << "Malformed recur argument"
+                 << source_map_.location(recur_span);
+      return nullptr;
+    }
+    arguments.push_back(std::move(argument));
+  }
+  if (arguments.empty()) {
+    LOG(ERROR) << "Recur without arguments" << source_map_.location(recur_span);
+    return nullptr;
   }
-  auto binary_operator = expect_binary_operator();
+  return builder.recur(std::move(arguments), recur_span);
+}
 
-  if (!binary_operator) {
-    LOG(INFO) << "-------binary No operator found, returning left";
-    return left;
+bool Parser::check_recur(Expression* expression, LoopExpression* loop,
+                         bool tail) {
+  switch (expression->type()) {
+    case ExpressionType::INTEGER:
+    case ExpressionType::IDENTIFIER:
+      return true;
+    case ExpressionType::PARENTHESIS:
+      return check_recur(
+          static_cast<ParenthesizedExpression*>(expression)->expression().get(),
+          loop, tail);
+    case ExpressionType::NOT:
+      return check_recur(
+          static_cast<NotExpression*>(expression)->expression().get(), loop,
+          false);
+    case ExpressionType::NEGATIVE:
+      return check_recur(
+          static_cast<NegativeExpression*>(expression)->expression().get(),
+          loop, false);
+    case ExpressionType::BINARY: {
+      auto binary = static_cast<BinaryExpression*>(expression);
+      return check_recur(binary->left().get(), loop, false) &&
+             check_recur(binary->right().get(), loop, false);
+    }
+    case ExpressionType::IF: {
+      auto if_expression = static_cast<IfExpression*>(expression);
+      return check_recur(if_expression->condition().get(), loop, false) &&
+             check_recur(if_expression->consequent().get(), loop, tail) &&
+             check_recur(if_expression->alternative().get(), loop, tail);
+    }
+    case ExpressionType::LET: {
+      auto let = static_cast<LetExpression*>(expression);
+      for (const auto& binding : let->bindings()) {
+        if (!check_recur(binding->expression().get(), loop, false)) {
+          return false;
+        }
+      }
+      return check_recur(let->expression().get(), loop, tail);
+    }
+    case ExpressionType::LOOP: {
+      auto inner = static_cast<LoopExpression*>(expression);
+      for (const auto& binding : inner->bindings()) {
+        if (!check_recur(binding->expression().get(), loop, false)) {
+          return false;
+        }
+      }
+      return check_recur(inner->expression().get(), inner, true);
+    }
+    case ExpressionType::RECUR: {
+      auto recur = static_cast<RecurExpression*>(expression);
+      if (!loop) {
+        LOG(ERROR) << "Recur outside of a loop"
+                   << source_map_.location(recur->span());
+        return false;
+      }
+      if (!tail) {
+        LOG(ERROR) << "Recur not in tail position"
+                   << source_map_.location(recur->span());
+        return false;
+      }
+      if (recur->arguments().size() != loop->bindings().size()) {
+        LOG(ERROR) << "Recur passes " << recur->arguments().size()
+                   << " arguments to a loop with " << loop->bindings().size()
+                   << " variables" << source_map_.location(recur->span());
+        return false;
+      }
+      for (const auto& argument : recur->arguments()) {
+        if (!check_recur(argument.get(), loop, false)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    case ExpressionType::CALL:
+      for (const auto& argument :
+           static_cast<CallExpression*>(expression)->arguments()) {
+        if (!check_recur(argument.get(), loop, false)) {
+          return false;
+        }
+      }
+      return true;
+    case ExpressionType::INTRINSIC:
+      for (const auto& argument :
+           static_cast<IntrinsicExpression*>(expression)->arguments()) {
+        if (!check_recur(argument.get(), loop, false)) {
+          return false;
+        }
+      }
+      return true;
+  }
+  return false;
+}
+
+bool Parser::check_recur(FlatAst& ast, NodeId node, NodeId loop,
+                         bool tail) {
+  switch (ast.kind(node)) {
+    case ExpressionType::INTEGER:
+    case ExpressionType::IDENTIFIER:
+      return true;
+    case ExpressionType::PARENTHESIS:
+      return check_recur(ast, ast.operand(node), loop, tail);
+    case ExpressionType::NOT:
+    case ExpressionType::NEGATIVE:
+      return check_recur(ast, ast.operand(node), loop, false);
+    case ExpressionType::BINARY:
+      return check_recur(ast, ast.left(node), loop, false) &&
+             check_recur(ast, ast.right(node), loop, false);
+    case ExpressionType::IF:
+      return check_recur(ast, ast.condition(node), loop, false) &&
+             check_recur(ast, ast.consequent(node), loop, tail) &&
+             check_recur(ast, ast.alternative(node), loop, tail);
+    case ExpressionType::LET:
+    case ExpressionType::LOOP: {
+      for (uint32_t i = 0; i < ast.binding_count(node); ++i) {
+        if (!check_recur(ast, ast.binding_expression(node, i), loop, false)) {
+          return false;
+        }
+      }
+      if (ast.kind(node) == ExpressionType::LOOP) {
+        return check_recur(ast, ast.body(node), node, true);
+      }
+      return check_recur(ast, ast.body(node), loop, tail);
+    }
+    case ExpressionType::RECUR: {
+      if (loop == kNoNode) {
+        LOG(ERROR) << "Recur outside of a loop"
+                   << source_map_.location(ast.span(node));
+        return false;
+      }
+      if (!tail) {
+        LOG(ERROR) << "Recur not in tail position"
+                   << source_map_.location(ast.span(node));
+        return false;
+      }
+      if (ast.argument_count(node) != ast.binding_count(loop)) {
+        LOG(ERROR) << "Recur passes " << ast.argument_count(node)
+                   << " arguments to a loop with " << ast.binding_count(loop)
+                   << " variables" << source_map_.location(ast.span(node));
+        return false;
+      }
+      for (uint32_t i = 0; i < ast.argument_count(node); ++i) {
+        if (!check_recur(ast, ast.argument(node, i), loop, false)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    case ExpressionType::CALL:
+    case ExpressionType::INTRINSIC:
+      for (uint32_t i = 0; i < ast.argument_count(node); ++i) {
+        if (!check_recur(ast, ast.argument(node, i), loop, false)) {
+          return false;
+        }
+      }
+      return true;
+  }
+  return false;
+}
+
+template <typename Builder>
+typename Builder::Node Parser::parse_prefix_expression(Builder& builder,
+                                                       Operator op,
+                                                       uint32_t op_span) {
+  std::vector<Prefix> prefixes = {{op, op_span}};
+  const Token* next;
+  while ((next = tokens_->peek()) && (next->is(Operator::UNARY_MINUS) ||
+                                      next->is(Operator::NOT))) {
+    prefixes.push_back({next->op(), span()});
+    tokens_->advance();
+  }
+  size_t last_not = prefixes.size();
+  for (size_t i = 0; i < prefixes.size(); ++i) {
+    if (prefixes[i].op == Operator::NOT) {
+      last_not = i;
+    }
+  }
+  // Unary minus binds tighter than any binary operator; ! only tighter than
+  // && and ||.
+  if (last_not == prefixes.size()) {
+    auto operand = parse_primary_expression(builder);
+    if (!operand) {
+      LOG(ERROR) << "Expression not recognized after "
+                 << op_to_string(prefixes.back().op);
+      return nullptr;
+    }
+    return build_prefixes(builder, prefixes, 0, prefixes.size(),
+                          std::move(operand));
+  }
+  if (not_depth_ >= kMaxChainDepth) {
+    deferred_prefixes_ = std::move(prefixes);
+    return builder.identifier(kNotVariable, op_span);
+  }
+  bool outermost = not_depth_ == 0;
+  ++not_depth_;
+  auto operand = parse_not_operand(builder, prefixes, last_not);
+  --not_depth_;
+  if (!operand) {
+    return nullptr;
+  }
+  if (outermost && !deferred_prefixes_.empty()) {
+    // operand refers to the first deferred run as kNotVariable, and each run
+    // to the one deferred while parsing it.
+    typename Builder::NodeList parts;
+    std::vector<uint32_t> spans;
+    while (!deferred_prefixes_.empty()) {
+      std::vector<Prefix> deferred = std::move(deferred_prefixes_);
+      deferred_prefixes_.clear();
+      size_t deferred_not = 0;
+      for (size_t i = 0; i < deferred.size(); ++i) {
+        if (deferred[i].op == Operator::NOT) {
+          deferred_not = i;
+        }
+      }
+      ++not_depth_;
+      auto part = parse_not_operand(builder, deferred, deferred_not);
+      --not_depth_;
+      if (!part) {
+        return nullptr;
+      }
+      parts.push_back(build_prefixes(builder, deferred, 0, deferred_not + 1,
+                                     std::move(part)));
+      spans.push_back(deferred.front().span);
+    }
+    typename Builder::BindingList bindings;
+    for (size_t i = parts.size(); i-- > 0;) {
+      builder.add_binding(bindings, kNotVariable, std::move(parts[i]),
+                          spans[i]);
+    }
+    operand = builder.let(std::move(bindings), std::move(operand), op_span);
   }
+  return build_prefixes(builder, prefixes, 0, last_not + 1,
+                        std::move(operand));
+}
 
-  auto right = parse_binary_expression();
-  if (!right) {
-    LOG(ERROR) << "Found operator but failed to parse right expression";
+template <typename Builder>
+typename Builder::Node Parser::parse_not_operand(
+    Builder& builder, const std::vector<Prefix>& prefixes, size_t last_not) {
+  auto operand = parse_primary_expression(builder);
+  if (!operand) {
+    LOG(ERROR) << "Expression not recognized after "
+               << op_to_string(prefixes.back().op);
     return nullptr;
   }
-  return std::make_unique<BinaryExpression>(std::move(left), std::move(right),
-                                            std::move(binary_operator));
+  operand = build_prefixes(builder, prefixes, last_not + 1, prefixes.size(),
+                           std::move(operand));
+  return parse_operators(builder, std::move(operand), Precedence::COMPARISON);
+}
+
+template <typename Builder>
+typename Builder::Node Parser::build_prefixes(
+    Builder& builder, const std::vector<Prefix>& prefixes, size_t begin,
+    size_t end, typename Builder::Node operand) {
+  typename Builder::BindingList chain;
+  uint32_t chain_span = 0;
+  size_t depth = 0;
+  for (size_t i = end; i-- > begin;) {
+    if (depth >= kMaxChainDepth) {
+      if (chain.empty()) {
+        chain_span = prefixes[i].span;
+      }
+      builder.add_binding(chain, kChainVariable, std::move(operand),
+                          prefixes[i].span);
+      operand = builder.identifier(kChainVariable, prefixes[i].span);
+      depth = 0;
+    }
+    operand = prefixes[i].op == Operator::UNARY_MINUS
+                  ? builder.negative(std::move(operand), prefixes[i].span)
+                  : builder.logical_not(std::move(operand), prefixes[i].span);
+    ++depth;
+  }
+  if (chain.empty()) {
+    return operand;
+  }
+  return builder.let(std::move(chain), std::move(operand), chain_span);
+}
+
+template <typename Builder>
+typename Builder::Node Parser::parse_expression(Builder& builder,
+                                                Precedence lowest) {
+  SIMP_TRACE(PARSER, "expression", static_cast<int>(lowest));
+  // An expression at the lowest level starts afresh, so ! operands around it
+  // do not count (see parse_prefix_expression).
+  size_t enclosing_not_depth = not_depth_;
+  if (lowest == Precedence::LOGICAL) {
+    not_depth_ = 0;
+  }
+  auto left = parse_primary_expression(builder);
+  if (left) {
+    left = parse_operators(builder, std::move(left), lowest);
+  }
+  not_depth_ = enclosing_not_depth;
+  return left;
+}
+
+template <typename Builder>
+typename Builder::Node Parser::parse_operators(Builder& builder,
+                                               typename Builder::Node left,
+                                               Precedence lowest) {
+  typename Builder::BindingList chain;
+  uint32_t chain_span = 0;
+  size_t depth = 0;
+  for (;;) {
+    const Token* next = tokens_->peek();
+    if (!next || !next->is_binary() ||
+        binary_precedence(next->op()) < lowest) {
+      break;
+    }
+    Operator op = next->op();
+    Precedence operand_precedence = next_precedence(binary_precedence(op));
+    uint32_t operator_span = span();
+    tokens_->advance();
+    auto right = parse_expression(builder, operand_precedence);
+    if (!right) {
+      LOG(ERROR) << "Found operator but failed to parse right expression";
+      return nullptr;
+    }
+    if (!is_associative(op) || !(next = tokens_->peek()) || !next->is(op)) {
+      left = builder.binary(std::move(left), std::move(right), op,
+                            operator_span);
+      ++depth;
+    } else {
+      // A longer run of the operator is collected whole before any of it is
+      // built, so that the shape of the tree can be chosen afterwards.
+      typename Builder::NodeList operands;
+      std::vector<uint32_t> spans = {operator_span};
+      operands.push_back(std::move(left));
+      operands.push_back(std::move(right));
+      while ((next = tokens_->peek()) && next->is(op)) {
+        spans.push_back(span());
+        tokens_->advance();
+        right = parse_expression(builder, operand_precedence);
+        if (!right) {
+          LOG(ERROR) << "Found operator but failed to parse right expression";
+          return nullptr;
+        }
+        operands.push_back(std::move(right));
+      }
+      // build_chain puts the first operand this many levels down.
+      for (size_t size = 1; size < operands.size(); size *= 2) {
+        ++depth;
+      }
+      left = build_chain(builder, operands, spans, op, 0, operands.size());
+    }
+    if (depth >= kMaxChainDepth) {
+      if (chain.empty()) {
+        chain_span = operator_span;
+      }
+      builder.add_binding(chain, kChainVariable, std::move(left),
+                          operator_span);
+      left = builder.identifier(kChainVariable, operator_span);
+      depth = 0;
+    }
+  }
+  if (chain.empty()) {
+    return left;
+  }
+  return builder.let(std::move(chain), std::move(left), chain_span);
+}
+
+template <typename Builder>
+typename Builder::Node Parser::build_chain(
+    Builder& builder, typename Builder::NodeList& operands,
+    const std::vector<uint32_t>& spans, Operator op, size_t begin,
+    size_t end) {
+  if (end - begin == 1) {
+    return std::move(operands[begin]);
+  }
+  // Rounding up keeps chains of two and three operands nested to the left,
+  // just as the non-associative operators are.
+  size_t middle = begin + (end - begin + 1) / 2;
+  auto left = build_chain(builder, operands, spans, op, begin, middle);
+  auto right = build_chain(builder, operands, spans, op, middle, end);
+  return builder.binary(std::move(left), std::move(right), op,
+                        spans[middle - 1]);
 }
 
 }  // namespace simp
\ No newline at end of file
@@ -1,49 +1,200 @@
+#pragma once
+
 #undef GOOGLE_STRIP_LOG
-#define GOOGLE_STRIP_LOG 0
+#define GOOGLE_STRIP_LOG 1
 #include <glog/logging.h>
 
-#include <deque>
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "ast/ast.h"
+#include "ast/flat_ast.h"
 #include "lexer/lexer.h"
+#include "lexer/streaming_lexer.h"
+#include "parser/builders.h"
+#include "resolver/resolver.h"
+#include "tokens/token_source.h"
 #include "tokens/tokens.h"
 namespace simp {
 class Parser {
  public:
-  Parser(std::deque<std::unique_ptr<Token>> tokens)
-      : tokens_(std::move(tokens)) {}
+  // How deeply operators that cannot be rebalanced nest before the expression
+  // built so far is bound to kChainVariable (see parse_expression).
+  static constexpr size_t kMaxChainDepth = 32;
+  // No identifier starts with a digit, so this name never captures a
+  // variable of the program.
+  static constexpr const char* kChainVariable = "0chain";
+  // Stands for a ! operand nested more than kMaxChainDepth deep, which is
+  // bound separately (see parse_prefix_expression).
+  static constexpr const char* kNotVariable = "0not";
+
+  Parser(TokenStream tokens)
+      : tokens_(std::make_unique<TokenStreamSource>(std::move(tokens))) {}
+  Parser(std::unique_ptr<TokenSource> tokens) : tokens_(std::move(tokens)) {}
+  // Streams the file through a StreamingLexer, so only a few tokens are held
+  // in memory however large it is.
   Parser(const std::string& file) {
-    Lexer lexer{file};
-    lexer.scan();
-    tokens_ = std::move(lexer.tokens());
+    auto lexer = std::make_unique<StreamingLexer>(file);
+    lexer->open();
+    tokens_ = std::move(lexer);
   }
 
-  std::unique_ptr<KeywordToken> expect_keyword(const std::string& keyword);
-  std::unique_ptr<OperatorToken> expect_binary_operator();
-  std::unique_ptr<OperatorToken> expect_close_paren();
-  std::unique_ptr<IdentifierToken> expect_identifier();
-  std::unique_ptr<OperatorToken> expect_assign_operator();
+  // Each expect_* consumes and returns the next token if it matches, and
+  // otherwise returns nullptr and leaves it in place. The token is valid
+  // until the next one is read.
+  const Token* expect_keyword(Keyword keyword);
+  const Token* expect_binary_operator();
+  const Token* expect_close_paren();
+  const Token* expect_identifier();
+  const Token* expect_assign_operator();
 
   bool parse();
-  std::unique_ptr<Expression> parse_primary_expression();
-  bool parse_bindings(
-      std::unique_ptr<std::unordered_map<std::string, std::unique_ptr<Binding>>>
-          bindings_map);
-  std::unique_ptr<Expression> parse_binary_expression();
+  // Parses into a FlatAst instead of a tree of Expression objects.
+  bool parse_flat();
+  // Checks that every recur is in tail position of a loop that binds as many
+  // variables as the recur passes arguments.
+  bool check_recur(Expression* expression, LoopExpression* loop, bool tail);
+  bool check_recur(FlatAst& ast, NodeId node, NodeId loop, bool tail);
+  // Records where the next token starts, for the node built from it.
+  uint32_t span();
+  // Consumes the remaining tokens.
   void print_tokens() {
-    while (!tokens_.empty()) {
-      LOG(INFO) << tokens_.front()->to_string();
-      tokens_.pop_front();
+    for (; tokens_->peek(); tokens_->advance()) {
+      std::cout << tokens_->to_string();
     }
   }
+  // The names of the parsed program, shared with the lexer.
+  SymbolTable& symbols() { return tokens_->symbols(); }
   // TODO: check if move needed.
   std::unique_ptr<Ast> ast() { return std::move(ast_); }
+  std::unique_ptr<FlatAst> flat_ast() { return std::move(flat_ast_); }
   void print_expressions() { std::cout << ast_->to_string() << std::endl; }
 
  private:
-  std::deque<std::unique_ptr<Token>> tokens_;
+  // The grammar, shared by both representations; see builders.h.
+  template <typename Builder>
+  typename Builder::Node parse_primary_expression(Builder& builder);
+  template <typename Builder>
+  bool parse_bindings(Builder& builder,
+                      typename Builder::BindingList& bindings);
+  template <typename Builder>
+  typename Builder::Node parse_loop_expression(Builder& builder,
+                                              uint32_t loop_span);
+  template <typename Builder>
+  typename Builder::Node parse_recur_expression(Builder& builder,
+                                               uint32_t recur_span);
+  // A program is any number of function definitions followed by the
+  // expression to evaluate, or by nothing, in which case it evaluates a call
+  // to main with main's parameters as its inputs.
+  template <typename Builder>
+  bool parse_program(Builder& builder, typename Builder::Node& root,
+                     std::vector<std::string>& inputs);
+  // Whether the next tokens start `let name parameter`, which no let
+  // expression does.
+  bool at_function_definition();
+  template <typename Builder>
+  bool parse_function(Builder& builder);
+  template <typename Builder>
+  typename Builder::Node parse_call(Builder& builder, const std::string& name,
+                                    uint32_t call_span);
+  // A call to an intrinsic no function of the program hides.
+  template <typename Builder>
+  typename Builder::Node parse_intrinsic(Builder& builder, Intrinsic intrinsic,
+                                         uint32_t call_span);
+  // Parses the parenthesized arguments of a call to name and checks that
+  // there are arity of them.
+  template <typename Builder>
+  bool parse_arguments(Builder& builder, const std::string& name, size_t arity,
+                       uint32_t call_span,
+                       typename Builder::NodeList& arguments);
+  // Parses operators binding at least as tightly as lowest by precedence
+  // climbing. Operands are parsed one level tighter, so recursion is bounded
+  // by the number of levels rather than by the length of an operator chain.
+  //
+  // Runs of one associative operator are balanced by build_chain. Anything
+  // else on one level, such as `a < b == c` or alternating && and ||, must
+  // nest to the left. Every kMaxChainDepth operators, the tree built so far
+  // becomes a binding of kChainVariable, and the rest of the chain refers to
+  // it:
+  //
+  //   let 0chain = a && b || ... and 0chain = 0chain || c && ... in ... end
+  //
+  // The bindings run in order and evaluate each operand as the operators
+  // did, so the value and the short circuits stay the same, but no chain is
+  // nested deeper than that.
+  template <typename Builder>
+  typename Builder::Node parse_expression(
+      Builder& builder, Precedence lowest = Precedence::LOGICAL);
+  // Continues parse_expression once its first operand, left, is parsed.
+  template <typename Builder>
+  typename Builder::Node parse_operators(Builder& builder,
+                                         typename Builder::Node left,
+                                         Precedence lowest);
+  // One prefix operator and where it is.
+  struct Prefix {
+    Operator op;
+    uint32_t span;
+  };
+  // Parses a run of prefix operators, the first of which, op, has just been
+  // consumed, and their operand. The run is read in a loop, and the operators
+  // are applied by build_prefixes.
+  //
+  // A ! takes everything up to the next && or ||, so each ! in a chain like
+  // `!a < !b < !c ...` nests the rest of the chain one level deeper. Past
+  // kMaxChainDepth levels, a ! is left to the outermost ! of the chain, which
+  // parses it once its own operand is done, with kNotVariable in its place:
+  //
+  //   !(let 0not = !c ... and 0not = !b < ... 0not in a < ... 0not end)
+  //
+  // The innermost operands are evaluated first then, which cannot be
+  // observed: none of the operators involved short circuits, so every
+  // operand is evaluated either way.
+  template <typename Builder>
+  typename Builder::Node parse_prefix_expression(Builder& builder, Operator op,
+                                                 uint32_t op_span);
+  // The operand of the last ! in prefixes, which is at last_not, with the
+  // unary minuses that follow it applied.
+  template <typename Builder>
+  typename Builder::Node parse_not_operand(Builder& builder,
+                                           const std::vector<Prefix>& prefixes,
+                                           size_t last_not);
+  // Applies prefixes[begin, end) to operand, the last one innermost. Every
+  // kMaxChainDepth operators, the expression built so far is bound to
+  // kChainVariable, as parse_expression does for chains.
+  template <typename Builder>
+  typename Builder::Node build_prefixes(Builder& builder,
+                                        const std::vector<Prefix>& prefixes,
+                                        size_t begin, size_t end,
+                                        typename Builder::Node operand);
+  // Joins operands[begin, end) with the associative op, which spans[i]
+  // separates from operands[i + 1], into a tree of logarithmic depth.
+  template <typename Builder>
+  typename Builder::Node build_chain(Builder& builder,
+                                     typename Builder::NodeList& operands,
+                                     const std::vector<uint32_t>& spans,
+                                     Operator op, size_t begin, size_t end);
+
+  // What a call needs to know about a function defined earlier in the file.
+  // Names are only looked up here; calls carry the index.
+  struct FunctionSignature {
+    uint32_t index;
+    std::vector<std::string> parameters;
+  };
+
+  std::unique_ptr<TokenSource> tokens_;
+  std::unordered_map<std::string, FunctionSignature> functions_;
   std::unique_ptr<Ast> ast_;
+  std::unique_ptr<FlatAst> flat_ast_;
+  SourceMap source_map_;
+  // The index of the file being parsed in source_map_, once a span needs it.
+  uint32_t source_file_ = SourceMap::kNoSpan;
+  // How many ! operands enclose the expression being parsed, counted from the
+  // innermost parentheses, let, call or other place that starts a new one.
+  size_t not_depth_ = 0;
+  // A run with a ! that was too deep to parse where it stood, and that the
+  // outermost ! operand of its chain still has to parse.
+  std::vector<Prefix> deferred_prefixes_;
 };
 }  // namespace simp
\ No newline at end of file
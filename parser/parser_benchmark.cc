@@ -0,0 +1,135 @@
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "lexer/lexer.h"
+#include "lexer/streaming_lexer.h"
+#include "parser/parser.h"
+#include "tokens/token_source.h"
+
+DEFINE_string(file, "", "Program to parse; a program is generated when empty");
+DEFINE_int32(depth, 16,
+             "Nesting depth of the generated program, which has 2^depth "
+             "leaf expressions");
+DEFINE_int32(iterations, 5, "Number of parses to time per token source");
+
+namespace simp {
+namespace {
+// A balanced sum, so the parser's recursion stays shallow however large the
+// program is.
+void generate(int depth, int& counter, std::string& out) {
+  if (depth == 0) {
+    std::string n = std::to_string(counter++ % 7);
+    out += "let x = " + n + " in if x < 3 then (x * 2) else -x end end";
+    return;
+  }
+  out += "(";
+  generate(depth - 1, counter, out);
+  out += ") + (";
+  generate(depth - 1, counter, out);
+  out += ")";
+}
+
+// The parser as it ran before TokenSource became a cursor: every token it
+// moves past costs a virtual call. The window never holds more than the
+// tokens last asked for.
+class TokenAtATimeSource : public TokenSource {
+ public:
+  explicit TokenAtATimeSource(TokenStream tokens)
+      : tokens_(std::move(tokens)) {
+    next_ = end_ = tokens_.data();
+  }
+
+  const std::string& file_name() const override {
+    return tokens_.file_name();
+  }
+  SymbolTable& symbols() override { return tokens_.symbols(); }
+
+ protected:
+  bool fill(size_t k) override {
+    const Token* last = tokens_.data() + tokens_.size();
+    end_ = std::min(next_ + k + 1, last);
+    return next_ + k < last;
+  }
+  int64_t integer_of(const Token& token) override {
+    return tokens_.integer(token);
+  }
+  int line_of(const Token& token) override { return tokens_.line(token); }
+  int position_of(const Token& token) override {
+    return tokens_.position(token);
+  }
+
+ private:
+  TokenStream tokens_;
+};
+
+// Parses FLAGS_iterations times with the sources make_source returns and
+// reports the best throughput in tokens per second.
+template <typename MakeSource>
+void report(const std::string& name, size_t token_count, bool flat,
+            MakeSource make_source) {
+  double best = 0;
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    Parser parser(make_source());
+    auto start = std::chrono::steady_clock::now();
+    bool success = flat ? parser.parse_flat() : parser.parse();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (!success) {
+      LOG(ERROR) << name << ": failed to parse";
+      return;
+    }
+    best = std::max(best, token_count / elapsed.count());
+  }
+  std::cout << name << (flat ? " (flat)" : " (tree)") << ": "
+            << static_cast<uint64_t>(best) << " tokens/s" << std::endl;
+}
+}  // namespace
+}  // namespace simp
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  std::string source;
+  if (FLAGS_file.empty()) {
+    int counter = 0;
+    simp::generate(FLAGS_depth, counter, source);
+  } else {
+    std::ifstream in(FLAGS_file);
+    source.assign(std::istreambuf_iterator<char>(in),
+                  std::istreambuf_iterator<char>());
+  }
+  simp::Lexer lexer(FLAGS_file.empty() ? "<generated>" : FLAGS_file);
+  if (!lexer.scan(source)) {
+    LOG(ERROR) << "Failed to scan";
+    return 1;
+  }
+  const simp::TokenStream& tokens = lexer.tokens();
+  std::cout << tokens.size() << " tokens" << std::endl;
+
+  for (bool flat : {true, false}) {
+    simp::report("virtual call per token", tokens.size(), flat, [&] {
+      return std::unique_ptr<simp::TokenSource>(
+          std::make_unique<simp::TokenAtATimeSource>(tokens));
+    });
+    simp::report("cursor over scanned tokens", tokens.size(), flat, [&] {
+      return std::unique_ptr<simp::TokenSource>(
+          std::make_unique<simp::TokenStreamSource>(tokens));
+    });
+    // Includes scanning, which the parser drives.
+    simp::report("streaming lexer", tokens.size(), flat, [&] {
+      auto streaming = std::make_unique<simp::StreamingLexer>("<generated>");
+      streaming->open(source);
+      return std::unique_ptr<simp::TokenSource>(std::move(streaming));
+    });
+  }
+  return 0;
+}
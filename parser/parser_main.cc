@@ -3,30 +3,77 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include <iostream>
+
+#include "optimizer/inliner.h"
+#include "optimizer/intrinsic_recognizer.h"
+#include "optimizer/simplifier.h"
 #include "parser.h"
+#include "trace/trace.h"
 
 DEFINE_bool(verbose, true, "Enable verbose output");
 DEFINE_string(file, "", "File to parse");
+DEFINE_bool(flat, false, "Parse into the flat array representation");
+DEFINE_bool(simplify, false,
+            "Fold constants and remove identities before printing the tree; "
+            "the number of nodes removed goes to stderr");
+DEFINE_int32(inline_budget, 0,
+             "With --simplify, first inline calls to non-recursive functions "
+             "of at most this many nodes; the number inlined goes to stderr");
+DEFINE_bool(intrinsics, false,
+            "With --simplify, first replace functions that emulate an "
+            "intrinsic with it; the number replaced goes to stderr");
+DEFINE_string(trace, "",
+              "Trace categories to record (lexer, parser, eval or all); the "
+              "trace is printed to stderr on exit");
 
 int main(int argc, char** argv) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
 
   if (FLAGS_verbose) {
     LOG(INFO) << "Verbose output enabled.";
-#undef GOOGLE_STRIP_LOG
-#define GOOGLE_STRIP_LOG 0
   }
+  uint32_t categories;
+  if (!simp::Tracer::parse_categories(FLAGS_trace, categories)) {
+    LOG(ERROR) << "Unknown trace category in: " << FLAGS_trace;
+    return 1;
+  }
+  simp::Tracer::enable(categories);
+
   if (FLAGS_file.empty()) {
     LOG(ERROR) << "No file provided";
     return 1;
   }
+  if (FLAGS_flat && FLAGS_simplify) {
+    LOG(ERROR) << "--simplify rewrites the tree and cannot be used with --flat";
+    return 1;
+  }
   simp::Parser parser(FLAGS_file);
-  bool success = parser.parse();
+  bool success = FLAGS_flat ? parser.parse_flat() : parser.parse();
   if (!success) {
     LOG(ERROR) << "Failed to parse file";
     return 1;
   }
-  parser.print_expressions();
+  if (FLAGS_flat) {
+    std::cout << parser.flat_ast()->to_string() << std::endl;
+  } else if (FLAGS_simplify) {
+    auto ast = parser.ast();
+    if (FLAGS_intrinsics) {
+      size_t recognized = simp::IntrinsicRecognizer().recognize(*ast);
+      std::cerr << "Recognized " << recognized << " intrinsics" << std::endl;
+    }
+    if (FLAGS_inline_budget > 0) {
+      size_t inlined = simp::Inliner(FLAGS_inline_budget).inline_calls(*ast);
+      std::cerr << "Inlined " << inlined << " calls" << std::endl;
+    }
+    size_t removed = simp::Simplifier().simplify(*ast);
+    std::cout << ast->to_string() << std::endl;
+    std::cerr << "Simplification removed " << removed << " nodes"
+              << std::endl;
+  } else {
+    parser.print_expressions();
+  }
+  simp::Tracer::dump(std::cerr);
 
   return 0;
 }
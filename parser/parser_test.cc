@@ -10,8 +10,189 @@ class ParserTest : public ::testing::Test {
   ParserTest() {}
   ~ParserTest() override {}
   void SetUp() override {}
+
+  static std::unique_ptr<Ast> parse_source(const std::string& source) {
+    Lexer lexer("<memory>");
+    if (!lexer.scan(source)) {
+      return nullptr;
+    }
+    Parser parser(std::move(lexer.tokens()));
+    return parser.parse() ? parser.ast() : nullptr;
+  }
+
+  static size_t depth(Expression* expression) {
+    if (expression->type() == ExpressionType::LET) {
+      auto let = static_cast<LetExpression*>(expression);
+      size_t deepest = depth(let->expression().get());
+      for (const auto& binding : let->bindings()) {
+        deepest = std::max(deepest, depth(binding->expression().get()));
+      }
+      return 1 + deepest;
+    }
+    if (expression->type() == ExpressionType::NOT) {
+      return 1 + depth(
+                     static_cast<NotExpression*>(expression)->expression().get());
+    }
+    if (expression->type() == ExpressionType::NEGATIVE) {
+      return 1 + depth(static_cast<NegativeExpression*>(expression)
+                           ->expression()
+                           .get());
+    }
+    if (expression->type() != ExpressionType::BINARY) {
+      return 1;
+    }
+    auto binary = static_cast<BinaryExpression*>(expression);
+    return 1 + std::max(depth(binary->left().get()),
+                        depth(binary->right().get()));
+  }
 };
 
+TEST_F(ParserTest, AppliesReadmePrecedence) {
+  const std::pair<std::string, int64_t> cases[] = {
+      {"2 * 3 + 4", 10},
+      {"4 + 2 * 3", 10},
+      {"-2 * 3 + 1", -5},
+      {"!1 < 2", 0},
+      {"1 < 2 == 1", 1},
+      // Comparisons nest to the left.
+      {"3 < 2 < 1", 1},
+      {"1 == 1 && 0 == 0 || 0", 1},
+      {"!0 && 0", 0},
+      {"- - 5", 5},
+      {"!!7", 1},
+  };
+  for (const auto& [source, expected] : cases) {
+    auto ast = parse_source(source);
+    ASSERT_NE(ast, nullptr) << source;
+    EXPECT_EQ(ast->eval(), expected) << source;
+  }
+}
+
+TEST_F(ParserTest, ParsesLongChainsIntoShallowTrees) {
+  constexpr int kOperands = 100000;
+  std::string source = "1";
+  for (int i = 1; i < kOperands; ++i) {
+    source += " + 1";
+  }
+  auto ast = parse_source(source);
+  ASSERT_NE(ast, nullptr);
+  EXPECT_EQ(ast->eval(), kOperands);
+  EXPECT_LE(depth(ast->root().get()), 18);
+
+  Lexer lexer("<memory>");
+  ASSERT_TRUE(lexer.scan(source));
+  Parser parser(std::move(lexer.tokens()));
+  ASSERT_TRUE(parser.parse_flat());
+  EXPECT_EQ(parser.flat_ast()->eval(), kOperands);
+}
+
+TEST_F(ParserTest, ParsesLongMixedChainsIntoShallowTrees) {
+  constexpr int kOperands = 100000;
+  // Alternating && and ||, and < and ==, can only nest to the left.
+  std::string logical = "1";
+  std::string comparison = "1";
+  int64_t logical_value = 1;
+  int64_t comparison_value = 1;
+  for (int i = 1; i < kOperands; ++i) {
+    int64_t operand = i % 5 != 0;
+    if (i % 3 == 0) {
+      logical += " || " + std::to_string(operand);
+      logical_value = logical_value || operand;
+    } else {
+      logical += " && " + std::to_string(operand);
+      logical_value = logical_value && operand;
+    }
+    operand = i % 3;
+    if (i % 2 == 0) {
+      comparison += " < " + std::to_string(operand);
+      comparison_value = comparison_value < operand;
+    } else {
+      comparison += " == " + std::to_string(operand);
+      comparison_value = comparison_value == operand;
+    }
+  }
+  for (const auto& [source, expected] :
+       {std::pair{logical, logical_value},
+        std::pair{comparison, comparison_value}}) {
+    auto ast = parse_source(source);
+    ASSERT_NE(ast, nullptr);
+    EXPECT_EQ(ast->eval(), expected);
+    EXPECT_LE(depth(ast->root().get()), 2 * Parser::kMaxChainDepth);
+
+    Lexer lexer("<memory>");
+    ASSERT_TRUE(lexer.scan(source));
+    Parser parser(std::move(lexer.tokens()));
+    ASSERT_TRUE(parser.parse_flat());
+    EXPECT_EQ(parser.flat_ast()->eval(), expected);
+  }
+  // Short chains keep their shape.
+  auto ast = parse_source("1 && 0 || 1");
+  ASSERT_NE(ast, nullptr);
+  EXPECT_EQ(ast->root()->type(), ExpressionType::BINARY);
+}
+
+TEST_F(ParserTest, ParsesLongChainsOfNotIntoShallowTrees) {
+  // Each ! takes the rest of the chain as its operand:
+  //   a + b * 1 < 2 == !(a' + b' * 1 < 2 == !(...))
+  constexpr int kSegments = 7500;
+  std::string source;
+  for (int i = 0; i < kSegments; ++i) {
+    source += std::to_string(i % 3) + " + " + std::to_string(i % 2) +
+              " * 1 < 2 == !";
+  }
+  source += "1";
+  int64_t expected = 1;
+  for (int i = kSegments; i-- > 0;) {
+    expected = (i % 3 + i % 2 < 2) == !expected;
+  }
+  auto ast = parse_source(source);
+  ASSERT_NE(ast, nullptr);
+  EXPECT_EQ(ast->eval(), expected);
+  EXPECT_LE(depth(ast->root().get()), 8 * Parser::kMaxChainDepth);
+
+  Lexer lexer("<memory>");
+  ASSERT_TRUE(lexer.scan(source));
+  Parser parser(std::move(lexer.tokens()));
+  ASSERT_TRUE(parser.parse_flat());
+  EXPECT_EQ(parser.flat_ast()->eval(), expected);
+
+  // A ! inside parentheses counts from them again.
+  ast = parse_source("!(!1 < !0) < !(0 < 1)");
+  ASSERT_NE(ast, nullptr);
+  EXPECT_EQ(ast->eval(), 1);
+}
+
+TEST_F(ParserTest, ParsesLongRunsOfPrefixOperatorsIntoShallowTrees) {
+  constexpr int kOperators = 100000;
+  std::string minus;
+  std::string logical_not;
+  std::string mixed;
+  int64_t mixed_value = 7;
+  for (int i = 0; i < kOperators; ++i) {
+    minus += "- ";
+    logical_not += "!";
+    mixed += i % 3 == 0 ? "!" : "- ";
+  }
+  for (int i = kOperators; i-- > 0;) {
+    mixed_value = i % 3 == 0 ? !mixed_value : -mixed_value;
+  }
+  for (const auto& [source, expected] :
+       {std::pair{minus + "7", int64_t{7}},
+        std::pair{logical_not + "7", int64_t{1}},
+        std::pair{mixed + "7", mixed_value}}) {
+    auto ast = parse_source(source);
+    ASSERT_NE(ast, nullptr);
+    EXPECT_EQ(ast->eval(), expected);
+    EXPECT_LE(depth(ast->root().get()), 2 * Parser::kMaxChainDepth);
+
+    Lexer lexer("<memory>");
+    ASSERT_TRUE(lexer.scan(source));
+    Parser parser(std::move(lexer.tokens()));
+    ASSERT_TRUE(parser.parse_flat());
+    EXPECT_EQ(parser.flat_ast()->eval(), expected);
+  }
+}
+
 TEST_F(ParserTest, ParsesIntExpression) {
   Lexer lexer("examples/just_nums.sl");
   bool lexer_worked = lexer.scan();
@@ -85,9 +266,143 @@ TEST_F(ParserTest, ParsesLetExpression) {
   bool parser_worked = parser.parse();
   ASSERT_TRUE(parser_worked);
 
-  // auto ast = parser.ast();
-  // EXPECT_EQ(ast->root()->type(), ExpressionType::LET);
-  // EXPECT_EQ(ast->root()->eval(), 3);
+  auto ast = parser.ast();
+  EXPECT_EQ(ast->root()->type(), ExpressionType::LET);
+  EXPECT_EQ(ast->root()->eval(), 7);
+}
+
+TEST_F(ParserTest, ParsesLoopExpression) {
+  Lexer lexer("examples/factorial_loop.sl");
+  bool lexer_worked = lexer.scan();
+  ASSERT_TRUE(lexer_worked);
+  Parser parser(std::move(lexer.tokens()));
+  bool parser_worked = parser.parse();
+  ASSERT_TRUE(parser_worked);
+
+  auto ast = parser.ast();
+  EXPECT_EQ(ast->root()->type(), ExpressionType::LET);
+  EXPECT_EQ(ast->root()->eval(), 2432902008176640000);
+}
+
+TEST_F(ParserTest, RunsLoopInConstantStack) {
+  Lexer lexer("examples/long_loop.sl");
+  ASSERT_TRUE(lexer.scan());
+  Parser parser(std::move(lexer.tokens()));
+  ASSERT_TRUE(parser.parse());
+  EXPECT_EQ(parser.ast()->eval(), 49999995000000);
+}
+
+TEST_F(ParserTest, RejectsMisplacedRecur) {
+  for (std::string file :
+       {"examples/recur_not_tail.sl", "examples/recur_outside_loop.sl",
+        "examples/recur_arity.sl"}) {
+    Lexer lexer(file);
+    ASSERT_TRUE(lexer.scan()) << file;
+    Parser parser(std::move(lexer.tokens()));
+    EXPECT_FALSE(parser.parse()) << file;
+  }
+}
+
+TEST_F(ParserTest, RecordsSpansInSourceMap) {
+  Parser parser("examples/if_statement.sl");
+  ASSERT_TRUE(parser.parse());
+  auto ast = parser.ast();
+  auto if_expression = static_cast<IfExpression*>(ast->root().get());
+  ASSERT_NE(if_expression->span(), SourceMap::kNoSpan);
+  const Span& span = ast->source_map().span(if_expression->span());
+  EXPECT_EQ(ast->source_map().file_name(span), "examples/if_statement.sl");
+  const Span& consequent =
+      ast->source_map().span(if_expression->consequent()->span());
+  EXPECT_EQ(consequent.line, span.line);
+  EXPECT_GT(consequent.position, span.position);
+}
+
+TEST_F(ParserTest, StreamedAndScannedTokensParseAlike) {
+  for (std::string file :
+       {"examples/if_statement.sl", "examples/factorial_loop.sl",
+        "examples/nested_loop.sl", "examples/sibling_lets.sl",
+        "examples/shadowing.sl"}) {
+    Lexer lexer(file);
+    ASSERT_TRUE(lexer.scan()) << file;
+    Parser scanned(std::move(lexer.tokens()));
+    ASSERT_TRUE(scanned.parse()) << file;
+    Parser streamed(file);
+    ASSERT_TRUE(streamed.parse()) << file;
+    auto expected = scanned.ast();
+    auto actual = streamed.ast();
+    EXPECT_EQ(actual->to_string(), expected->to_string()) << file;
+    EXPECT_EQ(actual->eval(), expected->eval()) << file;
+  }
+}
+
+TEST_F(ParserTest, ResolvesCallsToFunctionIndices) {
+  Parser parser("examples/nextprime.sl");
+  ASSERT_TRUE(parser.parse());
+  auto ast = parser.ast();
+  ASSERT_EQ(ast->functions().size(), 12);
+  EXPECT_EQ(ast->functions()[11]->name(), "main");
+  EXPECT_EQ(ast->inputs(), std::vector<std::string>{"x"});
+  ASSERT_EQ(ast->root()->type(), ExpressionType::CALL);
+  EXPECT_EQ(static_cast<CallExpression*>(ast->root().get())->function(), 11);
+  auto main_body =
+      static_cast<CallExpression*>(ast->functions()[11]->body().get());
+  ASSERT_EQ(main_body->type(), ExpressionType::CALL);
+  EXPECT_EQ(main_body->name(), "nextprime");
+  EXPECT_EQ(main_body->function(), 10);
+  EXPECT_EQ(ast->eval({100}), 101);
+  EXPECT_EQ(ast->eval({1000000}), 1000003);
+}
+
+TEST_F(ParserTest, ParsesFunctionsIntoFlatAst) {
+  for (std::string file : {"examples/functions.sl", "examples/nextprime.sl"}) {
+    Parser tree(file);
+    ASSERT_TRUE(tree.parse()) << file;
+    Parser flat(file);
+    ASSERT_TRUE(flat.parse_flat()) << file;
+    auto ast = tree.ast();
+    auto flat_ast = flat.flat_ast();
+    EXPECT_EQ(flat_ast->to_string(), ast->to_string()) << file;
+    std::vector<int64_t> arguments(ast->inputs().size(), 7919);
+    EXPECT_EQ(flat_ast->eval(arguments), ast->eval(arguments)) << file;
+  }
+  EXPECT_EQ(parse_source("let f x = x + 1 end f (f (1))")->eval(), 3);
+}
+
+TEST_F(ParserTest, RejectsMalformedCalls) {
+  EXPECT_FALSE(Parser("examples/call_arity.sl").parse());
+  // A function is not a value.
+  EXPECT_EQ(parse_source("let f x = x end f"), nullptr);
+  // Only earlier functions, and the function itself, can be called.
+  EXPECT_EQ(parse_source("let f x = g (x) end let g x = x end f (1)"),
+            nullptr);
+  EXPECT_EQ(parse_source("let f x = x end let f y = y end f (1)"), nullptr);
+  // Nothing to evaluate.
+  EXPECT_EQ(parse_source("let f x = x end"), nullptr);
+  EXPECT_EQ(parse_source("let f x = loop i = 0 in f (recur (i)) end end 1"),
+            nullptr);
+}
+
+TEST_F(ParserTest, ParsesIntrinsics) {
+  EXPECT_EQ(parse_source("div (-7) (2)")->eval(), -3);
+  EXPECT_EQ(parse_source("rem (-7) (2)")->eval(), -1);
+  EXPECT_EQ(parse_source("shiftr (-1) (60)")->eval(), 15);
+  EXPECT_EQ(parse_source("leadingzeros (shiftl (1) (3))")->eval(), 60);
+  EXPECT_EQ(parse_source("div (1) (0)")->eval(), 0);
+  // A function of the same name hides the intrinsic.
+  EXPECT_EQ(parse_source("let div x y = x + y end div (6) (2)")->eval(), 8);
+  EXPECT_EQ(parse_source("div (6)"), nullptr);
+  EXPECT_EQ(parse_source("leadingzeros (1) (2)"), nullptr);
+  Parser flat("examples/nextprime_intrinsics.sl");
+  ASSERT_TRUE(flat.parse_flat());
+  EXPECT_EQ(flat.flat_ast()->eval({1000}), 1009);
+}
+
+TEST_F(ParserTest, FailsOnMalformedStream) {
+  auto lexer = std::make_unique<StreamingLexer>("<memory>");
+  lexer->open("1 + 2 & 3");
+  Parser parser(std::move(lexer));
+  EXPECT_FALSE(parser.parse());
+  EXPECT_FALSE(Parser("non_existent_file.sl").parse());
 }
 
 }  // namespace
@@ -0,0 +1,194 @@
+#include "resolver.h"
+
+namespace simp {
+
+void Resolver::enter_frame(const std::vector<std::string>& parameters) {
+  scope_.clear();
+  frame_size_ = 0;
+  for (const auto& parameter : parameters) {
+    bind(parameter);
+  }
+}
+
+bool Resolver::resolve(Ast& ast) {
+  for (const auto& function : ast.functions()) {
+    enter_frame(function->parameters());
+    if (!resolve_expression(function->body().get())) {
+      return false;
+    }
+    function->set_frame_size(frame_size_);
+  }
+  enter_frame(ast.inputs());
+  if (!resolve_expression(ast.root().get())) {
+    return false;
+  }
+  ast.set_frame_size(frame_size_);
+  return true;
+}
+
+bool Resolver::resolve_bindings(Bindings& bindings) {
+  for (const auto& binding : bindings) {
+    if (!resolve_expression(binding->expression().get())) {
+      return false;
+    }
+    binding->set_slot(bind(binding->name()));
+  }
+  return true;
+}
+
+int Resolver::lookup(const std::string& name) {
+  for (size_t slot = scope_.size(); slot-- > 0;) {
+    if (scope_[slot] == name) {
+      return slot;
+    }
+  }
+  LOG(ERROR) << "Unbound variable: " << name;
+  return -1;
+}
+
+int Resolver::bind(const std::string& name) {
+  scope_.push_back(name);
+  frame_size_ = std::max(frame_size_, scope_.size());
+  return scope_.size() - 1;
+}
+
+bool Resolver::resolve_expression(Expression* expression) {
+  if (!expression) {
+    LOG(ERROR) << "Missing expression";
+    return false;
+  }
+  switch (expression->type()) {
+    case ExpressionType::INTEGER:
+      return true;
+    case ExpressionType::IDENTIFIER: {
+      auto identifier = static_cast<IdentifierExpression*>(expression);
+      identifier->set_slot(lookup(identifier->name()));
+      return identifier->slot() >= 0;
+    }
+    case ExpressionType::PARENTHESIS:
+      return resolve_expression(
+          static_cast<ParenthesizedExpression*>(expression)
+              ->expression()
+              .get());
+    case ExpressionType::NOT:
+      return resolve_expression(
+          static_cast<NotExpression*>(expression)->expression().get());
+    case ExpressionType::NEGATIVE:
+      return resolve_expression(
+          static_cast<NegativeExpression*>(expression)->expression().get());
+    case ExpressionType::IF: {
+      auto if_expression = static_cast<IfExpression*>(expression);
+      return resolve_expression(if_expression->condition().get()) &&
+             resolve_expression(if_expression->consequent().get()) &&
+             resolve_expression(if_expression->alternative().get());
+    }
+    case ExpressionType::BINARY: {
+      auto binary = static_cast<BinaryExpression*>(expression);
+      return resolve_expression(binary->left().get()) &&
+             resolve_expression(binary->right().get());
+    }
+    case ExpressionType::LET:
+    case ExpressionType::LOOP: {
+      Bindings& bindings =
+          expression->type() == ExpressionType::LET
+              ? static_cast<LetExpression*>(expression)->bindings()
+              : static_cast<LoopExpression*>(expression)->bindings();
+      Expression* body =
+          expression->type() == ExpressionType::LET
+              ? static_cast<LetExpression*>(expression)->expression().get()
+              : static_cast<LoopExpression*>(expression)->expression().get();
+      size_t depth = scope_.size();
+      bool resolved = resolve_bindings(bindings) && resolve_expression(body);
+      scope_.resize(depth);
+      return resolved;
+    }
+    case ExpressionType::RECUR:
+      for (const auto& argument :
+           static_cast<RecurExpression*>(expression)->arguments()) {
+        if (!resolve_expression(argument.get())) {
+          return false;
+        }
+      }
+      return true;
+    case ExpressionType::CALL:
+      for (const auto& argument :
+           static_cast<CallExpression*>(expression)->arguments()) {
+        if (!resolve_expression(argument.get())) {
+          return false;
+        }
+      }
+      return true;
+    case ExpressionType::INTRINSIC:
+      for (const auto& argument :
+           static_cast<IntrinsicExpression*>(expression)->arguments()) {
+        if (!resolve_expression(argument.get())) {
+          return false;
+        }
+      }
+      return true;
+  }
+  LOG(ERROR) << "Resolver does not support expression:\n"
+             << expression->to_string();
+  return false;
+}
+
+bool Resolver::resolve(FlatAst& ast) {
+  for (auto& function : ast.functions()) {
+    enter_frame(function.parameters);
+    if (!resolve_node(ast, function.body)) {
+      return false;
+    }
+    function.frame_size = frame_size_;
+  }
+  enter_frame(ast.inputs());
+  if (!resolve_node(ast, ast.root())) {
+    return false;
+  }
+  ast.set_frame_size(frame_size_);
+  return true;
+}
+
+bool Resolver::resolve_node(FlatAst& ast, NodeId node) {
+  switch (ast.kind(node)) {
+    case ExpressionType::INTEGER:
+      return true;
+    case ExpressionType::IDENTIFIER:
+      ast.set_slot(node, lookup(ast.name(node)));
+      return ast.slot(node) >= 0;
+    case ExpressionType::PARENTHESIS:
+    case ExpressionType::NOT:
+    case ExpressionType::NEGATIVE:
+      return resolve_node(ast, ast.operand(node));
+    case ExpressionType::IF:
+      return resolve_node(ast, ast.condition(node)) &&
+             resolve_node(ast, ast.consequent(node)) &&
+             resolve_node(ast, ast.alternative(node));
+    case ExpressionType::BINARY:
+      return resolve_node(ast, ast.left(node)) &&
+             resolve_node(ast, ast.right(node));
+    case ExpressionType::LET:
+    case ExpressionType::LOOP: {
+      size_t depth = scope_.size();
+      bool resolved = true;
+      for (uint32_t i = 0; resolved && i < ast.binding_count(node); ++i) {
+        resolved = resolve_node(ast, ast.binding_expression(node, i));
+        ast.set_binding_slot(node, i, bind(ast.binding_name(node, i)));
+      }
+      resolved = resolved && resolve_node(ast, ast.body(node));
+      scope_.resize(depth);
+      return resolved;
+    }
+    case ExpressionType::RECUR:
+    case ExpressionType::CALL:
+    case ExpressionType::INTRINSIC:
+      for (uint32_t i = 0; i < ast.argument_count(node); ++i) {
+        if (!resolve_node(ast, ast.argument(node, i))) {
+          return false;
+        }
+      }
+      return true;
+  }
+  return false;
+}
+
+}  // namespace simp
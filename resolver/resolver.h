@@ -0,0 +1,50 @@
+#pragma once
+
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "ast/ast.h"
+#include "ast/flat_ast.h"
+
+namespace simp {
+// Binds every identifier to the variable it names, once, after parsing.
+//
+// Variables live in a single flat frame. A binding gets the slot just above
+// the variables in scope at that point, so slots are reused by sibling scopes,
+// the variables of one let or loop are consecutive, and the frame is as large
+// as the deepest nesting of bindings. Evaluators then read a variable with a
+// single indexed load instead of searching names at run time.
+//
+// Each function has a frame of its own whose first slots are its parameters.
+// The root frame likewise starts with the program's inputs.
+class Resolver {
+ public:
+  // Assigns slots to all bindings and identifiers and records the frame sizes
+  // in the Ast and its functions. Returns false if a name is not bound.
+  bool resolve(Ast& ast);
+  bool resolve(FlatAst& ast);
+
+ private:
+  bool resolve_expression(Expression* expression);
+  bool resolve_node(FlatAst& ast, NodeId node);
+  // Finds the slot of the innermost variable called name, or -1.
+  int lookup(const std::string& name);
+  // Brings a binding into scope and returns its slot.
+  int bind(const std::string& name);
+  // Resolves each right hand side and then brings its name into scope, so
+  // later bindings see, and may shadow, earlier ones.
+  bool resolve_bindings(Bindings& bindings);
+  // Starts a new frame holding the parameters.
+  void enter_frame(const std::vector<std::string>& parameters);
+
+  // Names in scope and their slots, innermost last. A name's slot is its
+  // position in this list.
+  std::vector<std::string> scope_;
+  size_t frame_size_ = 0;
+};
+}  // namespace simp
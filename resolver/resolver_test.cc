@@ -0,0 +1,75 @@
+#include "resolver/resolver.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "parser/parser.h"
+
+namespace simp {
+namespace {
+using ::testing::Eq;
+class ResolverTest : public ::testing::Test {
+ protected:
+  ResolverTest() {}
+  ~ResolverTest() override {}
+  void SetUp() override {}
+
+  // Parsing already runs the resolver.
+  std::unique_ptr<Ast> parse(const std::string& file) {
+    Parser parser(file);
+    EXPECT_TRUE(parser.parse());
+    return parser.ast();
+  }
+};
+
+TEST_F(ResolverTest, ResolvesShadowedNamesToTheirOwnSlots) {
+  auto ast = parse("examples/shadowing.sl");
+  ASSERT_THAT(ast->root()->type(), Eq(ExpressionType::LET));
+  auto outer = static_cast<LetExpression*>(ast->root().get());
+  EXPECT_THAT(outer->bindings()[0]->slot(), Eq(0));
+
+  auto inner = static_cast<LetExpression*>(outer->expression().get());
+  EXPECT_THAT(inner->bindings()[0]->slot(), Eq(1));
+  EXPECT_THAT(inner->bindings()[1]->slot(), Eq(2));
+  // `a = a + 1` reads the previous binding of a.
+  auto sum = static_cast<BinaryExpression*>(
+      inner->bindings()[1]->expression().get());
+  EXPECT_THAT(static_cast<IdentifierExpression*>(sum->left().get())->slot(),
+              Eq(1));
+  EXPECT_THAT(
+      static_cast<IdentifierExpression*>(inner->expression().get())->slot(),
+      Eq(2));
+  EXPECT_THAT(ast->frame_size(), Eq(3));
+  EXPECT_THAT(ast->eval(), Eq(2));
+}
+
+TEST_F(ResolverTest, SiblingScopesShareSlots) {
+  auto ast = parse("examples/sibling_lets.sl");
+  EXPECT_THAT(ast->frame_size(), Eq(2));
+  EXPECT_THAT(ast->eval(), Eq(7));
+}
+
+TEST_F(ResolverTest, LoopVariablesAreConsecutive) {
+  auto ast = parse("examples/factorial_loop.sl");
+  auto let = static_cast<LetExpression*>(ast->root().get());
+  auto loop = static_cast<LoopExpression*>(let->expression().get());
+  EXPECT_THAT(loop->bindings()[0]->slot(), Eq(1));
+  EXPECT_THAT(loop->bindings()[1]->slot(), Eq(2));
+  EXPECT_THAT(ast->eval(), Eq(2432902008176640000));
+}
+
+TEST_F(ResolverTest, ResolvingAgainGivesTheSameFrame) {
+  auto ast = parse("examples/nested_loop.sl");
+  size_t frame_size = ast->frame_size();
+  ASSERT_TRUE(Resolver().resolve(*ast));
+  EXPECT_THAT(ast->frame_size(), Eq(frame_size));
+  EXPECT_THAT(ast->eval(), Eq(4));
+}
+
+TEST_F(ResolverTest, RejectsUnboundVariable) {
+  Parser parser("examples/unbound_variable.sl");
+  EXPECT_FALSE(parser.parse());
+}
+
+}  // namespace
+}  // namespace simp
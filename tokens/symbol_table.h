@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace simp {
+// Every distinct identifier and file name, stored once. Tokens refer to
+// names by their 32 bit Symbol, and the lexer and the parser share one table
+// so the parser gets the spelling back without anything being copied per
+// token.
+class SymbolTable {
+ public:
+  using Symbol = uint32_t;
+
+  Symbol intern(std::string_view name) {
+    auto it = ids_.find(name);
+    if (it != ids_.end()) {
+      return it->second;
+    }
+    // A deque never moves its elements, so the views used as keys stay valid.
+    const std::string& stored = names_.emplace_back(name);
+    Symbol symbol = names_.size() - 1;
+    ids_.emplace(stored, symbol);
+    return symbol;
+  }
+  const std::string& name(Symbol symbol) const { return names_[symbol]; }
+  size_t size() const { return names_.size(); }
+
+ private:
+  std::deque<std::string> names_;
+  std::unordered_map<std::string_view, Symbol> ids_;
+};
+}  // namespace simp
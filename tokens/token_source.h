@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "tokens/symbol_table.h"
+#include "tokens/tokens.h"
+
+namespace simp {
+// Where a Parser reads its tokens from: a cursor over a window of tokens
+// that sit contiguously in memory. Peeking and advancing within the window
+// are inline pointer operations; only when the parser looks past its end
+// does the source get a (virtual) chance to fill it. Only a few tokens past
+// the next unconsumed one need to be available, so a source may produce
+// them just as they are asked for.
+class TokenSource {
+ public:
+  virtual ~TokenSource() {}
+
+  // The token k places after the next unconsumed one, or nullptr past the
+  // end. The pointer is valid until the source is read from again.
+  const Token* peek(size_t k = 0) {
+    if (k < static_cast<size_t>(end_ - next_) || fill(k)) {
+      return next_ + k;
+    }
+    return nullptr;
+  }
+  // Consumes the next token.
+  void advance() {
+    if (next_ != end_ || fill(0)) {
+      ++next_;
+    }
+  }
+  // The value of the INTEGER token k places ahead.
+  int64_t integer(size_t k = 0) { return integer_of(*peek(k)); }
+  // Where the token k places ahead starts. Lines and positions start at 1.
+  int line(size_t k = 0) { return line_of(*peek(k)); }
+  int position(size_t k = 0) { return position_of(*peek(k)); }
+  virtual const std::string& file_name() const = 0;
+  virtual SymbolTable& symbols() = 0;
+  // False once the input turned out to be malformed; a source that fails
+  // stops producing tokens.
+  virtual bool ok() const { return true; }
+
+  // Formats the token k places ahead the way TokenStream::to_string does.
+  std::string to_string(size_t k = 0) {
+    const Token* token = peek(k);
+    if (!token) {
+      return "end-of-input";
+    }
+    switch (token->type) {
+      case TokenType::KEYWORD:
+        return keyword_to_string(token->keyword());
+      case TokenType::INTEGER:
+        return std::to_string(integer(k));
+      case TokenType::IDENTIFIER:
+        return symbols().name(token->value);
+      case TokenType::OPERATOR:
+        return op_to_string(token->op());
+    }
+    return "invalid-token";
+  }
+
+ protected:
+  // Makes at least k + 1 tokens available from next_, moving the window if
+  // need be. Returns false if the input ends first.
+  virtual bool fill(size_t k) = 0;
+  // What TokenStream would look up for a token inside the window.
+  virtual int64_t integer_of(const Token& token) = 0;
+  virtual int line_of(const Token& token) = 0;
+  virtual int position_of(const Token& token) = 0;
+
+  // The next unconsumed token and the end of the window.
+  const Token* next_ = nullptr;
+  const Token* end_ = nullptr;
+};
+
+// Reads a TokenStream that has been scanned whole: the window is the entire
+// stream, so the parser never calls into the source to move through it.
+class TokenStreamSource : public TokenSource {
+ public:
+  explicit TokenStreamSource(TokenStream tokens) : tokens_(std::move(tokens)) {
+    next_ = tokens_.data();
+    end_ = next_ + tokens_.size();
+  }
+  TokenStreamSource(const TokenStreamSource&) = delete;
+  TokenStreamSource& operator=(const TokenStreamSource&) = delete;
+
+  const std::string& file_name() const override {
+    return tokens_.file_name();
+  }
+  SymbolTable& symbols() override { return tokens_.symbols(); }
+
+ protected:
+  bool fill(size_t) override { return false; }
+  int64_t integer_of(const Token& token) override {
+    return tokens_.integer(token);
+  }
+  int line_of(const Token& token) override { return tokens_.line(token); }
+  int position_of(const Token& token) override {
+    return tokens_.position(token);
+  }
+
+ private:
+  TokenStream tokens_;
+};
+}  // namespace simp
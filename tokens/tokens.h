@@ -4,48 +4,147 @@
 #define GOOGLE_STRIP_LOG 1
 #include <glog/logging.h>
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <iostream>
-#include <map>
+#include <limits>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
+
+#include "tokens/symbol_table.h"
 
 namespace simp {
 
-enum TokenType {
+enum TokenType : uint8_t {
   KEYWORD,
   INTEGER,
   IDENTIFIER,
   OPERATOR,
 };
 
-inline std::map<std::string, std::string> Keywords = {
-    {"let", "let-keyword"},     {"end", "end-keyword"},
-    {"recur", "recur-keyword"}, {"if", "if-keyword"},
-    {"then", "then-keyword"},   {"else", "else-keyword"},
-    {"in", "in-keyword"},       {"and", "and-keyword"},
-    {"loop", "loop-keyword"},
+enum class Keyword : uint8_t {
+  LET,
+  END,
+  RECUR,
+  IF,
+  THEN,
+  ELSE,
+  IN,
+  AND,
+  LOOP,
+};
+
+inline constexpr std::string_view kKeywordNames[] = {
+    "let", "end", "recur", "if", "then", "else", "in", "and", "loop",
 };
+inline constexpr size_t kKeywordCount = std::size(kKeywordNames);
 
-inline bool is_valid_keyword(std::string keyword) {
-  return Keywords.find(keyword) != Keywords.end();
+// Keywords are found through a perfect hash chosen by the compiler: every
+// keyword lands in its own slot, so a word costs one hash, one table read and
+// at most one comparison, and nothing is allocated or mutable.
+inline constexpr size_t kKeywordSlots = 16;
+
+constexpr size_t keyword_hash(std::string_view word, uint32_t seed) {
+  return (word.size() + static_cast<unsigned char>(word.front()) * seed +
+          static_cast<unsigned char>(word.back())) %
+         kKeywordSlots;
+}
+
+// The smallest seed for which no two keywords share a slot.
+constexpr uint32_t find_keyword_seed() {
+  for (uint32_t seed = 1; seed < 1024; ++seed) {
+    bool taken[kKeywordSlots] = {};
+    bool collides = false;
+    for (std::string_view name : kKeywordNames) {
+      size_t slot = keyword_hash(name, seed);
+      collides = collides || taken[slot];
+      taken[slot] = true;
+    }
+    if (!collides) {
+      return seed;
+    }
+  }
+  return 0;
 }
 
-inline bool is_keyword_prefix(const std::string& prefix) {
-  for (const auto& pair : Keywords) {
-    if (pair.first.rfind(prefix, 0) == 0) {
+inline constexpr uint32_t kKeywordSeed = find_keyword_seed();
+static_assert(kKeywordSeed != 0, "No perfect hash for the keywords");
+
+// The keyword index in each slot, or kKeywordCount for an empty slot.
+inline constexpr std::array<uint8_t, kKeywordSlots> kKeywordSlotTable = [] {
+  std::array<uint8_t, kKeywordSlots> table{};
+  // std::array::fill is constexpr only from C++20, and not every target
+  // including this header builds with it.
+  for (auto& slot : table) {
+    slot = kKeywordCount;
+  }
+  for (size_t i = 0; i < kKeywordCount; ++i) {
+    table[keyword_hash(kKeywordNames[i], kKeywordSeed)] = i;
+  }
+  return table;
+}();
+
+inline constexpr size_t kLongestKeyword = [] {
+  size_t longest = 0;
+  for (std::string_view name : kKeywordNames) {
+    longest = std::max(longest, name.size());
+  }
+  return longest;
+}();
+
+constexpr bool find_keyword(std::string_view text, Keyword& keyword) {
+  if (text.empty() || text.size() > kLongestKeyword) {
+    return false;
+  }
+  size_t index = kKeywordSlotTable[keyword_hash(text, kKeywordSeed)];
+  if (index == kKeywordCount || kKeywordNames[index] != text) {
+    return false;
+  }
+  keyword = static_cast<Keyword>(index);
+  return true;
+}
+
+constexpr bool is_valid_keyword(std::string_view text) {
+  Keyword keyword{};
+  return find_keyword(text, keyword);
+}
+
+constexpr bool is_keyword_prefix(std::string_view prefix) {
+  for (std::string_view name : kKeywordNames) {
+    if (name.substr(0, prefix.size()) == prefix) {
       return true;
     }
   }
   return false;
 }
 
-inline std::string to_string(std::string keyword) {
-  if (!is_valid_keyword(keyword)) {
+static_assert([] {
+  for (size_t i = 0; i < kKeywordCount; ++i) {
+    Keyword keyword;
+    if (!find_keyword(kKeywordNames[i], keyword) ||
+        keyword != static_cast<Keyword>(i)) {
+      return false;
+    }
+  }
+  return true;
+}());
+
+inline std::string keyword_to_string(Keyword keyword) {
+  return std::string(kKeywordNames[static_cast<size_t>(keyword)]) + "-keyword";
+}
+
+inline std::string to_string(std::string_view keyword) {
+  Keyword found;
+  if (!find_keyword(keyword, found)) {
     return "invalid-keyword";
   }
-  return Keywords[keyword];
+  return keyword_to_string(found);
 }
 
-enum Operator {
+enum Operator : uint8_t {
   // single operators
   OPEN_PAREN,
   CLOSE_PAREN,
@@ -88,139 +187,178 @@ inline std::string op_to_string(Operator op) {
   }
 }
 
-inline std::string operators = "+-*(=)&|!";
-inline bool is_operator(char c) {
-  return operators.find(c) != std::string::npos;
+inline constexpr std::string_view kOperatorChars = "+-*(=)&|!<";
+constexpr bool is_operator(char c) {
+  return kOperatorChars.find(c) != std::string_view::npos;
 }
 
-class Token {
- public:
-  Token(TokenType type, int line, int position, std::string file_name)
-      : type_(type), line_(line), position_(position), file_name_(file_name) {}
-
-  TokenType type() { return type_; }
-  int line() { return line_; }
-  int position() { return position_; }
-  std::string file_name() { return file_name_; }
-  std::string location() {
-    return " in file:\"" + file_name_ + "\"\ton line:" + std::to_string(line_) +
-           "\tat position:" + std::to_string(position_);
-  }
-
-  /**************** Virtual methods******************/
-  virtual std::string to_string() = 0;
-  virtual ~Token() {}
-
- private:
-  TokenType type_;
-  int line_;
-  int position_;
-  std::string file_name_;
+// How tightly operators bind, loosest first, as in the README's table.
+enum class Precedence : uint8_t {
+  NONE,
+  LOGICAL,
+  NOT,
+  COMPARISON,
+  SUM,
+  PRODUCT,
+  NEGATION,
+  APPLICATION,
 };
 
-class OperatorToken : public Token {
- public:
-  OperatorToken(Operator op, int line, int position, std::string file_name)
-      : Token(TokenType::OPERATOR, line, position, file_name), op_(op) {
-    LOG(INFO) << "(" << op_to_string(op) << ")" << "OperatorToken created";
-  }
+constexpr Precedence next_precedence(Precedence precedence) {
+  return static_cast<Precedence>(static_cast<uint8_t>(precedence) + 1);
+}
 
-  OperatorToken(OperatorToken* op_token)
-      : Token(TokenType::OPERATOR, op_token->line(), op_token->position(),
-              op_token->file_name()),
-        op_(op_token->op()) {
-    LOG(INFO) << "(" << op_to_string(op_) << ")"
-              << "OperatorToken created from pointer";
+// The precedence of a binary operator, or NONE for any other operator.
+constexpr Precedence binary_precedence(Operator op) {
+  switch (op) {
+    case LOGICAL_AND:
+    case LOGICAL_OR:
+      return Precedence::LOGICAL;
+    case LESS_THAN:
+    case EQUALS:
+      return Precedence::COMPARISON;
+    case PLUS:
+      return Precedence::SUM;
+    case TIMES:
+      return Precedence::PRODUCT;
+    default:
+      return Precedence::NONE;
   }
+}
 
-  Operator op() { return op_; }
-  std::string to_string() override { return op_to_string(op_); }
+// Whether (a op b) op c always equals a op (b op c). Wrapping + and * are,
+// and so are && and || since both evaluate left to right and return 0 or 1.
+constexpr bool is_associative(Operator op) {
+  return op == PLUS || op == TIMES || op == LOGICAL_AND || op == LOGICAL_OR;
+}
 
-  bool is_binary() {
-    return op_ == Operator::PLUS || op_ == Operator::TIMES ||
-           op_ == Operator::EQUALS || op_ == Operator::LOGICAL_AND ||
-           op_ == Operator::LOGICAL_OR || op_ == Operator::LESS_THAN;
+// One lexed token: a plain 12 byte value. Whatever used to be copied into
+// every token (its spelling, its file name) lives once in the TokenStream and
+// its SymbolTable instead.
+struct Token {
+  TokenType type;
+  // The Operator of an OPERATOR token, the Keyword of a KEYWORD token, and
+  // for an INTEGER token whether value indexes the stream's literal table.
+  uint8_t code;
+  // The Symbol of an IDENTIFIER token, or an INTEGER token's literal.
+  uint32_t value;
+  // Byte offset of the token's first character in its file.
+  uint32_t offset;
+
+  Operator op() const { return static_cast<Operator>(code); }
+  Keyword keyword() const { return static_cast<Keyword>(code); }
+  bool is(Operator expected) const {
+    return type == TokenType::OPERATOR && op() == expected;
   }
-
-  ~OperatorToken() {
-    LOG(INFO) << "OperatorToken(" << to_string() << ") destroyed";
+  bool is(Keyword expected) const {
+    return type == TokenType::KEYWORD && keyword() == expected;
+  }
+  bool is_binary() const {
+    return type == TokenType::OPERATOR &&
+           (op() == Operator::PLUS || op() == Operator::TIMES ||
+            op() == Operator::EQUALS || op() == Operator::LOGICAL_AND ||
+            op() == Operator::LOGICAL_OR || op() == Operator::LESS_THAN);
   }
-
- private:
-  Operator op_;
 };
+static_assert(sizeof(Token) == 12);
 
-class IntegerToken : public Token {
+// The tokens of one file, stored contiguously, with what is needed to turn
+// them back into text and locations.
+class TokenStream {
  public:
-  IntegerToken(int value, int line, int position, std::string file_name)
-      : Token(TokenType::INTEGER, line, position, file_name), value_(value) {
-    LOG(INFO) << "IntegerToken created with value:" << value_;
-  }
-  int value() { return value_; }
-  std::string to_string() override { return std::to_string(value_); }
+  using Symbol = SymbolTable::Symbol;
 
-  ~IntegerToken() { LOG(INFO) << "IntegerToken(" << value_ << ") destroyed"; }
+  explicit TokenStream(std::shared_ptr<SymbolTable> symbols = nullptr)
+      : symbols_(symbols ? std::move(symbols)
+                         : std::make_shared<SymbolTable>()) {}
 
- private:
-  const int value_;
-};
+  void set_file_name(std::string_view file_name) {
+    file_ = symbols_->intern(file_name);
+  }
+  const std::string& file_name() const {
+    static const std::string kNoFileName;
+    return file_ == kNoFile ? kNoFileName : symbols_->name(file_);
+  }
+  SymbolTable& symbols() { return *symbols_; }
+  const std::shared_ptr<SymbolTable>& shared_symbols() const {
+    return symbols_;
+  }
 
-class KeywordToken : public Token {
- public:
-  KeywordToken(std::string keyword, int line, int position,
-               std::string file_name)
-      : Token(TokenType::KEYWORD, line, position, file_name),
-        keyword_(keyword) {
-    if (!is_valid_keyword(keyword_)) {
-      LOG(ERROR) << "Invalid keyword";
-      throw std::runtime_error("Invalid keyword");
-    } else {
-      LOG(INFO) << "(" << keyword << ") KeywordToken created";
+  void add_operator(Operator op, uint32_t offset) {
+    tokens_.push_back({TokenType::OPERATOR, op, 0, offset});
+  }
+  void add_keyword(Keyword keyword, uint32_t offset) {
+    tokens_.push_back(
+        {TokenType::KEYWORD, static_cast<uint8_t>(keyword), 0, offset});
+  }
+  void add_identifier(std::string_view name, uint32_t offset) {
+    tokens_.push_back(
+        {TokenType::IDENTIFIER, 0, symbols_->intern(name), offset});
+  }
+  void add_integer(int64_t value, uint32_t offset) {
+    // Nearly every literal fits the token itself; the rest go to a side table.
+    if (value >= 0 && value <= std::numeric_limits<uint32_t>::max()) {
+      tokens_.push_back({TokenType::INTEGER, 0, static_cast<uint32_t>(value),
+                         offset});
+      return;
     }
+    literals_.push_back(value);
+    tokens_.push_back({TokenType::INTEGER, 1,
+                       static_cast<uint32_t>(literals_.size() - 1), offset});
   }
-
-  KeywordToken(KeywordToken* keyword_token)
-      : Token(TokenType::KEYWORD, keyword_token->line(),
-              keyword_token->position(), keyword_token->file_name()),
-        keyword_(keyword_token->keyword()) {
-    if (!is_valid_keyword(keyword_)) {
-      throw std::runtime_error("Invalid keyword");
-    } else {
-      LOG(INFO) << "(" << keyword_ << ") KeywordToken created from pointer";
+  // Records that a new line starts at offset.
+  void add_line(uint32_t offset) { line_starts_.push_back(offset); }
+
+  size_t size() const { return tokens_.size(); }
+  bool empty() const { return tokens_.empty(); }
+  const Token& operator[](size_t index) const { return tokens_[index]; }
+  const Token* data() const { return tokens_.data(); }
+  std::vector<Token>::const_iterator begin() const { return tokens_.begin(); }
+  std::vector<Token>::const_iterator end() const { return tokens_.end(); }
+
+  int64_t integer(const Token& token) const {
+    return token.code ? literals_[token.value] : token.value;
+  }
+  const std::string& name(const Token& token) const {
+    return symbols_->name(token.value);
+  }
+  std::string to_string(const Token& token) const {
+    switch (token.type) {
+      case TokenType::KEYWORD:
+        return keyword_to_string(token.keyword());
+      case TokenType::INTEGER:
+        return std::to_string(integer(token));
+      case TokenType::IDENTIFIER:
+        return name(token);
+      case TokenType::OPERATOR:
+        return op_to_string(token.op());
     }
+    return "invalid-token";
   }
 
-  std::string keyword() { return keyword_; }
-  std::string to_string() override { return Keywords[keyword_]; }
-  ~KeywordToken() { LOG(INFO) << "KeywordToken(" << keyword_ << ") destroyed"; }
-
- private:
-  std::string keyword_;
-};
-
-class IdentifierToken : public Token {
- public:
-  IdentifierToken(std::string name, int line, int position,
-                  std::string file_name)
-      : Token(TokenType::IDENTIFIER, line, position, file_name), name_(name) {
-    LOG(INFO) << "IdentifierToken(" << name_ << ") created.";
+  // Lines and positions start at 1.
+  int line(const Token& token) const {
+    return std::upper_bound(line_starts_.begin(), line_starts_.end(),
+                            token.offset) -
+           line_starts_.begin();
   }
-  IdentifierToken(IdentifierToken* identifier_token)
-      : Token(TokenType::IDENTIFIER, identifier_token->line(),
-              identifier_token->position(), identifier_token->file_name()),
-        name_(identifier_token->name()) {
-    LOG(INFO) << "IdentifierToken(" << name_ << ") created from pointer.";
+  int position(const Token& token) const {
+    return token.offset - line_starts_[line(token) - 1] + 1;
   }
-
-  std::string name() { return name_; }
-  std::string to_string() override { return name_; }
-
-  ~IdentifierToken() {
-    LOG(INFO) << "IdentifierToken(" << name_ << ") destroyed";
+  std::string location(const Token& token) const {
+    return " in file:\"" + file_name() + "\"\ton line:" +
+           std::to_string(line(token)) +
+           "\tat position:" + std::to_string(position(token));
   }
 
  private:
-  std::string name_;
+  static constexpr Symbol kNoFile = std::numeric_limits<Symbol>::max();
+
+  std::shared_ptr<SymbolTable> symbols_;
+  Symbol file_ = kNoFile;
+  std::vector<Token> tokens_;
+  std::vector<int64_t> literals_;
+  std::vector<uint32_t> line_starts_ = {0};
 };
 
-}  // namespace simp
\ No newline at end of file
+}  // namespace simp
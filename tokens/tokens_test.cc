@@ -1,5 +1,7 @@
 #include "tokens.h"
 
+#include "token_source.h"
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
@@ -9,46 +11,123 @@ using ::testing::Eq;
 using ::testing::StrEq;
 class TokensTest : public ::testing::Test {
  protected:
-  TokensTest() {}
+  TokensTest() { tokens_.set_file_name("test"); }
   ~TokensTest() override {}
   void SetUp() override {}
+
+  TokenStream tokens_;
 };
 
 TEST_F(TokensTest, CanCreateOperaatorToken) {
-  OperatorToken token(Operator::PLUS, 1, 1, "test");
-  EXPECT_THAT(token.type(), Eq(TokenType::OPERATOR));
+  tokens_.add_operator(Operator::PLUS, 0);
+  const Token& token = tokens_[0];
+  EXPECT_THAT(token.type, Eq(TokenType::OPERATOR));
   EXPECT_THAT(token.op(), Eq(Operator::PLUS));
-  EXPECT_THAT(token.to_string(), StrEq("plus-operator"));
-  EXPECT_THAT(token.location(),
+  EXPECT_TRUE(token.is_binary());
+  EXPECT_THAT(tokens_.to_string(token), StrEq("plus-operator"));
+  EXPECT_THAT(tokens_.location(token),
               StrEq(" in file:\"test\"\ton line:1\tat position:1"));
 }
 
 TEST_F(TokensTest, CanCreateIntegerToken) {
-  IntegerToken token(123456, 1, 1, "test");
-  EXPECT_THAT(token.type(), Eq(TokenType::INTEGER));
-  EXPECT_THAT(token.value(), Eq(123456));
-  EXPECT_THAT(token.to_string(), StrEq("123456"));
-  EXPECT_THAT(token.location(),
+  tokens_.add_integer(123456, 0);
+  const Token& token = tokens_[0];
+  EXPECT_THAT(token.type, Eq(TokenType::INTEGER));
+  EXPECT_THAT(tokens_.integer(token), Eq(123456));
+  EXPECT_THAT(tokens_.to_string(token), StrEq("123456"));
+  EXPECT_THAT(tokens_.location(token),
               StrEq(" in file:\"test\"\ton line:1\tat position:1"));
 }
 
+TEST_F(TokensTest, KeepsLargeIntegersOutOfTheToken) {
+  tokens_.add_integer(9223372036854775807, 0);
+  tokens_.add_integer(4294967295, 20);
+  EXPECT_THAT(tokens_.integer(tokens_[0]), Eq(9223372036854775807));
+  EXPECT_THAT(tokens_.integer(tokens_[1]), Eq(4294967295));
+}
+
 TEST_F(TokensTest, CanCreateKeywordToken) {
-  KeywordToken token("let", 1, 1, "test");
-  EXPECT_THAT(token.type(), Eq(TokenType::KEYWORD));
-  EXPECT_THAT(token.keyword(), Eq("let"));
-  EXPECT_THAT(token.to_string(), StrEq("let-keyword"));
-  EXPECT_THAT(token.location(),
+  tokens_.add_keyword(Keyword::LET, 0);
+  const Token& token = tokens_[0];
+  EXPECT_THAT(token.type, Eq(TokenType::KEYWORD));
+  EXPECT_TRUE(token.is(Keyword::LET));
+  EXPECT_THAT(tokens_.to_string(token), StrEq("let-keyword"));
+  EXPECT_THAT(tokens_.location(token),
               StrEq(" in file:\"test\"\ton line:1\tat position:1"));
 }
 
 TEST_F(TokensTest, CanCreateIdentifierToken) {
-  IdentifierToken token("qwerttyuiop", 1, 1, "test");
-  EXPECT_THAT(token.type(), Eq(TokenType::IDENTIFIER));
-  EXPECT_THAT(token.name(), Eq("qwerttyuiop"));
-  EXPECT_THAT(token.to_string(), StrEq("qwerttyuiop"));
-  EXPECT_THAT(token.location(),
+  tokens_.add_identifier("qwerttyuiop", 0);
+  const Token& token = tokens_[0];
+  EXPECT_THAT(token.type, Eq(TokenType::IDENTIFIER));
+  EXPECT_THAT(tokens_.name(token), StrEq("qwerttyuiop"));
+  EXPECT_THAT(tokens_.to_string(token), StrEq("qwerttyuiop"));
+  EXPECT_THAT(tokens_.location(token),
               StrEq(" in file:\"test\"\ton line:1\tat position:1"));
 }
 
+TEST_F(TokensTest, InternsIdentifiers) {
+  tokens_.add_identifier("a", 0);
+  tokens_.add_identifier("b", 2);
+  tokens_.add_identifier(std::string("a"), 4);
+  EXPECT_THAT(tokens_[0].value, Eq(tokens_[2].value));
+  EXPECT_THAT(tokens_[0].value == tokens_[1].value, Eq(false));
+  // The file name and the two identifiers.
+  EXPECT_THAT(tokens_.symbols().size(), Eq(3));
+}
+
+TEST_F(TokensTest, LocatesTokensOnLaterLines) {
+  tokens_.add_keyword(Keyword::LET, 0);
+  tokens_.add_line(4);
+  tokens_.add_line(5);
+  tokens_.add_keyword(Keyword::END, 7);
+  EXPECT_THAT(tokens_.location(tokens_[1]),
+              StrEq(" in file:\"test\"\ton line:3\tat position:3"));
+}
+
+TEST_F(TokensTest, FindsKeywords) {
+  Keyword keyword;
+  ASSERT_TRUE(find_keyword("recur", keyword));
+  EXPECT_THAT(keyword, Eq(Keyword::RECUR));
+  EXPECT_FALSE(find_keyword("recurs", keyword));
+  EXPECT_FALSE(find_keyword("", keyword));
+}
+
+TEST_F(TokensTest, RejectsWordsSharingAKeywordSlot) {
+  // Every keyword is found, and a word hashing to its slot is not mistaken
+  // for it.
+  for (size_t i = 0; i < kKeywordCount; ++i) {
+    Keyword keyword;
+    ASSERT_TRUE(find_keyword(kKeywordNames[i], keyword));
+    EXPECT_THAT(keyword, Eq(static_cast<Keyword>(i)));
+  }
+  for (std::string_view word : {"lEt", "ifs", "nd", "_in", "loops", "x"}) {
+    EXPECT_FALSE(is_valid_keyword(word)) << word;
+  }
+  EXPECT_TRUE(is_keyword_prefix("rec"));
+  EXPECT_FALSE(is_keyword_prefix("rex"));
+  EXPECT_THAT(to_string("then"), StrEq("then-keyword"));
+  EXPECT_THAT(to_string("than"), StrEq("invalid-keyword"));
+}
+
+TEST_F(TokensTest, SourcePeeksAndAdvancesOverTheStream) {
+  tokens_.add_keyword(Keyword::LET, 0);
+  tokens_.add_identifier("a", 4);
+  tokens_.add_integer(int64_t{1} << 40, 8);
+  TokenStreamSource source(tokens_);
+  EXPECT_TRUE(source.peek()->is(Keyword::LET));
+  EXPECT_THAT(source.integer(2), Eq(int64_t{1} << 40));
+  EXPECT_THAT(source.position(2), Eq(9));
+  EXPECT_EQ(source.peek(3), nullptr);
+  source.advance();
+  EXPECT_THAT(source.to_string(), StrEq("a"));
+  source.advance();
+  source.advance();
+  EXPECT_EQ(source.peek(), nullptr);
+  // Advancing past the end stays there.
+  source.advance();
+  EXPECT_EQ(source.peek(), nullptr);
+}
+
 }  // namespace
-}  // namespace simp
\ No newline at end of file
+}  // namespace simp
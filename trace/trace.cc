@@ -0,0 +1,84 @@
+#include "trace/trace.h"
+
+#include <chrono>
+
+namespace simp {
+std::atomic<uint32_t> Tracer::enabled_{0};
+std::atomic<uint64_t> Tracer::next_{0};
+TraceEvent Tracer::ring_[Tracer::kCapacity];
+
+std::string_view trace_category_name(TraceCategory category) {
+  switch (category) {
+    case TraceCategory::LEXER:
+      return "lexer";
+    case TraceCategory::PARSER:
+      return "parser";
+    case TraceCategory::EVAL:
+      return "eval";
+  }
+  return "unknown";
+}
+
+bool Tracer::parse_categories(std::string_view list, uint32_t& categories) {
+  categories = 0;
+  while (!list.empty()) {
+    size_t comma = list.find(',');
+    std::string_view name = list.substr(0, comma);
+    list = comma == std::string_view::npos ? "" : list.substr(comma + 1);
+    if (name == "all") {
+      categories |= kAllTraceCategories;
+      continue;
+    }
+    bool found = false;
+    for (TraceCategory category : {TraceCategory::LEXER, TraceCategory::PARSER,
+                                   TraceCategory::EVAL}) {
+      if (name == trace_category_name(category)) {
+        categories |= trace_bit(category);
+        found = true;
+      }
+    }
+    if (!found) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Kept out of line so that a trace point adds only the test and a call to
+// the code around it.
+[[gnu::noinline, gnu::cold]] void Tracer::record(TraceCategory category,
+                                                 const char* what,
+                                                 int64_t value) {
+  uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count();
+  uint64_t index = next_.fetch_add(1, std::memory_order_relaxed);
+  ring_[index & (kCapacity - 1)] = {time, what, value, category};
+}
+
+std::vector<TraceEvent> Tracer::events() {
+  uint64_t next = next_.load(std::memory_order_acquire);
+  uint64_t first = next > kCapacity ? next - kCapacity : 0;
+  std::vector<TraceEvent> events;
+  events.reserve(next - first);
+  for (uint64_t i = first; i < next; ++i) {
+    events.push_back(ring_[i & (kCapacity - 1)]);
+  }
+  return events;
+}
+
+void Tracer::dump(std::ostream& out) {
+  std::vector<TraceEvent> all = events();
+  uint64_t dropped = next_.load(std::memory_order_relaxed) - all.size();
+  if (dropped > 0) {
+    out << "(" << dropped << " older events overwritten)\n";
+  }
+  for (const TraceEvent& event : all) {
+    out << event.time - all.front().time << "ns\t"
+        << trace_category_name(event.category) << "\t" << event.what << "\t"
+        << event.value << "\n";
+  }
+}
+
+void Tracer::clear() { next_.store(0, std::memory_order_release); }
+}  // namespace simp
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+namespace simp {
+// Tracing for the hot paths, in place of LOG(INFO). A trace point records a
+// string literal and one number into a fixed ring of binary events; nothing
+// is formatted until the ring is dumped.
+//
+// A category whose bit is clear in SIMP_TRACE_CATEGORIES is compiled out
+// entirely. A category compiled in costs one relaxed load and one branch
+// while it is disabled at run time.
+enum class TraceCategory : uint8_t {
+  LEXER,
+  PARSER,
+  EVAL,
+};
+
+constexpr uint32_t trace_bit(TraceCategory category) {
+  return 1u << static_cast<uint32_t>(category);
+}
+
+inline constexpr uint32_t kAllTraceCategories =
+    trace_bit(TraceCategory::LEXER) | trace_bit(TraceCategory::PARSER) |
+    trace_bit(TraceCategory::EVAL);
+
+// Release builds compile every category out unless told otherwise, e.g.
+// -DSIMP_TRACE_CATEGORIES=2 keeps the parser's trace points.
+#ifndef SIMP_TRACE_CATEGORIES
+#ifdef NDEBUG
+#define SIMP_TRACE_CATEGORIES 0
+#else
+#define SIMP_TRACE_CATEGORIES ::simp::kAllTraceCategories
+#endif
+#endif
+
+constexpr bool trace_compiled(TraceCategory category) {
+  return (SIMP_TRACE_CATEGORIES) & trace_bit(category);
+}
+
+struct TraceEvent {
+  // Nanoseconds on the steady clock.
+  uint64_t time;
+  // The literal passed at the trace point.
+  const char* what;
+  int64_t value;
+  TraceCategory category;
+};
+
+class Tracer {
+ public:
+  // Power of two, so the ring index is a mask.
+  static constexpr size_t kCapacity = 1 << 16;
+
+  // Categories are enabled as a mask of trace_bit()s.
+  static void enable(uint32_t categories) {
+    enabled_.store(categories, std::memory_order_relaxed);
+  }
+  static uint32_t enabled() { return enabled_.load(std::memory_order_relaxed); }
+  static bool enabled(TraceCategory category) {
+    return enabled_.load(std::memory_order_relaxed) & trace_bit(category);
+  }
+  // Parses a comma separated list such as "lexer,parser", or "all".
+  static bool parse_categories(std::string_view list, uint32_t& categories);
+
+  static void record(TraceCategory category, const char* what, int64_t value);
+  // The events still in the ring, oldest first. Meant to be called while
+  // nothing is recording.
+  static std::vector<TraceEvent> events();
+  // Writes events() one per line, with times relative to the oldest.
+  static void dump(std::ostream& out);
+  static void clear();
+
+ private:
+  static std::atomic<uint32_t> enabled_;
+  static std::atomic<uint64_t> next_;
+  static TraceEvent ring_[kCapacity];
+};
+
+std::string_view trace_category_name(TraceCategory category);
+}  // namespace simp
+
+// Records what (a string literal) and value when category, one of LEXER,
+// PARSER or EVAL, is compiled in and enabled.
+#define SIMP_TRACE(category, what, value)                                     \
+  do {                                                                        \
+    if constexpr (::simp::trace_compiled(::simp::TraceCategory::category)) {  \
+      if (::simp::Tracer::enabled(::simp::TraceCategory::category))           \
+          [[unlikely]] {                                                      \
+        ::simp::Tracer::record(::simp::TraceCategory::category, what,         \
+                               static_cast<int64_t>(value));                  \
+      }                                                                       \
+    }                                                                         \
+  } while (0)
@@ -0,0 +1,84 @@
+#include "trace/trace.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+
+#include "parser/parser.h"
+
+namespace simp {
+namespace {
+using ::testing::Eq;
+using ::testing::Gt;
+using ::testing::HasSubstr;
+using ::testing::StrEq;
+
+class TraceTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    Tracer::enable(0);
+    Tracer::clear();
+  }
+  void TearDown() override {
+    Tracer::enable(0);
+    Tracer::clear();
+  }
+};
+
+TEST_F(TraceTest, RecordsNothingWhileDisabled) {
+  SIMP_TRACE(PARSER, "ignored", 1);
+  Parser parser("examples/factorial_loop.sl");
+  ASSERT_TRUE(parser.parse());
+  EXPECT_TRUE(Tracer::events().empty());
+}
+
+TEST_F(TraceTest, RecordsOnlyEnabledCategories) {
+  if (!trace_compiled(TraceCategory::PARSER) ||
+      !trace_compiled(TraceCategory::LEXER)) {
+    GTEST_SKIP() << "Trace categories compiled out";
+  }
+  Tracer::enable(trace_bit(TraceCategory::PARSER));
+  Parser parser("examples/factorial_loop.sl");
+  ASSERT_TRUE(parser.parse());
+  auto events = Tracer::events();
+  ASSERT_THAT(events.size(), Gt(0));
+  for (const TraceEvent& event : events) {
+    EXPECT_THAT(event.category, Eq(TraceCategory::PARSER));
+  }
+  EXPECT_THAT(events.front().what, StrEq("expression"));
+}
+
+TEST_F(TraceTest, KeepsTheNewestEvents) {
+  if (!trace_compiled(TraceCategory::EVAL)) {
+    GTEST_SKIP() << "Trace categories compiled out";
+  }
+  Tracer::enable(trace_bit(TraceCategory::EVAL));
+  for (size_t i = 0; i < Tracer::kCapacity + 10; ++i) {
+    SIMP_TRACE(EVAL, "step", i);
+  }
+  auto events = Tracer::events();
+  ASSERT_THAT(events.size(), Eq(Tracer::kCapacity));
+  EXPECT_THAT(events.front().value, Eq(10));
+  EXPECT_THAT(events.back().value, Eq(Tracer::kCapacity + 9));
+  std::ostringstream dump;
+  Tracer::dump(dump);
+  EXPECT_THAT(dump.str(), HasSubstr("(10 older events overwritten)"));
+  EXPECT_THAT(dump.str(), HasSubstr("eval\tstep\t10\n"));
+}
+
+TEST_F(TraceTest, ParsesCategoryLists) {
+  uint32_t categories;
+  ASSERT_TRUE(Tracer::parse_categories("lexer,eval", categories));
+  EXPECT_THAT(categories, Eq(trace_bit(TraceCategory::LEXER) |
+                                 trace_bit(TraceCategory::EVAL)));
+  ASSERT_TRUE(Tracer::parse_categories("all", categories));
+  EXPECT_THAT(categories, Eq(kAllTraceCategories));
+  ASSERT_TRUE(Tracer::parse_categories("", categories));
+  EXPECT_THAT(categories, Eq(0));
+  EXPECT_FALSE(Tracer::parse_categories("lexer,vm", categories));
+}
+
+}  // namespace
+}  // namespace simp
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace simp {
+
+// Register based instruction set. Every instruction names its destination
+// register in `a` and its source registers in `b` and `c`. Jump targets need a
+// wider operand and combine `b` and `c` into a single 32 bit value.
+//
+// Integer literals never need an instruction of their own: the Vm preloads
+// every constant of a Program into the registers following the temporaries,
+// so instructions can use them directly as source registers.
+//
+// Every function is a Program of its own whose first registers are its
+// parameters. A call runs the callee in a fresh register window just above
+// the caller's.
+enum class OpCode : uint8_t {
+  MOVE,              // r[a] = r[b]
+  ADD,               // r[a] = r[b] + r[c]
+  MULTIPLY,          // r[a] = r[b] * r[c]
+  LESS_THAN,         // r[a] = r[b] < r[c]
+  EQUALS,            // r[a] = r[b] == r[c]
+  NOT,               // r[a] = !r[b]
+  NEGATE,            // r[a] = -r[b]
+  TO_BOOL,           // r[a] = r[b] != 0
+  JUMP,              // pc = bc
+  JUMP_IF_ZERO,      // if r[a] == 0 then pc = bc
+  JUMP_IF_NOT_ZERO,  // if r[a] != 0 then pc = bc
+  RETURN,            // return r[a]
+  CALL,              // r[a] = functions[b](r[c], r[c + 1], ...)
+  DIVIDE,            // r[a] = div(r[b], r[c]), see Intrinsic
+  REMAINDER,         // r[a] = rem(r[b], r[c])
+  SHIFT_LEFT,        // r[a] = shiftl(r[b], r[c])
+  SHIFT_RIGHT,       // r[a] = shiftr(r[b], r[c])
+  LEADING_ZEROS,     // r[a] = leadingzeros(r[b])
+};
+
+inline std::string opcode_to_string(OpCode op) {
+  switch (op) {
+    case OpCode::MOVE:
+      return "move";
+    case OpCode::ADD:
+      return "add";
+    case OpCode::MULTIPLY:
+      return "multiply";
+    case OpCode::LESS_THAN:
+      return "less-than";
+    case OpCode::EQUALS:
+      return "equals";
+    case OpCode::NOT:
+      return "not";
+    case OpCode::NEGATE:
+      return "negate";
+    case OpCode::TO_BOOL:
+      return "to-bool";
+    case OpCode::JUMP:
+      return "jump";
+    case OpCode::JUMP_IF_ZERO:
+      return "jump-if-zero";
+    case OpCode::JUMP_IF_NOT_ZERO:
+      return "jump-if-not-zero";
+    case OpCode::RETURN:
+      return "return";
+    case OpCode::CALL:
+      return "call";
+    case OpCode::DIVIDE:
+      return "divide";
+    case OpCode::REMAINDER:
+      return "remainder";
+    case OpCode::SHIFT_LEFT:
+      return "shift-left";
+    case OpCode::SHIFT_RIGHT:
+      return "shift-right";
+    case OpCode::LEADING_ZEROS:
+      return "leading-zeros";
+  }
+  return "invalid-opcode";
+}
+
+struct Instruction {
+  OpCode op;
+  uint16_t a;
+  uint16_t b;
+  uint16_t c;
+
+  uint32_t bc() const { return (static_cast<uint32_t>(b) << 16) | c; }
+  void set_bc(uint32_t value) {
+    b = static_cast<uint16_t>(value >> 16);
+    c = static_cast<uint16_t>(value & 0xffff);
+  }
+};
+
+static_assert(sizeof(Instruction) == 8, "instructions should stay compact");
+
+class Program {
+ public:
+  std::vector<Instruction>& code() { return code_; }
+  const std::vector<Instruction>& code() const { return code_; }
+  std::vector<int64_t>& constants() { return constants_; }
+  const std::vector<int64_t>& constants() const { return constants_; }
+  // Total number of registers, including the constant registers at the end.
+  uint16_t register_count() const { return register_count_; }
+  void set_register_count(uint16_t count) { register_count_ = count; }
+  uint16_t constant_base() const {
+    return register_count_ - constants_.size();
+  }
+  // The registers that hold the arguments on entry.
+  uint16_t parameter_count() const { return parameter_count_; }
+  void set_parameter_count(uint16_t count) { parameter_count_ = count; }
+  // The functions of the program, indexed as CALL names them. Only the
+  // Program being run has any.
+  std::vector<Program>& functions() { return functions_; }
+  const std::vector<Program>& functions() const { return functions_; }
+
+  std::string to_string() const {
+    std::string result = "";
+    for (size_t pc = 0; pc < code_.size(); ++pc) {
+      const Instruction& instruction = code_[pc];
+      result += std::to_string(pc) + "\t" + opcode_to_string(instruction.op) +
+                "\t" + std::to_string(instruction.a);
+      switch (instruction.op) {
+        case OpCode::JUMP:
+        case OpCode::JUMP_IF_ZERO:
+        case OpCode::JUMP_IF_NOT_ZERO:
+          result += "\t@" + std::to_string(instruction.bc());
+          break;
+        case OpCode::CALL:
+          result += "\tfunction " + std::to_string(instruction.b) + "\t" +
+                    std::to_string(instruction.c);
+          break;
+        default:
+          result += "\t" + register_to_string(instruction.b) + "\t" +
+                    register_to_string(instruction.c);
+      }
+      result += "\n";
+    }
+    for (size_t i = 0; i < functions_.size(); ++i) {
+      result += "function " + std::to_string(i) + ":\n" +
+                functions_[i].to_string();
+    }
+    return result;
+  }
+
+  std::string register_to_string(uint16_t reg) const {
+    if (reg >= constant_base() && reg < register_count_) {
+      return "#" + std::to_string(constants_[reg - constant_base()]);
+    }
+    return std::to_string(reg);
+  }
+
+ private:
+  std::vector<Instruction> code_;
+  std::vector<int64_t> constants_;
+  uint16_t register_count_ = 0;
+  uint16_t parameter_count_ = 0;
+  std::vector<Program> functions_;
+};
+
+}  // namespace simp
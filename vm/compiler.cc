@@ -0,0 +1,445 @@
+#include "compiler.h"
+
+namespace simp {
+
+std::unique_ptr<Program> BytecodeCompiler::compile(Ast& ast) {
+  auto program = std::make_unique<Program>();
+  if (ast.functions().size() > 0xffff) {
+    LOG(ERROR) << "Program defines too many functions";
+    return nullptr;
+  }
+  program->functions().resize(ast.functions().size());
+  for (size_t i = 0; i < ast.functions().size(); ++i) {
+    Function& function = *ast.functions()[i];
+    if (!compile_function(function.body().get(), function.parameters().size(),
+                          program->functions()[i])) {
+      LOG(ERROR) << "Failed to compile function " << function.name()
+                 << " to bytecode";
+      return nullptr;
+    }
+  }
+  if (!compile_function(ast.root().get(), ast.inputs().size(), *program)) {
+    LOG(ERROR) << "Failed to compile program to bytecode";
+    return nullptr;
+  }
+  return program;
+}
+
+bool BytecodeCompiler::compile_function(Expression* body, size_t parameters,
+                                        Program& program) {
+  program_ = &program;
+  constant_indices_.clear();
+  next_register_ = 0;
+  variable_registers_.clear();
+  loops_.clear();
+  program.set_parameter_count(parameters);
+  for (size_t i = 0; i < parameters; ++i) {
+    uint16_t reg;
+    if (!allocate_register(reg)) {
+      return false;
+    }
+    variable_registers_.push_back(reg);
+  }
+  uint16_t result;
+  if (!allocate_register(result) || !compile_expression(body, result)) {
+    return false;
+  }
+  emit(OpCode::RETURN, result);
+  if (program_->register_count() + program_->constants().size() >=
+      kConstantRegister) {
+    LOG(ERROR) << "Program needs too many registers";
+    return false;
+  }
+  relocate_constants();
+  return true;
+}
+
+bool BytecodeCompiler::allocate_register(uint16_t& reg) {
+  if (next_register_ == kConstantRegister) {
+    LOG(ERROR) << "Expression needs too many registers";
+    return false;
+  }
+  reg = next_register_++;
+  if (next_register_ > program_->register_count()) {
+    program_->set_register_count(next_register_);
+  }
+  return true;
+}
+
+uint16_t BytecodeCompiler::constant_register(int64_t value) {
+  auto found = constant_indices_.find(value);
+  if (found != constant_indices_.end()) {
+    return kConstantRegister | found->second;
+  }
+  uint16_t index = program_->constants().size();
+  program_->constants().push_back(value);
+  constant_indices_[value] = index;
+  return kConstantRegister | index;
+}
+
+void BytecodeCompiler::relocate_constants() {
+  uint16_t base = program_->register_count();
+  auto relocate = [base](uint16_t& reg) {
+    if (reg & kConstantRegister) {
+      reg = base + (reg & ~kConstantRegister);
+    }
+  };
+  for (auto& instruction : program_->code()) {
+    switch (instruction.op) {
+      case OpCode::JUMP:
+      case OpCode::JUMP_IF_ZERO:
+      case OpCode::JUMP_IF_NOT_ZERO:
+      // Names a function and the first of the argument temporaries.
+      case OpCode::CALL:
+        break;
+      default:
+        relocate(instruction.b);
+        relocate(instruction.c);
+    }
+  }
+  program_->set_register_count(base + program_->constants().size());
+}
+
+uint32_t BytecodeCompiler::emit(OpCode op, uint16_t a, uint16_t b,
+                                uint16_t c) {
+  program_->code().push_back(Instruction{op, a, b, c});
+  return program_->code().size() - 1;
+}
+
+void BytecodeCompiler::patch_jump(uint32_t jump) {
+  program_->code()[jump].set_bc(program_->code().size());
+}
+
+bool BytecodeCompiler::lookup(IdentifierExpression* identifier,
+                              uint16_t& reg) {
+  int slot = identifier->slot();
+  if (slot < 0 || static_cast<size_t>(slot) >= variable_registers_.size()) {
+    LOG(ERROR) << "Unresolved variable: " << identifier->name();
+    return false;
+  }
+  reg = variable_registers_[slot];
+  return true;
+}
+
+bool BytecodeCompiler::compile_operand(Expression* expression,
+                                       uint16_t scratch, uint16_t& reg) {
+  if (expression && expression->type() == ExpressionType::INTEGER) {
+    reg = constant_register(static_cast<IntExpression*>(expression)->value());
+    return true;
+  }
+  if (expression && expression->type() == ExpressionType::IDENTIFIER) {
+    return lookup(static_cast<IdentifierExpression*>(expression), reg);
+  }
+  reg = scratch;
+  return compile_expression(expression, scratch);
+}
+
+bool BytecodeCompiler::compile_expression(Expression* expression,
+                                          uint16_t target) {
+  if (!expression) {
+    LOG(ERROR) << "Missing expression";
+    return false;
+  }
+  switch (expression->type()) {
+    case ExpressionType::INTEGER: {
+      auto integer = static_cast<IntExpression*>(expression);
+      emit(OpCode::MOVE, target, constant_register(integer->value()));
+      return true;
+    }
+    case ExpressionType::PARENTHESIS: {
+      auto parenthesized = static_cast<ParenthesizedExpression*>(expression);
+      return compile_expression(parenthesized->expression().get(), target);
+    }
+    case ExpressionType::NOT: {
+      auto not_expression = static_cast<NotExpression*>(expression);
+      uint16_t operand;
+      if (!compile_operand(not_expression->expression().get(), target,
+                           operand)) {
+        return false;
+      }
+      emit(OpCode::NOT, target, operand);
+      return true;
+    }
+    case ExpressionType::NEGATIVE: {
+      auto negative = static_cast<NegativeExpression*>(expression);
+      uint16_t operand;
+      if (!compile_operand(negative->expression().get(), target, operand)) {
+        return false;
+      }
+      emit(OpCode::NEGATE, target, operand);
+      return true;
+    }
+    case ExpressionType::IF: {
+      auto if_expression = static_cast<IfExpression*>(expression);
+      if (!compile_expression(if_expression->condition().get(), target)) {
+        return false;
+      }
+      auto to_alternative = emit(OpCode::JUMP_IF_ZERO, target);
+      if (!compile_expression(if_expression->consequent().get(), target)) {
+        return false;
+      }
+      auto to_end = emit(OpCode::JUMP, target);
+      patch_jump(to_alternative);
+      if (!compile_expression(if_expression->alternative().get(), target)) {
+        return false;
+      }
+      patch_jump(to_end);
+      return true;
+    }
+    case ExpressionType::BINARY:
+      return compile_binary(static_cast<BinaryExpression*>(expression),
+                            target);
+    case ExpressionType::IDENTIFIER: {
+      uint16_t variable;
+      if (!lookup(static_cast<IdentifierExpression*>(expression), variable)) {
+        return false;
+      }
+      emit(OpCode::MOVE, target, variable);
+      return true;
+    }
+    case ExpressionType::LET: {
+      auto let = static_cast<LetExpression*>(expression);
+      std::vector<uint16_t> variables;
+      bool compiled = compile_bindings(let->bindings(), variables) &&
+                      compile_expression(let->expression().get(), target);
+      for (size_t i = 0; i < variables.size(); ++i) {
+        release_register();
+      }
+      return compiled;
+    }
+    case ExpressionType::LOOP:
+      return compile_loop(static_cast<LoopExpression*>(expression), target);
+    case ExpressionType::RECUR:
+      return compile_recur(static_cast<RecurExpression*>(expression));
+    case ExpressionType::CALL:
+      return compile_call(static_cast<CallExpression*>(expression), target);
+    case ExpressionType::INTRINSIC:
+      return compile_intrinsic(static_cast<IntrinsicExpression*>(expression),
+                               target);
+    default:
+      LOG(ERROR) << "Bytecode compiler does not support expression:\n"
+                 << expression->to_string();
+      return false;
+  }
+}
+
+bool BytecodeCompiler::compile_bindings(Bindings& bindings,
+                                        std::vector<uint16_t>& registers) {
+  for (const auto& binding : bindings) {
+    uint16_t reg;
+    if (!allocate_register(reg)) {
+      return false;
+    }
+    registers.push_back(reg);
+    if (!compile_expression(binding->expression().get(), reg)) {
+      return false;
+    }
+    int slot = binding->slot();
+    if (slot < 0) {
+      LOG(ERROR) << "Unresolved binding: " << binding->name();
+      return false;
+    }
+    if (static_cast<size_t>(slot) >= variable_registers_.size()) {
+      variable_registers_.resize(slot + 1);
+    }
+    variable_registers_[slot] = reg;
+  }
+  return true;
+}
+
+bool BytecodeCompiler::compile_loop(LoopExpression* expression,
+                                    uint16_t target) {
+  LoopContext loop;
+  bool compiled = compile_bindings(expression->bindings(), loop.variables);
+  if (compiled) {
+    loop.start = program_->code().size();
+    loops_.push_back(loop);
+    compiled = compile_expression(expression->expression().get(), target);
+    loops_.pop_back();
+  }
+  for (size_t i = 0; i < loop.variables.size(); ++i) {
+    release_register();
+  }
+  return compiled;
+}
+
+bool BytecodeCompiler::compile_recur(RecurExpression* expression) {
+  if (loops_.empty()) {
+    LOG(ERROR) << "Recur outside of a loop";
+    return false;
+  }
+  // Copied, since loops inside the arguments grow loops_.
+  const LoopContext loop = loops_.back();
+  auto& arguments = expression->arguments();
+  if (arguments.size() != loop.variables.size()) {
+    LOG(ERROR) << "Recur argument count does not match its loop";
+    return false;
+  }
+  // All arguments are computed before any loop variable is overwritten, since
+  // they may refer to each other's old values. Literals and arguments that
+  // leave a variable unchanged need no temporary.
+  std::vector<uint16_t> sources;
+  uint16_t temporaries = 0;
+  bool compiled = true;
+  for (size_t i = 0; compiled && i < arguments.size(); ++i) {
+    Expression* argument = arguments[i].get();
+    uint16_t source;
+    if (argument->type() == ExpressionType::INTEGER) {
+      compiled = compile_operand(argument, 0, source);
+    } else if (argument->type() == ExpressionType::IDENTIFIER &&
+               compile_operand(argument, 0, source) &&
+               source == loop.variables[i]) {
+      // recur passes the variable its own value.
+    } else if (allocate_register(source)) {
+      temporaries++;
+      compiled = compile_expression(argument, source);
+    } else {
+      compiled = false;
+    }
+    sources.push_back(source);
+  }
+  if (compiled) {
+    for (size_t i = 0; i < sources.size(); ++i) {
+      if (sources[i] != loop.variables[i]) {
+        emit(OpCode::MOVE, loop.variables[i], sources[i]);
+      }
+    }
+    auto jump = emit(OpCode::JUMP, 0);
+    program_->code()[jump].set_bc(loop.start);
+  }
+  for (uint16_t i = 0; i < temporaries; ++i) {
+    release_register();
+  }
+  return compiled;
+}
+
+bool BytecodeCompiler::compile_call(CallExpression* expression,
+                                    uint16_t target) {
+  // Each argument releases its own temporaries before the next one is
+  // allocated, so the argument registers are consecutive.
+  uint16_t first = next_register_;
+  uint16_t allocated = 0;
+  bool compiled = true;
+  for (const auto& argument : expression->arguments()) {
+    uint16_t reg;
+    if (!allocate_register(reg)) {
+      compiled = false;
+      break;
+    }
+    allocated++;
+    if (!compile_expression(argument.get(), reg)) {
+      compiled = false;
+      break;
+    }
+  }
+  if (compiled) {
+    emit(OpCode::CALL, target, expression->function(), first);
+  }
+  for (uint16_t i = 0; i < allocated; ++i) {
+    release_register();
+  }
+  return compiled;
+}
+
+bool BytecodeCompiler::compile_binary(BinaryExpression* expression,
+                                      uint16_t target) {
+  Operator op = expression->op();
+  if (op == Operator::LOGICAL_AND || op == Operator::LOGICAL_OR) {
+    // Shortcut evaluation: the left value decides whether the right hand side
+    // runs at all, and both sides are normalized to 0 or 1.
+    if (!compile_expression(expression->left().get(), target)) {
+      return false;
+    }
+    emit(OpCode::TO_BOOL, target, target);
+    auto to_end = emit(op == Operator::LOGICAL_AND ? OpCode::JUMP_IF_ZERO
+                                                   : OpCode::JUMP_IF_NOT_ZERO,
+                       target);
+    if (!compile_expression(expression->right().get(), target)) {
+      return false;
+    }
+    emit(OpCode::TO_BOOL, target, target);
+    patch_jump(to_end);
+    return true;
+  }
+
+  OpCode opcode;
+  switch (op) {
+    case Operator::PLUS:
+      opcode = OpCode::ADD;
+      break;
+    case Operator::TIMES:
+      opcode = OpCode::MULTIPLY;
+      break;
+    case Operator::LESS_THAN:
+      opcode = OpCode::LESS_THAN;
+      break;
+    case Operator::EQUALS:
+      opcode = OpCode::EQUALS;
+      break;
+    default:
+      LOG(ERROR) << "Not a binary operator: " << op_to_string(op);
+      return false;
+  }
+  return compile_operation(opcode, expression->left().get(),
+                           expression->right().get(), target);
+}
+
+bool BytecodeCompiler::compile_intrinsic(IntrinsicExpression* expression,
+                                         uint16_t target) {
+  OpCode opcode;
+  switch (expression->intrinsic()) {
+    case Intrinsic::DIV:
+      opcode = OpCode::DIVIDE;
+      break;
+    case Intrinsic::REM:
+      opcode = OpCode::REMAINDER;
+      break;
+    case Intrinsic::SHIFTL:
+      opcode = OpCode::SHIFT_LEFT;
+      break;
+    case Intrinsic::SHIFTR:
+      opcode = OpCode::SHIFT_RIGHT;
+      break;
+    case Intrinsic::LEADING_ZEROS:
+      opcode = OpCode::LEADING_ZEROS;
+      break;
+    default:
+      LOG(ERROR) << "Unknown intrinsic";
+      return false;
+  }
+  auto& arguments = expression->arguments();
+  return compile_operation(
+      opcode, arguments[0].get(),
+      arguments.size() > 1 ? arguments[1].get() : nullptr, target);
+}
+
+bool BytecodeCompiler::compile_operation(OpCode opcode, Expression* left,
+                                         Expression* right, uint16_t target) {
+  uint16_t left_register;
+  if (!compile_operand(left, target, left_register)) {
+    return false;
+  }
+  if (!right) {
+    emit(opcode, target, left_register);
+    return true;
+  }
+  uint16_t right_register;
+  if (right->type() == ExpressionType::INTEGER ||
+      right->type() == ExpressionType::IDENTIFIER) {
+    // Read in place, so the left value in target is not clobbered.
+    if (!compile_operand(right, target, right_register)) {
+      return false;
+    }
+    emit(opcode, target, left_register, right_register);
+    return true;
+  }
+  if (!allocate_register(right_register) ||
+      !compile_expression(right, right_register)) {
+    return false;
+  }
+  emit(opcode, target, left_register, right_register);
+  release_register();
+  return true;
+}
+
+}  // namespace simp
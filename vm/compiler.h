@@ -0,0 +1,73 @@
+#pragma once
+
+#undef GOOGLE_STRIP_LOG
+#define GOOGLE_STRIP_LOG 1
+#include <glog/logging.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ast/ast.h"
+#include "vm/bytecode.h"
+
+namespace simp {
+// Translates an Ast into register bytecode. Registers are handed out like a
+// stack: every subexpression gets the next free register and releases the
+// registers of its operands once it has combined them. Every let and loop
+// variable owns a register for as long as it is in scope, and literal and
+// variable operands are read straight from their register. A loop is a block
+// of code whose recurs move their arguments into the loop's registers and jump
+// back to its start. Each function is compiled the same way into a Program of
+// its own, with its parameters in its first registers.
+class BytecodeCompiler {
+ public:
+  std::unique_ptr<Program> compile(Ast& ast);
+
+ private:
+  // Until the number of temporaries is known, constant registers are encoded
+  // as kConstantRegister | index and relocated once compilation is done.
+  static constexpr uint16_t kConstantRegister = 0x8000;
+
+  // Compiles body into program, with the first registers holding the
+  // parameters.
+  bool compile_function(Expression* body, size_t parameters,
+                        Program& program);
+  bool compile_expression(Expression* expression, uint16_t target);
+  bool compile_operand(Expression* expression, uint16_t scratch,
+                       uint16_t& reg);
+  bool compile_binary(BinaryExpression* expression, uint16_t target);
+  // Emits r[target] = opcode(left, right), with right null for opcodes that
+  // take one operand.
+  bool compile_operation(OpCode opcode, Expression* left, Expression* right,
+                         uint16_t target);
+  bool compile_intrinsic(IntrinsicExpression* expression, uint16_t target);
+  bool compile_bindings(Bindings& bindings, std::vector<uint16_t>& registers);
+  bool compile_loop(LoopExpression* expression, uint16_t target);
+  bool compile_recur(RecurExpression* expression);
+  // Computes the arguments into consecutive registers and calls.
+  bool compile_call(CallExpression* expression, uint16_t target);
+  bool lookup(IdentifierExpression* identifier, uint16_t& reg);
+  uint16_t constant_register(int64_t value);
+  bool allocate_register(uint16_t& reg);
+  void release_register() { next_register_--; }
+  uint32_t emit(OpCode op, uint16_t a, uint16_t b = 0, uint16_t c = 0);
+  void patch_jump(uint32_t jump);
+  void relocate_constants();
+
+  // The Program being compiled, the entry or one of its functions.
+  Program* program_ = nullptr;
+  std::unordered_map<int64_t, uint16_t> constant_indices_;
+  uint16_t next_register_ = 0;
+  // The register holding each variable, indexed by its resolved frame slot.
+  std::vector<uint16_t> variable_registers_;
+
+  struct LoopContext {
+    uint32_t start;
+    std::vector<uint16_t> variables;
+  };
+  std::vector<LoopContext> loops_;
+};
+}  // namespace simp
@@ -0,0 +1,127 @@
+#include "vm.h"
+
+#include "ast/ast.h"
+
+namespace simp {
+
+int64_t Vm::run(const std::vector<int64_t>& arguments) {
+  std::copy(arguments.begin(), arguments.end(), registers_.begin());
+  calls_.clear();
+  const Program* program = &program_;
+  const Instruction* code = program->code().data();
+  size_t base = 0;
+  int64_t* r = registers_.data();
+  const Instruction* pc = code;
+  for (;;) {
+    const Instruction& instruction = *pc++;
+    switch (instruction.op) {
+      case OpCode::MOVE:
+        r[instruction.a] = r[instruction.b];
+        break;
+      case OpCode::ADD:
+        r[instruction.a] = wrapping_add(r[instruction.b], r[instruction.c]);
+        break;
+      case OpCode::MULTIPLY:
+        r[instruction.a] =
+            wrapping_multiply(r[instruction.b], r[instruction.c]);
+        break;
+      case OpCode::LESS_THAN:
+        r[instruction.a] = r[instruction.b] < r[instruction.c];
+        break;
+      case OpCode::EQUALS:
+        r[instruction.a] = r[instruction.b] == r[instruction.c];
+        break;
+      case OpCode::NOT:
+        r[instruction.a] = !r[instruction.b];
+        break;
+      case OpCode::NEGATE:
+        r[instruction.a] = wrapping_negate(r[instruction.b]);
+        break;
+      case OpCode::TO_BOOL:
+        r[instruction.a] = r[instruction.b] != 0;
+        break;
+      case OpCode::JUMP:
+        pc = code + instruction.bc();
+        break;
+      case OpCode::JUMP_IF_ZERO:
+        if (r[instruction.a] == 0) {
+          pc = code + instruction.bc();
+        }
+        break;
+      case OpCode::JUMP_IF_NOT_ZERO:
+        if (r[instruction.a] != 0) {
+          pc = code + instruction.bc();
+        }
+        break;
+      case OpCode::RETURN: {
+        if (calls_.empty()) {
+          return r[instruction.a];
+        }
+        int64_t value = r[instruction.a];
+        const Call call = calls_.back();
+        calls_.pop_back();
+        if (call.memoized != kNotMemoized) {
+          memo_cache_->insert(
+              call.memoized, registers_.data() + call.base + call.arguments,
+              program_.functions()[call.memoized].parameter_count(), value);
+        }
+        program = call.program;
+        code = program->code().data();
+        pc = call.pc;
+        base = call.base;
+        r = registers_.data() + base;
+        r[call.result] = value;
+        break;
+      }
+      case OpCode::DIVIDE:
+        r[instruction.a] = intrinsic_div(r[instruction.b], r[instruction.c]);
+        break;
+      case OpCode::REMAINDER:
+        r[instruction.a] = intrinsic_rem(r[instruction.b], r[instruction.c]);
+        break;
+      case OpCode::SHIFT_LEFT:
+        r[instruction.a] =
+            intrinsic_shiftl(r[instruction.b], r[instruction.c]);
+        break;
+      case OpCode::SHIFT_RIGHT:
+        r[instruction.a] =
+            intrinsic_shiftr(r[instruction.b], r[instruction.c]);
+        break;
+      case OpCode::LEADING_ZEROS:
+        r[instruction.a] = intrinsic_leadingzeros(r[instruction.b]);
+        break;
+      case OpCode::CALL: {
+        const Program& callee = program_.functions()[instruction.b];
+        uint32_t memoized = kNotMemoized;
+        if (memo_cache_ && memo_cache_->memoized(instruction.b)) {
+          if (memo_cache_->lookup(instruction.b, r + instruction.c,
+                                  callee.parameter_count(),
+                                  r[instruction.a])) {
+            break;
+          }
+          memoized = instruction.b;
+        }
+        size_t callee_base = base + program->register_count();
+        size_t needed = callee_base + callee.register_count();
+        if (needed > registers_.size()) {
+          registers_.resize(std::max(needed, 2 * registers_.size()));
+          r = registers_.data() + base;
+        }
+        int64_t* window = registers_.data() + callee_base;
+        std::copy_n(r + instruction.c, callee.parameter_count(), window);
+        std::copy(callee.constants().begin(), callee.constants().end(),
+                  window + callee.constant_base());
+        calls_.push_back(
+            {program, pc, base, instruction.a, instruction.c, memoized});
+        program = &callee;
+        code = callee.code().data();
+        pc = code;
+        base = callee_base;
+        r = window;
+        break;
+      }
+    }
+  }
+}
+
+}  // namespace simp
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "memo/memo_cache.h"
+#include "vm/bytecode.h"
+
+namespace simp {
+// Runs a compiled Program. The register file is allocated and the constant
+// registers are filled once, so a program can be run repeatedly without
+// touching the heap. Calls grow the register file by the callee's window the
+// first time they reach a new depth. Calls to the functions memo_cache
+// memoizes go through it.
+class Vm {
+ public:
+  explicit Vm(const Program& program, MemoCache* memo_cache = nullptr)
+      : program_(program),
+        memo_cache_(memo_cache),
+        registers_(program.register_count()) {
+    std::copy(program.constants().begin(), program.constants().end(),
+              registers_.begin() + program.constant_base());
+  }
+
+  // The arguments go to the program's parameter registers.
+  int64_t run(const std::vector<int64_t>& arguments = {});
+
+ private:
+  // Where to continue once a callee returns.
+  struct Call {
+    const Program* program;
+    const Instruction* pc;
+    size_t base;
+    uint16_t result;
+    // The callee, if its result goes into memo_cache_, and the caller's
+    // registers holding the arguments, which the callee never touches.
+    uint16_t arguments;
+    uint32_t memoized;
+  };
+  static constexpr uint32_t kNotMemoized = UINT32_MAX;
+
+  const Program& program_;
+  MemoCache* memo_cache_;
+  std::vector<int64_t> registers_;
+  std::vector<Call> calls_;
+};
+}  // namespace simp
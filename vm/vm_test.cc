@@ -0,0 +1,121 @@
+#include "vm/vm.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "parser/parser.h"
+#include "vm/compiler.h"
+
+namespace simp {
+namespace {
+using ::testing::Eq;
+using ::testing::NotNull;
+class VmTest : public ::testing::Test {
+ protected:
+  VmTest() {}
+  ~VmTest() override {}
+  void SetUp() override {}
+
+  std::unique_ptr<Ast> parse(const std::string& file) {
+    Parser parser(file);
+    EXPECT_TRUE(parser.parse());
+    return parser.ast();
+  }
+};
+
+TEST_F(VmTest, InstructionsAreCompact) {
+  EXPECT_THAT(sizeof(Instruction), Eq(8));
+}
+
+TEST_F(VmTest, RunsIntExpression) {
+  auto ast = parse("examples/just_nums.sl");
+  auto program = BytecodeCompiler().compile(*ast);
+  ASSERT_THAT(program, NotNull());
+  // One temporary for the result followed by one constant register.
+  EXPECT_THAT(program->code().size(), Eq(2));
+  EXPECT_THAT(program->register_count(), Eq(2));
+  EXPECT_THAT(program->constant_base(), Eq(1));
+  Vm vm(*program);
+  EXPECT_THAT(vm.run(), Eq(1234567890));
+}
+
+TEST_F(VmTest, RunsIfExpression) {
+  auto ast = parse("examples/if_statement.sl");
+  auto program = BytecodeCompiler().compile(*ast);
+  ASSERT_THAT(program, NotNull());
+  Vm vm(*program);
+  EXPECT_THAT(vm.run(), Eq(2));
+}
+
+TEST_F(VmTest, RunsLogicalExpression) {
+  auto ast = parse("examples/logical_expression.sl");
+  auto program = BytecodeCompiler().compile(*ast);
+  ASSERT_THAT(program, NotNull());
+  Vm vm(*program);
+  EXPECT_THAT(vm.run(), Eq(1));
+}
+
+TEST_F(VmTest, UsesConstantRegistersAsOperands) {
+  auto ast = parse("examples/overflow.sl");
+  auto program = BytecodeCompiler().compile(*ast);
+  ASSERT_THAT(program, NotNull());
+  ASSERT_THAT(program->code().size(), Eq(2));
+  EXPECT_THAT(program->code()[0].op, Eq(OpCode::ADD));
+  EXPECT_THAT(program->code()[0].b, Eq(program->constant_base()));
+  EXPECT_THAT(program->code()[0].c, Eq(program->constant_base() + 1));
+}
+
+TEST_F(VmTest, WrapsOnOverflow) {
+  auto ast = parse("examples/overflow.sl");
+  auto program = BytecodeCompiler().compile(*ast);
+  ASSERT_THAT(program, NotNull());
+  Vm vm(*program);
+  EXPECT_THAT(vm.run(), Eq(INT64_MIN));
+}
+
+TEST_F(VmTest, RunsLoopInConstantStack) {
+  auto ast = parse("examples/long_loop.sl");
+  auto program = BytecodeCompiler().compile(*ast);
+  ASSERT_THAT(program, NotNull());
+  Vm vm(*program);
+  EXPECT_THAT(vm.run(), Eq(49999995000000));
+}
+
+TEST_F(VmTest, CallsFunctionsInRegisterWindows) {
+  auto ast = parse("examples/nextprime.sl");
+  auto program = BytecodeCompiler().compile(*ast);
+  ASSERT_THAT(program, NotNull());
+  EXPECT_THAT(program->functions().size(), Eq(12));
+  EXPECT_THAT(program->parameter_count(), Eq(1));
+  // The input is moved into the argument register, then main is called.
+  ASSERT_THAT(program->code()[1].op, Eq(OpCode::CALL));
+  EXPECT_THAT(program->code()[1].b, Eq(11));
+  Vm vm(*program);
+  // leadingzeros recurses 64 deep, growing the register file as it goes.
+  for (int64_t n : {1, 100, 1000000, 2147483647}) {
+    EXPECT_THAT(vm.run({n}), Eq(ast->eval({n}))) << n;
+  }
+}
+
+TEST_F(VmTest, MatchesTreeEvaluation) {
+  for (std::string file :
+       {"examples/just_nums.sl", "examples/if_statement.sl",
+        "examples/not_expression.sl", "examples/negative_expression.sl",
+        "examples/parenthesized_expression.sl",
+        "examples/logical_expression.sl", "examples/overflow.sl",
+        "examples/shadowing.sl", "examples/factorial_loop.sl",
+        "examples/shiftl_loop.sl", "examples/swap_loop.sl",
+        "examples/nested_loop.sl", "examples/functions.sl",
+        "examples/intrinsics.sl"}) {
+    auto ast = parse(file);
+    auto program = BytecodeCompiler().compile(*ast);
+    ASSERT_THAT(program, NotNull()) << file;
+    Vm vm(*program);
+    EXPECT_THAT(vm.run(), Eq(ast->eval())) << file;
+    // Running again reuses the register file and gives the same result.
+    EXPECT_THAT(vm.run(), Eq(ast->eval())) << file;
+  }
+}
+
+}  // namespace
+}  // namespace simp